@@ -53,6 +53,29 @@ static std::initializer_list<Encoding> const encodingTable = {
 #endif
 };
 
+//--------------------------------------------------------------
+// Table describing the supported decompression modes. (Used to
+// decode request bodies.)
+//--------------------------------------------------------------
+
+struct Decoding {
+    char const                                        * name;
+    std::function<std::unique_ptr<StreamDecoder>()>     factory;
+};
+
+static std::initializer_list<Decoding> const decodingTable = {
+#if defined(ZINC_COMPRESSION_GZIP)
+    { "gzip",       [] () { return std::make_unique<StreamInflate>(true); }     },
+    { "x-gzip",     [] () { return std::make_unique<StreamInflate>(true); }     },
+#endif
+#if defined(ZINC_COMPRESSION_DEFLATE)
+    { "deflate",    [] () { return std::make_unique<StreamInflate>(false); }    },
+#endif
+#if defined(ZINC_COMPRESSION_BROTLI)
+    { "br",         [] () { return std::make_unique<StreamBrotliDecoder>(); }   },
+#endif
+};
+
 //--------------------------------------------------------------
 // Return the normalised encoding name for a given compression 
 // mode.
@@ -124,4 +147,15 @@ std::unique_ptr<OutputStream> makeStreamTransformer(compression::mode mode, long
     return (got != encodingTable.end()) ? got->factory(length) : std::unique_ptr<OutputStream>();
 }
 
+//--------------------------------------------------------------
+// Make a stream decoder for the specified encoding name, as found
+// in a Content-Encoding header. Return a null pointer if this
+// encoding is not supported.
+//--------------------------------------------------------------
+
+std::unique_ptr<StreamDecoder> makeStreamDecoder(std::string const & name) {
+    auto got = std::find_if(decodingTable.begin(), decodingTable.end(), [&name] (Decoding const & x) { return x.name == name; });
+    return (got != decodingTable.end()) ? got->factory() : std::unique_ptr<StreamDecoder>();
+}
+
 //========================================================================
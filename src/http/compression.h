@@ -30,6 +30,7 @@
 #include "stream.h"
 
 class Mime;
+class StreamDecoder;
 
 //--------------------------------------------------------------
 // HTTP compression handling.
@@ -69,6 +70,7 @@ std::string                     getCompressionName(compression::mode mode);
 compression::set                parseAcceptedEncodings(std::string const & str);
 compression::mode               selectCompressionMode(compression::set accepted, Mime const & mimetype);
 std::unique_ptr<OutputStream>   makeStreamTransformer(compression::mode mode, long length);
+std::unique_ptr<StreamDecoder>  makeStreamDecoder(std::string const & name);
 
 //--------------------------------------------------------------
 
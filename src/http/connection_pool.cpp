@@ -0,0 +1,100 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#include "../misc/logger.h"
+#include "connection_pool.h"
+
+//========================================================================
+// ConnectionPool
+//
+// Idle keep-alive connections to upstream servers (HTTP servers, FastCGI
+// backends), shared by all the worker threads. The most recently used
+// connections are reused first, so that the others expire, and
+// connections idle for too long are closed.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+ConnectionPool::ConnectionPool(std::chrono::seconds idleTimeout, size_t maxIdle)
+  : idleTimeout_(idleTimeout),
+    maxIdle_(maxIdle) {
+    LOG_TRACE("Init ConnectionPool");
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+ConnectionPool::~ConnectionPool() {
+    LOG_TRACE("Destroy ConnectionPool");
+}
+
+//--------------------------------------------------------------
+// Take an idle connection to the given server. Return an invalid
+// socket if there is none. A connection that became readable
+// while idle was closed by the server (or received garbage) and
+// is discarded.
+//--------------------------------------------------------------
+
+StreamSocket ConnectionPool::acquire(AddrIPv4 const & address) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = idle_.begin(); it != idle_.end(); ) {
+        if (now - it->since > idleTimeout_) {
+            it = idle_.erase(it);
+        } else if (it->address == address) {
+            StreamSocket socket = std::move(it->socket);
+            it = idle_.erase(it);
+            if (socket.select(std::chrono::milliseconds(0)) == 0) {
+                LOG_INFO("Reusing upstream connection on socket " << socket);
+                return socket;
+            }
+        } else {
+            ++it;
+        }
+    }
+    return StreamSocket();
+}
+
+//--------------------------------------------------------------
+// Give a connection back to the pool. If there are too many idle
+// connections to the same server, the oldest one is closed.
+//--------------------------------------------------------------
+
+void ConnectionPool::release(AddrIPv4 const & address, StreamSocket & socket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    for (auto it = idle_.begin(); it != idle_.end(); ) {
+        if (it->address == address && ++count >= maxIdle_) {
+            it = idle_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    idle_.push_front(Idle{ address, std::move(socket), std::chrono::steady_clock::now() });
+}
+
+//========================================================================
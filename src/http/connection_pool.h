@@ -0,0 +1,63 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <list>
+#include <mutex>
+#include <chrono>
+
+#include "stream_socket.h"
+
+//--------------------------------------------------------------
+// Pool of idle keep-alive connections to upstream servers.
+//--------------------------------------------------------------
+
+class ConnectionPool {
+public:
+    ConnectionPool(std::chrono::seconds idleTimeout, size_t maxIdle);
+    ~ConnectionPool();
+
+    StreamSocket    acquire(AddrIPv4 const & address);
+    void            release(AddrIPv4 const & address, StreamSocket & socket);
+
+private:
+    struct Idle {
+        AddrIPv4                                address;    // server the connection is established with
+        StreamSocket                            socket;     // the connection itself
+        std::chrono::steady_clock::time_point   since;      // moment the connection became idle
+    };
+
+    std::chrono::seconds    idleTimeout_;                   // idle connections older than this are closed
+    size_t                  maxIdle_;                       // maximum number of idle connections to the same server
+    std::mutex              mutex_;                         // thread synchronization
+    std::list<Idle>         idle_;                          // idle connections, most recently released first
+};
+
+//--------------------------------------------------------------
+
+#endif
+
+//========================================================================
@@ -0,0 +1,292 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+
+#include "../misc/logger.h"
+#include "event_hub.h"
+
+//========================================================================
+// EventHub
+//
+// Events pushed to the clients of an event stream. See the Server-Sent
+// Events section of the HTML standard for the wire format. Each event is
+// serialized once when it is published. The clients then copy the bytes
+// as they are, however many they are.
+//
+// The most recent events are kept in a bounded ring, so that a client
+// that reconnects with a Last-Event-ID header gets the events it missed.
+// Identifiers start from the current time in microseconds. This way
+// they keep increasing across server restarts, and a client coming back
+// after a restart gets the whole ring instead of nothing.
+//
+// Clients waiting in a thread block on a condition variable. Clients
+// waiting in a reactor poll a signal, which is a pipe: publishing an
+// event closes its write end, which wakes all the pollers at once with
+// a single system call, whatever their number. The next event uses a
+// new pipe, created only if someone waits for it.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+EventHub::EventHub(size_t capacity)
+  : capacity_(capacity),
+    lastId_(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count())),
+    closed_(false),
+    fired_(std::make_shared<Signal>(true)) {
+    LOG_TRACE("Init EventHub");
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+EventHub::~EventHub() {
+    LOG_TRACE("Destroy EventHub");
+}
+
+//--------------------------------------------------------------
+// Publish an event, with an optional type, and wake the clients
+// waiting for it. Return the event identifier.
+//--------------------------------------------------------------
+
+uint64_t EventHub::publish(std::string const & data, std::string const & type) {
+    std::shared_ptr<Signal> signal;
+    uint64_t id;
+    if (true) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = ++lastId_;
+        if (capacity_ > 0) {
+            if (events_.size() >= capacity_) {
+                events_.pop_front();
+            }
+            events_.push_back({ id, serialize(id, data, type) });
+        }
+        signal = std::move(signal_);
+    }
+    condition_.notify_all();
+    if (signal) {
+        signal->fire();
+    }
+    LOG_TRACE("Event " << id << " published");
+    return id;
+}
+
+//--------------------------------------------------------------
+// Append to the output the events published after the one the
+// cursor points to, and move the cursor to the last event. If
+// some of them are not kept anymore, they are skipped. Return
+// the number of events appended.
+//--------------------------------------------------------------
+
+size_t EventHub::fetch(uint64_t & cursor, std::string & output) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    if (cursor < lastId_ && !events_.empty()) {
+        uint64_t first = events_.front().id;
+        size_t ndx = cursor < first ? 0 : static_cast<size_t>(cursor - first + 1);
+        for ( ; ndx < events_.size(); ndx++) {
+            output.append(events_[ndx].text);
+            count++;
+        }
+    }
+    cursor = lastId_;
+    return count;
+}
+
+//--------------------------------------------------------------
+// Return the cursor a client starts from, given the identifier of
+// the last event it received (i.e. the Last-Event-ID header). A
+// new client starts with the next event.
+//--------------------------------------------------------------
+
+uint64_t EventHub::seek(std::string const & lastEventId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    char * end;
+    uint64_t id = std::strtoull(lastEventId.c_str(), &end, 10);
+    if (lastEventId.empty() || *end != 0) {
+        return lastId_;
+    }
+    return std::min(id, lastId_);
+}
+
+//--------------------------------------------------------------
+// Wait until an event is published after the one the cursor
+// points to, or the timeout expires. Return true if there is an
+// event to fetch.
+//--------------------------------------------------------------
+
+bool EventHub::wait(uint64_t cursor, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return condition_.wait_for(lock, timeout, [&] { return lastId_ > cursor || closed_; }) && !closed_;
+}
+
+//--------------------------------------------------------------
+// Return a signal to poll, which is ready when an event is
+// published after the one the cursor points to. (Right away if
+// there is one already.)
+//--------------------------------------------------------------
+
+std::shared_ptr<EventHub::Signal> EventHub::watch(uint64_t cursor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (lastId_ > cursor || closed_) {
+        return fired_;
+    }
+    if (!signal_) {
+        signal_ = std::make_shared<Signal>(false);
+    }
+    return signal_;
+}
+
+//--------------------------------------------------------------
+// Wake up all the clients for good: the server is shutting down.
+//--------------------------------------------------------------
+
+void EventHub::close() {
+    std::shared_ptr<Signal> signal;
+    if (true) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        signal = std::move(signal_);
+    }
+    condition_.notify_all();
+    if (signal) {
+        signal->fire();
+    }
+}
+
+//--------------------------------------------------------------
+// Indicate whether the server is shutting down.
+//--------------------------------------------------------------
+
+bool EventHub::isClosed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+//--------------------------------------------------------------
+// Change the number of events kept.
+//--------------------------------------------------------------
+
+void EventHub::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    while (events_.size() > capacity_) {
+        events_.pop_front();
+    }
+}
+
+//--------------------------------------------------------------
+// Serialize an event. Each line of the data is sent in its own
+// field. As for the client, a line ends with CR, LF or CRLF, so
+// that a lone CR cannot start a field of its own. Line breaks are
+// not allowed in the type.
+//--------------------------------------------------------------
+
+std::string EventHub::serialize(uint64_t id, std::string const & data, std::string const & type) {
+    std::string text = "id: " + std::to_string(id) + "\n";
+    if (!type.empty()) {
+        text.append("event: ");
+        std::remove_copy_if(type.begin(), type.end(), std::back_inserter(text), [] (char ch) { return ch == '\r' || ch == '\n'; });
+        text.push_back('\n');
+    }
+
+    size_t start = 0;
+    for ( ; ; ) {
+        size_t end = data.find_first_of("\r\n", start);
+        size_t len = (end == std::string::npos ? data.size() : end) - start;
+        text.append("data: ").append(data, start, len).push_back('\n');
+        if (end == std::string::npos) {
+            break;
+        }
+        start = data.compare(end, 2, "\r\n") == 0 ? end + 2 : end + 1;
+    }
+
+    text.push_back('\n');
+    return text;
+}
+
+//========================================================================
+// EventHub::Signal
+//
+// Pipe that nothing is ever written to. Closing its write end makes its
+// read end ready (end of file) for all the pollers, for good. Signals
+// are only used by reactors, which are not available on Windows.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor. Create the pipe, and fire it at once if requested.
+//--------------------------------------------------------------
+
+EventHub::Signal::Signal(bool fired)
+  : pipe_ { -1, -1 } {
+#ifndef _WIN32
+    if (pipe(pipe_) == 0) {
+        for (int fd: pipe_) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    } else {
+        LOG_ERROR("Error creating event signal pipe");
+    }
+#endif
+    if (fired) {
+        fire();
+    }
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+EventHub::Signal::~Signal() {
+#ifndef _WIN32
+    for (int fd: pipe_) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+#endif
+}
+
+//--------------------------------------------------------------
+// Fire the signal.
+//--------------------------------------------------------------
+
+void EventHub::Signal::fire() {
+#ifndef _WIN32
+    if (pipe_[1] >= 0) {
+        ::close(pipe_[1]);
+        pipe_[1] = -1;
+    }
+#endif
+}
+
+//========================================================================
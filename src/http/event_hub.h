@@ -0,0 +1,89 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef EVENT_HUB_H
+#define EVENT_HUB_H
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+//--------------------------------------------------------------
+// Events pushed to the clients of an event stream (Server-Sent
+// Events), with the most recent ones kept for clients that
+// reconnect.
+//--------------------------------------------------------------
+
+class EventHub {
+public:
+    EventHub(size_t capacity);
+    ~EventHub();
+
+    class Signal {                              // descriptor that becomes ready when an event is published
+    public:
+        Signal(bool fired);
+        ~Signal();
+
+        int     getHandle() const                           { return pipe_[0];  }
+        void    fire();
+
+    private:
+        int     pipe_[2];                       // pipe whose write end is closed to fire the signal
+    };
+
+    uint64_t                publish(std::string const & data, std::string const & type = std::string());
+    size_t                  fetch(uint64_t & cursor, std::string & output);
+    uint64_t                seek(std::string const & lastEventId);
+    bool                    wait(uint64_t cursor, std::chrono::milliseconds timeout);
+    std::shared_ptr<Signal> watch(uint64_t cursor);
+    void                    close();
+    bool                    isClosed();
+    void                    setCapacity(size_t capacity);
+
+    static std::string      serialize(uint64_t id, std::string const & data, std::string const & type);
+
+private:
+    struct Event {
+        uint64_t        id;                     // event identifier
+        std::string     text;                   // event, as sent to the clients
+    };
+
+    std::deque<Event>               events_;    // most recent events, oldest first
+    size_t                          capacity_;  // maximum number of events kept
+    uint64_t                        lastId_;    // identifier of the last event published
+    bool                            closed_;    // the server is shutting down
+    std::shared_ptr<Signal>         signal_;    // signal fired by the next event, if someone waits for it
+    std::shared_ptr<Signal>         fired_;     // signal always ready, for those who are late
+    std::mutex                      mutex_;     // thread synchronization
+    std::condition_variable         condition_; // thread synchronization
+};
+
+//--------------------------------------------------------------
+
+#endif
+
+//========================================================================
@@ -0,0 +1,655 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#ifdef ZINC_HTTP2
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "hpack.h"
+
+//========================================================================
+// hpack
+//
+// Implementation of HPACK (RFC 7541), the header compression format of
+// HTTP/2. A header block is a sequence of representations that either
+// reference an entry of the indexing table or carry a literal name and/or
+// value, possibly Huffman coded. Both the encoder and the decoder maintain
+// a dynamic table that must stay synchronized with the peer, which is
+// why header blocks must be decoded (and encoded) in the exact order
+// they are transmitted on the connection.
+//========================================================================
+
+namespace {
+
+//--------------------------------------------------------------
+// Static table (RFC 7541, Appendix A).
+//--------------------------------------------------------------
+
+struct StaticEntry {
+    char const * name;
+    char const * value;
+};
+
+StaticEntry const kStaticTable[] = {
+        { ":authority",                  "" },
+        { ":method",                     "GET" },
+        { ":method",                     "POST" },
+        { ":path",                       "/" },
+        { ":path",                       "/index.html" },
+        { ":scheme",                     "http" },
+        { ":scheme",                     "https" },
+        { ":status",                     "200" },
+        { ":status",                     "204" },
+        { ":status",                     "206" },
+        { ":status",                     "304" },
+        { ":status",                     "400" },
+        { ":status",                     "404" },
+        { ":status",                     "500" },
+        { "accept-charset",              "" },
+        { "accept-encoding",             "gzip, deflate" },
+        { "accept-language",             "" },
+        { "accept-ranges",               "" },
+        { "accept",                      "" },
+        { "access-control-allow-origin", "" },
+        { "age",                         "" },
+        { "allow",                       "" },
+        { "authorization",               "" },
+        { "cache-control",               "" },
+        { "content-disposition",         "" },
+        { "content-encoding",            "" },
+        { "content-language",            "" },
+        { "content-length",              "" },
+        { "content-location",            "" },
+        { "content-range",               "" },
+        { "content-type",                "" },
+        { "cookie",                      "" },
+        { "date",                        "" },
+        { "etag",                        "" },
+        { "expect",                      "" },
+        { "expires",                     "" },
+        { "from",                        "" },
+        { "host",                        "" },
+        { "if-match",                    "" },
+        { "if-modified-since",           "" },
+        { "if-none-match",               "" },
+        { "if-range",                    "" },
+        { "if-unmodified-since",         "" },
+        { "last-modified",               "" },
+        { "link",                        "" },
+        { "location",                    "" },
+        { "max-forwards",                "" },
+        { "proxy-authenticate",          "" },
+        { "proxy-authorization",         "" },
+        { "range",                       "" },
+        { "referer",                     "" },
+        { "refresh",                     "" },
+        { "retry-after",                 "" },
+        { "server",                      "" },
+        { "set-cookie",                  "" },
+        { "strict-transport-security",   "" },
+        { "transfer-encoding",           "" },
+        { "user-agent",                  "" },
+        { "vary",                        "" },
+        { "via",                         "" },
+        { "www-authenticate",            "" },
+};
+
+size_t const kStaticCount = sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+//--------------------------------------------------------------
+// Huffman code (RFC 7541, Appendix B). The last entry is EOS.
+//--------------------------------------------------------------
+
+struct HuffmanCode {
+    uint32_t code;
+    int      length;
+};
+
+HuffmanCode const kHuffmanTable[257] = {
+    { 0x00001ff8, 13 }, { 0x007fffd8, 23 }, { 0x0fffffe2, 28 }, { 0x0fffffe3, 28 },
+    { 0x0fffffe4, 28 }, { 0x0fffffe5, 28 }, { 0x0fffffe6, 28 }, { 0x0fffffe7, 28 },
+    { 0x0fffffe8, 28 }, { 0x00ffffea, 24 }, { 0x3ffffffc, 30 }, { 0x0fffffe9, 28 },
+    { 0x0fffffea, 28 }, { 0x3ffffffd, 30 }, { 0x0fffffeb, 28 }, { 0x0fffffec, 28 },
+    { 0x0fffffed, 28 }, { 0x0fffffee, 28 }, { 0x0fffffef, 28 }, { 0x0ffffff0, 28 },
+    { 0x0ffffff1, 28 }, { 0x0ffffff2, 28 }, { 0x3ffffffe, 30 }, { 0x0ffffff3, 28 },
+    { 0x0ffffff4, 28 }, { 0x0ffffff5, 28 }, { 0x0ffffff6, 28 }, { 0x0ffffff7, 28 },
+    { 0x0ffffff8, 28 }, { 0x0ffffff9, 28 }, { 0x0ffffffa, 28 }, { 0x0ffffffb, 28 },
+    { 0x00000014,  6 }, { 0x000003f8, 10 }, { 0x000003f9, 10 }, { 0x00000ffa, 12 },
+    { 0x00001ff9, 13 }, { 0x00000015,  6 }, { 0x000000f8,  8 }, { 0x000007fa, 11 },
+    { 0x000003fa, 10 }, { 0x000003fb, 10 }, { 0x000000f9,  8 }, { 0x000007fb, 11 },
+    { 0x000000fa,  8 }, { 0x00000016,  6 }, { 0x00000017,  6 }, { 0x00000018,  6 },
+    { 0x00000000,  5 }, { 0x00000001,  5 }, { 0x00000002,  5 }, { 0x00000019,  6 },
+    { 0x0000001a,  6 }, { 0x0000001b,  6 }, { 0x0000001c,  6 }, { 0x0000001d,  6 },
+    { 0x0000001e,  6 }, { 0x0000001f,  6 }, { 0x0000005c,  7 }, { 0x000000fb,  8 },
+    { 0x00007ffc, 15 }, { 0x00000020,  6 }, { 0x00000ffb, 12 }, { 0x000003fc, 10 },
+    { 0x00001ffa, 13 }, { 0x00000021,  6 }, { 0x0000005d,  7 }, { 0x0000005e,  7 },
+    { 0x0000005f,  7 }, { 0x00000060,  7 }, { 0x00000061,  7 }, { 0x00000062,  7 },
+    { 0x00000063,  7 }, { 0x00000064,  7 }, { 0x00000065,  7 }, { 0x00000066,  7 },
+    { 0x00000067,  7 }, { 0x00000068,  7 }, { 0x00000069,  7 }, { 0x0000006a,  7 },
+    { 0x0000006b,  7 }, { 0x0000006c,  7 }, { 0x0000006d,  7 }, { 0x0000006e,  7 },
+    { 0x0000006f,  7 }, { 0x00000070,  7 }, { 0x00000071,  7 }, { 0x00000072,  7 },
+    { 0x000000fc,  8 }, { 0x00000073,  7 }, { 0x000000fd,  8 }, { 0x00001ffb, 13 },
+    { 0x0007fff0, 19 }, { 0x00001ffc, 13 }, { 0x00003ffc, 14 }, { 0x00000022,  6 },
+    { 0x00007ffd, 15 }, { 0x00000003,  5 }, { 0x00000023,  6 }, { 0x00000004,  5 },
+    { 0x00000024,  6 }, { 0x00000005,  5 }, { 0x00000025,  6 }, { 0x00000026,  6 },
+    { 0x00000027,  6 }, { 0x00000006,  5 }, { 0x00000074,  7 }, { 0x00000075,  7 },
+    { 0x00000028,  6 }, { 0x00000029,  6 }, { 0x0000002a,  6 }, { 0x00000007,  5 },
+    { 0x0000002b,  6 }, { 0x00000076,  7 }, { 0x0000002c,  6 }, { 0x00000008,  5 },
+    { 0x00000009,  5 }, { 0x0000002d,  6 }, { 0x00000077,  7 }, { 0x00000078,  7 },
+    { 0x00000079,  7 }, { 0x0000007a,  7 }, { 0x0000007b,  7 }, { 0x00007ffe, 15 },
+    { 0x000007fc, 11 }, { 0x00003ffd, 14 }, { 0x00001ffd, 13 }, { 0x0ffffffc, 28 },
+    { 0x000fffe6, 20 }, { 0x003fffd2, 22 }, { 0x000fffe7, 20 }, { 0x000fffe8, 20 },
+    { 0x003fffd3, 22 }, { 0x003fffd4, 22 }, { 0x003fffd5, 22 }, { 0x007fffd9, 23 },
+    { 0x003fffd6, 22 }, { 0x007fffda, 23 }, { 0x007fffdb, 23 }, { 0x007fffdc, 23 },
+    { 0x007fffdd, 23 }, { 0x007fffde, 23 }, { 0x00ffffeb, 24 }, { 0x007fffdf, 23 },
+    { 0x00ffffec, 24 }, { 0x00ffffed, 24 }, { 0x003fffd7, 22 }, { 0x007fffe0, 23 },
+    { 0x00ffffee, 24 }, { 0x007fffe1, 23 }, { 0x007fffe2, 23 }, { 0x007fffe3, 23 },
+    { 0x007fffe4, 23 }, { 0x001fffdc, 21 }, { 0x003fffd8, 22 }, { 0x007fffe5, 23 },
+    { 0x003fffd9, 22 }, { 0x007fffe6, 23 }, { 0x007fffe7, 23 }, { 0x00ffffef, 24 },
+    { 0x003fffda, 22 }, { 0x001fffdd, 21 }, { 0x000fffe9, 20 }, { 0x003fffdb, 22 },
+    { 0x003fffdc, 22 }, { 0x007fffe8, 23 }, { 0x007fffe9, 23 }, { 0x001fffde, 21 },
+    { 0x007fffea, 23 }, { 0x003fffdd, 22 }, { 0x003fffde, 22 }, { 0x00fffff0, 24 },
+    { 0x001fffdf, 21 }, { 0x003fffdf, 22 }, { 0x007fffeb, 23 }, { 0x007fffec, 23 },
+    { 0x001fffe0, 21 }, { 0x001fffe1, 21 }, { 0x003fffe0, 22 }, { 0x001fffe2, 21 },
+    { 0x007fffed, 23 }, { 0x003fffe1, 22 }, { 0x007fffee, 23 }, { 0x007fffef, 23 },
+    { 0x000fffea, 20 }, { 0x003fffe2, 22 }, { 0x003fffe3, 22 }, { 0x003fffe4, 22 },
+    { 0x007ffff0, 23 }, { 0x003fffe5, 22 }, { 0x003fffe6, 22 }, { 0x007ffff1, 23 },
+    { 0x03ffffe0, 26 }, { 0x03ffffe1, 26 }, { 0x000fffeb, 20 }, { 0x0007fff1, 19 },
+    { 0x003fffe7, 22 }, { 0x007ffff2, 23 }, { 0x003fffe8, 22 }, { 0x01ffffec, 25 },
+    { 0x03ffffe2, 26 }, { 0x03ffffe3, 26 }, { 0x03ffffe4, 26 }, { 0x07ffffde, 27 },
+    { 0x07ffffdf, 27 }, { 0x03ffffe5, 26 }, { 0x00fffff1, 24 }, { 0x01ffffed, 25 },
+    { 0x0007fff2, 19 }, { 0x001fffe3, 21 }, { 0x03ffffe6, 26 }, { 0x07ffffe0, 27 },
+    { 0x07ffffe1, 27 }, { 0x03ffffe7, 26 }, { 0x07ffffe2, 27 }, { 0x00fffff2, 24 },
+    { 0x001fffe4, 21 }, { 0x001fffe5, 21 }, { 0x03ffffe8, 26 }, { 0x03ffffe9, 26 },
+    { 0x0ffffffd, 28 }, { 0x07ffffe3, 27 }, { 0x07ffffe4, 27 }, { 0x07ffffe5, 27 },
+    { 0x000fffec, 20 }, { 0x00fffff3, 24 }, { 0x000fffed, 20 }, { 0x001fffe6, 21 },
+    { 0x003fffe9, 22 }, { 0x001fffe7, 21 }, { 0x001fffe8, 21 }, { 0x007ffff3, 23 },
+    { 0x003fffea, 22 }, { 0x003fffeb, 22 }, { 0x01ffffee, 25 }, { 0x01ffffef, 25 },
+    { 0x00fffff4, 24 }, { 0x00fffff5, 24 }, { 0x03ffffea, 26 }, { 0x007ffff4, 23 },
+    { 0x03ffffeb, 26 }, { 0x07ffffe6, 27 }, { 0x03ffffec, 26 }, { 0x03ffffed, 26 },
+    { 0x07ffffe7, 27 }, { 0x07ffffe8, 27 }, { 0x07ffffe9, 27 }, { 0x07ffffea, 27 },
+    { 0x07ffffeb, 27 }, { 0x0ffffffe, 28 }, { 0x07ffffec, 27 }, { 0x07ffffed, 27 },
+    { 0x07ffffee, 27 }, { 0x07ffffef, 27 }, { 0x07fffff0, 27 }, { 0x03ffffee, 26 },
+    { 0x3fffffff, 30 },
+};
+
+//--------------------------------------------------------------
+// Decoding tables derived from the Huffman code. Codes of a given
+// length are consecutive numbers, so a code can be decoded by
+// comparing it with the first code of its length.
+//--------------------------------------------------------------
+
+class HuffmanDecodingTable {
+public:
+    HuffmanDecodingTable() : first_(), count_(), offset_() {
+        std::array<uint16_t, 257> order;
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = static_cast<uint16_t>(i);
+        }
+        std::sort(order.begin(), order.end(), [](uint16_t a, uint16_t b) {
+            return kHuffmanTable[a].length != kHuffmanTable[b].length ? kHuffmanTable[a].length < kHuffmanTable[b].length : kHuffmanTable[a].code < kHuffmanTable[b].code;
+        });
+        for (size_t i = order.size(); i-- > 0; ) {
+            int len = kHuffmanTable[order[i]].length;
+            first_[len] = kHuffmanTable[order[i]].code;
+            offset_[len] = static_cast<uint16_t>(i);
+            count_[len]++;
+        }
+        symbols_ = order;
+    }
+
+    int lookup(uint32_t code, int length) const {
+        if (count_[length] && code >= first_[length] && code - first_[length] < count_[length]) {
+            return symbols_[offset_[length] + code - first_[length]];
+        }
+        return -1;
+    }
+
+private:
+    uint32_t                    first_[31];     // first code of each length
+    uint32_t                    count_[31];     // number of codes of each length
+    uint16_t                    offset_[31];    // index in symbols_ of the first code of each length
+    std::array<uint16_t, 257>   symbols_;       // symbols sorted by code length then code
+};
+
+//--------------------------------------------------------------
+// Return whether a header field should never be indexed, or
+// should not be indexed because its value changes with each
+// response.
+//--------------------------------------------------------------
+
+bool isSensitive(std::string const & name) {
+    return name == "set-cookie" || name == "authorization" || name == "proxy-authorization";
+}
+
+bool isVolatile(std::string const & name) {
+    return name == "date" || name == "content-length" || name == "etag" || name == "last-modified" || name == "age" || name == "expires";
+}
+
+}
+
+//========================================================================
+// hpack::Table
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+hpack::Table::Table(size_t capacity)
+  : size_(0),
+    capacity_(capacity) {
+}
+
+//--------------------------------------------------------------
+// Retrieve an entry by its index. Index 1 to 61 are static
+// entries, higher indexes are dynamic entries.
+//--------------------------------------------------------------
+
+bool hpack::Table::get(size_t index, Header & header) const {
+    if (index >= 1 && index <= kStaticCount) {
+        header.first = kStaticTable[index - 1].name;
+        header.second = kStaticTable[index - 1].value;
+        return true;
+    } else if (index > kStaticCount && index - kStaticCount - 1 < entries_.size()) {
+        header = entries_[index - kStaticCount - 1];
+        return true;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------
+// Look for an entry. Return the index of an entry matching both
+// the name and the value if there is one, otherwise the index
+// of an entry matching only the name, otherwise zero.
+//--------------------------------------------------------------
+
+size_t hpack::Table::find(Header const & header, bool & exact) const {
+    size_t found = 0;
+    exact = false;
+    for (size_t i = 0; i < kStaticCount; i++) {
+        if (header.first == kStaticTable[i].name) {
+            if (header.second == kStaticTable[i].value) {
+                exact = true;
+                return i + 1;
+            } else if (!found) {
+                found = i + 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < entries_.size(); i++) {
+        if (header.first == entries_[i].first) {
+            if (header.second == entries_[i].second) {
+                exact = true;
+                return i + kStaticCount + 1;
+            } else if (!found) {
+                found = i + kStaticCount + 1;
+            }
+        }
+    }
+    return found;
+}
+
+//--------------------------------------------------------------
+// Insert a new entry in the dynamic table, evicting the oldest
+// entries if needed. An entry bigger than the table empties it.
+//--------------------------------------------------------------
+
+void hpack::Table::insert(Header const & header) {
+    size_t size = header.first.size() + header.second.size() + 32;
+    if (size > capacity_) {
+        entries_.clear();
+        size_ = 0;
+    } else {
+        evict(size);
+        entries_.push_front(header);
+        size_ += size;
+    }
+}
+
+//--------------------------------------------------------------
+// Change the maximum size of the dynamic table.
+//--------------------------------------------------------------
+
+void hpack::Table::setCapacity(size_t capacity) {
+    capacity_ = capacity;
+    evict(0);
+}
+
+//--------------------------------------------------------------
+// Evict the oldest entries until there is enough room for a
+// new entry of the specified size.
+//--------------------------------------------------------------
+
+void hpack::Table::evict(size_t room) {
+    while (!entries_.empty() && size_ + room > capacity_) {
+        Header const & last = entries_.back();
+        size_ -= last.first.size() + last.second.size() + 32;
+        entries_.pop_back();
+    }
+}
+
+//========================================================================
+// hpack::Decoder
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor. The capacity is the table size advertised to
+// the peer in our SETTINGS frame.
+//--------------------------------------------------------------
+
+hpack::Decoder::Decoder(size_t capacity)
+  : table_(capacity),
+    limit_(capacity),
+    overflow_(false) {
+}
+
+//--------------------------------------------------------------
+// Decode a complete header block. Return false in case of
+// error, in which case the connection cannot be used anymore
+// (the table may be out of sync with the encoder). Decoding
+// also stops as soon as the header list exceeds the given size,
+// counted as for SETTINGS_MAX_HEADER_LIST_SIZE (name, value
+// and 32 bytes per field), since a small block can reference
+// large table entries many times.
+//--------------------------------------------------------------
+
+bool hpack::Decoder::decode(uint8_t const * data, size_t length, HeaderList & headers, size_t limit) {
+    uint8_t const * p = data;
+    uint8_t const * end = data + length;
+    bool start = true;
+    size_t size = 0;
+
+    overflow_ = false;
+    while (p < end) {
+        uint8_t b = *p;
+        size_t index;
+        Header header;
+
+        if (b & 0x80) {
+            // Indexed header field.
+            if (!decodeInteger(p, end, 7, index) || !table_.get(index, header)) {
+                return false;
+            }
+        } else if ((b & 0xE0) == 0x20) {
+            // Dynamic table size update, only allowed at the
+            // beginning of a block.
+            if (!start || !decodeInteger(p, end, 5, index) || index > limit_) {
+                return false;
+            }
+            table_.setCapacity(index);
+            continue;
+        } else {
+            // Literal header field, with incremental indexing,
+            // without indexing or never indexed.
+            bool indexing = (b & 0xC0) == 0x40;
+            if (!decodeInteger(p, end, indexing ? 6 : 4, index)) {
+                return false;
+            } else if (index) {
+                if (!table_.get(index, header)) {
+                    return false;
+                }
+            } else if (!decodeString(p, end, header.first)) {
+                return false;
+            }
+            if (!decodeString(p, end, header.second)) {
+                return false;
+            }
+            if (indexing) {
+                table_.insert(header);
+            }
+        }
+
+        size += header.first.size() + header.second.size() + 32;
+        if (size > limit) {
+            overflow_ = true;
+            return false;
+        }
+        headers.push_back(std::move(header));
+        start = false;
+    }
+
+    return true;
+}
+
+//========================================================================
+// hpack::Encoder
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor. The capacity is the largest table size we are
+// willing to use, the actual size being bounded by the limit
+// set by the peer.
+//--------------------------------------------------------------
+
+hpack::Encoder::Encoder(size_t capacity)
+  : table_(capacity),
+    maximum_(capacity),
+    lowest_(SIZE_MAX) {
+}
+
+//--------------------------------------------------------------
+// Apply the SETTINGS_HEADER_TABLE_SIZE received from the peer.
+// The change is signaled at the beginning of the next block.
+//--------------------------------------------------------------
+
+void hpack::Encoder::setLimit(size_t limit) {
+    size_t capacity = std::min(limit, maximum_);
+    if (capacity != table_.getCapacity() || lowest_ != SIZE_MAX) {
+        lowest_ = std::min(lowest_, capacity);
+        table_.setCapacity(capacity);
+    }
+}
+
+//--------------------------------------------------------------
+// Encode a list of headers.
+//--------------------------------------------------------------
+
+void hpack::Encoder::encode(HeaderList const & headers, std::vector<uint8_t> & block) {
+    if (lowest_ != SIZE_MAX) {
+        if (lowest_ < table_.getCapacity()) {
+            encodeInteger(block, 0x20, 5, lowest_);
+        }
+        encodeInteger(block, 0x20, 5, table_.getCapacity());
+        lowest_ = SIZE_MAX;
+    }
+
+    for (Header const & header: headers) {
+        bool exact;
+        size_t index = table_.find(header, exact);
+        if (exact) {
+            encodeInteger(block, 0x80, 7, index);
+        } else {
+            if (isSensitive(header.first)) {
+                encodeInteger(block, 0x10, 4, index);
+            } else if (isVolatile(header.first)) {
+                encodeInteger(block, 0x00, 4, index);
+            } else {
+                encodeInteger(block, 0x40, 6, index);
+                table_.insert(header);
+            }
+            if (!index) {
+                encodeString(block, header.first);
+            }
+            encodeString(block, header.second);
+        }
+    }
+}
+
+//========================================================================
+// Primitives
+//========================================================================
+
+//--------------------------------------------------------------
+// Encode an integer with a N-bit prefix (RFC 7541, 5.1). The
+// flags occupy the bits of the first byte above the prefix.
+//--------------------------------------------------------------
+
+void hpack::encodeInteger(std::vector<uint8_t> & out, uint8_t flags, int prefix, size_t value) {
+    size_t mask = (1u << prefix) - 1;
+    if (value < mask) {
+        out.push_back(static_cast<uint8_t>(flags | value));
+    } else {
+        out.push_back(static_cast<uint8_t>(flags | mask));
+        value -= mask;
+        while (value >= 128) {
+            out.push_back(static_cast<uint8_t>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+}
+
+//--------------------------------------------------------------
+// Decode an integer with a N-bit prefix. Values that do not
+// fit in 28 bits are rejected.
+//--------------------------------------------------------------
+
+bool hpack::decodeInteger(uint8_t const * & p, uint8_t const * end, int prefix, size_t & value) {
+    if (p >= end) {
+        return false;
+    }
+    size_t mask = (1u << prefix) - 1;
+    value = *p++ & mask;
+    if (value < mask) {
+        return true;
+    }
+    for (int shift = 0; p < end && shift <= 21; shift += 7) {
+        uint8_t b = *p++;
+        value += static_cast<size_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------------------
+// Encode a string literal, Huffman coded if that makes it
+// shorter.
+//--------------------------------------------------------------
+
+void hpack::encodeString(std::vector<uint8_t> & out, std::string const & str) {
+    size_t length = huffmanLength(str);
+    if (length < str.size()) {
+        encodeInteger(out, 0x80, 7, length);
+        huffmanEncode(out, str);
+    } else {
+        encodeInteger(out, 0x00, 7, str.size());
+        out.insert(out.end(), str.begin(), str.end());
+    }
+}
+
+//--------------------------------------------------------------
+// Decode a string literal.
+//--------------------------------------------------------------
+
+bool hpack::decodeString(uint8_t const * & p, uint8_t const * end, std::string & str) {
+    if (p >= end) {
+        return false;
+    }
+    bool huffman = (*p & 0x80) != 0;
+    size_t length;
+    if (!decodeInteger(p, end, 7, length) || length > static_cast<size_t>(end - p)) {
+        return false;
+    }
+    if (huffman) {
+        if (!huffmanDecode(p, length, str)) {
+            return false;
+        }
+    } else {
+        str.assign(reinterpret_cast<char const *>(p), length);
+    }
+    p += length;
+    return true;
+}
+
+//--------------------------------------------------------------
+// Huffman encode a string. The last byte is padded with the
+// most significant bits of EOS (i.e. with ones).
+//--------------------------------------------------------------
+
+void hpack::huffmanEncode(std::vector<uint8_t> & out, std::string const & str) {
+    uint64_t bits = 0;
+    int count = 0;
+    for (unsigned char ch: str) {
+        bits = (bits << kHuffmanTable[ch].length) | kHuffmanTable[ch].code;
+        count += kHuffmanTable[ch].length;
+        while (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<uint8_t>(bits >> count));
+        }
+    }
+    if (count) {
+        out.push_back(static_cast<uint8_t>((bits << (8 - count)) | (0xFF >> count)));
+    }
+}
+
+//--------------------------------------------------------------
+// Decode a Huffman coded string. Decoding EOS, padding longer
+// than 7 bits or padding not made of ones are errors.
+//--------------------------------------------------------------
+
+bool hpack::huffmanDecode(uint8_t const * data, size_t length, std::string & str) {
+    static HuffmanDecodingTable const table;
+
+    str.clear();
+    uint32_t code = 0;
+    int count = 0;
+    for (size_t i = 0; i < length; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            code = (code << 1) | ((data[i] >> bit) & 1);
+            if (++count > 30) {
+                return false;
+            }
+            int symbol = table.lookup(code, count);
+            if (symbol >= 256) {
+                return false;
+            } else if (symbol >= 0) {
+                str.push_back(static_cast<char>(symbol));
+                code = 0;
+                count = 0;
+            }
+        }
+    }
+    return count <= 7 && code == (1u << count) - 1;
+}
+
+//--------------------------------------------------------------
+// Return the length in bytes of the Huffman coding of a string.
+//--------------------------------------------------------------
+
+size_t hpack::huffmanLength(std::string const & str) {
+    size_t bits = 0;
+    for (unsigned char ch: str) {
+        bits += static_cast<size_t>(kHuffmanTable[ch].length);
+    }
+    return (bits + 7) / 8;
+}
+
+//========================================================================
+
+#endif
@@ -0,0 +1,119 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#ifndef HPACK_H
+#define HPACK_H
+
+#ifdef ZINC_HTTP2
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <cstdint>
+
+namespace hpack {
+
+typedef std::pair<std::string, std::string> Header;    // header field (lowercase name, value)
+typedef std::vector<Header>                 HeaderList; // ordered list of header fields
+
+//--------------------------------------------------------------
+// Indexing table (static entries followed by dynamic entries).
+//--------------------------------------------------------------
+
+class Table {
+public:
+    Table(size_t capacity);
+
+    bool    get(size_t index, Header & header) const;
+    size_t  find(Header const & header, bool & exact) const;
+    void    insert(Header const & header);
+    void    setCapacity(size_t capacity);
+
+    size_t  getSize() const                         { return size_;             }
+    size_t  getCapacity() const                     { return capacity_;         }
+    size_t  getCount() const                        { return entries_.size();   }
+
+private:
+    std::deque<Header>  entries_;       // dynamic entries, most recent first
+    size_t              size_;          // current size of the dynamic entries (as defined by RFC 7541)
+    size_t              capacity_;      // maximum size of the dynamic entries
+
+    void    evict(size_t room);
+};
+
+//--------------------------------------------------------------
+// Header block decoder.
+//--------------------------------------------------------------
+
+class Decoder {
+public:
+    Decoder(size_t capacity);
+
+    bool    decode(uint8_t const * data, size_t length, HeaderList & headers, size_t limit = SIZE_MAX);
+    bool    isOverflow() const                      { return overflow_;         }
+
+private:
+    Table   table_;                     // decoding table
+    size_t  limit_;                     // maximum table size we accept (our SETTINGS_HEADER_TABLE_SIZE)
+    bool    overflow_;                  // whether the last block exceeded the header list limit
+};
+
+//--------------------------------------------------------------
+// Header block encoder.
+//--------------------------------------------------------------
+
+class Encoder {
+public:
+    Encoder(size_t capacity);
+
+    void    encode(HeaderList const & headers, std::vector<uint8_t> & block);
+    void    setLimit(size_t limit);
+
+private:
+    Table   table_;                     // encoding table
+    size_t  maximum_;                   // largest table size we are willing to use
+    size_t  lowest_;                    // lowest table size since the last block (or SIZE_MAX if no change is pending)
+};
+
+//--------------------------------------------------------------
+// Primitives.
+//--------------------------------------------------------------
+
+void    encodeInteger(std::vector<uint8_t> & out, uint8_t flags, int prefix, size_t value);
+bool    decodeInteger(uint8_t const * & p, uint8_t const * end, int prefix, size_t & value);
+void    encodeString(std::vector<uint8_t> & out, std::string const & str);
+bool    decodeString(uint8_t const * & p, uint8_t const * end, std::string & str);
+void    huffmanEncode(std::vector<uint8_t> & out, std::string const & str);
+bool    huffmanDecode(uint8_t const * data, size_t length, std::string & str);
+size_t  huffmanLength(std::string const & str);
+
+//--------------------------------------------------------------
+
+}
+
+#endif
+#endif
+
+//========================================================================
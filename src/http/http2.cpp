@@ -0,0 +1,1197 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#ifdef ZINC_HTTP2
+
+#include <algorithm>
+#include <cstring>
+
+#include "../misc/logger.h"
+#include "../misc/string.h"
+#include "../misc/base64.h"
+#include "resource.h"
+#include "http_response.h"
+#include "http2.h"
+
+//========================================================================
+// Http2
+//
+// Implementation of HTTP/2 (RFC 7540) over cleartext TCP (h2c), either
+// with prior knowledge or after an upgrade from HTTP/1.1. The connection
+// is read by a single thread that decodes frames and header blocks in
+// order. Each stream is then processed by a worker thread that sees the
+// request as the equivalent HTTP/1.1 message, so that HttpRequest,
+// HttpResponse and the resources are shared with HTTP/1.x; the response
+// produced by HttpResponse is translated back into HEADERS and DATA
+// frames. Flow control is enforced in both directions. Priorities are
+// parsed and recorded, but streams are served in the order their data
+// become available.
+//========================================================================
+
+namespace {
+
+char const      kPreface[]      = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";  // client connection preface
+size_t const    kPrefaceLength  = sizeof(kPreface) - 1;
+size_t const    kMaxStreams     = 32;               // maximum number of concurrent streams
+int32_t const   kDefaultWindow  = 65535;            // initial flow control window defined by the protocol
+int32_t const   kWindowSize     = 1 << 20;          // flow control window we advertise, per stream and for the connection
+uint32_t const  kFrameSize      = 16384;            // maximum frame size we accept
+size_t const    kTableSize      = 4096;             // HPACK table size
+
+//--------------------------------------------------------------
+// Append a frame header to a buffer.
+//--------------------------------------------------------------
+
+void appendFrameHeader(std::vector<uint8_t> & buffer, size_t length, uint8_t type, uint8_t flags, uint32_t id) {
+    uint8_t header[] = {
+        static_cast<uint8_t>(length >> 16),
+        static_cast<uint8_t>(length >> 8),
+        static_cast<uint8_t>(length),
+        type,
+        flags,
+        static_cast<uint8_t>((id >> 24) & 0x7F),
+        static_cast<uint8_t>(id >> 16),
+        static_cast<uint8_t>(id >> 8),
+        static_cast<uint8_t>(id),
+    };
+    buffer.insert(buffer.end(), header, header + sizeof(header));
+}
+
+//--------------------------------------------------------------
+// Read a 32-bit big endian integer.
+//--------------------------------------------------------------
+
+uint32_t readUInt32(uint8_t const * p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+//--------------------------------------------------------------
+// Return whether a header field is specific to a HTTP/1.1
+// connection, i.e. must not appear in a HTTP/2 message.
+//--------------------------------------------------------------
+
+bool isConnectionSpecific(std::string const & name) {
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding" || name == "upgrade";
+}
+
+//--------------------------------------------------------------
+// Build the HTTP/1.1 equivalent of the head of a request. Return
+// false if the request is malformed. (See RFC 7540 section 8.1.2.)
+//--------------------------------------------------------------
+
+bool buildHead(hpack::HeaderList const & headers, bool end, std::string & head, bool & chunked) {
+    std::string method, path, scheme, authority, cookies, fields;
+    bool regular = false, length = false;
+
+    for (hpack::Header const & h: headers) {
+        std::string const & name = h.first;
+        std::string const & value = h.second;
+        if (name.empty() || value.find_first_of(std::string("\r\n\0", 3)) != std::string::npos) {
+            return false;
+        }
+        if (name[0] == ':') {
+            std::string * target = name == ":method" ? &method : name == ":path" ? &path : name == ":scheme" ? &scheme : name == ":authority" ? &authority : nullptr;
+            if (regular || !target || !target->empty() || value.empty()) {
+                return false;
+            }
+            *target = value;
+        } else {
+            regular = true;
+            if (std::any_of(name.cbegin(), name.cend(), [] (char ch) { return !isgraph(ch) || isupper(ch) || ch == ':'; }) ||
+                isConnectionSpecific(name) || (name == "te" && value != "trailers")) {
+                return false;
+            }
+            if (name == "cookie") {
+                cookies += cookies.empty() ? value : "; " + value;
+            } else {
+                length |= name == "content-length";
+                fields += name + ": " + value + "\r\n";
+            }
+        }
+    }
+
+    if (method.empty() || path.empty() || scheme.empty() ||
+        std::any_of(method.cbegin(), method.cend(), [] (char ch) { return !isalpha(ch); }) ||
+        std::any_of(path.cbegin(), path.cend(), [] (char ch) { return !isgraph(ch); })) {
+        return false;
+    }
+
+    head = method + " " + path + " HTTP/2.0\r\n";
+    if (!authority.empty()) {
+        head += "host: " + authority + "\r\n";
+    }
+    head += fields;
+    if (!cookies.empty()) {
+        head += "cookie: " + cookies + "\r\n";
+    }
+    chunked = !end && !length;
+    if (chunked) {
+        head += "transfer-encoding: chunked\r\n";       // DATA frames will be presented as chunks
+    }
+    head += "\r\n";
+    return true;
+}
+
+}
+
+//========================================================================
+// Http2::Connection
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+Http2::Connection::Connection(IHttpConfig & config, StreamSocket & socket, ThreadPool & pool, AddrIPv4 const & local, AddrIPv4 const & remote)
+  : config_(config),
+    socket_(socket),
+    pool_(pool),
+    local_(local),
+    remote_(remote),
+    lastStreamId_(0),
+    sendWindow_(kDefaultWindow),
+    recvWindow_(kDefaultWindow),
+    peerWindowSize_(kDefaultWindow),
+    peerFrameSize_(kFrameSize),
+    closing_(false),
+    blockStream_(0),
+    blockEnd_(false),
+    blockDependency_(0),
+    blockWeight_(16),
+    decoder_(kTableSize),
+    encoder_(kTableSize) {
+    LOG_TRACE("Init Http2::Connection");
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+Http2::Connection::~Connection() {
+    LOG_TRACE("Destroy Http2::Connection");
+}
+
+//--------------------------------------------------------------
+// Check whether a client starts a connection with the HTTP/2
+// preface, without consuming any data.
+//--------------------------------------------------------------
+
+bool Http2::Connection::isPreface(StreamSocket & socket, std::chrono::milliseconds timeout) {
+    char buffer[kPrefaceLength];
+    size_t count = 0;
+    for ( ; ; ) {
+        size_t n = socket.peek(buffer, sizeof(buffer), timeout);
+        if (n == count || memcmp(buffer, kPreface, n)) {
+            return false;
+        } else if (n == sizeof(buffer)) {
+            return true;
+        }
+        count = n;
+    }
+}
+
+//--------------------------------------------------------------
+// Process the connection. Does not return until the connection
+// is closed. If the connection was upgraded from HTTP/1.1, the
+// request that caused the upgrade is answered on stream 1.
+//--------------------------------------------------------------
+
+void Http2::Connection::run(HttpRequest const * upgrade) {
+    std::chrono::milliseconds timeout = config_.getTimeout();
+
+    // Send our settings and enlarge the connection window.
+
+    uint32_t headerList = static_cast<uint32_t>(config_.getLimitRequestHeaders());
+    uint8_t settings[] = {
+        0, MaxConcurrentStreams,    0, 0, 0, kMaxStreams,
+        0, InitialWindowSize,       static_cast<uint8_t>(kWindowSize >> 24), static_cast<uint8_t>(kWindowSize >> 16), static_cast<uint8_t>(kWindowSize >> 8), static_cast<uint8_t>(kWindowSize),
+        0, EnablePush,              0, 0, 0, 0,
+        0, MaxHeaderListSize,       static_cast<uint8_t>(headerList >> 24), static_cast<uint8_t>(headerList >> 16), static_cast<uint8_t>(headerList >> 8), static_cast<uint8_t>(headerList),
+    };
+    sendFrame(Settings, 0, 0, settings, sizeof(settings));
+    sendWindowUpdate(0, kWindowSize - kDefaultWindow);
+    recvWindow_ = kWindowSize;
+
+    // In case of an upgrade, apply the settings sent in the
+    // HTTP2-Settings header (base64url, without padding) and
+    // answer the original request.
+
+    bool ok = true;
+    if (upgrade) {
+        std::string text = upgrade->getHeaderValue(HttpHeader::HTTP2Settings);
+        std::replace(text.begin(), text.end(), '-', '+');
+        std::replace(text.begin(), text.end(), '_', '/');
+        text.append((4 - text.size() % 4) % 4, '=');
+        std::vector<uint8_t> payload;
+        if (!base64::decode(payload, text) || payload.size() % 6 || applySettings(payload.data(), payload.size()) != NoError) {
+            ok = fail(ProtocolError);
+        } else {
+            lastStreamId_ = 1;
+            if (!startStream(1, std::string(), false, true, upgrade)) {
+                sendReset(1, RefusedStream);
+            }
+        }
+    }
+
+    // Check the client preface.
+
+    char preface[kPrefaceLength];
+    if (ok && (socket_.read(preface, sizeof(preface), timeout, true) != sizeof(preface) || memcmp(preface, kPreface, sizeof(preface)))) {
+        ok = fail(ProtocolError);
+    }
+
+    // Read and process frames until the connection is closed or
+    // an error occurs. When the client is idle, the connection is
+    // only closed once all streams are done.
+
+    bool first = true;
+    while (ok) {
+        uint8_t header[9];
+        auto start = std::chrono::steady_clock::now();
+        size_t got = 0, r;
+        while (got < sizeof(header) && (r = socket_.read(header + got, sizeof(header) - got, timeout, false)) > 0) {
+            got += r;
+        }
+        if (got != sizeof(header)) {
+
+            // Only a timeout between two frames is benign: if part
+            // of a header was consumed, the next read would start in
+            // the middle of a frame.
+
+            if (got) {
+                ok = fail(ProtocolError);
+                break;
+            }
+            bool timedout = std::chrono::steady_clock::now() - start >= timeout;
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (timedout && !streams_.empty()) {
+                continue;
+            }
+            lock.unlock();
+            if (timedout) {
+                sendGoAway(NoError);
+            }
+            break;
+        }
+
+        size_t length = (static_cast<size_t>(header[0]) << 16) | (static_cast<size_t>(header[1]) << 8) | header[2];
+        uint8_t type = header[3];
+        uint8_t flags = header[4];
+        uint32_t id = readUInt32(header + 5) & 0x7FFFFFFF;
+        if (length > kFrameSize) {
+            ok = fail(FrameSizeError);
+            break;
+        }
+
+        std::vector<uint8_t> payload(length);
+        if (length && socket_.read(payload.data(), length, timeout, true) != length) {
+            break;
+        }
+        LOG_TRACE("HTTP/2 frame: type = " << static_cast<int>(type) << ", flags = " << static_cast<int>(flags) << ", stream = " << id << ", length = " << length);
+
+        if ((first && type != Settings) || (blockStream_ && (type != Continuation || id != blockStream_))) {
+            ok = fail(ProtocolError);
+        } else {
+            ok = processFrame(type, flags, id, payload);
+        }
+        first = false;
+        reap(false);
+    }
+
+    // Stop the workers.
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+        cond_.notify_all();
+    }
+    reap(true);
+}
+
+//--------------------------------------------------------------
+// Process a frame. Return false if the connection must be
+// closed.
+//--------------------------------------------------------------
+
+bool Http2::Connection::processFrame(uint8_t type, uint8_t flags, uint32_t id, std::vector<uint8_t> const & payload) {
+    size_t length = payload.size();
+
+    switch (type) {
+    case Data:
+        if (!id) {
+            return fail(ProtocolError);
+        }
+        return processData(id, flags, payload);
+
+    case Headers: {
+        if (!id || !(id & 1)) {
+            return fail(ProtocolError);
+        }
+        size_t pos = 0, padding = 0;
+        if (flags & Padded) {
+            if (!length) {
+                return fail(FrameSizeError);
+            }
+            padding = payload[pos++];
+        }
+        blockDependency_ = 0;
+        blockWeight_ = 16;
+        if (flags & PriorityFlag) {
+            if (length < pos + 5) {
+                return fail(FrameSizeError);
+            }
+            blockDependency_ = readUInt32(&payload[pos]) & 0x7FFFFFFF;
+            blockWeight_ = payload[pos + 4] + 1;
+            pos += 5;
+        }
+        if (padding > length - pos) {
+            return fail(ProtocolError);
+        }
+        block_.assign(payload.begin() + static_cast<long>(pos), payload.end() - static_cast<long>(padding));
+        if (block_.size() > static_cast<size_t>(config_.getLimitRequestHeaders())) {
+            return fail(EnhanceYourCalm);
+        }
+        blockStream_ = id;
+        blockEnd_ = (flags & EndStream) != 0;
+        return (flags & EndHeaders) ? processHeaders() : true;
+    }
+
+    case Continuation:
+        if (!blockStream_) {
+            return fail(ProtocolError);
+        }
+        block_.insert(block_.end(), payload.begin(), payload.end());
+        if (block_.size() > static_cast<size_t>(config_.getLimitRequestHeaders())) {
+            return fail(EnhanceYourCalm);
+        }
+        return (flags & EndHeaders) ? processHeaders() : true;
+
+    case Priority:
+        if (!id) {
+            return fail(ProtocolError);
+        } else if (length != 5) {
+            sendReset(id, FrameSizeError);
+        } else {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto got = streams_.find(id);
+            if (got != streams_.end()) {
+                got->second->dependency_ = readUInt32(payload.data()) & 0x7FFFFFFF;
+                got->second->weight_ = payload[4] + 1;
+            }
+        }
+        return true;
+
+    case ResetStream:
+        if (!id || id > lastStreamId_) {
+            return fail(ProtocolError);
+        } else if (length != 4) {
+            return fail(FrameSizeError);
+        } else {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto got = streams_.find(id);
+            if (got != streams_.end()) {
+                LOG_TRACE("HTTP/2 stream " << id << " reset by client (error " << readUInt32(payload.data()) << ")");
+                got->second->reset_ = true;
+                cond_.notify_all();
+            }
+        }
+        return true;
+
+    case Settings:
+        if (id) {
+            return fail(ProtocolError);
+        } else if (flags & Ack) {
+            return length ? fail(FrameSizeError) : true;
+        } else if (length % 6) {
+            return fail(FrameSizeError);
+        } else {
+            ErrorCode error = applySettings(payload.data(), length);
+            if (error != NoError) {
+                return fail(error);
+            }
+            return sendFrame(Settings, Ack, 0, nullptr, 0);
+        }
+
+    case Ping:
+        if (id) {
+            return fail(ProtocolError);
+        } else if (length != 8) {
+            return fail(FrameSizeError);
+        }
+        return (flags & Ack) ? true : sendFrame(Ping, Ack, 0, payload.data(), length);
+
+    case GoAway:
+        if (id) {
+            return fail(ProtocolError);
+        }
+        LOG_TRACE("HTTP/2 connection closed by client");
+        return true;
+
+    case WindowUpdate: {
+        if (length != 4) {
+            return fail(FrameSizeError);
+        }
+        uint32_t increment = readUInt32(payload.data()) & 0x7FFFFFFF;
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!id) {
+            if (!increment || static_cast<int64_t>(sendWindow_) + increment > 0x7FFFFFFF) {
+                lock.unlock();
+                return fail(!increment ? ProtocolError : FlowControlError);
+            }
+            sendWindow_ += static_cast<int32_t>(increment);
+        } else {
+            auto got = streams_.find(id);
+            if (got != streams_.end()) {
+                Stream & stream = *got->second;
+                if (!increment || static_cast<int64_t>(stream.sendWindow_) + increment > 0x7FFFFFFF) {
+                    stream.reset_ = true;
+                    lock.unlock();
+                    sendReset(id, !increment ? ProtocolError : FlowControlError);
+                    return true;
+                }
+                stream.sendWindow_ += static_cast<int32_t>(increment);
+            }
+        }
+        cond_.notify_all();
+        return true;
+    }
+
+    case PushPromise:
+        return fail(ProtocolError);     // clients cannot push
+
+    default:
+        return true;                    // unknown frame types are ignored
+    }
+}
+
+//--------------------------------------------------------------
+// Process a complete header block. The block must always be
+// decoded to keep the decoding table in sync, even if the
+// stream is then refused.
+//--------------------------------------------------------------
+
+bool Http2::Connection::processHeaders() {
+    uint32_t id = blockStream_;
+    bool end = blockEnd_;
+    hpack::HeaderList headers;
+    bool decoded = decoder_.decode(block_.data(), block_.size(), headers, static_cast<size_t>(config_.getLimitRequestHeaders()));
+    block_.clear();
+    blockStream_ = 0;
+    if (!decoded) {
+        return fail(decoder_.isOverflow() ? EnhanceYourCalm : CompressionError);   // the table is out of sync either way
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // A header block on an open stream contains trailer fields,
+    // which are dropped. It must end the stream.
+
+    auto got = streams_.find(id);
+    if (got != streams_.end()) {
+        Stream & stream = *got->second;
+        if (stream.reset_) {
+            return true;
+        } else if (stream.remoteClosed_ || !end) {
+            stream.reset_ = true;
+            cond_.notify_all();
+            lock.unlock();
+            sendReset(id, stream.remoteClosed_ ? StreamClosed : ProtocolError);
+        } else {
+            if (stream.chunked_) {
+                stream.input_ += "0\r\n\r\n";
+            }
+            stream.remoteClosed_ = true;
+            cond_.notify_all();
+        }
+        return true;
+    } else if (id <= lastStreamId_) {
+        return true;                    // stream already closed
+    }
+
+    // Open a new stream, if the limit is not reached.
+
+    lastStreamId_ = id;
+    bool refused = streams_.size() >= kMaxStreams;
+    lock.unlock();
+
+    std::string head;
+    bool chunked;
+    if (refused) {
+        sendReset(id, RefusedStream);
+    } else if (blockDependency_ == id || !buildHead(headers, end, head, chunked)) {
+        sendReset(id, ProtocolError);
+    } else if (!startStream(id, head, chunked, end, nullptr)) {
+        sendReset(id, RefusedStream);   // no worker available
+    } else {
+        std::lock_guard<std::mutex> lock2(mutex_);
+        streams_[id]->dependency_ = blockDependency_;
+        streams_[id]->weight_ = blockWeight_;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Process a DATA frame. The whole frame, including padding,
+// counts for flow control. Data for streams that do not expect
+// any are discarded, but credited back to the connection window.
+//--------------------------------------------------------------
+
+bool Http2::Connection::processData(uint32_t id, uint8_t flags, std::vector<uint8_t> const & payload) {
+    size_t length = payload.size();
+    size_t pos = 0, padding = 0;
+    if (flags & Padded) {
+        if (!length) {
+            return fail(FrameSizeError);
+        }
+        padding = payload[pos++];
+        if (padding > length - pos) {
+            return fail(ProtocolError);
+        }
+    }
+    size_t size = length - pos - padding;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    recvWindow_ -= static_cast<int32_t>(length);
+    if (recvWindow_ < 0) {
+        lock.unlock();
+        return fail(FlowControlError);
+    }
+
+    auto got = streams_.find(id);
+    if (got == streams_.end() || got->second->remoteClosed_ || got->second->reset_ || got->second->done_) {
+        bool closed = got != streams_.end() && got->second->remoteClosed_ && !got->second->reset_;
+        recvWindow_ += static_cast<int32_t>(length);
+        lock.unlock();
+        if (got == streams_.end() && id > lastStreamId_) {
+            return fail(ProtocolError);
+        } else if (closed) {
+            sendReset(id, StreamClosed);
+        }
+        if (length) {
+            sendWindowUpdate(0, static_cast<uint32_t>(length));
+        }
+        return true;
+    }
+
+    Stream & stream = *got->second;
+    stream.recvWindow_ -= static_cast<int32_t>(length);
+    if (stream.recvWindow_ < 0) {
+        stream.reset_ = true;
+        recvWindow_ += static_cast<int32_t>(length);
+        cond_.notify_all();
+        lock.unlock();
+        sendReset(id, FlowControlError);
+        sendWindowUpdate(0, static_cast<uint32_t>(length));
+        return true;
+    }
+
+    if (size) {
+        char const * data = reinterpret_cast<char const *>(payload.data() + pos);
+        if (stream.chunked_) {
+            char prefix[24];
+            snprintf(prefix, sizeof(prefix), "%zx\r\n", size);
+            stream.input_.append(prefix).append(data, size).append("\r\n");
+        } else {
+            stream.input_.append(data, size);
+        }
+        stream.uncredited_ += size;
+    }
+    if (flags & EndStream) {
+        if (stream.chunked_) {
+            stream.input_ += "0\r\n\r\n";
+        }
+        stream.remoteClosed_ = true;
+    }
+    cond_.notify_all();
+
+    // Padding is not delivered: credit it back at once.
+
+    bool open = !stream.remoteClosed_;
+    size_t unused = length - size;
+    stream.recvWindow_ += static_cast<int32_t>(unused);
+    recvWindow_ += static_cast<int32_t>(unused);
+    lock.unlock();
+
+    if (unused) {
+        if (open) {
+            sendWindowUpdate(id, static_cast<uint32_t>(unused));
+        }
+        sendWindowUpdate(0, static_cast<uint32_t>(unused));
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Apply settings received from the client.
+//--------------------------------------------------------------
+
+Http2::ErrorCode Http2::Connection::applySettings(uint8_t const * data, size_t length) {
+    for (size_t i = 0; i + 6 <= length; i += 6) {
+        int setting = (data[i] << 8) | data[i + 1];
+        uint32_t value = readUInt32(data + i + 2);
+        LOG_TRACE("HTTP/2 setting " << setting << " = " << value);
+
+        switch (setting) {
+        case HeaderTableSize: {
+            std::lock_guard<std::mutex> lock(writeMutex_);
+            encoder_.setLimit(value);
+            break;
+        }
+        case EnablePush:
+            if (value > 1) {
+                return ProtocolError;
+            }
+            break;
+        case InitialWindowSize: {
+            if (value > 0x7FFFFFFF) {
+                return FlowControlError;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            int64_t delta = static_cast<int64_t>(value) - peerWindowSize_;
+            for (auto & p: streams_) {
+                if (p.second->sendWindow_ + delta > 0x7FFFFFFF) {
+                    return FlowControlError;
+                }
+                p.second->sendWindow_ += static_cast<int32_t>(delta);
+            }
+            peerWindowSize_ = value;
+            cond_.notify_all();
+            break;
+        }
+        case MaxFrameSize:
+            if (value < 16384 || value > 16777215) {
+                return ProtocolError;
+            } else {
+                std::lock_guard<std::mutex> lock(mutex_);
+                peerFrameSize_ = value;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return NoError;
+}
+
+//--------------------------------------------------------------
+// Create a stream and hand it over to a worker of the server
+// thread pool, so that streams count against the same limit as
+// HTTP/1.1 connections. The task is not queued: waiting for a
+// worker while holding one could starve the pool. Return false
+// if no worker is available, in which case the stream is not
+// created.
+//--------------------------------------------------------------
+
+bool Http2::Connection::startStream(uint32_t id, std::string const & head, bool chunked, bool end, HttpRequest const * upgrade) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stream = std::make_unique<Stream>(id, static_cast<int32_t>(peerWindowSize_), kWindowSize);
+    stream->input_ = head;
+    stream->chunked_ = chunked;
+    stream->remoteClosed_ = end;
+    if (!pool_.addTask(std::make_unique<Worker>(*this, *stream, upgrade), static_cast<size_t>(config_.getLimitThreads()))) {
+        return false;
+    }
+    streams_[id] = std::move(stream);
+    return true;
+}
+
+//--------------------------------------------------------------
+// Process a stream (worker task). The request is parsed and
+// answered exactly as a HTTP/1.1 request would be.
+//--------------------------------------------------------------
+
+void Http2::Connection::process(Stream & stream, HttpRequest const * upgrade) {
+    HttpRequest own(local_, remote_, false);
+    HttpRequest const & request = upgrade ? *upgrade : own;
+    std::shared_ptr<Resource> body;
+    HttpRequest::Result r = HttpRequest::Result::OK();
+
+    if (!upgrade) {
+        Input input(*this, stream);
+        r = own.parseHead(input, config_.getTimeout(), static_cast<size_t>(config_.getLimitRequestLine()), static_cast<size_t>(config_.getLimitRequestHeaders()));
+        if (r.isOK()) {
+            if (own.getVerb().isOneOf(HttpVerb::Get | HttpVerb::Head | HttpVerb::Post | HttpVerb::Put | HttpVerb::Delete)) {
+                body = config_.resolve(own.getURI());
+            } else {
+                body = config_.makeErrorPage(405);
+            }
+            r = own.parseBody(input, config_.getTimeout(), static_cast<size_t>(config_.getLimitRequestHeaders()), static_cast<size_t>(config_.getLimitRequestBody()), body->getBodySink(own, static_cast<size_t>(config_.getLimitRequestBody())));
+        }
+        if (r.isError()) {
+            body = config_.makeErrorPage(r.getHttpStatus());
+        }
+    } else if (request.getVerb().isOneOf(HttpVerb::Get | HttpVerb::Head | HttpVerb::Post | HttpVerb::Put | HttpVerb::Delete)) {
+        body = config_.resolve(request.getURI());
+    } else {
+        body = config_.makeErrorPage(405);
+    }
+
+    if (!r.isAborted()) {
+        Output output(*this, stream);
+        HttpResponse response(config_, request, output, HttpResponse::Connection::Multiplexed);
+        LOG_INFO_SEND("Replying: " << body->getDescription() << " (HTTP/2 stream " << stream.id_ << ")");
+        body->transmit(response, request);
+        output.finish();
+    }
+
+    // The response is complete. If the client is still sending
+    // the request, tell it to stop, and return what it sent to
+    // the connection window.
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool reset = !stream.remoteClosed_ && !stream.reset_;
+    uint32_t unused = static_cast<uint32_t>(stream.uncredited_);
+    recvWindow_ += static_cast<int32_t>(unused);
+    stream.uncredited_ = 0;
+    stream.input_.clear();
+    stream.inputPos_ = 0;
+    stream.reset_ |= reset;
+    stream.done_ = true;
+    lock.unlock();
+
+    if (reset) {
+        sendReset(stream.id_, r.isAborted() ? Cancel : NoError);
+    }
+    if (unused) {
+        sendWindowUpdate(0, unused);
+    }
+}
+
+//--------------------------------------------------------------
+// Return received data to the flow control windows, once the
+// worker has consumed enough of it.
+//--------------------------------------------------------------
+
+void Http2::Connection::credit(Stream & stream) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint32_t increment = 0;
+    bool open = !stream.remoteClosed_ && !stream.reset_;
+    if (stream.uncredited_ && stream.input_.size() - stream.inputPos_ <= kWindowSize / 2) {
+        increment = static_cast<uint32_t>(stream.uncredited_);
+        stream.uncredited_ = 0;
+        stream.recvWindow_ += static_cast<int32_t>(increment);
+        recvWindow_ += static_cast<int32_t>(increment);
+    }
+    lock.unlock();
+
+    if (increment) {
+        if (open) {
+            sendWindowUpdate(stream.id_, increment);
+        }
+        sendWindowUpdate(0, increment);
+    }
+}
+
+//--------------------------------------------------------------
+// Delete streams whose worker is done. If all is set, wait for
+// all workers to return first.
+//--------------------------------------------------------------
+
+void Http2::Connection::reap(bool all) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (all) {
+        cond_.wait(lock, [this] {
+            return std::all_of(streams_.begin(), streams_.end(), [] (std::pair<uint32_t const, std::unique_ptr<Stream>> const & x) { return x.second->finished_; });
+        });
+    }
+    for (auto it = streams_.begin(); it != streams_.end(); ) {
+        if (it->second->finished_) {
+            it = streams_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+// Signal a connection error to the client. Always return false
+// so that the caller can return the result directly.
+//--------------------------------------------------------------
+
+bool Http2::Connection::fail(ErrorCode error) {
+    LOG_TRACE("HTTP/2 connection error " << static_cast<int>(error));
+    sendGoAway(error);
+    return false;
+}
+
+//--------------------------------------------------------------
+// Send a frame. Frames are sent in one write so that frames
+// emitted by concurrent streams do not interleave.
+//--------------------------------------------------------------
+
+bool Http2::Connection::sendFrame(uint8_t type, uint8_t flags, uint32_t id, void const * payload, size_t length) {
+    std::vector<uint8_t> buffer;
+    buffer.reserve(9 + length);
+    appendFrameHeader(buffer, length, type, flags, id);
+    if (length) {
+        auto p = static_cast<uint8_t const *>(payload);
+        buffer.insert(buffer.end(), p, p + length);
+    }
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    return socket_.write(buffer.data(), buffer.size());
+}
+
+//--------------------------------------------------------------
+// Send the response headers. The header block is encoded and
+// sent, possibly split in CONTINUATION frames, while holding
+// the write lock, because the encoding table and the order in
+// which blocks are sent must match.
+//--------------------------------------------------------------
+
+bool Http2::Connection::sendHeaders(Stream & stream, hpack::HeaderList const & headers, bool end) {
+    size_t frameSize;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stream.reset_ || closing_) {
+            return false;
+        }
+        frameSize = peerFrameSize_;
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    std::vector<uint8_t> block, buffer;
+    encoder_.encode(headers, block);
+    for (size_t pos = 0; pos < block.size() || pos == 0; ) {
+        size_t n = std::min(frameSize, block.size() - pos);
+        uint8_t flags = pos + n == block.size() ? EndHeaders : 0;
+        if (pos == 0) {
+            appendFrameHeader(buffer, n, Headers, static_cast<uint8_t>(flags | (end ? EndStream : 0)), stream.id_);
+        } else {
+            appendFrameHeader(buffer, n, Continuation, flags, stream.id_);
+        }
+        buffer.insert(buffer.end(), block.begin() + static_cast<long>(pos), block.begin() + static_cast<long>(pos + n));
+        pos += n;
+        if (!n) {
+            break;
+        }
+    }
+    return socket_.write(buffer.data(), buffer.size());
+}
+
+//--------------------------------------------------------------
+// Send response data, waiting for the flow control windows to
+// open as needed.
+//--------------------------------------------------------------
+
+bool Http2::Connection::sendData(Stream & stream, char const * data, size_t length, bool end) {
+    do {
+        size_t n = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (length) {
+                if (stream.reset_ || closing_) {
+                    return false;
+                }
+                int32_t window = std::min(sendWindow_, stream.sendWindow_);
+                if (window > 0) {
+                    n = std::min({ length, static_cast<size_t>(window), static_cast<size_t>(peerFrameSize_) });
+                    sendWindow_ -= static_cast<int32_t>(n);
+                    stream.sendWindow_ -= static_cast<int32_t>(n);
+                    break;
+                }
+                if (cond_.wait_for(lock, config_.getTimeout()) == std::cv_status::timeout) {
+                    return false;
+                }
+            }
+        }
+        if (!sendFrame(Data, n == length && end ? EndStream : 0, stream.id_, data, n)) {
+            return false;
+        }
+        data += n;
+        length -= n;
+    } while (length);
+    return true;
+}
+
+//--------------------------------------------------------------
+// Send a RST_STREAM frame.
+//--------------------------------------------------------------
+
+void Http2::Connection::sendReset(uint32_t id, ErrorCode error) {
+    uint8_t payload[] = { 0, 0, 0, static_cast<uint8_t>(error) };
+    sendFrame(ResetStream, 0, id, payload, sizeof(payload));
+}
+
+//--------------------------------------------------------------
+// Send a GOAWAY frame.
+//--------------------------------------------------------------
+
+void Http2::Connection::sendGoAway(ErrorCode error) {
+    uint8_t payload[] = {
+        static_cast<uint8_t>((lastStreamId_ >> 24) & 0x7F),
+        static_cast<uint8_t>(lastStreamId_ >> 16),
+        static_cast<uint8_t>(lastStreamId_ >> 8),
+        static_cast<uint8_t>(lastStreamId_),
+        0, 0, 0, static_cast<uint8_t>(error),
+    };
+    sendFrame(GoAway, 0, 0, payload, sizeof(payload));
+}
+
+//--------------------------------------------------------------
+// Send a WINDOW_UPDATE frame.
+//--------------------------------------------------------------
+
+void Http2::Connection::sendWindowUpdate(uint32_t id, uint32_t increment) {
+    uint8_t payload[] = {
+        static_cast<uint8_t>((increment >> 24) & 0x7F),
+        static_cast<uint8_t>(increment >> 16),
+        static_cast<uint8_t>(increment >> 8),
+        static_cast<uint8_t>(increment),
+    };
+    sendFrame(WindowUpdate, 0, id, payload, sizeof(payload));
+}
+
+//========================================================================
+// Http2::Connection::Stream
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+Http2::Connection::Stream::Stream(uint32_t id, int32_t sendWindow, int32_t recvWindow)
+  : id_(id),
+    sendWindow_(sendWindow),
+    recvWindow_(recvWindow),
+    uncredited_(0),
+    inputPos_(0),
+    chunked_(false),
+    remoteClosed_(false),
+    reset_(false),
+    done_(false),
+    finished_(false),
+    dependency_(0),
+    weight_(16) {
+}
+
+//========================================================================
+// Http2::Connection::Worker
+//
+// Task run by the server thread pool to process the request of a stream.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+Http2::Connection::Worker::Worker(Connection & connection, Stream & stream, HttpRequest const * upgrade)
+  : ThreadPool::Task(),
+    connection_(connection),
+    stream_(stream),
+    upgrade_(upgrade) {
+}
+
+//--------------------------------------------------------------
+// Process the stream, then let the connection know the stream
+// can be deleted.
+//--------------------------------------------------------------
+
+void Http2::Connection::Worker::run(int /* no */) {
+    connection_.process(stream_, upgrade_);
+    std::lock_guard<std::mutex> lock(connection_.mutex_);
+    stream_.finished_ = true;
+    connection_.cond_.notify_all();
+}
+
+//========================================================================
+// Http2::Connection::Input
+//
+// Present the request received on a stream to the HTTP/1.1 parser: the
+// head rebuilt from the header block, followed by the content of the
+// DATA frames.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+Http2::Connection::Input::Input(Connection & connection, Stream & stream)
+  : connection_(connection),
+    stream_(stream) {
+}
+
+//--------------------------------------------------------------
+// Read data, waiting for DATA frames as needed.
+//--------------------------------------------------------------
+
+size_t Http2::Connection::Input::read(void * data, size_t length, std::chrono::milliseconds timeout, bool exact) {
+    std::unique_lock<std::mutex> lock(connection_.mutex_);
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    size_t count = 0;
+
+    while (count < length) {
+        size_t available = stream_.input_.size() - stream_.inputPos_;
+        if (available) {
+            size_t n = std::min(length - count, available);
+            memcpy(static_cast<char *>(data) + count, stream_.input_.data() + stream_.inputPos_, n);
+            stream_.inputPos_ += n;
+            count += n;
+            if (stream_.inputPos_ == stream_.input_.size()) {
+                stream_.input_.clear();
+                stream_.inputPos_ = 0;
+            } else if (stream_.inputPos_ >= kFrameSize) {
+                stream_.input_.erase(0, stream_.inputPos_);
+                stream_.inputPos_ = 0;
+            }
+            if (!exact) {
+                break;
+            }
+        } else if (stream_.remoteClosed_ || stream_.reset_ || connection_.closing_ ||
+                   connection_.cond_.wait_until(lock, deadline) == std::cv_status::timeout) {
+            break;
+        }
+    }
+
+    lock.unlock();
+    connection_.credit(stream_);
+    return count < length && exact ? 0 : count;
+}
+
+//========================================================================
+// Http2::Connection::Output
+//
+// Translate the response emitted by HttpResponse, which is formatted as
+// a HTTP/1.1 message, into a HEADERS frame followed by DATA frames. Body
+// data are gathered until a full frame can be sent or until the response
+// is flushed.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+Http2::Connection::Output::Output(Connection & connection, Stream & stream)
+  : connection_(connection),
+    stream_(stream),
+    headDone_(false),
+    failed_(false) {
+}
+
+//--------------------------------------------------------------
+// Write a chunk of the response.
+//--------------------------------------------------------------
+
+bool Http2::Connection::Output::write(void const * data, size_t length) {
+    auto text = static_cast<char const *>(data);
+    if (failed_) {
+        return false;
+    }
+
+    if (!headDone_) {
+        size_t start = head_.size() >= 3 ? head_.size() - 3 : 0;
+        head_.append(text, length);
+        size_t got = head_.find("\r\n\r\n", start);
+        if (got == std::string::npos) {
+            return true;
+        }
+        buffer_.assign(head_.begin() + static_cast<long>(got + 4), head_.end());
+        head_.resize(got + 2);
+        parseHead();
+    } else {
+        buffer_.insert(buffer_.end(), text, text + length);
+    }
+
+    return buffer_.size() < kFrameSize || send(false);
+}
+
+//--------------------------------------------------------------
+// Send what has been written so far.
+//--------------------------------------------------------------
+
+bool Http2::Connection::Output::flush() {
+    return !failed_ && (!headDone_ || send(false));
+}
+
+//--------------------------------------------------------------
+// Same as flush: the stream only ends with finish().
+//--------------------------------------------------------------
+
+bool Http2::Connection::Output::sync() {
+    return flush();
+}
+
+//--------------------------------------------------------------
+// Send the end of the response and close the stream.
+//--------------------------------------------------------------
+
+void Http2::Connection::Output::finish() {
+    if (!headDone_) {
+        headers_.assign({ { ":status", "500" } });      // should not happen: HttpResponse always emits headers
+        headDone_ = true;
+    }
+    if (!failed_) {
+        send(true);
+    }
+}
+
+//--------------------------------------------------------------
+// Parse the status line and headers emitted by HttpResponse.
+//--------------------------------------------------------------
+
+void Http2::Connection::Output::parseHead() {
+    headDone_ = true;
+    size_t eol = head_.find("\r\n");
+    headers_.emplace_back(":status", head_.size() >= 12 ? head_.substr(9, 3) : "500");
+
+    for (size_t pos = eol + 2; pos < head_.size(); pos = eol + 2) {
+        eol = head_.find("\r\n", pos);
+        size_t colon = head_.find(':', pos);
+        if (colon < eol) {
+            std::string name = head_.substr(pos, colon - pos);
+            std::string value = head_.substr(colon + 1, eol - colon - 1);
+            string::lowercase(name);
+            string::trim(value, string::trim_both);
+            if (!isConnectionSpecific(name)) {
+                headers_.emplace_back(std::move(name), std::move(value));
+            }
+        }
+    }
+    head_.clear();
+}
+
+//--------------------------------------------------------------
+// Send the pending headers and data. If this is the end of the
+// response, the last frame carries the END_STREAM flag.
+//--------------------------------------------------------------
+
+bool Http2::Connection::Output::send(bool end) {
+    bool ok = true;
+    if (!headers_.empty()) {
+        ok = connection_.sendHeaders(stream_, headers_, end && buffer_.empty());
+        headers_.clear();
+        if (end && buffer_.empty()) {
+            end = false;
+        }
+    }
+    if (ok && (!buffer_.empty() || end)) {
+        ok = connection_.sendData(stream_, buffer_.data(), buffer_.size(), end);
+        buffer_.clear();
+    }
+    failed_ |= !ok;
+    return ok;
+}
+
+//========================================================================
+
+#endif
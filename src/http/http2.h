@@ -0,0 +1,216 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#ifndef HTTP2_H
+#define HTTP2_H
+
+#ifdef ZINC_HTTP2
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "ihttpconfig.h"
+#include "stream_socket.h"
+#include "http_request.h"
+#include "hpack.h"
+#include "thread_pool.h"
+
+namespace Http2 {
+
+//--------------------------------------------------------------
+// Frame types, flags, error codes and settings (RFC 7540).
+//--------------------------------------------------------------
+
+enum FrameType {
+    Data            = 0x0,
+    Headers         = 0x1,
+    Priority        = 0x2,
+    ResetStream     = 0x3,
+    Settings        = 0x4,
+    PushPromise     = 0x5,
+    Ping            = 0x6,
+    GoAway          = 0x7,
+    WindowUpdate    = 0x8,
+    Continuation    = 0x9,
+};
+
+enum FrameFlag {
+    EndStream       = 0x01,
+    Ack             = 0x01,
+    EndHeaders      = 0x04,
+    Padded          = 0x08,
+    PriorityFlag    = 0x20,
+};
+
+enum ErrorCode {
+    NoError             = 0x0,
+    ProtocolError       = 0x1,
+    InternalError       = 0x2,
+    FlowControlError    = 0x3,
+    SettingsTimeout     = 0x4,
+    StreamClosed        = 0x5,
+    FrameSizeError      = 0x6,
+    RefusedStream       = 0x7,
+    Cancel              = 0x8,
+    CompressionError    = 0x9,
+    ConnectError        = 0xA,
+    EnhanceYourCalm     = 0xB,
+};
+
+enum Setting {
+    HeaderTableSize         = 0x1,
+    EnablePush              = 0x2,
+    MaxConcurrentStreams    = 0x3,
+    InitialWindowSize       = 0x4,
+    MaxFrameSize            = 0x5,
+    MaxHeaderListSize       = 0x6,
+};
+
+//--------------------------------------------------------------
+// HTTP/2 connection.
+//--------------------------------------------------------------
+
+class Connection {
+public:
+    Connection(IHttpConfig & config, StreamSocket & socket, ThreadPool & pool, AddrIPv4 const & local, AddrIPv4 const & remote);
+    ~Connection();
+
+    void    run(HttpRequest const * upgrade);
+
+    static bool isPreface(StreamSocket & socket, std::chrono::milliseconds timeout);
+
+private:
+    struct Stream {
+        Stream(uint32_t id, int32_t sendWindow, int32_t recvWindow);
+
+        uint32_t        id_;                // stream identifier
+        int32_t         sendWindow_;        // how many bytes we can send
+        int32_t         recvWindow_;        // how many bytes the client can send
+        size_t          uncredited_;        // bytes received and not yet returned to the client with a WINDOW_UPDATE
+        std::string     input_;             // request as seen by the HTTP/1.1 parser (head then body)
+        size_t          inputPos_;          // position of the first unread byte in input_
+        bool            chunked_;           // whether DATA frames are presented as chunks to the parser
+        bool            remoteClosed_;      // END_STREAM received
+        bool            reset_;             // stream reset by either side
+        bool            done_;              // the response is complete
+        bool            finished_;          // the worker task returned
+        uint32_t        dependency_;        // priority: stream this stream depends on
+        int             weight_;            // priority: weight (1 to 256)
+    };
+
+    class Worker : public ThreadPool::Task {  // task processing the request of a stream
+    public:
+        Worker(Connection & connection, Stream & stream, HttpRequest const * upgrade);
+        void run(int no) override;
+
+    private:
+        Connection &        connection_;
+        Stream &            stream_;
+        HttpRequest const * upgrade_;
+    };
+
+    class Input : public InputStream {      // body of a request, as read by the HTTP/1.1 parser
+    public:
+        Input(Connection & connection, Stream & stream);
+        size_t read(void * data, size_t length, std::chrono::milliseconds timeout, bool exact) override;
+
+    private:
+        Connection &    connection_;
+        Stream &        stream_;
+    };
+
+    class Output : public OutputStream {    // response, as emitted by HttpResponse
+    public:
+        Output(Connection & connection, Stream & stream);
+        bool write(void const * data, size_t length) override;
+        bool flush() override;
+        bool sync() override;
+        void finish();
+
+    private:
+        Connection &        connection_;
+        Stream &            stream_;
+        std::string         head_;          // status line and headers, until they are complete
+        bool                headDone_;      // whether the status line and headers were parsed
+        hpack::HeaderList   headers_;       // headers waiting to be sent
+        std::vector<char>   buffer_;        // body data waiting to be sent
+        bool                failed_;        // the stream was reset or the connection lost
+
+        void    parseHead();
+        bool    send(bool end);
+    };
+
+    IHttpConfig &                               config_;            // server configuration
+    StreamSocket &                              socket_;            // connection with the client
+    ThreadPool &                                pool_;              // pool the stream workers run in
+    AddrIPv4                                    local_;             // local address (i.e. the server)
+    AddrIPv4                                    remote_;            // remote address (i.e. the client)
+    std::map<uint32_t, std::unique_ptr<Stream>> streams_;           // active streams
+    uint32_t                                    lastStreamId_;      // highest stream identifier received
+    int32_t                                     sendWindow_;        // connection flow control: how many bytes we can send
+    int32_t                                     recvWindow_;        // connection flow control: how many bytes the client can send
+    uint32_t                                    peerWindowSize_;    // SETTINGS_INITIAL_WINDOW_SIZE of the client
+    uint32_t                                    peerFrameSize_;     // SETTINGS_MAX_FRAME_SIZE of the client
+    bool                                        closing_;           // the connection is going down
+    std::vector<uint8_t>                        block_;             // header block being received
+    uint32_t                                    blockStream_;       // stream of the header block being received (or zero)
+    bool                                        blockEnd_;          // whether the header block ends the stream
+    uint32_t                                    blockDependency_;   // priority carried by the HEADERS frame: dependency
+    int                                         blockWeight_;       // priority carried by the HEADERS frame: weight
+    hpack::Decoder                              decoder_;           // request headers decoder
+    hpack::Encoder                              encoder_;           // response headers encoder
+    std::mutex                                  mutex_;             // protects streams and windows
+    std::condition_variable                     cond_;              // signaled when windows, inputs or stream states change
+    std::mutex                                  writeMutex_;        // serializes frames sent on the socket and the encoder
+
+    bool        processFrame(uint8_t type, uint8_t flags, uint32_t id, std::vector<uint8_t> const & payload);
+    bool        processHeaders();
+    bool        processData(uint32_t id, uint8_t flags, std::vector<uint8_t> const & payload);
+    ErrorCode   applySettings(uint8_t const * data, size_t length);
+    bool        startStream(uint32_t id, std::string const & head, bool chunked, bool end, HttpRequest const * upgrade);
+    void        process(Stream & stream, HttpRequest const * upgrade);
+    void        credit(Stream & stream);
+    void        reap(bool all);
+    bool        fail(ErrorCode error);
+
+    bool        sendFrame(uint8_t type, uint8_t flags, uint32_t id, void const * payload, size_t length);
+    bool        sendHeaders(Stream & stream, hpack::HeaderList const & headers, bool end);
+    bool        sendData(Stream & stream, char const * data, size_t length, bool end);
+    void        sendReset(uint32_t id, ErrorCode error);
+    void        sendGoAway(ErrorCode error);
+    void        sendWindowUpdate(uint32_t id, uint32_t increment);
+};
+
+//--------------------------------------------------------------
+
+}
+
+#endif
+#endif
+
+//========================================================================
@@ -156,6 +156,7 @@ HttpHeader::Mapping::Mapping()
         { HttpHeader::IfNoneMatch,                      "If-None-Match"                     },
         { HttpHeader::IfRange,                          "If-Range"                          },
         { HttpHeader::IfUnmodifiedSince,                "If-Unmodified-Since"               },
+        { HttpHeader::LastEventID,                      "Last-Event-ID"                     },
         { HttpHeader::LastModified,                     "Last-Modified"                     },
         { HttpHeader::Link,                             "Link"                              },
         { HttpHeader::Location,                         "Location"                          },
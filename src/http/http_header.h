@@ -84,6 +84,7 @@ public:
         IfNoneMatch,
         IfRange,
         IfUnmodifiedSince,
+        LastEventID,
         LastModified,
         Link,
         Location,
@@ -30,6 +30,8 @@
 #include "../misc/base64.h"
 #include "../misc/string.h"
 #include "ihttpconfig.h"
+#include "stream_chunked.h"
+#include "stream_compress.h"
 #include "http_request.h"
 
 //========================================================================
@@ -44,6 +46,7 @@
 int const   HTTP_VERSION_0_9    = 0x0009;
 int const   HTTP_VERSION_1_0    = 0x0100;
 int const   HTTP_VERSION_1_1    = 0x0101;
+int const   HTTP_VERSION_2_0    = 0x0200;
 
 //--------------------------------------------------------------
 // Constructor for an HTTP response.
@@ -80,10 +83,21 @@ HttpRequest::~HttpRequest() {
 }
 
 //--------------------------------------------------------------
-// Parse a request.
+// Parse a request (or a response), including its body.
 //--------------------------------------------------------------
 
 HttpRequest::Result HttpRequest::parse(InputStream & s, std::chrono::seconds timeout, size_t limitRequestLine, size_t limitRequestHeaders, size_t limitRequestBody) {
+    Result r = parseHead(s, timeout, limitRequestLine, limitRequestHeaders);
+    return r.isOK() ? parseBody(s, timeout, limitRequestHeaders, limitRequestBody, nullptr) : r;
+}
+
+//--------------------------------------------------------------
+// Parse the request line (or response line) and the headers.
+// This allows the caller to decide what to do with the body
+// before it is actually read.
+//--------------------------------------------------------------
+
+HttpRequest::Result HttpRequest::parseHead(InputStream & s, std::chrono::seconds timeout, size_t limitRequestLine, size_t limitRequestHeaders) {
 
     // Parse the request line and headers. Abort as soon
     // as an error occurs, don't try to recover: we will
@@ -103,24 +117,73 @@ HttpRequest::Result HttpRequest::parse(InputStream & s, std::chrono::seconds tim
         LOG_INFO_RECV("Response: HTTP/" << (httpVersion_ >> 8) << "." << (httpVersion_ & 0xFF) << " " << status_.getStatusCode() << " " << status_.getStatusString());
     }
 
-    Result r2 = parseHeaders(s, timeout, limitRequestHeaders);
+    Result r2 = parseHeaders(s, timeout, limitRequestHeaders, headers_);
     if (!r2.isOK()) {
         return r2;
     }
 
+    // A request with both a Transfer-Encoding and a Content-Length
+    // is rejected: intermediaries may disagree on where its body
+    // ends, and smuggle the rest as another request. (See RFC 7230
+    // section 3.3.3.)
+
+    auto got = headers_.find(HttpHeader::TransferEncoding);
+    if (request_ && got != headers_.end() && !string::compare_i(got->second, "identity") && headers_.find(HttpHeader::ContentLength) != headers_.end()) {
+        return Result::Error(400);
+    }
+    return r2;
+}
+
+//--------------------------------------------------------------
+// Parse the body, if any. By default, the body is stored in a
+// blob that can be retrieved with getBody(). If a sink is given,
+// the decoded body is written to it instead. Unless decode is
+// false, in which case the content coding is left untouched and
+// only the transfer coding is removed.
+//--------------------------------------------------------------
+
+HttpRequest::Result HttpRequest::parseBody(InputStream & s, std::chrono::seconds timeout, size_t limitRequestHeaders, size_t limitRequestBody, OutputStream * sink, bool decode) {
+
     // Determine if a body is present, and how it is transfered
-    // (i.e. chunked or not)
+    // (i.e. chunked or not). If both a Transfer-Encoding and a
+    // Content-Length are present (only in a response, requests
+    // are rejected by parseHead), the former overrides the latter,
+    // which is removed. (See RFC 7230 section 3.3.3.)
 
-    std::function<bool(OutputStream &)> reader;
+    std::function<Result(OutputStream &)> reader;
     HttpHeaderMap::const_iterator got;
 
-    if ((got = headers_.find(HttpHeader::TransferEncoding)) != headers_.end()) {
-        if (got->second != "identity") {
-            return Result::Error(501);  // transfer encodings other than identity are not supported yet
+    if ((got = headers_.find(HttpHeader::TransferEncoding)) != headers_.end() && !string::compare_i(got->second, "identity")) {
+        if (!string::compare_i(got->second, "chunked")) {
+            return Result::Error(501);  // transfer encodings other than chunked and identity are not supported
         }
-    }
+        headers_.erase(HttpHeader::ContentLength);
 
-    if ((got = headers_.find(HttpHeader::ContentLength)) != headers_.end()) {
+        reader = [this, timeout, limitRequestHeaders, limitRequestBody, &s] (OutputStream & body) {
+            logger::dump dump(ansi::cyan, "<=");
+            StreamDechunked chunked(s, limitRequestBody);
+            for ( ; ; ) {
+                char buffer[1024];
+                size_t r = chunked.read(buffer, sizeof(buffer), timeout, false);
+                if (!r) {
+                    break;
+                }
+                if (!body.write(buffer, r)) {
+                    return Result::Error(400);
+                }
+                dump.write(buffer, r);
+            }
+            if (chunked.isOverflow()) {
+                return Result::Error(413);
+            } else if (!chunked.isComplete()) {
+                return Result::Error(400);
+            }
+            if (!body.flush()) {
+                return Result::Error(400);
+            }
+            return parseHeaders(s, timeout, limitRequestHeaders, trailers_);   // trailer fields, if any, are kept apart from the headers
+        };
+    } else if ((got = headers_.find(HttpHeader::ContentLength)) != headers_.end()) {
         long length = string::to_long(got->second, 10);
         if (length < 0) {
             return Result::Error(400);
@@ -135,29 +198,84 @@ HttpRequest::Result HttpRequest::parse(InputStream & s, std::chrono::seconds tim
             while (rem) {
                 char buffer[1024];
                 size_t r = s.read(buffer, std::min(rem, sizeof(buffer)), timeout, false);
-                if (!r) {
-                    return false;
+                if (!r || !body.write(buffer, r)) {
+                    return Result::Error(400);
                 }
-                body.write(buffer, r);
                 dump.write(buffer, r);
                 rem -= r;
             }
-            body.flush();
-            return true;
+            return body.flush() ? Result::OK() : Result::Error(400);
+        };
+    } else if (!request_) {
+
+        // A response with neither Transfer-Encoding nor Content-Length
+        // is delimited by the server closing the connection. (It is up
+        // to the caller to skip the body of responses that cannot have
+        // one, e.g. 204, 304 or responses to HEAD requests.)
+
+        reader = [timeout, &s] (OutputStream & body) {
+            logger::dump dump(ansi::cyan, "<=");
+            for ( ; ; ) {
+                char buffer[1024];
+                size_t r = s.read(buffer, sizeof(buffer), timeout, false);
+                if (!r) {
+                    break;
+                }
+                if (!body.write(buffer, r)) {
+                    return Result::Error(400);
+                }
+                dump.write(buffer, r);
+            }
+            return body.flush() ? Result::OK() : Result::Error(400);
         };
     }
 
-    // A body is present: read it.
+    // A body is present: read it. If it is compressed, insert the
+    // relevant decoders. Encodings are listed in the order they
+    // were applied, so the decoder for the first encoding must
+    // come last in the chain.
 
     if (reader) {
-        Body wrapper(body_);
+        Body wrapper(body_, limitRequestBody);
+        wrapper.setDestination(sink);
+        std::vector<std::unique_ptr<StreamDecoder>> decoders;
+        sink = &wrapper;
+
+        if (decode && (got = headers_.find(HttpHeader::ContentEncoding)) != headers_.end()) {
+            bool supported = true;
+            string::split(got->second, ',', 0, string::trim_both, [&] (std::string & name) {
+                string::lowercase(name);
+                if (name != "identity") {
+                    std::unique_ptr<StreamDecoder> decoder = makeStreamDecoder(name);
+                    if (!decoder) {
+                        supported = false;
+                        return false;
+                    }
+                    decoder->setDestination(sink);
+                    sink = decoder.get();
+                    decoders.push_back(std::move(decoder));
+                }
+                return true;
+            });
+            if (!supported) {
+                return Result::Error(415);
+            }
+        }
 
-        // (later: insert gzip/inflate/brotli decompression here)
+        Result r = reader(*sink);
+        if (wrapper.isOverflow() || std::any_of(decoders.cbegin(), decoders.cend(), [] (std::unique_ptr<StreamDecoder> const & d) { return d->isOverflow(); })) {
+            return Result::Error(413);
+        } else if (wrapper.isFailed()) {
+            return Result::Error(500);
+        } else if (!r.isOK()) {
+            return r;
+        }
 
-        if (!reader(wrapper)) {
-            return Result::Error(400);
+        if (!decoders.empty()) {
+            LOG_DEBUG_RECV("<= decoded request body (" << got->second << ")");
+            headers_.erase(HttpHeader::ContentEncoding);
         }
-        LOG_DEBUG_RECV("<= request body (" << body_.getSize() << " bytes)");
+        LOG_DEBUG_RECV("<= request body (" << wrapper.getLength() << " bytes)");
     }
 
     return Result::OK();
@@ -199,6 +317,54 @@ HttpRequest::Result HttpRequest::isWebSocketUpgrade() const {
     return Result::Abort();
 }
 
+//--------------------------------------------------------------
+// Indicates if this request is a request to switch protocol to
+// HTTP/2 over cleartext TCP. (See RFC 7540 section 3.2.) Since
+// the response to the request is sent on the new connection,
+// requests with a body are answered in HTTP/1.1.
+//--------------------------------------------------------------
+
+HttpRequest::Result HttpRequest::isHttp2Upgrade() const {
+    bool h2c = false, settings = false;
+    string::split(getHeaderValue(HttpHeader::Upgrade), ',', 0, string::trim_both, [&] (std::string & token) {
+        h2c |= string::compare_i(token, "h2c");
+        return true;
+    });
+    string::split(getHeaderValue(HttpHeader::Connection), ',', 0, string::trim_both, [&] (std::string & token) {
+        settings |= string::compare_i(token, "HTTP2-Settings");
+        return true;
+    });
+    if (!h2c || !settings || httpVersion_ != HTTP_VERSION_1_1 || headers_.find(HttpHeader::HTTP2Settings) == headers_.end() ||
+        headers_.find(HttpHeader::TransferEncoding) != headers_.end() || string::to_long(getHeaderValue(HttpHeader::ContentLength), 10) > 0) {
+        return Result::Abort();
+    }
+    return Result::OK();
+}
+
+//--------------------------------------------------------------
+// Indicates if the client expects a 100 (Continue) interim response
+// before sending the body. (See RFC 7231 section 5.1.1.) Return
+// OK if the client waits for the interim response, Abort if
+// there is no expectation, or an error if the expectation cannot
+// be met or the body is known to be too large.
+//--------------------------------------------------------------
+
+HttpRequest::Result HttpRequest::expectsContinue(size_t limitRequestBody) const {
+    auto got = headers_.find(HttpHeader::Expect);
+    if (got == headers_.end()) {
+        return Result::Abort();
+    } else if (!string::compare_i(got->second, "100-continue")) {
+        return Result::Error(417);
+    } else if (httpVersion_ < HTTP_VERSION_1_1) {
+        return Result::Abort();     // HTTP/1.0 clients do not understand interim responses
+    }
+    long length = string::to_long(getHeaderValue(HttpHeader::ContentLength), 10);
+    if (length > static_cast<long>(limitRequestBody)) {
+        return Result::Error(413);
+    }
+    return Result::OK();
+}
+
 //--------------------------------------------------------------
 // Return the list of accepted encodings.
 //--------------------------------------------------------------
@@ -481,7 +647,7 @@ HttpRequest::Result HttpRequest::parseResponseLine(InputStream & s, std::chrono:
 // - blanks at the end of a line are silently ignored
 //--------------------------------------------------------------
 
-HttpRequest::Result HttpRequest::parseHeaders(InputStream & s, std::chrono::milliseconds timeout, size_t maxsize) {
+HttpRequest::Result HttpRequest::parseHeaders(InputStream & s, std::chrono::milliseconds timeout, size_t maxsize, HttpHeaderMap & fields) {
     std::string key, value;
     int state = 0, ch = 0;
     bool skip = false;
@@ -557,7 +723,7 @@ HttpRequest::Result HttpRequest::parseHeaders(InputStream & s, std::chrono::mill
             if (ch == '\n') {
                 string::trim(value, string::trim_right);
                 LOG_DEBUG_RECV("<= " << key << ": " << value);
-                headers_.emplace(key, value);
+                fields.emplace(key, value);
                 state = 0;
             } else {
                 value.push_back('\r');
@@ -577,3 +743,57 @@ HttpRequest::Result HttpRequest::parseHeaders(InputStream & s, std::chrono::mill
 }
 
 //========================================================================
+// HttpRequest::Body
+//
+// Simple wrapper class to write to a blob as if it were an OutputStream,
+// or to forward data to another stream if a destination is set. Also
+// enforces the maximum size of the request body, which matters when
+// the body is compressed or chunked and its actual size is not known in
+// advance.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+HttpRequest::Body::Body(blob & store, size_t limit)
+  : store_(store),
+    remaining_(limit),
+    length_(0),
+    overflow_(false),
+    failed_(false) {
+}
+
+//--------------------------------------------------------------
+// Write a chunk of data to the blob or to the destination
+// stream.
+//--------------------------------------------------------------
+
+bool HttpRequest::Body::write(void const * data, size_t length) {
+    if (length > remaining_) {
+        overflow_ = true;
+        return false;
+    }
+    bool ok = getDestination() ? getDestination()->write(data, length) : store_.write(data, length);
+    if (!ok) {
+        failed_ = true;
+        return false;
+    }
+    remaining_ -= length;
+    length_ += length;
+    return true;
+}
+
+//--------------------------------------------------------------
+// Flush the destination stream, if any.
+//--------------------------------------------------------------
+
+bool HttpRequest::Body::flush() {
+    if (getDestination() && !getDestination()->flush()) {
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+//========================================================================
@@ -63,10 +63,16 @@ public:
     };
 
     Result                  parse(InputStream & s, std::chrono::seconds timeout, size_t limitRequestLine, size_t limitRequestHeaders, size_t limitRequestBody);
+    Result                  parseHead(InputStream & s, std::chrono::seconds timeout, size_t limitRequestLine, size_t limitRequestHeaders);
+    Result                  parseBody(InputStream & s, std::chrono::seconds timeout, size_t limitRequestHeaders, size_t limitRequestBody, OutputStream * sink, bool decode = true);
     bool                    shouldKeepAlive() const;
     Result                  isWebSocketUpgrade() const;
+    Result                  isHttp2Upgrade() const;
+    Result                  expectsContinue(size_t limitRequestBody) const;
     compression::set        getAcceptedEncodings() const;
     std::string const &     getHeaderValue(HttpHeader const & hdr) const;
+    HttpHeaderMap const &   getHeaders() const              { return headers_;          }
+    HttpHeaderMap const &   getTrailers() const             { return trailers_;         }
 
     AddrIPv4 const &        getLocalAddress() const         { return localAddress_;     }
     AddrIPv4 const &        getRemoteAddress() const        { return remoteAddress_;    }
@@ -81,38 +87,42 @@ private:
     bool                    request_;           // indicate whether we are parsing a request or a response.
     AddrIPv4                localAddress_;      // local address (i.e. the server side)
     AddrIPv4                remoteAddress_;     // remote address (i.e. the client side)
-    bool                    secure_;            // whether the connection is secured or not (always false: TLS not supported yet)
+    bool                    secure_;            // whether the connection is secured by TLS or not
     HttpVerb                verb_;              // verb (GET, POST, PUT, HEAD, etc.)
     URI                     uri_;               // requested URI
     HttpHeaderMap           headers_;           // request headers
+    HttpHeaderMap           trailers_;          // trailer fields of a chunked body
     int                     httpVersion_;       // protocol version
     HttpStatus              status_;            // status code
     blob                    body_;              // content of the request body
 
     Result  parseRequestLine(InputStream & s, std::chrono::milliseconds timeout, size_t maxsize);
     Result  parseResponseLine(InputStream & s, std::chrono::milliseconds timeout, size_t maxsize);
-    Result  parseHeaders(InputStream & s, std::chrono::milliseconds timeout, size_t maxsize);
+    Result  parseHeaders(InputStream & s, std::chrono::milliseconds timeout, size_t maxsize, HttpHeaderMap & fields);
 
     class Body : public OutputStream {          // simple wrapper class to write to a blob as if it were an OutputStream
     public:
-        Body(blob & store) : store_(store)                  {                                       }
-        bool write(void const * data, size_t length)        { return store_.write(data, length);    }
+        Body(blob & store, size_t limit);
+        bool write(void const * data, size_t length) override;
+        bool flush() override;
+
+        size_t getLength() const                            { return length_;                       }
+        bool isOverflow() const                             { return overflow_;                     }
+        bool isFailed() const                               { return failed_;                       }
 
     private:
-        blob & store_;
+        blob &  store_;                         // blob the data are written to (when there is no destination stream)
+        size_t  remaining_;                     // number of bytes that can still be written
+        size_t  length_;                        // number of bytes written so far
+        bool    overflow_;                      // flag to remember if the limit was exceeded
+        bool    failed_;                        // flag to remember if writing to the blob failed
     };
-
-#ifdef UNIT_TESTING
-public:
-#else
-private:
-#endif
-    HttpHeaderMap const &   getHeaders() const                  { return headers_;              }
 };
 
 extern int const HTTP_VERSION_0_9;              // constant representing HTTP/0.9
 extern int const HTTP_VERSION_1_0;              // constant representing HTTP/1.0
 extern int const HTTP_VERSION_1_1;              // constant representing HTTP/1.1
+extern int const HTTP_VERSION_2_0;              // constant representing HTTP/2
 
 //--------------------------------------------------------------
 
@@ -49,10 +49,10 @@
 // Constructor.
 //--------------------------------------------------------------
 
-HttpResponse::HttpResponse(IHttpConfig & config, HttpRequest const & request, StreamSocket & socket, Connection connection)
+HttpResponse::HttpResponse(IHttpConfig & config, HttpRequest const & request, OutputStream & output, Connection connection)
   : config_(config),
     request_(request),
-    socket_(socket),
+    output_(output),
     httpStatus_(200), 
     headerState_(0),
     connection_(connection),
@@ -167,6 +167,45 @@ bool HttpResponse::flush() {
     return true;
 }
 
+//--------------------------------------------------------------
+// Push to the client what the resource transmitted so far. Until
+// the headers are complete, there is nothing to push.
+//--------------------------------------------------------------
+
+bool HttpResponse::sync() {
+    return headerState_ != 10 || getDestination()->sync();
+}
+
+//--------------------------------------------------------------
+// Transmit a range of a file as part of the response body. When
+// the body is sent as-is (no compression, no chunked encoding,
+// not a HEAD request), the file goes straight to the socket,
+// which can send it without copying it to user space. Otherwise
+// it is read and passed through the chain of transformers.
+//--------------------------------------------------------------
+
+bool HttpResponse::sendFile(HANDLE_T file, uint64_t offset, size_t length) {
+    if (headerState_ == 10 && getDestination() == &output_ && !logger::isDumpEnabled()) {
+        return output_.sendFile(file, offset, length);
+    }
+    return OutputStream::sendFile(file, offset, length);
+}
+
+//--------------------------------------------------------------
+// Transmit data available in a pipe as part of the response. Same
+// as sendFile: once the headers are parsed, if the body is sent
+// as-is, the data go straight from the pipe to the socket.
+// Otherwise they are read and passed through write(), which
+// also parses the headers.
+//--------------------------------------------------------------
+
+long HttpResponse::sendPipe(HANDLE_T pipe, size_t length) {
+    if (headerState_ == 10 && getDestination() == &output_ && !logger::isDumpEnabled()) {
+        return output_.sendPipe(pipe, length);
+    }
+    return OutputStream::sendPipe(pipe, length);
+}
+
 //--------------------------------------------------------------
 // Return the response date. This date corresponds to the moment
 // this function is called for the first time, which depending
@@ -188,28 +227,48 @@ date HttpResponse::getResponseDate() {
 
 void HttpResponse::prepareForBody() {
 
-    // The destination device is the client socket for regular
-    // requests and null device for HEAD requests.
+    // If the resource transmitted a status, set the HTTP
+    // status accordingly and remove the corresponding
+    // header (it must not be transmitted to the client).
+
+    auto status = headers_.find(HttpHeader::Status);
+    if (status != headers_.end()) {
+        std::string const & st = status->second;
+        size_t len = st.size();
+        if (len == 3 || (len > 3 && isspace(st[3]))) {
+            long code = string::to_long(st.substr(0, 3), 10);
+            if (code >= 100 && code <= 999) {
+                setHttpStatus(code);
+            }
+        }
+        headers_.erase(HttpHeader::Status);
+    }
+
+    // The destination device is the client socket (or HTTP/2
+    // stream) for regular requests and null device for HEAD
+    // requests and responses that cannot have a body.
 
-    if (request_.getVerb().isOneOf(HttpVerb::Head)) {
+    bool bodyless = isBodyless();
+    if (bodyless || request_.getVerb().isOneOf(HttpVerb::Head)) {
         std::unique_ptr<OutputStream> null = std::make_unique<StreamNull>();
         setDestination(null.get());
         transformers_.push_back(std::move(null));
     } else {
-        setDestination(&socket_);
+        setDestination(&output_);
     }
 
     // Determine if the resource transmitted a fixed length.
 
     auto got = headers_.find(HttpHeader::ContentLength);
-    long length = got != headers_.end() ? string::to_long(got->second, 10) : -1;
+    long length = bodyless ? 0 : got != headers_.end() ? string::to_long(got->second, 10) : -1;
 
     // If HTTP compression is enabled and the client accepts compression and
     // the resource is either bigger than 16 bytes or either of unknown size,
-    // apply compression.
+    // apply compression. (Not for a partial content, the range refers to
+    // the uncompressed data, nor for a body the resource already encoded.)
 
     compression::set accepted = request_.getAcceptedEncodings();
-    if (config_.isCompressionEnabled() && !accepted.empty() && (length < 0 || length >= 16)) {
+    if (!bodyless && config_.isCompressionEnabled() && !accepted.empty() && (length < 0 || length >= 16) && headers_.find(HttpHeader::ContentRange) == headers_.end() && !isEncoded()) {
         auto got2 = headers_.find(HttpHeader::ContentType);
         if (got2 != headers_.end()) {
             encoding_ = selectCompressionMode(accepted, Mime(got2->second));
@@ -220,9 +279,18 @@ void HttpResponse::prepareForBody() {
     // the response body. If compression is enabled or if size
     // is unknown, we choose chunked encoding and headers are
     // delayed. Otherwise, we send headers now and there
-    // is no transformers.
+    // is no transformers. HTTP/2 streams frame the body
+    // themselves, so only compression applies to them.
 
-    if (encoding_ != compression::none || length < 0) {
+    if (connection_ == Connection::Multiplexed) {
+        emitHeaders(encoding_ != compression::none ? -1 : length);
+        if (encoding_ != compression::none) {
+            std::unique_ptr<OutputStream> transformer = makeStreamTransformer(encoding_, length);
+            transformer->setDestination(getDestination());
+            setDestination(transformer.get());
+            transformers_.push_back(std::move(transformer));
+        }
+    } else if (encoding_ != compression::none || length < 0) {
         std::unique_ptr<OutputStream> transformer1 = std::make_unique<StreamChunked>([this](long length) { this->emitHeaders(length); });
         transformer1->setDestination(getDestination());
         setDestination(transformer1.get());
@@ -240,53 +308,70 @@ void HttpResponse::prepareForBody() {
 }
 
 //--------------------------------------------------------------
-// Emit the headers.
+// Indicate if the resource declared a content coding of its own
+// (e.g. a body relayed from an upstream server as is).
 //--------------------------------------------------------------
 
-void HttpResponse::emitHeaders(long length) {
+bool HttpResponse::isEncoded() const {
+    auto got = headers_.find(HttpHeader::ContentEncoding);
+    return got != headers_.end() && !string::compare_i(got->second, "identity");
+}
 
-    // If the resource transmitted a status, set the HTTP
-    // status accordingly and remove the corresponding
-    // header (it must not be transmitted to the client).
+//--------------------------------------------------------------
+// Indicate if the status forbids a body (1xx, 204 and 304).
+//--------------------------------------------------------------
 
-    auto got = headers_.find(HttpHeader::Status);
-    if (got != headers_.end()) {
-        std::string const & st = got->second;
-        size_t len = st.size();
-        if (len == 3 || (len > 3 && isspace(st[3]))) {
-            long status = string::to_long(st.substr(0, 3), 10);
-            if (status >= 100 && status <= 999) {
-                setHttpStatus(status);
-            }
-        }
-        headers_.erase(HttpHeader::Status);
-    }
+bool HttpResponse::isBodyless() const {
+    int code = httpStatus_.getStatusCode();
+    return (code >= 100 && code < 200) || code == 204 || code == 304;
+}
+
+//--------------------------------------------------------------
+// Emit the headers.
+//--------------------------------------------------------------
+
+void HttpResponse::emitHeaders(long length) {
 
     // Build and transmit the response line.
 
     std::string resp = "HTTP/1.1 " + std::to_string(httpStatus_.getStatusCode()) + " " + httpStatus_.getStatusString();
-    socket_.write(resp.data(), resp.length());
-    socket_.emitEol();
+    output_.write(resp.data(), resp.length());
+    output_.emitEol();
     LOG_DEBUG_SEND("=> " << resp);
 
     // If the length is known, insert a Content-Length field
     // and remove any Transfer-Encoding indication. Otherwise,
-    // indicate a chunked encoding.
+    // indicate a chunked encoding. A response that cannot have
+    // a body has neither (the Content-Length of a 304 would be
+    // that of the full response).
 
-    if (length >= 0) {
+    if (isBodyless()) {
+        headers_.erase(HttpHeader::ContentLength);
+        headers_.erase(HttpHeader::TransferEncoding);
+    } else if (length >= 0) {
         headers_[HttpHeader::ContentLength] = std::to_string(length);
         headers_.erase(HttpHeader::TransferEncoding);
     } else {
         headers_.erase(HttpHeader::ContentLength);
-        headers_[HttpHeader::TransferEncoding] = "chunked";
+        if (connection_ != Connection::Multiplexed) {
+            headers_[HttpHeader::TransferEncoding] = "chunked";
+        }
     }
 
-    // Set the field indicating the compression mode.
+    // Set the field indicating the compression mode. A content
+    // coding applied by the resource itself is left as is. When
+    // we compress the body, an entity tag can only be weak.
 
     if (encoding_ == compression::none) {
-        headers_.erase(HttpHeader::ContentEncoding);
+        if (!isEncoded()) {
+            headers_.erase(HttpHeader::ContentEncoding);
+        }
     } else {
         headers_[HttpHeader::ContentEncoding] = getCompressionName(encoding_);
+        auto tag = headers_.find(HttpHeader::ETag);
+        if (tag != headers_.end() && tag->second.compare(0, 2, "W/") != 0) {
+            tag->second.insert(0, "W/");    // a strong tag identifies the bytes of the uncompressed body
+        }
     }
 
     // Set the field indicating the connection status.
@@ -305,10 +390,10 @@ void HttpResponse::emitHeaders(long length) {
     // Send all the headers to the client.
 
     for (auto & p: headers_) {
-        socket_.emitHeader(p.first, p.second);
+        output_.emitHeader(p.first, p.second);
         LOG_DEBUG_SEND("=> " << p.first.getFieldName() << ": " << p.second);
     }
-    socket_.emitEol();
+    output_.emitEol();
 }
 
 //========================================================================
@@ -48,13 +48,17 @@ public:
         Close,
         KeepAlive,
         Upgrade,
+        Multiplexed,
     };
 
-    HttpResponse(IHttpConfig & config, HttpRequest const & request, StreamSocket & socket, Connection connection);
+    HttpResponse(IHttpConfig & config, HttpRequest const & request, OutputStream & output, Connection connection);
     ~HttpResponse() override;
 
     bool    write(void const * data, size_t length) override;
     bool    flush() override;
+    bool    sync() override;
+    bool    sendFile(HANDLE_T file, uint64_t offset, size_t length) override;
+    long    sendPipe(HANDLE_T pipe, size_t length) override;
 
     date    getResponseDate();
     void    setHttpStatus(HttpStatus status)            { httpStatus_ = status; }
@@ -62,20 +66,22 @@ public:
 private:
     IHttpConfig &                               config_;                // server configuration
     HttpRequest const &                         request_;               // info about the request
-    StreamSocket &                              socket_;                // client socket 
+    OutputStream &                              output_;                // client socket, or HTTP/2 stream
     std::vector<std::unique_ptr<OutputStream>>  transformers_;          // list of transformers applied to the response (compression, chunk, etc.)
     HttpStatus                                  httpStatus_;            // HTTP status of the response
     int                                         headerState_;           // (temporary variable to parse the headers) machine state
     std::string                                 headerKey_;             // (temporary variable to parse the headers) key being parsed
     std::string                                 headerValue_;           // (temporary variable to parse the headers) value being parsed
     HttpHeaderMap                               headers_;               // response headers
-    Connection                                  connection_;            // send a "connection: close/keepalive/upgrade"
+    Connection                                  connection_;            // send a "connection: close/keepalive/upgrade", or no framing at all (HTTP/2)
     compression::mode                           encoding_;              // actual encoding
     date                                        responseDate_;          // date of the response
     logger::dump                                dump_;                  // helper object to dump response body
 
     void    prepareForBody();
     void    emitHeaders(long length);
+    bool    isEncoded() const;
+    bool    isBodyless() const;
 };
 
 //--------------------------------------------------------------
@@ -21,6 +21,11 @@
 // THE SOFTWARE.
 //========================================================================
 
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/resource.h>
+#endif
+
 #include "../misc/logger.h"
 #include "ihttpconfig.h"
 #include "uri.h"
@@ -28,6 +33,7 @@
 #include "http_request.h"
 #include "http_response.h"
 #include "http_server.h"
+#include "http2.h"
 
 //========================================================================
 // HttpServer
@@ -35,6 +41,12 @@
 // Implement the HTTP server. A socket is bound to the specified port to
 // accept incoming requests and a pool of threads is used to process
 // connections as they arrive. 
+//
+// A resource that must wait for a while before it can be transmitted
+// (e.g. a running CGI script) can hand the waiting over to a reactor.
+// The connection is then suspended in the reactor, which frees the
+// worker thread, and resumed by a worker thread when the resource is
+// done.
 //========================================================================
 
 //--------------------------------------------------------------
@@ -42,7 +54,11 @@
 //--------------------------------------------------------------
 
 HttpServer::HttpServer(IHttpConfig & config)
-  : config_(config) {
+  : config_(config)
+#ifndef _WIN32
+  , next_(0)
+#endif
+    {
     LOG_TRACE("Init HttpServer");
 }
 
@@ -52,6 +68,12 @@ HttpServer::HttpServer(IHttpConfig & config)
 
 HttpServer::~HttpServer() {
     LOG_TRACE("Destroy HttpServer");
+#ifndef _WIN32
+    for (auto & reactor: reactors_) {
+        reactor->stop();        // first, so that no connection is resumed meanwhile
+    }
+#endif
+    config_.getEventHub().close();     // release the event stream subscribers waiting in worker threads
     pool_.stopAll();
 }
 
@@ -62,6 +84,17 @@ HttpServer::~HttpServer() {
 
 int HttpServer::startup() {
 
+#ifndef _WIN32
+    // Allow as many open sockets as the system permits, since
+    // each connection (e.g. an idle WebSocket) holds one.
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+#endif
+
     // Create and configure the server socket.
 
     if (!socket_.create()) {
@@ -79,6 +112,12 @@ int HttpServer::startup() {
         return EXIT_FAILURE;
     }
 
+#ifndef _WIN32
+    for (int i = 0; i < config_.getReactorThreads(); i++) {
+        reactors_.push_back(std::make_unique<Reactor>());
+    }
+#endif
+
     StreamSocket::shutdown(false);
     LOG_INFO("Server is up and listening");
 
@@ -111,6 +150,18 @@ void HttpServer::stop() {
     socket_.close();
 }
 
+//--------------------------------------------------------------
+// Suspend a connection until the operation it waits for is done.
+// Reactors are used in turn.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+void HttpServer::suspend(std::unique_ptr<Connection> connection) {
+    size_t n = next_++ % reactors_.size();
+    reactors_[n]->add(std::make_unique<Suspended>(std::move(connection)));
+}
+#endif
+
 //========================================================================
 // HttpServer::Connection
 //
@@ -128,7 +179,9 @@ HttpServer::Connection::Connection(HttpServer & server, StreamSocket & socket, A
     server_(server),
     socket_(std::move(socket)),
     local_(local),
-    remote_(remote) {
+    remote_(remote),
+    secure_(false),
+    keepalive_(false) {
     LOG_TRACE("Init HttpServer::Connection");
 }
 
@@ -145,32 +198,87 @@ HttpServer::Connection::~Connection() {
 //--------------------------------------------------------------
 
 void HttpServer::Connection::run(int /* no */) {
-    bool keepalive;
+
+    // If the connection was suspended while its resource was
+    // waiting in a reactor, finish transmitting the response, then
+    // go on with the next request.
+
+    if (response_) {
+        body_->complete(*response_, *request_);
+        response_.reset();
+        body_.reset();
+        if (!keepalive_) {
+            socket_.setCorked(false);
+            LOG_INFO("Closing connection on socket " << socket_);
+            return;
+        }
+    } else {
+
+        // If TLS is enabled, clients may connect either in clear text
+        // or with TLS on the same port. A TLS client speaks first with
+        // a handshake record, which tells them apart.
+
+#ifdef ZINC_TLS
+        if (StreamSocket::isTLSEnabled() && socket_.isTLSHandshake(server_.config_.getTimeout())) {
+            if (!socket_.startTLS(server_.config_.getTimeout())) {
+                LOG_INFO("TLS handshake failed, closing connection on socket " << socket_);
+                return;
+            }
+            secure_ = true;
+        }
+#endif
+
+        // A client with prior knowledge of HTTP/2 starts with
+        // the connection preface instead of a request. (HTTP/2
+        // is only offered in clear text, i.e. h2c.)
+
+#ifdef ZINC_HTTP2
+        if (!secure_ && Http2::Connection::isPreface(socket_, server_.config_.getTimeout())) {
+            LOG_INFO("Using HTTP/2 on socket " << socket_);
+            Http2::Connection(server_.config_, socket_, server_.pool_, local_, remote_).run(nullptr);
+            LOG_INFO("Closing connection on socket " << socket_);
+            return;
+        }
+#endif
+    }
+
     do {
-        // Parse the request and resolve which local resource
-        // to transmit.
+        // Parse the request line and headers, and resolve which
+        // local resource to transmit. Then read the body, giving
+        // the resource the opportunity to process it on the fly.
 
         std::shared_ptr<Resource> body;
-        HttpRequest request(local_, remote_, false);
-        HttpRequest::Result r = request.parse(socket_, server_.config_.getTimeout(), static_cast<size_t>(server_.config_.getLimitRequestLine()), static_cast<size_t>(server_.config_.getLimitRequestHeaders()), static_cast<size_t>(server_.config_.getLimitRequestBody()));
+        request_ = std::make_unique<HttpRequest>(local_, remote_, secure_);
+        HttpRequest & request = *request_;
+        HttpRequest::Result r = request.parseHead(socket_, server_.config_.getTimeout(), static_cast<size_t>(server_.config_.getLimitRequestLine()), static_cast<size_t>(server_.config_.getLimitRequestHeaders()));
         if (r.isAborted()) {
             break;
         } else if (r.isError()) {
-            keepalive = false;
+            keepalive_ = false;
             body = server_.config_.makeErrorPage(r.getHttpStatus());
         } else {
+#ifdef ZINC_HTTP2
+            if (!secure_ && request.isHttp2Upgrade().isOK()) {
+                LOG_INFO("Switching protocol to HTTP/2 on socket " << socket_);
+                socket_.setCorked(false);
+                socket_.emitPage("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+                Http2::Connection(server_.config_, socket_, server_.pool_, local_, remote_).run(&request);
+                break;
+            }
+#endif
 #ifdef ZINC_WEBSOCKET
             HttpRequest::Result ws = request.isWebSocketUpgrade();
             if (ws.isError()) {
-                keepalive = false;
+                keepalive_ = false;
                 body = server_.config_.makeErrorPage(ws.getHttpStatus());
             } else if (ws.isOK()) {
                 LOG_INFO("Switching protocol on socket " << socket_);
-                server_.websockets_.add(server_.config_, std::move(socket_)).handshake(request);
+                socket_.setCorked(false);
+                server_.websockets_.add(server_.config_, std::move(socket_), request);
                 return;
             } else {
 #endif
-                keepalive = request.shouldKeepAlive();
+                keepalive_ = request.shouldKeepAlive();
                 if (request.getVerb().isOneOf(HttpVerb::Get | HttpVerb::Head | HttpVerb::Post | HttpVerb::Put | HttpVerb::Delete)) {
                     body = server_.config_.resolve(request.getURI());
                 } else {
@@ -179,19 +287,177 @@ void HttpServer::Connection::run(int /* no */) {
 #ifdef ZINC_WEBSOCKET
             }
 #endif
+
+            // If the client waits for an interim response before sending
+            // the body, either reply 100 (Continue) or reject the request
+            // right now, sparing a body that would be discarded anyway.
+
+            HttpRequest::Result ex = request.expectsContinue(static_cast<size_t>(server_.config_.getLimitRequestBody()));
+            if (ex.isError()) {
+                keepalive_ = false;
+                body = server_.config_.makeErrorPage(ex.getHttpStatus());
+            } else if (ex.isOK() && !body->acceptsBody()) {
+                keepalive_ = false;      // the body is not sent, so the connection cannot be reused
+            } else {
+                if (ex.isOK()) {
+                    LOG_DEBUG_SEND("=> HTTP/1.1 100 Continue");
+                    socket_.emitPage("HTTP/1.1 100 Continue\r\n\r\n");
+                }
+                r = request.parseBody(socket_, server_.config_.getTimeout(), static_cast<size_t>(server_.config_.getLimitRequestHeaders()), static_cast<size_t>(server_.config_.getLimitRequestBody()), body->getBodySink(request, static_cast<size_t>(server_.config_.getLimitRequestBody())));
+                if (r.isAborted()) {
+                    break;
+                } else if (r.isError()) {
+                    keepalive_ = false;
+                    body = server_.config_.makeErrorPage(r.getHttpStatus());
+                }
+            }
         }
 
-        // Build and transmit a response.
+        // Build and transmit a response. If the client pipelines its
+        // requests and the next one is already received, delay sending
+        // the response so that consecutive small responses are sent
+        // together.
 
-        HttpResponse response(server_.config_, request, socket_, keepalive ? HttpResponse::Connection::KeepAlive : HttpResponse::Connection::Close);
+        socket_.setCorked(keepalive_ && socket_.hasPendingInput());
+        response_ = std::make_unique<HttpResponse>(server_.config_, request, socket_, keepalive_ ? HttpResponse::Connection::KeepAlive : HttpResponse::Connection::Close);
         LOG_INFO_SEND("Replying: " << body->getDescription());
-        body->transmit(response, request);
+
+        // If reactors are enabled, the resource may hand the rest
+        // of the work over to one of them. The connection is then
+        // suspended (see done) and this function is called again
+        // when the resource is done.
+
+#ifndef _WIN32
+        if (!server_.reactors_.empty()) {
+            handler_ = body->detach(*response_, request);
+            if (handler_) {
+                body_ = std::move(body);
+                return;
+            }
+        } else {
+            body->transmit(*response_, request);
+        }
+#else
+        body->transmit(*response_, request);
+#endif
+        response_.reset();
 
         // Loop until the client or the server request a
         // connection close.
 
-    } while (keepalive);
+    } while (keepalive_);
+    socket_.setCorked(false);
     LOG_INFO("Closing connection on socket " << socket_);
 }
 
+//--------------------------------------------------------------
+// Called by the worker thread once run() returns. If the resource
+// handed its work over to a reactor, suspend the connection in it.
+// Otherwise, the connection is done and destroyed.
+//--------------------------------------------------------------
+
+void HttpServer::Connection::done(std::unique_ptr<ThreadPool::Task> self) {
+#ifndef _WIN32
+    if (handler_) {
+        server_.suspend(std::unique_ptr<Connection>(static_cast<Connection *>(self.release())));
+    }
+#endif
+}
+
+//========================================================================
+// HttpServer::Suspended
+//
+// Connection waiting in a reactor for the operation of its resource to
+// be done, e.g. a script to terminate. The operation writes to the
+// client as data become available. The client socket is non-blocking
+// meanwhile, so that the reactor thread is never blocked: what the
+// client does not accept is kept in the socket output buffer, and the
+// operation is paused (e.g. the script output is left in the pipe)
+// until the client takes it. A client that accepts nothing for too
+// long is disconnected.
+//========================================================================
+
+#ifndef _WIN32
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+HttpServer::Suspended::Suspended(std::unique_ptr<Connection> connection)
+  : connection_(std::move(connection)),
+    congested_(false) {
+    connection_->socket_.setBlocking(false);
+}
+
+//--------------------------------------------------------------
+// Gather the descriptors to wait for. The first one is the client
+// socket, only watched when the client is congested. The operation
+// descriptors are then ignored, but not its deadline.
+//--------------------------------------------------------------
+
+void HttpServer::Suspended::prepare(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline) {
+    fds.push_back({ congested_ ? connection_->socket_.getHandle() : -1, POLLOUT, 0 });
+    size_t first = fds.size();
+    connection_->handler_->prepare(fds, deadline);
+    if (congested_) {
+        for (size_t i = first; i < fds.size(); i++) {
+            fds[i].fd = -1;
+        }
+        deadline = std::min(deadline, since_ + connection_->server_.config_.getTimeout());
+    }
+}
+
+//--------------------------------------------------------------
+// Process the ready descriptors. Return false when the connection
+// is handed back to the thread pool.
+//--------------------------------------------------------------
+
+bool HttpServer::Suspended::process(struct pollfd const * fds) {
+    Connection & connection = *connection_;
+    auto now = std::chrono::steady_clock::now();
+    if (congested_) {
+        if (fds[0].revents != 0) {
+            connection.socket_.sync();      // a broken connection is noticed by the next write
+            congested_ = connection.socket_.hasPendingOutput();
+            since_ = now;
+        } else if (now >= since_ + connection.server_.config_.getTimeout()) {
+            LOG_INFO("Client is not reading, closing connection on socket " << connection.socket_);
+            connection.handler_.reset();
+            connection.keepalive_ = false;
+            connection.socket_.close();
+            return resume();
+        }
+    }
+
+    if (!connection.handler_->process(fds + 1)) {
+        connection.handler_.reset();
+        return resume();
+    }
+
+    if (!congested_) {
+        struct pollfd pf = { connection.socket_.getHandle(), POLLOUT, 0 };
+        if (connection.socket_.hasPendingOutput() || poll(&pf, 1, 0) == 0) {
+            congested_ = true;
+            since_ = now;
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Give the connection back to the thread pool, so that the
+// response is completed. (It waits for a worker thread if all
+// of them are busy.) The socket is blocking again, and sends
+// what it still holds with the next write.
+//--------------------------------------------------------------
+
+bool HttpServer::Suspended::resume() {
+    HttpServer & server = connection_->server_;
+    connection_->socket_.setBlocking(true);
+    server.pool_.addTask(std::move(connection_), server.config_.getLimitThreads(), true);
+    return false;
+}
+
+#endif
+
 //========================================================================
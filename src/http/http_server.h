@@ -24,9 +24,17 @@
 #ifndef HTTP_SERVER_H
 #define HTTP_SERVER_H
 
+#include <vector>
+#include <memory>
+#include <atomic>
+
 #include "ihttpconfig.h"
 #include "thread_pool.h"
+#include "reactor.h"
+#include "event_hub.h"
 #include "stream_socket.h"
+#include "http_request.h"
+#include "http_response.h"
 #include "websocket.h"
 
 //--------------------------------------------------------------
@@ -44,6 +52,7 @@ public:
 #ifdef ZINC_WEBSOCKET
     void    broadcast(WebSocket::Frame const & frame)       { websockets_.broadcast(frame); }
 #endif
+    uint64_t publish(std::string const & data, std::string const & type = std::string())    { return config_.getEventHub().publish(data, type); }
 
 private:
     IHttpConfig &               config_;        // server configuration
@@ -52,6 +61,10 @@ private:
 #ifdef ZINC_WEBSOCKET
     WebSocket::ConnectionList   websockets_;    // active websocket connections
 #endif
+#ifndef _WIN32
+    std::vector<std::unique_ptr<Reactor>>   reactors_;  // reactors waiting for the running scripts
+    std::atomic<unsigned>                   next_;      // reactor the next suspended connection goes to
+#endif
 
     class Connection : public ThreadPool::Task {
     public:
@@ -59,13 +72,40 @@ private:
         ~Connection();
 
         void run(int no) override;
+        void done(std::unique_ptr<ThreadPool::Task> self) override;
 
     private:
-        HttpServer &    server_;    // server
-        StreamSocket    socket_;    // connection with the client
-        AddrIPv4        local_;     // local address (i.e. the server)
-        AddrIPv4        remote_;    // remote address (i.e. the client)
+        HttpServer &                        server_;    // server
+        StreamSocket                        socket_;    // connection with the client
+        AddrIPv4                            local_;     // local address (i.e. the server)
+        AddrIPv4                            remote_;    // remote address (i.e. the client)
+        bool                                secure_;    // whether the connection is secured by TLS or not
+        bool                                keepalive_; // whether the connection is kept open after the current request
+        std::unique_ptr<HttpRequest>        request_;   // request being processed
+        std::shared_ptr<Resource>           body_;      // resource being transmitted, while the connection is suspended
+        std::unique_ptr<Reactor::Handler>   handler_;   // operation the connection waits for, while it is suspended
+        std::unique_ptr<HttpResponse>       response_;  // response being transmitted
+
+        friend class HttpServer;
     };
+
+#ifndef _WIN32
+    class Suspended : public Reactor::Handler {     // connection waiting in a reactor for its resource to be ready
+    public:
+        Suspended(std::unique_ptr<Connection> connection);
+        void prepare(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline) override;
+        bool process(struct pollfd const * fds) override;
+
+    private:
+        std::unique_ptr<Connection>             connection_;    // suspended connection
+        bool                                    congested_;     // whether the client does not accept more data for now
+        std::chrono::steady_clock::time_point   since_;         // moment the client stopped accepting data
+
+        bool                                    resume();
+    };
+
+    void    suspend(std::unique_ptr<Connection> connection);
+#endif
 };
 
 //--------------------------------------------------------------
@@ -58,6 +58,7 @@ public:
     friend std::ostream &   operator << (std::ostream & os, HttpVerb const & rhs)       { return os << rhs.getVerbName();                           }
     bool                    isValid() const                                             { return verb_ != Unknown;                                  }
     bool                    isOneOf(Verb set) const                                     { return (verb_ & set) != 0;                                }
+    bool                    isIdempotent() const                                        { return isOneOf(Get | Head | Put | Delete | Options | Trace); }
 
     std::string const &     getVerbName() const;
 
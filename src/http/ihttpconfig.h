@@ -32,6 +32,7 @@ class HttpStatus;   // forward declarations: we cannot include the relevant head
 class Resource;     // because of circular dependencies
 class AddrIPv4;
 class URI;
+class EventHub;
 
 #ifdef ZINC_WEBSOCKET
 namespace WebSocket {
@@ -52,14 +53,18 @@ public:
 
     virtual int                         getListeningPort()                          = 0;
     virtual int                         getLimitThreads()                           = 0;
+    virtual int                         getReactorThreads()                         = 0;
     virtual int                         getLimitRequestLine()                       = 0;
     virtual int                         getLimitRequestHeaders()                    = 0;
     virtual int                         getLimitRequestBody()                       = 0;
     virtual std::chrono::seconds        getTimeout()                                = 0;
     virtual bool                        isCompressionEnabled()                      = 0;
     virtual std::string                 getVersionString()                          = 0;
+    virtual EventHub &                  getEventHub()                               = 0;
 
 #ifdef ZINC_WEBSOCKET
+    virtual int                         getWebSocketQueue()                         = 0;
+    virtual bool                        isSlowClientDropped()                       = 0;
     virtual void                        handleMessage(WebSocket::Connection & socket, WebSocket::Frame & frame)   = 0;
 #endif
 };
@@ -0,0 +1,220 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+#endif
+#include <algorithm>
+
+#include "../misc/logger.h"
+#include "reactor.h"
+
+//========================================================================
+// Reactor
+//
+// Thread waiting for I/O on behalf of operations that would otherwise
+// each block a worker thread (e.g. a CGI script running for a while).
+// A handler describes the descriptors it waits for and an optional
+// deadline, and is called back when one of them is ready or the deadline
+// is passed. When it is done, the handler is destroyed.
+//
+// Handlers run in the reactor thread and must not block. Not available
+// on Windows.
+//========================================================================
+
+#ifndef _WIN32
+
+//--------------------------------------------------------------
+// Constructor. Start the reactor thread.
+//--------------------------------------------------------------
+
+Reactor::Reactor()
+  : wakeup_ { -1, -1 },
+    count_(0),
+    stop_(false) {
+    LOG_TRACE("Init Reactor");
+    if (pipe(wakeup_) == 0) {
+        for (int fd: wakeup_) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    } else {
+        LOG_ERROR("Error creating reactor wakeup pipe");
+    }
+    thread_ = std::thread([this] {
+        this->run();
+    });
+}
+
+//--------------------------------------------------------------
+// Destructor. Stop the reactor thread.
+//--------------------------------------------------------------
+
+Reactor::~Reactor() {
+    LOG_TRACE("Destroy Reactor");
+    stop();
+    for (int fd: wakeup_) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+//--------------------------------------------------------------
+// Hand an operation over to the reactor. If the reactor is
+// stopped, the handler is destroyed right away.
+//--------------------------------------------------------------
+
+void Reactor::add(std::unique_ptr<Handler> handler) {
+    if (true) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stop_) {
+            pending_.push_back(std::move(handler));
+            count_++;
+        }
+    }
+    char c = 0;
+    while (write(wakeup_[1], &c, 1) < 0 && errno == EINTR) {
+    }
+}
+
+//--------------------------------------------------------------
+// Stop the reactor thread and destroy the pending operations.
+//--------------------------------------------------------------
+
+void Reactor::stop() {
+    if (true) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    char c = 0;
+    while (write(wakeup_[1], &c, 1) < 0 && errno == EINTR) {
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+//--------------------------------------------------------------
+// Return the number of operations being processed.
+//--------------------------------------------------------------
+
+size_t Reactor::getHandlerCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+//--------------------------------------------------------------
+// Reactor thread. Each handler appends its descriptors to the
+// array given to poll(), and is called back if one of them is
+// ready or its deadline is passed.
+//--------------------------------------------------------------
+
+void Reactor::run() {
+    struct Slot {
+        size_t                                  offset;         // position of the handler descriptors in the poll() array
+        size_t                                  count;          // number of descriptors
+        std::chrono::steady_clock::time_point   deadline;       // moment the handler must be called back anyway
+    };
+
+    std::vector<struct pollfd> fds;
+    std::vector<Slot> slots;
+    for ( ; ; ) {
+        if (true) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) {
+                break;
+            }
+            for (auto & handler: pending_) {
+                handlers_.push_back(std::move(handler));
+            }
+            pending_.clear();
+        }
+
+        // Gather the descriptors and the earliest deadline.
+
+        fds.clear();
+        slots.clear();
+        fds.push_back({ wakeup_[0], POLLIN, 0 });
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        for (auto & handler: handlers_) {
+            Slot slot { fds.size(), 0, std::chrono::steady_clock::time_point::max() };
+            handler->prepare(fds, slot.deadline);
+            slot.count = fds.size() - slot.offset;
+            deadline = std::min(deadline, slot.deadline);
+            slots.push_back(slot);
+        }
+
+        int timeout = -1;
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            timeout = static_cast<int>(std::max<long long>(0, remaining.count() + 1));
+        }
+
+        int r = poll(fds.data(), static_cast<nfds_t>(fds.size()), timeout);
+        if (r < 0) {
+            if (errno != EINTR) {
+                LOG_ERROR("internal error: poll() failed");
+            }
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            char buffer[256];
+            while (read(wakeup_[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+
+        // Call back the handlers that are ready, and destroy
+        // those that are done.
+
+        auto now = std::chrono::steady_clock::now();
+        auto slot = slots.begin();
+        for (auto it = handlers_.begin(); it != handlers_.end(); ++slot) {
+            bool ready = slot->deadline <= now;
+            for (size_t i = 0; i < slot->count && !ready; i++) {
+                ready = fds[slot->offset + i].revents != 0;
+            }
+            if (ready && !(*it)->process(fds.data() + slot->offset)) {
+                it = handlers_.erase(it);
+                std::lock_guard<std::mutex> lock(mutex_);
+                count_--;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Shutting down: abort the remaining operations.
+
+    handlers_.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+    count_ = 0;
+}
+
+#endif
+
+//========================================================================
@@ -0,0 +1,73 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+struct pollfd;
+
+//--------------------------------------------------------------
+// Thread multiplexing the I/O of several pending operations.
+//--------------------------------------------------------------
+
+class Reactor {
+public:
+    Reactor();
+    ~Reactor();
+
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+
+        virtual void prepare(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline) = 0;
+        virtual bool process(struct pollfd const * fds) = 0;
+    };
+
+    void    add(std::unique_ptr<Handler> handler);
+    void    stop();
+    size_t  getHandlerCount();
+
+private:
+    std::list<std::unique_ptr<Handler>>     handlers_;      // operations being processed (only accessed by the reactor thread)
+    std::vector<std::unique_ptr<Handler>>   pending_;       // operations added since the last iteration
+    std::mutex                              mutex_;         // thread synchronization
+    std::thread                             thread_;        // reactor thread
+    int                                     wakeup_[2];     // pipe used to interrupt poll() when an operation is added
+    size_t                                  count_;         // number of operations being processed or pending
+    bool                                    stop_;          // shutdown request
+
+    void    run();
+};
+
+//--------------------------------------------------------------
+
+#endif
+
+//========================================================================
@@ -49,4 +49,49 @@ Resource::~Resource() {
     LOG_TRACE("Destroy resource: " << description_);
 }
 
+//--------------------------------------------------------------
+// Called once the request headers are parsed, before the body is
+// read. A resource that can process the body while it is received
+// returns a stream the body is written to. A body known to exceed
+// the given limit is rejected by the parser anyway, so no sink should
+// be set up for it. By default, return nullptr: the body is stored in
+// the request object.
+//--------------------------------------------------------------
+
+OutputStream * Resource::getBodySink(HttpRequest const & /* request */, size_t /* limitRequestBody */) {
+    return nullptr;
+}
+
+//--------------------------------------------------------------
+// Indicate if the resource makes use of the request body. If not,
+// a client that waits for a 100 (Continue) response before sending
+// the body gets the final response immediately instead. By default,
+// return false: static resources ignore the body.
+//--------------------------------------------------------------
+
+bool Resource::acceptsBody() const {
+    return false;
+}
+
+//--------------------------------------------------------------
+// Start transmitting the resource, possibly handing the rest of
+// the work over to a reactor. A resource that has to wait for a
+// while (e.g. for a script to run) returns a handler the reactor
+// waits for, then complete() is called from a worker thread. By
+// default, transmit the resource synchronously and return nullptr.
+//--------------------------------------------------------------
+
+std::unique_ptr<Reactor::Handler> Resource::detach(HttpResponse & response, HttpRequest const & request) {
+    transmit(response, request);
+    return nullptr;
+}
+
+//--------------------------------------------------------------
+// Finish the transmission started by detach(), once the handler
+// it returned is done. By default, there is nothing to do.
+//--------------------------------------------------------------
+
+void Resource::complete(HttpResponse & /* response */, HttpRequest const & /* request */) {
+}
+
 //========================================================================
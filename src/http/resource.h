@@ -26,6 +26,7 @@
 
 #include "http_request.h"
 #include "http_response.h"
+#include "reactor.h"
 
 //--------------------------------------------------------------
 // Local resource.
@@ -38,6 +39,10 @@ public:
 
     std::string const & getDescription() const                                          { return description_; }
     virtual void        transmit(HttpResponse & response, HttpRequest const & request)  = 0;
+    virtual OutputStream * getBodySink(HttpRequest const & request, size_t limitRequestBody);
+    virtual bool        acceptsBody() const;
+    virtual std::unique_ptr<Reactor::Handler> detach(HttpResponse & response, HttpRequest const & request);
+    virtual void        complete(HttpResponse & response, HttpRequest const & request);
 
 private:
     std::string description_;
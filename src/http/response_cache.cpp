@@ -0,0 +1,344 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#include <algorithm>
+
+#include "../misc/logger.h"
+#include "../misc/string.h"
+#include "response_cache.h"
+
+//========================================================================
+// ResponseCache
+//
+// Short-lived cache of dynamic responses (a.k.a. micro-cache). Scripts
+// opt in by sending a Cache-Control header with a max-age or s-maxage
+// directive: the response is then reused for that long, instead of
+// running the script for each request. With stale-while-revalidate, an
+// expired response keeps being served for a while longer, while one
+// caller (and only one) runs the script again to refresh it.
+//
+// The cache is bounded in size. The least recently used responses are
+// dropped first.
+//
+// The cache also coalesces identical requests (single-flight): when
+// there is no usable response, the first caller runs the script (it is
+// the leader of a "flight"), and concurrent callers wait for it to land
+// instead of running the script too. They are given the leader output,
+// even if it cannot be stored, provided it is not specific to the
+// leader client (cookies, private responses). If the leader takes too
+// long, they run the script themselves.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+ResponseCache::ResponseCache(size_t capacity)
+  : capacity_(capacity),
+    size_(0) {
+    LOG_TRACE("Init ResponseCache");
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+ResponseCache::~ResponseCache() {
+    LOG_TRACE("Destroy ResponseCache");
+}
+
+//--------------------------------------------------------------
+// Look up a response. On success, return a copy of the response
+// and its age. If there is no usable response and another caller
+// is running the script, wait for its output, at most for the
+// given time. Otherwise, if requested, the caller becomes the
+// leader: other callers wait for it until it calls store() or
+// abandon(). Likewise, the caller elected to refresh a stale
+// response must call store() or abandon().
+//--------------------------------------------------------------
+
+ResponseCache::State ResponseCache::lookup(std::string const & key, std::string & content, std::chrono::seconds & age, bool lead, std::chrono::milliseconds wait) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto got = index_.find(key);
+    if (got != index_.end()) {
+        auto it = got->second;
+        age = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - it->stored);
+        if (age < it->maxAge + it->stale) {
+            entries_.splice(entries_.begin(), entries_, it);
+            content = it->content;
+            if (age < it->maxAge || !lead || flights_.count(key) != 0) {
+                return State::Hit;
+            }
+            flights_[key] = std::make_shared<Flight>();
+            return State::Revalidate;
+        }
+        remove(it);
+    }
+
+    auto flight = flights_.find(key);
+    if (flight == flights_.end()) {
+        if (!lead) {
+            return State::Miss;
+        }
+        flights_[key] = std::make_shared<Flight>();
+        return State::Lead;
+    }
+
+    std::shared_ptr<Flight> f = flight->second;
+    if (!landed_.wait_for(lock, wait, [&f] { return f->done; }) || !f->shared) {
+        return State::Miss;
+    }
+    content = f->content;
+    age = std::chrono::seconds(0);
+    return State::Hit;
+}
+
+//--------------------------------------------------------------
+// Store a response, if it is cacheable, replacing the previous
+// one with the same key. Callers waiting for this response are
+// given it.
+//--------------------------------------------------------------
+
+void ResponseCache::store(std::string const & key, std::string const & content) {
+    std::chrono::seconds maxAge, stale;
+    bool cacheable = getFreshness(content, maxAge, stale);
+    bool shared = cacheable || isShareable(content);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    land(key, shared, content);
+    auto got = index_.find(key);
+    if (got != index_.end()) {
+        remove(got->second);
+    }
+    if (!cacheable || content.size() > capacity_ / 8) {
+        return;
+    }
+
+    while (size_ + content.size() > capacity_ && !entries_.empty()) {
+        remove(std::prev(entries_.end()));
+    }
+
+    entries_.push_front(Entry { key, content, std::chrono::steady_clock::now(), maxAge, stale });
+    index_[key] = entries_.begin();
+    size_ += content.size();
+}
+
+//--------------------------------------------------------------
+// Give up running the script (it failed, or its output is too
+// large to be kept). Callers waiting for it run the script
+// themselves, and a stale response will be refreshed by
+// another caller.
+//--------------------------------------------------------------
+
+void ResponseCache::abandon(std::string const & key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    land(key, false, std::string());
+}
+
+//--------------------------------------------------------------
+// Change the maximum total size of the stored responses.
+//--------------------------------------------------------------
+
+void ResponseCache::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    while (size_ > capacity_ && !entries_.empty()) {
+        remove(std::prev(entries_.end()));
+    }
+}
+
+//--------------------------------------------------------------
+// Return the maximum size of a stored response.
+//--------------------------------------------------------------
+
+size_t ResponseCache::getEntryLimit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_ / 8;
+}
+
+//--------------------------------------------------------------
+// Parse the header block of a script output to determine how long
+// the response can be cached. Only successful responses that do
+// not set cookies and carry an explicit lifetime are cacheable.
+//--------------------------------------------------------------
+
+bool ResponseCache::getFreshness(std::string const & content, std::chrono::seconds & maxAge, std::chrono::seconds & staleWhileRevalidate) {
+    long age = -1, sage = -1, swr = 0;
+    bool cacheable = true;
+
+    bool complete = scanHeaders(content, [&] (std::string const & name, std::string & value) {
+        if (string::compare_i(name, "Status")) {
+            cacheable = cacheable && value.compare(0, 3, "200") == 0;
+        } else if (string::compare_i(name, "Set-Cookie")) {
+            cacheable = false;
+        } else if (string::compare_i(name, "Cache-Control")) {
+            string::split(value, ',', 0, string::trim_both, [&] (std::string & directive) {
+                string::lowercase(directive);
+                if (directive == "no-store" || directive == "no-cache" || directive == "private") {
+                    cacheable = false;
+                } else if (directive.compare(0, 8, "max-age=") == 0) {
+                    age = string::to_long(directive.substr(8), 10);
+                } else if (directive.compare(0, 9, "s-maxage=") == 0) {
+                    sage = string::to_long(directive.substr(9), 10);
+                } else if (directive.compare(0, 23, "stale-while-revalidate=") == 0) {
+                    swr = std::max(0L, string::to_long(directive.substr(23), 10));
+                }
+                return true;
+            });
+        }
+    });
+
+    maxAge = std::chrono::seconds(sage >= 0 ? sage : age);  // s-maxage applies to shared caches and takes precedence
+    staleWhileRevalidate = std::chrono::seconds(swr);
+    return complete && cacheable && maxAge.count() > 0;
+}
+
+//--------------------------------------------------------------
+// Parse the header block of a script output to determine if the
+// response can be given to other clients than the one it was
+// produced for, i.e. it does not set cookies and is neither
+// private nor forbidden to store.
+//--------------------------------------------------------------
+
+bool ResponseCache::isShareable(std::string const & content) {
+    bool shareable = true;
+    bool complete = scanHeaders(content, [&] (std::string const & name, std::string & value) {
+        if (string::compare_i(name, "Set-Cookie")) {
+            shareable = false;
+        } else if (string::compare_i(name, "Cache-Control")) {
+            string::split(value, ',', 0, string::trim_both, [&] (std::string & directive) {
+                string::lowercase(directive);
+                shareable = shareable && directive != "no-store" && directive != "private";
+                return true;
+            });
+        }
+    });
+    return complete && shareable;
+}
+
+//--------------------------------------------------------------
+// Call a function for each field in the header block of a script
+// output. Return false if the header block is malformed or
+// incomplete.
+//--------------------------------------------------------------
+
+bool ResponseCache::scanHeaders(std::string const & content, std::function<void(std::string const &, std::string &)> callback) {
+    size_t pos = 0;
+    for (;;) {
+        size_t eol = content.find('\n', pos);
+        if (eol == std::string::npos) {
+            return false;
+        }
+        std::string line = content.substr(pos, eol - pos);
+        pos = eol + 1;
+        string::trim(line, string::trim_right);
+        if (line.empty()) {
+            return true;
+        }
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        std::string value = line.substr(colon + 1);
+        string::trim(value, string::trim_both);
+        callback(line.substr(0, colon), value);
+    }
+}
+
+//--------------------------------------------------------------
+// Mark the flight for a key as done, and wake up the callers
+// waiting for it. Must be called with the mutex locked.
+//--------------------------------------------------------------
+
+void ResponseCache::land(std::string const & key, bool shared, std::string const & content) {
+    auto got = flights_.find(key);
+    if (got != flights_.end()) {
+        got->second->done = true;
+        got->second->shared = shared;
+        if (shared) {
+            got->second->content = content;
+        }
+        flights_.erase(got);
+        landed_.notify_all();
+    }
+}
+
+//--------------------------------------------------------------
+// Remove an entry. Must be called with the mutex locked.
+//--------------------------------------------------------------
+
+void ResponseCache::remove(std::list<Entry>::iterator it) {
+    size_ -= it->content.size();
+    index_.erase(it->key);
+    entries_.erase(it);
+}
+
+//========================================================================
+// ResponseCache::Guard
+//
+// Make sure the flight of a caller elected to run a script lands, even if
+// the caller leaves early: otherwise later callers for the same key would
+// wait for it until they time out.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+ResponseCache::Guard::Guard(ResponseCache & cache, std::string const & key)
+  : cache_(&cache),
+    key_(key) {
+}
+
+//--------------------------------------------------------------
+// Destructor. Abandon the flight, unless it has landed already.
+//--------------------------------------------------------------
+
+ResponseCache::Guard::~Guard() {
+    abandon();
+}
+
+//--------------------------------------------------------------
+// Store the script output, which lands the flight.
+//--------------------------------------------------------------
+
+void ResponseCache::Guard::store(std::string const & content) {
+    if (cache_) {
+        cache_->store(key_, content);
+        cache_ = nullptr;
+    }
+}
+
+//--------------------------------------------------------------
+// Give up running the script.
+//--------------------------------------------------------------
+
+void ResponseCache::Guard::abandon() {
+    if (cache_) {
+        cache_->abandon(key_);
+        cache_ = nullptr;
+    }
+}
+
+//========================================================================
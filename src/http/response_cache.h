@@ -0,0 +1,109 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+
+//--------------------------------------------------------------
+// Cache of dynamic responses, stored as the raw output of the
+// script (headers and body).
+//--------------------------------------------------------------
+
+class ResponseCache {
+public:
+    ResponseCache(size_t capacity);
+    ~ResponseCache();
+
+    enum class State {
+        Miss,           // no usable response, the script must run
+        Lead,           // no usable response, the caller must run the script then call store() or abandon()
+        Hit,            // the response can be served
+        Revalidate,     // the response can be served, then the caller must run the script and call store() or abandon()
+    };
+
+    State           lookup(std::string const & key, std::string & content, std::chrono::seconds & age, bool lead = false, std::chrono::milliseconds wait = std::chrono::milliseconds(0));
+    void            store(std::string const & key, std::string const & content);
+    void            abandon(std::string const & key);
+    void            setCapacity(size_t capacity);
+    size_t          getEntryLimit();
+
+    static bool     getFreshness(std::string const & content, std::chrono::seconds & maxAge, std::chrono::seconds & staleWhileRevalidate);
+    static bool     isShareable(std::string const & content);
+
+    class Guard {                               // held by the caller running the script for a Lead or Revalidate state
+    public:
+        Guard(ResponseCache & cache, std::string const & key);
+        Guard(Guard const &) = delete;
+        Guard & operator=(Guard const &) = delete;
+        ~Guard();
+
+        void store(std::string const & content);
+        void abandon();
+
+    private:
+        ResponseCache * cache_;                 // cache the flight belongs to, or nullptr once it has landed
+        std::string     key_;                   // key of the response
+    };
+
+private:
+    struct Entry {
+        std::string                             key;            // key of the entry
+        std::string                             content;        // script output
+        std::chrono::steady_clock::time_point   stored;         // moment the response was stored
+        std::chrono::seconds                    maxAge;         // freshness lifetime
+        std::chrono::seconds                    stale;          // extra time the response can be served while being refreshed
+    };
+
+    struct Flight {
+        bool                                    done;           // whether the leader is done
+        bool                                    shared;         // whether the leader output can be given to the followers
+        std::string                             content;        // leader output
+    };
+
+    size_t                                                      capacity_;  // maximum total size of the stored responses
+    size_t                                                      size_;      // total size of the stored responses
+    std::mutex                                                  mutex_;     // thread synchronization
+    std::list<Entry>                                            entries_;   // stored responses, most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;     // stored responses by key
+    std::unordered_map<std::string, std::shared_ptr<Flight>>    flights_;   // scripts being run by a leader, by key
+    std::condition_variable                                     landed_;    // signaled when a flight is done
+
+    void            remove(std::list<Entry>::iterator it);
+    void            land(std::string const & key, bool shared, std::string const & content);
+    static bool     scanHeaders(std::string const & content, std::function<void(std::string const &, std::string &)> callback);
+};
+
+//--------------------------------------------------------------
+
+#endif
+
+//========================================================================
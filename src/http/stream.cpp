@@ -21,7 +21,11 @@
 // THE SOFTWARE.
 //========================================================================
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include <cstring>
+#include <algorithm>
 
 #include "../misc/logger.h"
 #include "stream.h"
@@ -65,6 +69,79 @@ bool OutputStream::flush() {
     return true;
 }
 
+//--------------------------------------------------------------
+// Push the data buffered so far to the client, without ending
+// the stream (unlike flush). This is used when the source of the
+// data is idle, so that streamed content is not held back in the
+// buffers of the transformers. By default, pass the request on
+// to the destination stream.
+//--------------------------------------------------------------
+
+bool OutputStream::sync() {
+    return destination_ == nullptr || destination_->sync();
+}
+
+//--------------------------------------------------------------
+// Write a range of a file to the stream. The default
+// implementation reads the file and writes its content through
+// write(). Streams able to transmit a file without copying it
+// to user space (e.g. sockets) override this method.
+//--------------------------------------------------------------
+
+bool OutputStream::sendFile(HANDLE_T file, uint64_t offset, size_t length) {
+    char buffer[16384];
+    while (length > 0) {
+        size_t count = std::min(length, sizeof(buffer));
+#ifdef _WIN32
+        OVERLAPPED ov = {};
+        ov.Offset = static_cast<DWORD>(offset);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD r;
+        if (!ReadFile(file, buffer, static_cast<DWORD>(count), &r, &ov) || r == 0) {
+            return false;
+        }
+#else
+        ssize_t r = pread(file, buffer, count, static_cast<off_t>(offset));
+        if (r <= 0) {
+            return false;
+        }
+#endif
+        if (!write(buffer, static_cast<size_t>(r))) {
+            return false;
+        }
+        offset += static_cast<uint64_t>(r);
+        length -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Transmit data available in a pipe, up to the given length.
+// Return the number of bytes taken from the pipe, zero at the end
+// of input, or a negative value if the pipe could not be read or
+// the data could not be written. The default implementation reads
+// the pipe and writes the data through write(). Streams able to
+// move data from a pipe without copying it to user space override
+// this method.
+//--------------------------------------------------------------
+
+long OutputStream::sendPipe(HANDLE_T pipe, size_t length) {
+    char buffer[16384];
+    size_t count = std::min(length, sizeof(buffer));
+#ifdef _WIN32
+    DWORD r;
+    if (!ReadFile(pipe, buffer, static_cast<DWORD>(count), &r, nullptr)) {
+        return GetLastError() == ERROR_BROKEN_PIPE ? 0 : -1;
+    }
+#else
+    ssize_t r = ::read(pipe, buffer, count);
+    if (r <= 0) {
+        return static_cast<long>(r);
+    }
+#endif
+    return write(buffer, static_cast<size_t>(r)) ? static_cast<long>(r) : -1;
+}
+
 //--------------------------------------------------------------
 // Emit a CRLF. (Note: the end-of-line marker in HTTP messages
 // is always CRLF, even on UNIX systems.)
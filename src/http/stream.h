@@ -28,6 +28,7 @@
 #include <string>
 #include <chrono>
 
+#include "../misc/portability.h"
 #include "http_header.h"
 
 //--------------------------------------------------------------
@@ -57,6 +58,9 @@ public:
 
     virtual bool    write(void const * data, size_t length) = 0;
     virtual bool    flush();
+    virtual bool    sync();
+    virtual bool    sendFile(HANDLE_T file, uint64_t offset, size_t length);
+    virtual long    sendPipe(HANDLE_T pipe, size_t length);
 
     void            emitEol();
     void            emitHeader(HttpHeader const & header, std::string const & value);
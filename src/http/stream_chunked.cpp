@@ -22,6 +22,7 @@
 //========================================================================
 
 #include <cstring>
+#include <cctype>
 #include <algorithm>
 
 #include "../misc/logger.h"
@@ -74,7 +75,9 @@ bool StreamChunked::write(void const * data, size_t length) {
                 emitHeaders_(-1);
                 headersSent_ = true;
             }
-            encodeChunk();
+            if (!encodeChunk()) {
+                return false;
+            }
         }
         size_t size = std::min(maxChunkLength_ - chunkLength_, length - ndx);
         memcpy(currentChunk_ + chunkLength_, ptr + ndx, size);
@@ -104,22 +107,198 @@ bool StreamChunked::flush() {
     return getDestination()->flush();
 }
 
+//--------------------------------------------------------------
+// Send the data bufferized so far as a chunk, without ending
+// the transfer. This commits to chunked mode, since the total
+// length is not known yet.
+//--------------------------------------------------------------
+
+bool StreamChunked::sync() {
+    if (chunkLength_ > 0) {
+        if (!headersSent_) {
+            emitHeaders_(-1);
+            headersSent_ = true;
+        }
+        if (!encodeChunk()) {
+            return false;
+        }
+    }
+    return getDestination()->sync();
+}
+
 //--------------------------------------------------------------
 // Encode the (possibly empty) current chunk of data. Refer to
-// RFC 7230 section 4.1 for more information.
+// RFC 7230 section 4.1 for more information. Return false if
+// the destination stream failed (e.g. the client is gone).
 //--------------------------------------------------------------
 
-void StreamChunked::encodeChunk() {
+bool StreamChunked::encodeChunk() {
     char size[16];
     sprintf(size, "%lx", static_cast<unsigned long>(chunkLength_));
     LOG_TRACE("=> chunk of 0x" << size << " bytes");
 
-    getDestination()->write(size, strlen(size));
+    bool ok = getDestination()->write(size, strlen(size));
     getDestination()->emitEol();
-    getDestination()->write(currentChunk_, chunkLength_);
+    ok = getDestination()->write(currentChunk_, chunkLength_) && ok;
     getDestination()->emitEol();
 
     chunkLength_ = 0;
+    return ok;
+}
+
+//========================================================================
+// StreamDechunked
+//
+// Stream decoder for chunked Transfer-Encoding. This is the counterpart
+// of the StreamChunked class: it wraps the stream a message body is
+// read from and returns the content of the successive chunks, checking
+// on the fly that the decoded data do not exceed a maximum size. The
+// decoder stops right after the last (empty) chunk: the trailer section
+// that may follow is left in the source stream, so that the caller can
+// parse it as regular header fields. Refer to RFC 7230 section 4.1 for
+// more information.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+StreamDechunked::StreamDechunked(InputStream & source, size_t maxlen)
+  : source_(source),
+    state_(State::Header),
+    maxLength_(maxlen),
+    totalLength_(0),
+    chunkLength_(0),
+    overflow_(false) {
+
+    LOG_TRACE("Init StreamDechunked (max length = " << maxLength_ << ")");
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+StreamDechunked::~StreamDechunked() {
+    LOG_TRACE("Destroy StreamDechunked");
+}
+
+//--------------------------------------------------------------
+// Read decoded data. Return the number of bytes read, or zero
+// if the last chunk was reached or if an error occurred. (Call
+// isComplete() to tell the difference.) If the exact parameter
+// is true, does not return until the exact number of requested
+// bytes are read, otherwise return when at least one byte is
+// read.
+//--------------------------------------------------------------
+
+size_t StreamDechunked::read(void * data, size_t length, std::chrono::milliseconds timeout, bool exact) {
+    char * ptr = static_cast<char *>(data);
+    size_t count = 0;
+
+    while (count < length && state_ != State::Done) {
+        if (state_ == State::Failed) {
+            return 0;
+        }
+        if (state_ == State::Header) {
+            if (!decodeChunkHeader(timeout)) {
+                state_ = State::Failed;
+                return 0;
+            }
+            continue;
+        }
+
+        size_t r = source_.read(ptr + count, std::min(length - count, chunkLength_), timeout, false);
+        if (!r) {
+            state_ = State::Failed;
+            return 0;
+        }
+        count += r;
+        chunkLength_ -= r;
+
+        // The chunk data are followed by a CRLF. (We also
+        // accept a single LF.)
+
+        if (chunkLength_ == 0) {
+            int ch = source_.readByte(timeout);
+            if (ch == '\r') {
+                ch = source_.readByte(timeout);
+            }
+            if (ch != '\n') {
+                state_ = State::Failed;
+                return 0;
+            }
+            state_ = State::Header;
+        }
+
+        if (!exact) {
+            break;
+        }
+    }
+
+    return (exact && count < length) ? 0 : count;
+}
+
+//--------------------------------------------------------------
+// Decode a chunk header, i.e. a line of the form: "size\r\n" or
+// "size;extensions\r\n". Extensions are silently ignored. Return
+// false in case of syntax error, timeout, or if the chunk would
+// exceed the maximum size of the decoded data.
+//--------------------------------------------------------------
+
+bool StreamDechunked::decodeChunkHeader(std::chrono::milliseconds timeout) {
+    size_t size = 0, digits = 0;
+    int state = 0;
+
+    auto accept = [this, &size] () {
+        if (size > maxLength_ - totalLength_) {
+            LOG_TRACE("<= chunk of " << size << " bytes exceeds the maximum length");
+            overflow_ = true;
+            return false;
+        }
+        LOG_TRACE("<= chunk of " << size << " bytes");
+        totalLength_ += size;
+        chunkLength_ = size;
+        state_ = size > 0 ? State::Data : State::Done;
+        return true;
+    };
+
+    for (size_t count = 0; count < CHUNK_MAXHEADER; count++) {
+        int ch = source_.readByte(timeout);
+        if (ch < 0) {
+            return false;                           // timeout or socket closed
+        }
+
+        switch (state) {
+        case 0:                                     // read the chunk size
+            if (isxdigit(ch)) {
+                if (++digits > sizeof(size_t) * 2) {
+                    return false;
+                }
+                size = (size << 4) | static_cast<size_t>(isdigit(ch) ? ch - '0' : (ch | 0x20) - 'a' + 10);
+            } else if (digits == 0) {
+                return false;
+            } else if (ch == ';' || isblank(ch)) {
+                state = 1;
+            } else if (ch == '\r') {
+                state = 2;
+            } else if (ch == '\n') {
+                return accept();
+            } else {
+                return false;
+            }
+            break;
+        case 1:                                     // skip extensions up to the end of line
+            if (ch == '\r') {
+                state = 2;
+            } else if (ch == '\n') {
+                return accept();
+            }
+            break;
+        case 2:                                     // process CRLF
+            return ch == '\n' && accept();
+        }
+    }
+    return false;                                   // chunk header too long
 }
 
 //========================================================================
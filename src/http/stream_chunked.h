@@ -33,6 +33,7 @@
 //--------------------------------------------------------------
 
 #define CHUNK_MAXSIZE       4096
+#define CHUNK_MAXHEADER     1024
 
 class StreamChunked : public OutputStream {
 public:
@@ -41,6 +42,7 @@ public:
 
     bool    write(void const * data, size_t length) override;
     bool    flush() override;
+    bool    sync() override;
 
 private:
     std::function<void(long)>   emitHeaders_;                   // callback to emit the HTTP headers
@@ -49,7 +51,39 @@ private:
     size_t                      maxChunkLength_;                // maximum size of a chunk
     size_t                      chunkLength_;                   // number of bytes in the current chunk
 
-    void    encodeChunk();
+    bool    encodeChunk();
+};
+
+//--------------------------------------------------------------
+// Stream decoder for chunked Transfer-Encoding.
+//--------------------------------------------------------------
+
+class StreamDechunked : public InputStream {
+public:
+    StreamDechunked(InputStream & source, size_t maxlen);
+    ~StreamDechunked() override;
+
+    size_t  read(void * data, size_t length, std::chrono::milliseconds timeout, bool exact) override;
+
+    bool    isComplete() const                      { return state_ == State::Done;     }
+    bool    isOverflow() const                      { return overflow_;                 }
+
+private:
+    enum class State {
+        Header,                                                 // expecting a chunk header
+        Data,                                                   // reading the content of a chunk
+        Done,                                                   // last chunk received
+        Failed,                                                 // syntax error, timeout or overflow
+    };
+
+    InputStream &               source_;                        // stream the encoded data are read from
+    State                       state_;                         // decoder state
+    size_t                      maxLength_;                     // maximum size of the decoded data
+    size_t                      totalLength_;                   // number of bytes decoded so far
+    size_t                      chunkLength_;                   // number of bytes remaining in the current chunk
+    bool                        overflow_;                      // flag to remember if the maximum size was exceeded
+
+    bool    decodeChunkHeader(std::chrono::milliseconds timeout);
 };
 
 //--------------------------------------------------------------
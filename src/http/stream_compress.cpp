@@ -83,6 +83,19 @@ bool StreamDeflate::flush() {
     return getDestination()->flush();
 }
 
+//--------------------------------------------------------------
+// Emit everything compressed so far, aligned on a byte boundary
+// so that the client can decode it, and push it further down.
+// The compression ratio suffers a bit from each sync, hence
+// callers should not sync after every write.
+//--------------------------------------------------------------
+
+bool StreamDeflate::sync() {
+    state_.avail_in = 0;
+    compress(Z_SYNC_FLUSH);
+    return getDestination()->sync();
+}
+
 //--------------------------------------------------------------
 // Compress the current chunk of data and write the output
 // to the destination stream.
@@ -158,23 +171,249 @@ bool StreamBrotli::write(void const * data, size_t length) {
 }
 
 //--------------------------------------------------------------
-// Flush the stream.
+// Flush the stream. This ends the compressed stream.
 //--------------------------------------------------------------
 
 bool StreamBrotli::flush() {
+    compress(BROTLI_OPERATION_FINISH);
+    return getDestination()->flush();
+}
+
+//--------------------------------------------------------------
+// Emit everything compressed so far, so that the client can
+// decode it, and push it further down. The stream stays open.
+//--------------------------------------------------------------
+
+bool StreamBrotli::sync() {
+    compress(BROTLI_OPERATION_FLUSH);
+    return getDestination()->sync();
+}
+
+//--------------------------------------------------------------
+// Run the given operation on the encoder without new input, and
+// write the resulting output to the destination stream.
+//--------------------------------------------------------------
+
+void StreamBrotli::compress(BrotliEncoderOperation op) {
     do {
         unsigned char buffer[1024];
         unsigned char * next_out = buffer;
         unsigned char const * next_in = nullptr;
         size_t avail_out = sizeof(buffer), avail_in = 0;
 
-        BrotliEncoderCompressStream(state_, BROTLI_OPERATION_FLUSH, &avail_in, &next_in, &avail_out, &next_out, nullptr);
+        BrotliEncoderCompressStream(state_, op, &avail_in, &next_in, &avail_out, &next_out, nullptr);
         getDestination()->write(buffer, sizeof(buffer) - avail_out);
 
-        LOG_TRACE("encode " << sizeof(buffer) - avail_out << " bytes");
-    } while (BrotliEncoderHasMoreOutput(state_));
+        LOG_TRACE("Brotli encode: " << sizeof(buffer) - avail_out << " bytes");
+    } while (BrotliEncoderHasMoreOutput(state_) || (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(state_)));
+}
 
-    return getDestination()->flush();
+//--------------------------------------------------------------
+
+#endif // defined(ZINC_COMPRESSION_BROTLI)
+
+//========================================================================
+// StreamDecoder
+//
+// Base class for stream transformers that decompress data on the fly.
+// To protect the server against decompression bombs, it keeps track of
+// the number of bytes received and decoded, and aborts decoding as soon
+// as the expansion ratio becomes unreasonable. (The absolute size of
+// the decoded data is checked further down the chain, by the object
+// that stores them.)
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+StreamDecoder::StreamDecoder(size_t maxratio)
+  : OutputStream(),
+    maxRatio_(maxratio),
+    inputLength_(0),
+    outputLength_(0),
+    overflow_(false) {
+}
+
+//--------------------------------------------------------------
+// Account for a chunk of encoded data.
+//--------------------------------------------------------------
+
+bool StreamDecoder::consume(size_t length) {
+    inputLength_ += length;
+    return !overflow_;
+}
+
+//--------------------------------------------------------------
+// Write a chunk of decoded data to the destination stream, after
+// checking the expansion ratio.
+//--------------------------------------------------------------
+
+bool StreamDecoder::emit(void const * data, size_t length) {
+    outputLength_ += length;
+    if (outputLength_ >= DECODER_MINRATIOCHECK && outputLength_ / std::max(inputLength_, static_cast<size_t>(1)) >= maxRatio_) {
+        LOG_TRACE("Decoder: expansion ratio exceeded (" << inputLength_ << " => " << outputLength_ << " bytes)");
+        overflow_ = true;
+        return false;
+    }
+    return length == 0 || getDestination()->write(data, length);
+}
+
+//========================================================================
+// StreamInflate
+//
+// Stream transformer that decompress data on the fly using the deflate
+// or gzip algorithm.
+//========================================================================
+
+#if defined(ZINC_COMPRESSION_GZIP) || defined(ZINC_COMPRESSION_DEFLATE)
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+StreamInflate::StreamInflate(bool gzip, size_t maxratio)
+  : StreamDecoder(maxratio),
+    finished_(false) {
+    LOG_TRACE("Init StreamInflate (gzip = " << gzip << ")");
+
+    int windowbits = 15;
+    if (gzip) {
+        windowbits |= 16;
+    }
+
+    memset(&state_, 0, sizeof(state_));
+    inflateInit2(&state_, windowbits);
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+StreamInflate::~StreamInflate() {
+    LOG_TRACE("Destroy StreamInflate");
+    inflateEnd(&state_);
+}
+
+//--------------------------------------------------------------
+// Write a chunk of compressed data. Return false if the data
+// are corrupted or if the expansion ratio is exceeded.
+//--------------------------------------------------------------
+
+bool StreamInflate::write(void const * data, size_t length) {
+    if (finished_ || !consume(length)) {
+        return length == 0;     // trailing garbage after the end of the compressed stream
+    }
+
+    state_.avail_in = static_cast<uInt>(length);
+    state_.next_in = reinterpret_cast<unsigned char const *>(data);
+
+    do {
+        unsigned char buffer[4096];
+        state_.next_out = buffer;
+        state_.avail_out = sizeof(buffer);
+
+        int r = inflate(&state_, Z_NO_FLUSH);
+        if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR) {
+            LOG_TRACE("Deflate decode: error " << r);
+            return false;
+        }
+        if (!emit(buffer, sizeof(buffer) - state_.avail_out)) {
+            return false;
+        }
+        LOG_TRACE("Deflate decode: " << sizeof(buffer) - state_.avail_out << " bytes");
+
+        if (r == Z_STREAM_END) {
+            finished_ = true;
+            return state_.avail_in == 0;
+        }
+    } while (state_.avail_out == 0);
+
+    return true;
+}
+
+//--------------------------------------------------------------
+// Flush the stream. Fail if the compressed data are truncated.
+//--------------------------------------------------------------
+
+bool StreamInflate::flush() {
+    return finished_ && getDestination()->flush();
+}
+
+//--------------------------------------------------------------
+
+#endif // defined(ZINC_COMPRESSION_GZIP) || defined(ZINC_COMPRESSION_DEFLATE)
+
+//========================================================================
+// StreamBrotliDecoder
+//
+// Stream transformer that decompress data on the fly using the Brotli
+// algorithm.
+//========================================================================
+
+#if defined(ZINC_COMPRESSION_BROTLI)
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+StreamBrotliDecoder::StreamBrotliDecoder(size_t maxratio)
+    : StreamDecoder(maxratio),
+      state_(nullptr) {
+
+    LOG_TRACE("Init StreamBrotliDecoder");
+    state_ = BrotliDecoderCreateInstance(0, 0, nullptr);
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+StreamBrotliDecoder::~StreamBrotliDecoder() {
+    LOG_TRACE("Destroy StreamBrotliDecoder");
+    BrotliDecoderDestroyInstance(state_);
+}
+
+//--------------------------------------------------------------
+// Write a chunk of compressed data. Return false if the data
+// are corrupted or if the expansion ratio is exceeded.
+//--------------------------------------------------------------
+
+bool StreamBrotliDecoder::write(void const * data, size_t length) {
+    if (BrotliDecoderIsFinished(state_) || !consume(length)) {
+        return length == 0;     // trailing garbage after the end of the compressed stream
+    }
+
+    unsigned char const * next_in = reinterpret_cast<unsigned char const *>(data);
+    for ( ; ; ) {
+        unsigned char buffer[4096];
+        unsigned char * next_out = buffer;
+        size_t avail_out = sizeof(buffer);
+
+        BrotliDecoderResult r = BrotliDecoderDecompressStream(state_, &length, &next_in, &avail_out, &next_out, nullptr);
+        if (r == BROTLI_DECODER_RESULT_ERROR) {
+            LOG_TRACE("Brotli decode: " << BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state_)));
+            return false;
+        }
+        if (!emit(buffer, sizeof(buffer) - avail_out)) {
+            return false;
+        }
+        LOG_TRACE("Brotli decode: " << sizeof(buffer) - avail_out << " bytes");
+
+        if (r == BROTLI_DECODER_RESULT_SUCCESS) {
+            return length == 0;
+        } else if (r == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
+            return true;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+// Flush the stream. Fail if the compressed data are truncated.
+//--------------------------------------------------------------
+
+bool StreamBrotliDecoder::flush() {
+    return BrotliDecoderIsFinished(state_) && getDestination()->flush();
 }
 
 //--------------------------------------------------------------
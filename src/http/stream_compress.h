@@ -31,6 +31,7 @@
 
 #if defined(ZINC_COMPRESSION_BROTLI)
 #include <brotli/encode.h>
+#include <brotli/decode.h>
 #endif
 
 #include "stream.h"
@@ -47,6 +48,7 @@ public:
 
     bool write(void const * data, size_t length) override;
     bool flush() override;
+    bool sync() override;
 
 private:
     z_stream state_;
@@ -67,9 +69,74 @@ public:
 
     bool write(void const * data, size_t length) override;
     bool flush() override;
+    bool sync() override;
 
 private:
     BrotliEncoderState * state_;
+
+    void compress(BrotliEncoderOperation op);
+};
+#endif
+
+//--------------------------------------------------------------
+// Base class for stream decoders. (Decompression of request
+// bodies.)
+//--------------------------------------------------------------
+
+#define DECODER_MAXRATIO        100                 // maximum expansion ratio
+#define DECODER_MINRATIOCHECK   (1024 * 1024)       // size from which the ratio is checked
+
+class StreamDecoder : public OutputStream {
+public:
+    StreamDecoder(size_t maxratio);
+
+    bool    isOverflow() const                      { return overflow_;     }
+
+protected:
+    bool    consume(size_t length);
+    bool    emit(void const * data, size_t length);
+
+private:
+    size_t  maxRatio_;                                  // maximum ratio between decoded and encoded data
+    size_t  inputLength_;                               // number of bytes received so far
+    size_t  outputLength_;                              // number of bytes decoded so far
+    bool    overflow_;                                  // flag to remember if the maximum ratio was exceeded
+};
+
+//--------------------------------------------------------------
+// Stream decoder for deflate/gzip content encoding.
+//--------------------------------------------------------------
+
+#if defined(ZINC_COMPRESSION_GZIP) || defined(ZINC_COMPRESSION_DEFLATE)
+class StreamInflate : public StreamDecoder {
+public:
+    StreamInflate(bool gzip, size_t maxratio = DECODER_MAXRATIO);
+    ~StreamInflate() override;
+
+    bool write(void const * data, size_t length) override;
+    bool flush() override;
+
+private:
+    z_stream state_;
+    bool     finished_;
+};
+#endif
+
+//--------------------------------------------------------------
+// Stream decoder for brotli content encoding.
+//--------------------------------------------------------------
+
+#if defined(ZINC_COMPRESSION_BROTLI)
+class StreamBrotliDecoder : public StreamDecoder {
+public:
+    StreamBrotliDecoder(size_t maxratio = DECODER_MAXRATIO);
+    ~StreamBrotliDecoder() override;
+
+    bool write(void const * data, size_t length) override;
+    bool flush() override;
+
+private:
+    BrotliDecoderState * state_;
 };
 #endif
 
@@ -26,10 +26,20 @@
 #include <WS2tcpip.h>
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#ifdef ZINC_TLS
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 #include <algorithm>
 
@@ -129,12 +139,34 @@ std::ostream & operator << (std::ostream & os, AddrIPv4 const & rhs) {
 }
 
 //--------------------------------------------------------------
-// Retrieve the name from an IP address. (See below.)
+// Retrieve the name from an IP address. If wait is false and the
+// name is not known yet, return the address while the name is
+// looked up in the background. (See below.)
+//--------------------------------------------------------------
+
+std::string AddrIPv4::getNameInfo(bool wait) const {
+    static AddrIPv4::Resolver resolver(lookupName, std::chrono::hours(1), std::chrono::minutes(1)); // Thread-safe as of C++11
+    return resolver.resolve(*this, wait);
+}
+
+//--------------------------------------------------------------
+// Look up the name of an IP address with getnameinfo(). Return
+// false if the address has no name.
 //--------------------------------------------------------------
 
-std::string AddrIPv4::getNameInfo() const {
-    static AddrIPv4::Resolver resolver; // Thread-safe as of C++11
-    return resolver.resolve(*this);
+bool AddrIPv4::lookupName(AddrIPv4 const & addr, std::string & name) {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(addr.addr_);
+    sa.sin_port = htons(addr.port_);
+
+    char host[1028];
+    if (getnameinfo(reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa), host, sizeof(host), nullptr, 0, NI_NAMEREQD) != 0) {
+        return false;
+    }
+    name = host;
+    return true;
 }
 
 //--------------------------------------------------------------
@@ -154,27 +186,120 @@ void AddrIPv4::fillAddrIn(void * addr, size_t length) const {
 //========================================================================
 // AddrIPv4::Resolver
 //
-// Helper object to perform thread-safe calls to getnameinfo(). We need
-// to implement this pattern because despite POSIX requiring that this
-// API be thread-safe, it is actually not on some plateforms.
+// Cache of reverse DNS lookups. Names are kept for a while, and so are
+// failures (the name is then the address itself), so that a client
+// making many requests costs one lookup. Lookups are done without
+// holding the lock, so that a slow DNS server only delays the requests
+// from the address being looked up; concurrent requests for the same
+// address wait for the same lookup. Callers that cannot wait get the
+// address (or the expired name) while the lookup is done by a
+// background thread.
 //========================================================================
 
 //--------------------------------------------------------------
-// Does the actual name lookup.
+// Constructor.
+//--------------------------------------------------------------
+
+AddrIPv4::Resolver::Resolver(Lookup lookup, std::chrono::seconds ttl, std::chrono::seconds negativeTtl)
+  : lookup_(lookup),
+    ttl_(ttl),
+    negativeTtl_(negativeTtl),
+    stop_(false) {
+}
+
+//--------------------------------------------------------------
+// Destructor. Stop the background thread, if started.
+//--------------------------------------------------------------
+
+AddrIPv4::Resolver::~Resolver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        condition_.notify_all();
+    }
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+//--------------------------------------------------------------
+// Return the name of an address.
 //--------------------------------------------------------------
 
-std::string AddrIPv4::Resolver::resolve(AddrIPv4 const & addr) {
+std::string AddrIPv4::Resolver::resolve(AddrIPv4 const & addr, bool wait) {
     std::unique_lock<std::mutex> lock(mutex_);
 
-    struct sockaddr_in sa;
-    sa.sin_family = AF_INET;
-    sa.sin_addr.s_addr = htonl(addr.addr_);
-    sa.sin_port = htons(addr.port_);
+    auto got = cache_.find(addr.addr_);
+    if (got != cache_.end() && (got->second.pending || got->second.expires > std::chrono::steady_clock::now())) {
+        if (got->second.pending && wait) {
+            condition_.wait(lock, [&] { return !cache_[addr.addr_].pending; });
+            return cache_[addr.addr_].name;
+        }
+        return got->second.name.empty() ? addr.getAddressString() : got->second.name;
+    }
 
-    char host[1028];
-    getnameinfo(reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa), host, sizeof(host), nullptr, 0, 0);
+    // The name is unknown or expired. Keep the cache from
+    // growing forever by dropping expired entries when it
+    // gets large.
 
-    return std::string(host);
+    if (got == cache_.end() && cache_.size() >= 4096) {
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = cache_.begin(); it != cache_.end(); ) {
+            it = (!it->second.pending && it->second.expires <= now) ? cache_.erase(it) : std::next(it);
+        }
+    }
+
+    Entry & entry = cache_[addr.addr_];
+    entry.pending = true;
+    if (!wait) {
+        std::string name = entry.name.empty() ? addr.getAddressString() : entry.name;
+        queue_.push_back(addr);
+        if (!worker_.joinable()) {
+            worker_ = std::thread(&Resolver::run, this);
+        }
+        condition_.notify_all();
+        return name;
+    }
+
+    lock.unlock();
+    update(addr);
+    lock.lock();
+    return cache_[addr.addr_].name;
+}
+
+//--------------------------------------------------------------
+// Look up an address and store the result.
+//--------------------------------------------------------------
+
+void AddrIPv4::Resolver::update(AddrIPv4 const & addr) {
+    std::string name;
+    bool ok = lookup_(addr, name);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry & entry = cache_[addr.addr_];
+    entry.name = ok ? name : addr.getAddressString();
+    entry.expires = std::chrono::steady_clock::now() + (ok ? ttl_ : negativeTtl_);
+    entry.pending = false;
+    condition_.notify_all();
+}
+
+//--------------------------------------------------------------
+// Background thread: look up the queued addresses.
+//--------------------------------------------------------------
+
+void AddrIPv4::Resolver::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        if (queue_.empty()) {
+            condition_.wait(lock);
+        } else {
+            AddrIPv4 addr = queue_.front();
+            queue_.pop_front();
+            lock.unlock();
+            update(addr);
+            lock.lock();
+        }
+    }
 }
 
 //========================================================================
@@ -191,7 +316,17 @@ std::string AddrIPv4::Resolver::resolve(AddrIPv4 const & addr) {
 //--------------------------------------------------------------
 
 StreamSocket::StreamSocket()
-    : socket_(INVALID_SOCKET) {
+    : socket_(INVALID_SOCKET),
+      inputStart_(0),
+      inputEnd_(0),
+#ifdef ZINC_TLS
+      corked_(false),
+      blocking_(true),
+      ssl_(nullptr) {
+#else
+      corked_(false),
+      blocking_(true) {
+#endif
 }
 
 //--------------------------------------------------------------
@@ -199,7 +334,17 @@ StreamSocket::StreamSocket()
 //--------------------------------------------------------------
 
 StreamSocket::StreamSocket(SOCKET_T socket)
-  : socket_(socket) {
+  : socket_(socket),
+    inputStart_(0),
+    inputEnd_(0),
+#ifdef ZINC_TLS
+    corked_(false),
+    blocking_(true),
+    ssl_(nullptr) {
+#else
+    corked_(false),
+    blocking_(true) {
+#endif
     LOG_TRACE("Init socket (fd = " << socket_ << ")");
 }
 
@@ -209,8 +354,22 @@ StreamSocket::StreamSocket(SOCKET_T socket)
 
 StreamSocket::StreamSocket(StreamSocket && other)
   : OutputStream(other),
-    socket_(other.socket_) {
+    socket_(other.socket_),
+    input_(std::move(other.input_)),
+    inputStart_(other.inputStart_),
+    inputEnd_(other.inputEnd_),
+    output_(std::move(other.output_)),
+#ifdef ZINC_TLS
+    corked_(other.corked_),
+    blocking_(other.blocking_),
+    ssl_(other.ssl_) {
+    other.ssl_ = nullptr;
+#else
+    corked_(other.corked_),
+    blocking_(other.blocking_) {
+#endif
     other.socket_ = INVALID_SOCKET;
+    other.inputStart_ = other.inputEnd_ = 0;
 }
 
 //--------------------------------------------------------------
@@ -218,6 +377,12 @@ StreamSocket::StreamSocket(StreamSocket && other)
 //--------------------------------------------------------------
 
 StreamSocket::~StreamSocket() {
+#ifdef ZINC_TLS
+    if (ssl_) {
+        SSL_shutdown(ssl_);
+        SSL_free(ssl_);
+    }
+#endif
     if (IS_SOCKET_VALID(socket_)) {
         LOG_TRACE("Destroy socket (fd = " << socket_ << ")");
         closesocket(socket_);
@@ -231,6 +396,15 @@ StreamSocket::~StreamSocket() {
 StreamSocket & StreamSocket::operator = (StreamSocket && other) {
     setDestination(other.getDestination());
     std::swap(socket_, other.socket_);
+    std::swap(input_, other.input_);
+    std::swap(inputStart_, other.inputStart_);
+    std::swap(inputEnd_, other.inputEnd_);
+    std::swap(output_, other.output_);
+    std::swap(corked_, other.corked_);
+    std::swap(blocking_, other.blocking_);
+#ifdef ZINC_TLS
+    std::swap(ssl_, other.ssl_);
+#endif
     return *this;
 }
 
@@ -244,7 +418,11 @@ bool StreamSocket::create() {
         return false;
     }
 #endif
+#ifdef SOCK_CLOEXEC
+    SOCKET_T s = socket(PF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);   // not inherited by CGI interpreters
+#else
     SOCKET_T s = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+#endif
     if (IS_SOCKET_VALID(s)) {
         int optval = 1;
         setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char const *>(&optval), sizeof(optval));
@@ -314,7 +492,11 @@ StreamSocket StreamSocket::accept(AddrIPv4 * addr) {
     if (IS_SOCKET_VALID(socket_)) {
         struct sockaddr_in remote;
         socklen_t len = sizeof(remote);
+#if defined(__linux__) && defined(SOCK_CLOEXEC)
+        SOCKET_T client = ::accept4(socket_, reinterpret_cast<struct sockaddr *>(&remote), &len, SOCK_CLOEXEC);
+#else
         SOCKET_T client = ::accept(socket_, reinterpret_cast<struct sockaddr *>(&remote), &len);
+#endif
         if (IS_SOCKET_VALID(client)) {
             if (addr) {
                 *addr = AddrIPv4(ntohl(remote.sin_addr.s_addr), ntohs(remote.sin_port));
@@ -343,8 +525,24 @@ AddrIPv4 StreamSocket::getLocalAddress() {
 //--------------------------------------------------------------
 
 int StreamSocket::select(std::chrono::milliseconds timeout) {
+    return hasPendingInput() ? 1 : waitReadable(timeout);
+}
+
+//--------------------------------------------------------------
+// Wait until the socket itself is readable, ignoring the
+// content of the input buffer. With TLS, records already
+// decrypted but not consumed also count as readable data.
+//--------------------------------------------------------------
+
+int StreamSocket::waitReadable(std::chrono::milliseconds timeout) {
+#ifdef ZINC_TLS
+    if (ssl_ && SSL_pending(ssl_) > 0) {
+        return 1;
+    }
+#endif
     int r = -1;
     if (IS_SOCKET_VALID(socket_)) {
+#ifdef _WIN32
         fd_set readfs;
         FD_ZERO(&readfs);
         FD_SET(socket_, &readfs);
@@ -352,6 +550,33 @@ int StreamSocket::select(std::chrono::milliseconds timeout) {
         tm.tv_sec = static_cast<long>((timeout.count() / 1000));
         tm.tv_usec = static_cast<long>((timeout.count() % 1000) * 1000);
         r = ::select(static_cast<int>(socket_) + 1, &readfs, nullptr, nullptr, &tm);
+#else
+        struct pollfd fd = { socket_, POLLIN, 0 };
+        r = ::poll(&fd, 1, static_cast<int>(timeout.count()));
+#endif
+    }
+    return r;
+}
+
+//--------------------------------------------------------------
+// Wait until the socket can accept more outgoing data.
+//--------------------------------------------------------------
+
+int StreamSocket::waitWritable(std::chrono::milliseconds timeout) {
+    int r = -1;
+    if (IS_SOCKET_VALID(socket_)) {
+#ifdef _WIN32
+        fd_set writefs;
+        FD_ZERO(&writefs);
+        FD_SET(socket_, &writefs);
+        struct timeval tm;
+        tm.tv_sec = static_cast<long>((timeout.count() / 1000));
+        tm.tv_usec = static_cast<long>((timeout.count() % 1000) * 1000);
+        r = ::select(static_cast<int>(socket_) + 1, nullptr, &writefs, nullptr, &tm);
+#else
+        struct pollfd fd = { socket_, POLLOUT, 0 };
+        r = ::poll(&fd, 1, static_cast<int>(timeout.count()));
+#endif
     }
     return r;
 }
@@ -361,10 +586,35 @@ int StreamSocket::select(std::chrono::milliseconds timeout) {
 //--------------------------------------------------------------
 
 void StreamSocket::close() {
+#ifdef ZINC_TLS
+    if (ssl_) {
+        SSL_shutdown(ssl_);
+        SSL_free(ssl_);
+        ssl_ = nullptr;
+    }
+#endif
     if (IS_SOCKET_VALID(socket_)) {
         closesocket(socket_);
         socket_ = INVALID_SOCKET;
     }
+    inputStart_ = inputEnd_ = 0;
+    output_.clear();
+}
+
+//--------------------------------------------------------------
+// Shut the connection down in both directions, without closing
+// the socket. A thread waiting on the socket is woken up and
+// sees the connection closed, and may then close the socket.
+//--------------------------------------------------------------
+
+void StreamSocket::disconnect() {
+    if (IS_SOCKET_VALID(socket_)) {
+#ifdef _WIN32
+        ::shutdown(socket_, SD_BOTH);
+#else
+        ::shutdown(socket_, SHUT_RDWR);
+#endif
+    }
 }
 
 //--------------------------------------------------------------
@@ -373,21 +623,52 @@ void StreamSocket::close() {
 // parameter is true, does not return until the exact number
 // of requested bytes are read, otherwise return when at least
 // one byte is read.
+//
+// Data are received in an input buffer, so that parsing a request
+// byte per byte does not cost a system call per byte, and so that
+// pipelined requests are already available when the previous one
+// is done. Before waiting for the client, any delayed output is
+// sent, since the client may well be waiting for it.
 //--------------------------------------------------------------
 
 size_t StreamSocket::read(void * data, size_t length, std::chrono::milliseconds timeout, bool exact) {
-    size_t count = 0;
+    size_t count = std::min(length, inputEnd_ - inputStart_);
+    if (count) {
+        memcpy(data, input_.data() + inputStart_, count);
+        inputStart_ += count;
+        if (count >= length || !exact) {
+            return count;
+        }
+    }
+
+    if (!sendPending()) {
+        return 0;
+    }
+
     while (timeout.count() > 0 && !shutdown_) {
         std::chrono::milliseconds delay = std::min(timeout, 500ms);
         int ret = select(delay);
         if (ret > 0) {
-            int r = recv(socket_, static_cast<char *>(data) + count, static_cast<int>(length - count), 0);
+            int r;
+            if (length - count >= SOCKET_BUFFERSIZE) {
+                r = receive(static_cast<char *>(data) + count, length - count);
+            } else {
+                input_.resize(SOCKET_BUFFERSIZE);
+                r = receive(input_.data(), SOCKET_BUFFERSIZE);
+                if (r > 0) {
+                    size_t n = std::min(length - count, static_cast<size_t>(r));
+                    memcpy(static_cast<char *>(data) + count, input_.data(), n);
+                    inputStart_ = n;
+                    inputEnd_ = static_cast<size_t>(r);
+                    r = static_cast<int>(n);
+                }
+            }
             if (r > 0) {
                 count += static_cast<size_t>(r);
                 if (count >= length || !exact) {
                     return count;
                 }
-            } else {
+            } else if (r == 0) {
                 break;
             }
         }
@@ -399,19 +680,506 @@ size_t StreamSocket::read(void * data, size_t length, std::chrono::milliseconds
 }
 
 //--------------------------------------------------------------
-// Write a chunk of data on the socket.
+// Copy the beginning of the pending input without consuming it.
+// If less than the requested length is buffered, wait once for
+// more data. Return the number of bytes copied, which is zero
+// if nothing was received before the timeout. The length must
+// not exceed the size of the input buffer.
+//--------------------------------------------------------------
+
+size_t StreamSocket::peek(void * data, size_t length, std::chrono::milliseconds timeout) {
+    if (inputEnd_ - inputStart_ < length && sendPending()) {
+        if (inputStart_ > 0) {
+            memmove(input_.data(), input_.data() + inputStart_, inputEnd_ - inputStart_);
+            inputEnd_ -= inputStart_;
+            inputStart_ = 0;
+        }
+        input_.resize(SOCKET_BUFFERSIZE);
+        while (timeout.count() > 0 && !shutdown_) {
+            std::chrono::milliseconds delay = std::min(timeout, 500ms);
+            int ret = waitReadable(delay);
+            if (ret > 0) {
+                int r = receive(input_.data() + inputEnd_, SOCKET_BUFFERSIZE - inputEnd_);
+                if (r > 0) {
+                    inputEnd_ += static_cast<size_t>(r);
+                }
+                if (r >= 0) {
+                    break;
+                }
+            } else if (ret < 0) {
+                break;
+            }
+            timeout -= delay;
+        }
+    }
+
+    size_t count = std::min(length, inputEnd_ - inputStart_);
+    memcpy(data, input_.data() + inputStart_, count);
+    return count;
+}
+
+//--------------------------------------------------------------
+// Wait for incoming data. Return true if the peer closed or reset
+// the connection before sending anything, false if data arrived
+// or nothing happened before the timeout.
+//--------------------------------------------------------------
+
+bool StreamSocket::isClosedByPeer(std::chrono::milliseconds timeout) {
+    char ch;
+    return select(timeout) > 0 && peek(&ch, 1, timeout) == 0;
+}
+
+//--------------------------------------------------------------
+// Read what is available without waiting, for a caller that
+// was notified the socket is readable. Buffered input comes
+// first, otherwise the socket is read once. Return the number
+// of bytes read, zero if the connection is closed or broken, or
+// a negative value if the TLS layer has nothing to deliver yet.
+//--------------------------------------------------------------
+
+long StreamSocket::readAvailable(void * data, size_t length) {
+    size_t count = std::min(length, inputEnd_ - inputStart_);
+    if (count) {
+        memcpy(data, input_.data() + inputStart_, count);
+        inputStart_ += count;
+        return static_cast<long>(count);
+    }
+    return receive(static_cast<char *>(data), length);
+}
+
+//--------------------------------------------------------------
+// Write what the socket accepts without waiting. Return the
+// number of bytes written, zero if the socket cannot take more
+// data for now, or a negative value if the connection is broken.
+// With TLS, a call that returned zero must be repeated with the
+// same data. (On Windows, the call may block.)
+//--------------------------------------------------------------
+
+long StreamSocket::writeAvailable(void const * data, size_t length) {
+#ifdef ZINC_TLS
+    if (ssl_) {
+        ERR_clear_error();
+        int r = SSL_write(ssl_, data, static_cast<int>(std::min(length, static_cast<size_t>(INT32_MAX))));
+        if (r > 0) {
+            return r;
+        }
+        int err = SSL_get_error(ssl_, r);
+        return err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ ? 0 : -1;
+    }
+#endif
+#ifdef _WIN32
+    int r = send(socket_, static_cast<char const *>(data), static_cast<int>(length), 0);
+#else
+    ssize_t r = send(socket_, data, length, MSG_DONTWAIT);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+#endif
+    return r > 0 ? static_cast<long>(r) : -1;
+}
+
+//--------------------------------------------------------------
+// Release the input and output buffers, once the pending data
+// are consumed, for a connection that is going to stay open and
+// mostly idle. They are allocated again if needed.
+//--------------------------------------------------------------
+
+void StreamSocket::releaseBuffers() {
+    sendPending();
+    if (!hasPendingInput()) {
+        std::vector<char>().swap(input_);
+        inputStart_ = inputEnd_ = 0;
+    }
+    std::vector<char>().swap(output_);
+}
+
+//--------------------------------------------------------------
+// Write a chunk of data on the socket. If the socket is corked,
+// data are accumulated in the output buffer and only sent when
+// the buffer is full. In non-blocking mode, what the socket does
+// not accept now is kept in the output buffer as well.
 //--------------------------------------------------------------
 
 bool StreamSocket::write(void const * data, size_t length) {
-    if (length > 0) {
-        auto count = static_cast<int>(length);
-        if (send(socket_, reinterpret_cast<char const *>(data), count, 0) != count) {
+    auto p = static_cast<char const *>(data);
+    if (corked_ && output_.size() + length <= SOCKET_BUFFERSIZE) {
+        output_.insert(output_.end(), p, p + length);
+        return true;
+    }
+    if (!sendPending()) {
+        return false;
+    }
+    long sent = output_.empty() ? sendAll(p, length) : 0;      // data still pending must go first
+    if (sent < 0) {
+        return false;
+    }
+    output_.insert(output_.end(), p + sent, p + length);
+    return true;
+}
+
+//--------------------------------------------------------------
+// Send pending data, unless the socket is corked.
+//--------------------------------------------------------------
+
+bool StreamSocket::flush() {
+    return corked_ || sendPending();
+}
+
+//--------------------------------------------------------------
+// Send the pending data now, even if the socket is corked: the
+// response being transmitted asked not to be held back.
+//--------------------------------------------------------------
+
+bool StreamSocket::sync() {
+    return sendPending();
+}
+
+//--------------------------------------------------------------
+// Switch the socket to non-blocking mode, or back. In non-blocking
+// mode, writes never wait for the client: what the socket cannot
+// take is kept in the output buffer until the next write or sync,
+// and the caller is expected to wait for the socket to become
+// writable while hasPendingOutput() is true. (Encrypted sockets
+// are always non-blocking at the system level.)
+//--------------------------------------------------------------
+
+void StreamSocket::setBlocking(bool blocking) {
+    blocking_ = blocking;
+#ifdef ZINC_TLS
+    if (ssl_) {
+        return;
+    }
+#endif
+    if (IS_SOCKET_VALID(socket_)) {
+#ifdef _WIN32
+        u_long nonblocking = blocking ? 0 : 1;
+        ioctlsocket(socket_, FIONBIO, &nonblocking);
+#else
+        int flags = fcntl(socket_, F_GETFL);
+        fcntl(socket_, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+#endif
+    }
+}
+
+//--------------------------------------------------------------
+// Cork or uncork the socket. When corked, small writes are
+// gathered and sent at once. This is used to send responses to
+// pipelined requests together. Uncorking the socket sends any
+// pending data.
+//--------------------------------------------------------------
+
+void StreamSocket::setCorked(bool corked) {
+    corked_ = corked;
+    if (!corked) {
+        sendPending();
+    }
+}
+
+//--------------------------------------------------------------
+// Transmit a range of a file. On Linux, a plain socket uses
+// sendfile(2) so that the file content is never copied to user
+// space. An encrypted socket can do the same when the kernel
+// performs the encryption (kTLS); otherwise the content is read
+// and sent through the TLS layer.
+//--------------------------------------------------------------
+
+bool StreamSocket::sendFile(HANDLE_T file, uint64_t offset, size_t length) {
+#ifdef __linux__
+    if (!sendPending()) {
+        return false;
+    }
+#ifdef ZINC_TLS
+    if (ssl_) {
+#ifdef SSL_OP_ENABLE_KTLS
+        if (!BIO_get_ktls_send(SSL_get_wbio(ssl_))) {
+            return OutputStream::sendFile(file, offset, length);
+        }
+        while (length > 0 && !shutdown_) {
+            ERR_clear_error();
+            ossl_ssize_t r = SSL_sendfile(ssl_, file, static_cast<off_t>(offset), length, 0);
+            if (r > 0) {
+                offset += static_cast<uint64_t>(r);
+                length -= static_cast<size_t>(r);
+            } else if (SSL_get_error(ssl_, static_cast<int>(r)) == SSL_ERROR_WANT_WRITE) {
+                waitWritable(500ms);
+            } else {
+                return false;
+            }
+        }
+        return length == 0;
+#else
+        return OutputStream::sendFile(file, offset, length);
+#endif
+    }
+#endif
+    while (length > 0) {
+        off_t pos = static_cast<off_t>(offset);
+        ssize_t r = ::sendfile(socket_, file, &pos, length);
+        if (r <= 0) {
             return false;
         }
+        offset += static_cast<uint64_t>(r);
+        length -= static_cast<size_t>(r);
+    }
+    return true;
+#else
+    return OutputStream::sendFile(file, offset, length);
+#endif
+}
+
+//--------------------------------------------------------------
+// Transmit data available in a pipe. On Linux, a plain socket uses
+// splice(2), so that the data move from the pipe to the socket
+// without being copied to user space. Encrypted sockets, and
+// descriptors splice(2) does not support, read the pipe and send
+// the data as usual. So does a non-blocking socket that is full
+// or has data pending, which keeps what it cannot send.
+//--------------------------------------------------------------
+
+long StreamSocket::sendPipe(HANDLE_T pipe, size_t length) {
+#ifdef __linux__
+#ifdef ZINC_TLS
+    if (ssl_) {
+        return OutputStream::sendPipe(pipe, length);
+    }
+#endif
+    if (!sendPending()) {
+        return -1;
+    }
+    if (!output_.empty()) {
+        return OutputStream::sendPipe(pipe, length);
+    }
+    ssize_t r = ::splice(pipe, nullptr, socket_, nullptr, length, SPLICE_F_MOVE);
+    if (r < 0 && (errno == EINVAL || errno == EAGAIN)) {
+        return OutputStream::sendPipe(pipe, length);
+    }
+    return static_cast<long>(r);
+#else
+    return OutputStream::sendPipe(pipe, length);
+#endif
+}
+
+//--------------------------------------------------------------
+// Receive a chunk of data from the socket, decrypting it if TLS
+// is active. Return the number of bytes received, zero if the
+// connection is closed or broken, or a negative value if the
+// TLS layer needs more data before it can deliver anything.
+//--------------------------------------------------------------
+
+int StreamSocket::receive(char * data, size_t length) {
+#ifdef ZINC_TLS
+    if (ssl_) {
+        ERR_clear_error();
+        int r = SSL_read(ssl_, data, static_cast<int>(length));
+        if (r > 0) {
+            return r;
+        }
+        int err = SSL_get_error(ssl_, r);
+        return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? -1 : 0;
+    }
+#endif
+    int r = recv(socket_, data, static_cast<int>(length), 0);
+    return r > 0 ? r : 0;
+}
+
+//--------------------------------------------------------------
+// Send a chunk of data, retrying in case of partial write.
+// Encrypted sockets are non-blocking, so we may have to wait
+// until the socket accepts more data. In non-blocking mode, we
+// stop there instead. Return the number of bytes sent, or -1 if
+// the connection is broken.
+//--------------------------------------------------------------
+
+long StreamSocket::sendAll(char const * data, size_t length) {
+    size_t sent = 0;
+    while (sent < length) {
+#ifdef ZINC_TLS
+        if (ssl_) {
+            ERR_clear_error();
+            int r = SSL_write(ssl_, data + sent, static_cast<int>(std::min(length - sent, static_cast<size_t>(INT32_MAX))));
+            if (r <= 0) {
+                int err = SSL_get_error(ssl_, r);
+                if ((err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) && !shutdown_) {
+                    if (!blocking_) {
+                        break;
+                    }
+                    waitWritable(500ms);
+                    continue;
+                }
+                return -1;
+            }
+            sent += static_cast<size_t>(r);
+            continue;
+        }
+#endif
+        int r = send(socket_, data + sent, static_cast<int>(length - sent), 0);
+        if (r <= 0) {
+            if (r < 0 && !blocking_ && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            return -1;
+        }
+        sent += static_cast<size_t>(r);
     }
+    return static_cast<long>(sent);
+}
+
+//--------------------------------------------------------------
+// Send the content of the output buffer. In non-blocking mode,
+// what the socket does not accept stays in the buffer.
+//--------------------------------------------------------------
+
+bool StreamSocket::sendPending() {
+    long sent = output_.empty() ? 0 : sendAll(output_.data(), output_.size());
+    if (sent < 0) {
+        output_.clear();
+        return false;
+    }
+    output_.erase(output_.begin(), output_.begin() + sent);
     return true;
 }
 
+//--------------------------------------------------------------
+// TLS support. A single context, holding the certificate and
+// the session cache, is shared by all connections.
+//--------------------------------------------------------------
+
+#ifdef ZINC_TLS
+
+static SSL_CTX * tlsContext = nullptr;
+
+//--------------------------------------------------------------
+// Create the TLS context from a certificate chain and a private
+// key, both in PEM format. Returning sessions are resumed either
+// from a stateless ticket or from the server-side session cache,
+// which spares them the asymmetric part of the handshake. Kernel
+// TLS is requested so that the kernel takes over the record
+// encryption after the handshake, when available.
+//--------------------------------------------------------------
+
+bool StreamSocket::setupTLS(std::string const & certificate, std::string const & key) {
+    SSL_CTX * ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        return false;
+    }
+
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_NO_RENEGOTIATION);
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+    SSL_CTX_set_mode(ctx, SSL_MODE_RELEASE_BUFFERS | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);     // a write to retry may have moved to the output buffer
+
+    static unsigned char const sessionContext[] = "zinc";
+    SSL_CTX_set_session_id_context(ctx, sessionContext, sizeof(sessionContext) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, 4096);
+    SSL_CTX_set_timeout(ctx, 3600);
+    SSL_CTX_set_num_tickets(ctx, 2);
+
+    if (SSL_CTX_use_certificate_chain_file(ctx, certificate.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, key.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        LOG_ERROR("Cannot load TLS certificate: " << ERR_reason_error_string(ERR_get_error()));
+        SSL_CTX_free(ctx);
+        return false;
+    }
+
+    if (tlsContext) {
+        SSL_CTX_free(tlsContext);
+    }
+    tlsContext = ctx;
+    return true;
+}
+
+//--------------------------------------------------------------
+// Indicate whether incoming connections may use TLS.
+//--------------------------------------------------------------
+
+bool StreamSocket::isTLSEnabled() {
+    return tlsContext != nullptr;
+}
+
+//--------------------------------------------------------------
+// Wait for the first byte sent by the client and indicate
+// whether it starts a TLS handshake. The byte is left in the
+// socket, so that either the TLS layer or the HTTP parser can
+// read it afterwards.
+//--------------------------------------------------------------
+
+bool StreamSocket::isTLSHandshake(std::chrono::milliseconds timeout) {
+    while (timeout.count() > 0 && !shutdown_) {
+        std::chrono::milliseconds delay = std::min(timeout, 500ms);
+        int ret = waitReadable(delay);
+        if (ret > 0) {
+            unsigned char ch;
+            return recv(socket_, reinterpret_cast<char *>(&ch), 1, MSG_PEEK) == 1 && ch == 0x16;     // TLS record type "handshake"
+        } else if (ret < 0) {
+            break;
+        }
+        timeout -= delay;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------
+// Perform the server side of the TLS handshake. The socket is
+// switched to non-blocking mode, so that a stalled client can
+// neither block the handshake nor a later read of a partial
+// record beyond the timeout.
+//--------------------------------------------------------------
+
+bool StreamSocket::startTLS(std::chrono::milliseconds timeout) {
+    if (!tlsContext || ssl_ || !IS_SOCKET_VALID(socket_)) {
+        return false;
+    }
+
+#ifdef _WIN32
+    u_long nonblocking = 1;
+    ioctlsocket(socket_, FIONBIO, &nonblocking);
+#else
+    fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+#endif
+
+    ssl_ = SSL_new(tlsContext);
+    if (!ssl_ || SSL_set_fd(ssl_, static_cast<int>(socket_)) != 1) {
+        close();
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline && !shutdown_) {
+        ERR_clear_error();
+        int r = SSL_accept(ssl_);
+        if (r == 1) {
+#ifdef SSL_OP_ENABLE_KTLS
+            bool ktls = BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+            bool ktls = false;
+#endif
+            LOG_TRACE("TLS handshake done (fd = " << socket_ << ", " << SSL_get_version(ssl_)
+                      << (SSL_session_reused(ssl_) ? ", resumed" : "")
+                      << (ktls ? ", ktls" : "") << ")");
+            return true;
+        }
+        int err = SSL_get_error(ssl_, r);
+        if (err == SSL_ERROR_WANT_READ) {
+            waitReadable(500ms);
+        } else if (err == SSL_ERROR_WANT_WRITE) {
+            waitWritable(500ms);
+        } else {
+            break;
+        }
+    }
+
+    LOG_TRACE("TLS handshake failed (fd = " << socket_ << ")");
+    SSL_free(ssl_);
+    ssl_ = nullptr;
+    return false;
+}
+
+#endif
+
 //--------------------------------------------------------------
 // Shutdown. If set to true, abort ASAP all reading operations
 // on all existing sockets.
@@ -26,7 +26,14 @@
 
 #include <ostream>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
 #include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
 
 #include "../misc/portability.h"
 #include "stream.h"
@@ -44,34 +51,64 @@ public:
 
     AddrIPv4 & operator = (AddrIPv4 const & other)                                  { addr_ = other.addr_; port_ = other.port_; return *this;   }
     operator bool() const                                                           { return addr_ != 0 && port_ != 0;                          }
+    bool            isLoopback() const                                              { return (addr_ >> 24) == 127;                              }
 
     std::string     getAddressString() const;
     std::string     getPortString() const;
-    std::string     getNameInfo() const;
+    std::string     getNameInfo(bool wait = true) const;
 
     void            fillAddrIn(void * addrin, size_t length) const;
 
     friend std::ostream & operator << (std::ostream & os, AddrIPv4 const & rhs);
     friend bool           operator == (AddrIPv4 const & lhs, AddrIPv4 const & rhs)  { return lhs.addr_ == rhs.addr_ && lhs.port_ == rhs.port_; }
 
-private:
-    uint32_t    addr_;
-    uint16_t    port_;
-
     class Resolver {
     public:
-        Resolver() = default;
-        std::string resolve(AddrIPv4 const & addr);
+        typedef std::function<bool(AddrIPv4 const &, std::string &)> Lookup;
+
+        Resolver(Lookup lookup, std::chrono::seconds ttl, std::chrono::seconds negativeTtl);
+        ~Resolver();
+
+        std::string resolve(AddrIPv4 const & addr, bool wait);
 
     private:
-        std::mutex  mutex_;
+        struct Entry {
+            std::string                             name;       // host name, or address if the lookup failed
+            std::chrono::steady_clock::time_point   expires;    // when the entry must be refreshed
+            bool                                    pending;    // whether a lookup is in progress
+        };
+
+        Lookup                                  lookup_;        // function doing the actual lookup
+        std::chrono::seconds                    ttl_;           // lifetime of successful lookups
+        std::chrono::seconds                    negativeTtl_;   // lifetime of failed lookups
+        std::mutex                              mutex_;         // thread synchronization
+        std::condition_variable                 condition_;     // thread synchronization
+        std::unordered_map<uint32_t, Entry>     cache_;         // cached names, by IP address
+        std::deque<AddrIPv4>                    queue_;         // addresses waiting for a background lookup
+        std::thread                             worker_;        // thread doing the background lookups
+        bool                                    stop_;          // flag asking the worker thread to stop
+
+        void        run();
+        void        update(AddrIPv4 const & addr);
     };
+
+    static bool     lookupName(AddrIPv4 const & addr, std::string & name);
+
+private:
+    uint32_t    addr_;
+    uint16_t    port_;
 };
 
 //--------------------------------------------------------------
 // Socket.
 //--------------------------------------------------------------
 
+#define SOCKET_BUFFERSIZE   16384       // size of the input and output buffers
+
+#ifdef ZINC_TLS
+struct ssl_st;
+#endif
+
 class StreamSocket : public OutputStream, public InputStream {
 public:
     StreamSocket();
@@ -93,17 +130,57 @@ public:
     AddrIPv4        getLocalAddress();
     int             select(std::chrono::milliseconds timeout);
     void            close();
+    void            disconnect();
 
     size_t          read(void * data, size_t length, std::chrono::milliseconds timeout, bool exact) override;
+    size_t          peek(void * data, size_t length, std::chrono::milliseconds timeout);
+    long            readAvailable(void * data, size_t length);
+    bool            isClosedByPeer(std::chrono::milliseconds timeout);
+    long            writeAvailable(void const * data, size_t length);
     bool            write(void const * data, size_t length) override;
+    bool            flush() override;
+    bool            sync() override;
+    bool            sendFile(HANDLE_T file, uint64_t offset, size_t length) override;
+    long            sendPipe(HANDLE_T pipe, size_t length) override;
+
+    bool            hasPendingInput() const                                             { return inputStart_ < inputEnd_;   }
+    bool            hasPendingOutput() const                                            { return !output_.empty();          }
+    SOCKET_T        getHandle() const                                                   { return socket_;                   }
+    void            setCorked(bool corked);
+    void            setBlocking(bool blocking);
+    void            releaseBuffers();
+
+#ifdef ZINC_TLS
+    bool            isTLSHandshake(std::chrono::milliseconds timeout);
+    bool            startTLS(std::chrono::milliseconds timeout);
+    bool            isSecure() const                                                    { return ssl_ != nullptr;           }
+
+    static bool     setupTLS(std::string const & certificate, std::string const & key);
+    static bool     isTLSEnabled();
+#endif
 
     static void     shutdown(bool shutdown);
 
 private:
     StreamSocket(SOCKET_T socket);
 
-    SOCKET_T        socket_;    // BSD socket
-    static bool     shutdown_;  // server is shuting down
+    SOCKET_T            socket_;        // BSD socket
+    std::vector<char>   input_;         // input buffer
+    size_t              inputStart_;    // position of the first unread byte in the input buffer
+    size_t              inputEnd_;      // position past the last unread byte in the input buffer
+    std::vector<char>   output_;        // output buffer (used when the socket is corked, or cannot take more data in non-blocking mode)
+    bool                corked_;        // whether writes are delayed until the output buffer is full
+    bool                blocking_;      // whether writes wait until the socket accepts all the data
+#ifdef ZINC_TLS
+    ssl_st            * ssl_;           // TLS session, or null if the connection is not encrypted
+#endif
+    static bool         shutdown_;      // server is shuting down
+
+    int                 waitReadable(std::chrono::milliseconds timeout);
+    int                 waitWritable(std::chrono::milliseconds timeout);
+    int                 receive(char * data, size_t length);
+    long                sendAll(char const * data, size_t length);
+    bool                sendPending();
 };
 
 //--------------------------------------------------------------
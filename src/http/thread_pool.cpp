@@ -52,19 +52,22 @@ ThreadPool::~ThreadPool() {
 
 //--------------------------------------------------------------
 // Add a task to the queue, increasing the number of worker
-// threads if none is available to process this new task.
+// threads if none is available to process this new task. If the
+// limit is reached, the task is refused, unless it is allowed
+// to wait in the queue for a worker to be available.
 //--------------------------------------------------------------
 
-bool ThreadPool::addTask(std::unique_ptr<Task> task, size_t limit) {
+bool ThreadPool::addTask(std::unique_ptr<Task> task, size_t limit, bool queue) {
     std::lock_guard<std::mutex> lock(mutex_);
     if (idle_ == 0) {
         size_t n = workers_.size();
-        if (n >= limit) {
+        if (n < limit) {
+            workers_.emplace_back([this, n] {
+                this->worker(static_cast<int>(n + 1));
+            });
+        } else if (!queue) {
             return false;
         }
-        workers_.emplace_back([this, n] {
-            this->worker(static_cast<int>(n + 1));
-        });
     }
     tasks_.push(std::move(task));
     condition_.notify_one();
@@ -89,7 +92,9 @@ void ThreadPool::stopAll() {
 }
 
 //--------------------------------------------------------------
-// Worker thread.
+// Worker thread. Once a task has run, it is given back its own
+// ownership: by default it is destroyed, but it may hand itself
+// over to someone else to be resumed later.
 //--------------------------------------------------------------
 
 void ThreadPool::worker(int no) {
@@ -111,7 +116,9 @@ void ThreadPool::worker(int no) {
             this->tasks_.pop();
             this->idle_--;
         }
-        task->run(no);
+        Task * t = task.get();
+        t->run(no);
+        t->done(std::move(task));
     }
 }
 
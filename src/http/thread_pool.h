@@ -43,9 +43,10 @@ public:
         virtual ~Task() = default;
 
         virtual void run(int no) = 0;
+        virtual void done(std::unique_ptr<Task> /* self */)    { }
     };
 
-    bool    addTask(std::unique_ptr<Task> obj, size_t limit);
+    bool    addTask(std::unique_ptr<Task> obj, size_t limit, bool queue = false);
     void    stopAll();
 
     size_t  getThreadCount() const          { return workers_.size();               }
@@ -23,6 +23,26 @@
 
 #ifdef ZINC_WEBSOCKET
 
+#ifdef _WIN32
+#include <WinSock2.h>
+#define poll WSAPoll
+typedef ULONG nfds_t;
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#include <cstring>
+#include <array>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 #include "../misc/logger.h"
 #include "../misc/base64.h"
 #include "../misc/sha1.h"
@@ -36,7 +56,8 @@ using namespace std::literals::chrono_literals;
 // WebSocket::Frame
 //
 // Encapsulate a WebSocket frame. See RFC 6455 for more information. Also
-// provide methods to send and receive frames on a stream.
+// provide methods to serialize frames, and to decode them from a buffer
+// as data arrive.
 //========================================================================
 
 //--------------------------------------------------------------
@@ -44,126 +65,134 @@ using namespace std::literals::chrono_literals;
 //--------------------------------------------------------------
 
 WebSocket::Frame::Frame()
-  : opcode_(Close) {
+  : opcode_(Close),
+    masked_(false) {
 }
 
 //--------------------------------------------------------------
-// Receive and decode a frame.
+// Decode a frame from the beginning of a buffer. Return the
+// number of bytes the frame takes, zero if the buffer does not
+// hold a whole frame yet, or a negative value if the payload
+// is bigger than the given limit.
 //--------------------------------------------------------------
 
-bool WebSocket::Frame::receive(InputStream & input, std::chrono::milliseconds timeout) {
-    uint8_t buffer[256];
-    static_assert((sizeof(buffer) % 4) == 0, "Buffer size must be a multiple of 4");
+long WebSocket::Frame::decode(uint8_t const * data, size_t length, size_t limit) {
+    size_t size;
+    long offset = decodeHeader(data, length, limit, size);
+    if (offset <= 0) {
+        return offset;
+    }
+    if (length - static_cast<size_t>(offset) < size) {
+        return 0;
+    }
+    payload_.assign(data + offset, data + offset + size);
+    unmask();
+    return offset + static_cast<long>(size);
+}
 
-    if (!input.read(buffer, 2, timeout, true)) {
-        return false;
+//--------------------------------------------------------------
+// Decode the header of a frame: its type, masking key and
+// payload length, returned in size. The payload itself is left
+// untouched. Return the number of bytes the header takes, zero
+// if the buffer does not hold it yet, or a negative value if
+// the payload is bigger than the given limit.
+//--------------------------------------------------------------
+
+long WebSocket::Frame::decodeHeader(uint8_t const * data, size_t length, size_t limit, size_t & size) {
+    if (length < 2) {
+        return 0;
     }
-    opcode_ = static_cast<Opcode>(buffer[0] & 0x0F);
-    bool masked = (buffer[1] & 0x80) != 0;
-    size_t size = buffer[1] & 0x7F;
+    bool masked = (data[1] & 0x80) != 0;
+    uint64_t announced = data[1] & 0x7F;
+    size_t offset = 2;
 
-    if (size == 126) {
-        if (!input.read(buffer, 2, timeout, true)) {
-            return false;
+    if (announced == 126) {
+        if (length < 4) {
+            return 0;
         }
-        size = (static_cast<size_t>(buffer[0]) << 8)
-             | static_cast<size_t>(buffer[1]);
-    } else if (size == 127) {
-        if (!input.read(buffer, 8, timeout, true)) {
-            return false;
+        announced = (static_cast<uint64_t>(data[2]) << 8)
+                  | static_cast<uint64_t>(data[3]);
+        offset = 4;
+    } else if (announced == 127) {
+        if (length < 10) {
+            return 0;
+        }
+        announced = 0;
+        for (size_t i = 2; i < 10; i++) {
+            announced = (announced << 8) | data[i];
         }
-        size = (static_cast<size_t>(buffer[4]) << 24)
-             | (static_cast<size_t>(buffer[5]) << 16)
-             | (static_cast<size_t>(buffer[6]) << 8)
-             | static_cast<size_t>(buffer[7]);
+        offset = 10;
+    }
+    if (announced > limit) {
+        return -1;
     }
 
-    uint8_t mask[4];
     if (masked) {
-        if (!input.read(mask, 4, timeout, true)) {
-            return false;
+        if (length < offset + 4) {
+            return 0;
         }
-    } else {
-        memset(mask, 0, sizeof(mask));
+        memcpy(mask_, data + offset, 4);
+        offset += 4;
     }
 
-    payload_.clear();
-    while (size) {
-        size_t len = std::min(size, sizeof(buffer));
-        if (!input.read(buffer, len, timeout, true)) {
-            return false;
-        }
-        for (size_t i = 0; i < len; i++) {
-            buffer[i] ^= mask[i & 3];
-        }
-        payload_.insert(payload_.end(), buffer, buffer + len);
-        size -= len;
-    }
+    opcode_ = static_cast<Opcode>(data[0] & 0x0F);
+    masked_ = masked;
+    size = static_cast<size_t>(announced);
+    return static_cast<long>(offset);
+}
 
-    return true;
+//--------------------------------------------------------------
+// Remove the masking of a received payload, once complete.
+//--------------------------------------------------------------
+
+void WebSocket::Frame::unmask() {
+    if (masked_) {
+        ApplyMask(payload_.data(), payload_.size(), mask_);
+        masked_ = false;
+    }
 }
 
 //--------------------------------------------------------------
-// Send a frame.
+// Return the frame as sent by a server (i.e. not masked), so
+// that it can be encoded once and sent to several clients.
 //--------------------------------------------------------------
 
-bool WebSocket::Frame::send(OutputStream & output, iprng & prng, bool masked) const {
-    uint8_t buffer[256];
-    static_assert((sizeof(buffer) % 4) == 0, "Buffer size must be a multiple of 4");
+std::vector<uint8_t> WebSocket::Frame::serialize() const {
+    uint8_t header[10];
+    size_t offset = encodeHeader(header);
+
+    std::vector<uint8_t> result;
+    result.reserve(offset + payload_.size());
+    result.insert(result.end(), header, header + offset);
+    result.insert(result.end(), payload_.cbegin(), payload_.cend());
+    return result;
+}
+
+//--------------------------------------------------------------
+// Encode the header of the frame, without masking key. Return
+// the number of bytes written (up to 10).
+//--------------------------------------------------------------
 
+size_t WebSocket::Frame::encodeHeader(uint8_t * header) const {
     size_t size = payload_.size();
     size_t offset = 1;
 
-    buffer[0] = static_cast<uint8_t>(0x80 + opcode_);
-    buffer[1] = masked ? 0x80 : 0x00;
+    header[0] = static_cast<uint8_t>(0x80 + opcode_);
+    header[1] = 0x00;
 
     if (size <= 125) {
-        buffer[offset++] |= size;
+        header[offset++] |= size;
     } else if (size <= 65535) {
-        buffer[offset++] |= 126;
-        buffer[offset++] = static_cast<uint8_t>(size >> 8);
-        buffer[offset++] = static_cast<uint8_t>(size);
+        header[offset++] |= 126;
+        header[offset++] = static_cast<uint8_t>(size >> 8);
+        header[offset++] = static_cast<uint8_t>(size);
     } else {
-        buffer[offset++] |= 127;
-        buffer[offset++] = 0;   // ignore higher bits, frames bigger than 2^31 bytes are unlikely to happen
-        buffer[offset++] = 0;
-        buffer[offset++] = 0;
-        buffer[offset++] = 0;
-        buffer[offset++] = static_cast<uint8_t>(size >> 24);
-        buffer[offset++] = static_cast<uint8_t>(size >> 16);
-        buffer[offset++] = static_cast<uint8_t>(size >> 8);
-        buffer[offset++] = static_cast<uint8_t>(size);
-    }
-
-    uint8_t mask[4];
-    if (masked) {
-        uint32_t v = prng.next();
-        for (size_t i = 0; i < 4; i++) {
-            mask[i] = static_cast<uint8_t>(v);
-            buffer[offset++] = mask[i];
-            v >>= 8;
+        header[offset++] |= 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            header[offset++] = static_cast<uint8_t>(static_cast<uint64_t>(size) >> shift);
         }
-    } else {
-        memset(mask, 0, sizeof(mask));
-    }
-
-    if (!output.write(buffer, offset)) {
-        return false;
     }
-
-    uint8_t const * source = payload_.data();
-    while (size) {
-        size_t len = std::min(size, sizeof(buffer));
-        for (size_t i = 0; i < len; i++) {
-            buffer[i] = source[i] ^ mask[i & 3];
-        }
-        if (!output.write(buffer, len)) {
-            return false;
-        }
-        source += len;
-        size -= len;
-    }
-    return true;
+    return offset;
 }
 
 //--------------------------------------------------------------
@@ -215,7 +244,15 @@ int WebSocket::Frame::getCloseMessage() const {
 //========================================================================
 // WebSocket::Connection
 //
-// Implement the server side of a WebSocket connection.
+// Implement the server side of a WebSocket connection. The connection
+// does not own a thread: the event loop of the list reads and decodes
+// incoming frames as data arrive, and the messages are passed to the
+// configuration by the workers of the list, one at a time and in order
+// for a given connection.
+//
+// Outgoing frames go through a bounded queue. They are sent right away
+// as far as the socket accepts them, and the event loop sends the rest
+// when the client reads, so that a slow client never blocks the sender.
 //========================================================================
 
 //--------------------------------------------------------------
@@ -226,7 +263,14 @@ WebSocket::Connection::Connection(ConnectionList & parent, IHttpConfig & config,
   : parent_(parent),
     config_(config),
     socket_(std::move(socket)),
-    listener_([this] () { listen(); }) {
+    outputOffset_(0),
+    outputSize_(0),
+    watching_(false),
+    registered_(false),
+    broken_(false),
+    partialLength_(0),
+    dispatching_(false),
+    connected_(true) {
 
     LOG_TRACE("Init WebSocket::Connection");
 }
@@ -237,7 +281,6 @@ WebSocket::Connection::Connection(ConnectionList & parent, IHttpConfig & config,
 
 WebSocket::Connection::~Connection() {
     socket_.close();
-    listener_.join();
     LOG_TRACE("Destroy WebSocket::Connection");
 }
 
@@ -255,71 +298,534 @@ void WebSocket::Connection::handshake(HttpRequest const & request) {
 }
 
 //--------------------------------------------------------------
-// Send a message.
+// Send a message. May be called from any thread.
 //--------------------------------------------------------------
 
 void WebSocket::Connection::sendMessage(WebSocket::Frame const & message) {
-    message.send(socket_, prng::instance(), false);
+    sendBuffer(std::make_shared<std::vector<uint8_t> const>(message.serialize()));
+}
+
+//--------------------------------------------------------------
+// Send a serialized frame. If the queue is full, the frame is
+// dropped or the client is disconnected, depending on the
+// configuration. May be called from any thread.
+//--------------------------------------------------------------
+
+void WebSocket::Connection::sendBuffer(Buffer buffer) {
+    std::lock_guard<std::mutex> lock(socketMutex_);
+    if (!connected_ || broken_) {
+        return;
+    }
+    if (!output_.empty() && outputSize_ + buffer->size() > static_cast<size_t>(config_.getWebSocketQueue())) {
+        if (config_.isSlowClientDropped()) {
+            LOG_TRACE("WebSocket queue full on socket " << socket_ << ", dropping message");
+        } else {
+            LOG_INFO("WebSocket client too slow on socket " << socket_ << ", disconnecting");
+            abort();
+        }
+        return;
+    }
+    outputSize_ += buffer->size();
+    output_.push_back(std::move(buffer));
+    if (!drain()) {
+        abort();
+    }
+}
+
+//--------------------------------------------------------------
+// Called by the event loop when the socket is readable. Read
+// what is available, and queue the frames that are complete.
+// Return false when the connection must be closed.
+//--------------------------------------------------------------
+
+bool WebSocket::Connection::receive() {
+
+    // While the payload of a large frame is expected, read it
+    // straight into the frame. Its storage is reserved for the
+    // announced length, bounded by the body limit, so it is never
+    // copied again, and it is unmasked in place once complete.
+
+    if (partialLength_) {
+        std::vector<uint8_t> & payload = partial_.payload_;
+        size_t received = payload.size();
+        payload.resize(std::min(partialLength_, received + SOCKET_BUFFERSIZE));
+        long r = readSocket(payload.data() + received, payload.size() - received);
+        payload.resize(received + static_cast<size_t>(std::max(r, 0L)));
+        if (r <= 0) {
+            return r < 0;
+        }
+        if (payload.size() == partialLength_) {
+            partial_.unmask();
+            post(std::move(partial_));
+            partial_ = Frame();
+            partialLength_ = 0;
+        }
+        return true;
+    }
+
+    uint8_t buffer[SOCKET_BUFFERSIZE];
+    long r = readSocket(buffer, sizeof(buffer));
+    if (r <= 0) {
+        return r < 0;
+    }
+
+    // Decode straight from the buffer when nothing is left from
+    // the previous read, and keep the incomplete frame if any.
+
+    uint8_t const * data = buffer;
+    size_t length = static_cast<size_t>(r);
+    if (!input_.empty()) {
+        input_.insert(input_.end(), buffer, buffer + length);
+        data = input_.data();
+        length = input_.size();
+    }
+
+    size_t offset = 0;
+    for ( ; ; ) {
+        Frame frame;
+        long n = frame.decode(data + offset, length - offset, static_cast<size_t>(config_.getLimitRequestBody()));
+        if (n < 0) {
+            LOG_INFO("WebSocket frame too large on socket " << socket_);
+            return false;
+        } else if (n == 0) {
+
+            // The frame is not complete. If it is large, keep what
+            // was received of its payload, and read the rest
+            // straight into it (see above).
+
+            size_t size;
+            long header = frame.decodeHeader(data + offset, length - offset, static_cast<size_t>(config_.getLimitRequestBody()), size);
+            if (header > 0 && size > SOCKET_BUFFERSIZE) {
+                uint8_t const * start = data + offset + header;
+                partial_ = std::move(frame);
+                partial_.payload_.reserve(size);
+                partial_.payload_.assign(start, data + length);
+                partialLength_ = size;
+                offset = length;
+            }
+            break;
+        }
+        offset += static_cast<size_t>(n);
+        post(std::move(frame));
+    }
+
+    if (data == buffer) {
+        input_.assign(buffer + offset, buffer + length);
+    } else {
+        input_.erase(input_.begin(), input_.begin() + static_cast<long>(offset));
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Read what is available on the socket, without waiting. Return
+// the number of bytes read, zero if the connection is closed, or
+// a negative value if the TLS layer has nothing to deliver yet.
+//--------------------------------------------------------------
+
+long WebSocket::Connection::readSocket(void * data, size_t length) {
+#ifdef ZINC_TLS
+    if (socket_.isSecure()) {
+        std::lock_guard<std::mutex> lock(socketMutex_);    // a TLS session cannot read and write concurrently
+        return socket_.readAvailable(data, length);
+    }
+#endif
+    return socket_.readAvailable(data, length);
+}
+
+//--------------------------------------------------------------
+// Called by the event loop when the socket accepts more data.
+// Return false when the connection must be closed.
+//--------------------------------------------------------------
+
+bool WebSocket::Connection::transmit() {
+    std::lock_guard<std::mutex> lock(socketMutex_);
+    return !broken_ && drain();
+}
+
+//--------------------------------------------------------------
+// Send the queued frames, as far as the socket accepts them
+// without waiting, and have the event loop watch the socket if
+// some are left. Return false if the connection is broken, or if
+// the event loop cannot watch it (the frames left would never be
+// sent). The caller holds the socket mutex.
+//--------------------------------------------------------------
+
+bool WebSocket::Connection::drain() {
+    while (!output_.empty()) {
+        Buffer const & front = output_.front();
+        long r = socket_.writeAvailable(front->data() + outputOffset_, front->size() - outputOffset_);
+        if (r < 0) {
+            return false;
+        } else if (r == 0) {
+            break;
+        }
+        outputOffset_ += static_cast<size_t>(r);
+        outputSize_ -= static_cast<size_t>(r);
+        if (outputOffset_ == front->size()) {
+            output_.pop_front();
+            outputOffset_ = 0;
+        }
+    }
+
+    bool waiting = !output_.empty();
+    if (waiting != watching_) {
+        watching_ = waiting;
+        if (registered_ && !parent_.watch(*this, true)) {       // otherwise, registering picks up watching_
+            LOG_ERROR("Error watching WebSocket connection on socket " << socket_);
+            return false;
+        }
+    }
+    return true;
 }
 
 //--------------------------------------------------------------
-// Listener thread.
+// Give up sending: discard the queue and shut the connection
+// down, so that the event loop sees it closed and releases it.
+// The caller holds the socket mutex.
 //--------------------------------------------------------------
 
-void WebSocket::Connection::listen() {
+void WebSocket::Connection::abort() {
+    broken_ = true;
+    output_.clear();
+    outputOffset_ = 0;
+    outputSize_ = 0;
+    socket_.disconnect();
+}
+
+//--------------------------------------------------------------
+// Queue a message. If no worker is dispatching the messages of
+// this connection, hand the queue over to one.
+//--------------------------------------------------------------
+
+void WebSocket::Connection::post(Frame frame) {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    queue_.push_back(std::move(frame));
+    if (!dispatching_) {
+        dispatching_ = true;
+        parent_.pool_.addTask(std::make_unique<Dispatcher>(shared_from_this()), static_cast<size_t>(config_.getLimitThreads()), true);
+    }
+}
+
+//--------------------------------------------------------------
+// Worker side: pass the queued messages to the configuration,
+// in order, until the queue is empty.
+//--------------------------------------------------------------
+
+void WebSocket::Connection::dispatch() {
     for ( ; ; ) {
-        int r = socket_.select(60s);
-        if (r > 0) {
-            WebSocket::Frame frame;
-            if (!frame.receive(socket_, 10s)) {
-                socket_.close();
+        Frame frame;
+        if (true) {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (queue_.empty()) {
+                dispatching_ = false;
                 return;
             }
-            config_.handleMessage(*this, frame);
+            frame = std::move(queue_.front());
+            queue_.pop_front();
         }
+        config_.handleMessage(*this, frame);
     }
 }
 
+//--------------------------------------------------------------
+// Close the socket. Only the event loop closes connections,
+// once the socket is no longer watched.
+//--------------------------------------------------------------
+
+void WebSocket::Connection::close() {
+    LOG_INFO("Closing WebSocket connection on socket " << socket_);
+    std::lock_guard<std::mutex> lock(socketMutex_);
+    connected_ = false;
+    output_.clear();
+    socket_.close();
+}
+
 //========================================================================
 // WebSocket::ConnectionList
 //
-// Implement a thread safe list of connections.
+// Implement a thread safe list of connections. A single thread waits
+// for incoming data on all the connections (with epoll on Linux, so
+// that the cost does not grow with the number of idle connections,
+// and with poll elsewhere), and a bounded pool of workers passes the
+// messages to the configuration. The same thread sends the frames
+// left in the queues when the clients are ready.
 //========================================================================
 
 //--------------------------------------------------------------
-// Create a new connection and add it to the list.
+// Constructor. Start the event loop thread.
+//--------------------------------------------------------------
+
+WebSocket::ConnectionList::ConnectionList()
+#ifdef __linux__
+  : epoll_(epoll_create1(EPOLL_CLOEXEC)),
+    wakeup_ { -1, -1 },
+    stop_(false) {
+    if (epoll_ < 0) {
+        LOG_ERROR("Error creating WebSocket epoll instance");
+    }
+    if (pipe(wakeup_) == 0) {
+        for (int fd: wakeup_) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_[0], &event);
+    } else {
+        LOG_ERROR("Error creating WebSocket wakeup pipe");
+    }
+#else
+  : stop_(false) {
+#endif
+    thread_ = std::thread([this] {
+        this->run();
+    });
+}
+
+//--------------------------------------------------------------
+// Destructor. Stop the event loop and the workers, and close
+// the connections.
 //--------------------------------------------------------------
 
-WebSocket::Connection & WebSocket::ConnectionList::add(IHttpConfig & config, StreamSocket socket) {
+WebSocket::ConnectionList::~ConnectionList() {
+    if (true) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+#ifdef __linux__
+    char c = 0;
+    while (write(wakeup_[1], &c, 1) < 0 && errno == EINTR) {
+    }
+#endif
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    pool_.stopAll();
+    list_.clear();
+#ifdef __linux__
+    for (int fd: wakeup_) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    if (epoll_ >= 0) {
+        ::close(epoll_);
+    }
+#endif
+}
+
+//--------------------------------------------------------------
+// Create a new connection, reply to the upgrade request, and
+// start watching the connection.
+//--------------------------------------------------------------
+
+void WebSocket::ConnectionList::add(IHttpConfig & config, StreamSocket socket, HttpRequest const & request) {
+    auto connection = std::make_shared<Connection>(*this, config, std::move(socket));
+    connection->handshake(request);
+
+    // The client may have sent frames right after the upgrade
+    // request, and they are already buffered by the socket.
+
+    while (connection->socket_.hasPendingInput()) {
+        if (!connection->receive()) {
+            connection->close();
+            return;
+        }
+    }
+    connection->socket_.releaseBuffers();
+
     std::lock_guard<std::mutex> lock(mutex_);
-    list_.emplace_back(*this, config, std::move(socket));
-    return list_.back();
+    list_.push_back(connection);
+    bool watched;
+    if (true) {
+        std::lock_guard<std::mutex> lock2(connection->socketMutex_);    // replies to the frames above may be queued already
+        watched = watch(*connection, false);
+        connection->registered_ = watched;
+    }
+    if (!watched) {
+        LOG_ERROR("Error watching WebSocket connection on socket " << connection->socket_);
+        connection->close();
+    }
 }
 
 //--------------------------------------------------------------
-// Remove a connection from the list.
+// Remove the closed connections from the list.
 //--------------------------------------------------------------
 
 void WebSocket::ConnectionList::purge() {
     std::lock_guard<std::mutex> lock(mutex_);
-    list_.remove_if([] (Connection const & item) { return !item.isConnected(); });
+    list_.remove_if([] (std::shared_ptr<Connection> const & item) { return !item->isConnected(); });
 }
 
 //--------------------------------------------------------------
-// Broadcast a message to all connections in the list.
+// Broadcast a message to all connections in the list. The frame
+// is serialized once and shared by the queues, and the list is
+// not locked while sending.
 //--------------------------------------------------------------
 
 void WebSocket::ConnectionList::broadcast(Frame const & frame) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (Connection & c: list_) {
-        c.sendMessage(frame);
+    auto buffer = std::make_shared<std::vector<uint8_t> const>(frame.serialize());
+    std::vector<std::shared_ptr<Connection>> targets;
+    if (true) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        targets.assign(list_.cbegin(), list_.cend());
+    }
+    for (auto & c: targets) {
+        c->sendBuffer(buffer);
     }
 }
 
+//--------------------------------------------------------------
+// Register a connection with the event loop (or update what it
+// waits for), depending on whether frames are waiting to be
+// sent. The caller holds the socket mutex of the connection.
+//--------------------------------------------------------------
+
+bool WebSocket::ConnectionList::watch(Connection & connection, bool update) {
+#ifdef __linux__
+    struct epoll_event event = {};
+    event.events = EPOLLIN | (connection.watching_ ? EPOLLOUT : 0);
+    event.data.ptr = &connection;
+    return epoll_ctl(epoll_, update ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, connection.socket_.getHandle(), &event) == 0;
+#else
+    (void) connection;
+    (void) update;
+    return true;       // the socket is polled with the right events at each iteration
+#endif
+}
+
+//--------------------------------------------------------------
+// Stop watching a connection and close it.
+//--------------------------------------------------------------
+
+void WebSocket::ConnectionList::release(Connection & connection) {
+#ifdef __linux__
+    epoll_ctl(epoll_, EPOLL_CTL_DEL, connection.socket_.getHandle(), nullptr);
+#endif
+    connection.close();
+}
+
+//--------------------------------------------------------------
+// Event loop thread. On Linux, the connections are registered
+// once with epoll, and the thread only hears about those that
+// have data. Elsewhere, the list is polled, and new connections
+// are picked up within a fraction of a second.
+//--------------------------------------------------------------
+
+void WebSocket::ConnectionList::run() {
+#ifdef __linux__
+    std::array<struct epoll_event, 256> events;
+    for ( ; ; ) {
+        int n = epoll_wait(epoll_, events.data(), static_cast<int>(events.size()), -1);
+        if (n < 0) {
+            if (errno != EINTR) {
+                LOG_ERROR("internal error: epoll_wait() failed");
+                return;
+            }
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            auto connection = static_cast<Connection *>(events[static_cast<size_t>(i)].data.ptr);
+            if (connection == nullptr) {
+                char buffer[256];
+                while (read(wakeup_[0], buffer, sizeof(buffer)) > 0) {
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stop_) {
+                    return;
+                }
+            } else {
+                uint32_t ready = events[static_cast<size_t>(i)].events;
+                bool open = true;
+                if (ready & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    open = connection->receive();
+                }
+                if (open && (ready & EPOLLOUT)) {
+                    open = connection->transmit();
+                }
+                if (!open) {
+                    release(*connection);
+                }
+            }
+        }
+    }
+#else
+    std::vector<std::shared_ptr<Connection>> watched;
+    std::vector<struct pollfd> fds;
+    for ( ; ; ) {
+        watched.clear();
+        fds.clear();
+        if (true) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) {
+                return;
+            }
+            for (auto & c: list_) {
+                if (c->isConnected()) {
+                    std::lock_guard<std::mutex> lock2(c->socketMutex_);
+                    watched.push_back(c);
+                    fds.push_back({ c->socket_.getHandle(), static_cast<short>(c->watching_ ? POLLIN | POLLOUT : POLLIN), 0 });
+                }
+            }
+        }
+        if (fds.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            continue;
+        }
+        int r = poll(fds.data(), static_cast<nfds_t>(fds.size()), 250);
+        for (size_t i = 0; r > 0 && i < fds.size(); i++) {
+            bool open = true;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                open = watched[i]->receive();
+            }
+            if (open && (fds[i].revents & POLLOUT)) {
+                open = watched[i]->transmit();
+            }
+            if (!open) {
+                release(*watched[i]);
+            }
+        }
+    }
+#endif
+}
+
 //========================================================================
 // WebSocket helper functions.
 //========================================================================
 
+//--------------------------------------------------------------
+// Apply (or remove, this is the same) a masking key to a payload,
+// in place. The bulk of the data is processed 16 bytes at a time
+// with SSE2 if available, otherwise 8 bytes at a time, with the
+// key repeated to the size of a register.
+//--------------------------------------------------------------
+
+void WebSocket::ApplyMask(uint8_t * data, size_t length, uint8_t const * mask) {
+    uint32_t key32;
+    memcpy(&key32, mask, sizeof(key32));
+    uint64_t key64 = (static_cast<uint64_t>(key32) << 32) | key32;
+    size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128i key128 = _mm_set1_epi32(static_cast<int>(key32));
+    for ( ; i + 16 <= length; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_xor_si128(x, key128));
+    }
+#endif
+    for ( ; i + 8 <= length; i += 8) {
+        uint64_t x;
+        memcpy(&x, data + i, sizeof(x));
+        x ^= key64;
+        memcpy(data + i, &x, sizeof(x));
+    }
+    for ( ; i < length; i++) {
+        data[i] ^= mask[i & 3];
+    }
+}
+
 //--------------------------------------------------------------
 // Generate a random nonce suitable for WebSocket handshake.
 //--------------------------------------------------------------
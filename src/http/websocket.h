@@ -28,11 +28,16 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
 #include <list>
 
 #include "../misc/prng.h"
 #include "ihttpconfig.h"
+#include "thread_pool.h"
 #include "stream_socket.h"
 #include "http_request.h"
 
@@ -57,8 +62,10 @@ public:
 
     Frame();
 
-    bool receive(InputStream & input, std::chrono::milliseconds timeout);
-    bool send(OutputStream & output, iprng & prng, bool masked) const;
+    long decode(uint8_t const * data, size_t length, size_t limit);
+    long decodeHeader(uint8_t const * data, size_t length, size_t limit, size_t & size);
+    void unmask();
+    std::vector<uint8_t> serialize() const;
 
     void setTextMessage(char const * message);
     void setBinaryMessage(void const * message, size_t length);
@@ -72,29 +79,69 @@ public:
 private:
     std::vector<uint8_t>    payload_;
     Opcode                  opcode_;
+    uint8_t                 mask_[4];       // masking key of a received frame
+    bool                    masked_;        // whether the received payload is masked
+
+    size_t  encodeHeader(uint8_t * header) const;
+
+    friend class Connection;
 };
 
 //--------------------------------------------------------------
 // WebSocket connection.
 //--------------------------------------------------------------
 
-class Connection {
+class Connection : public std::enable_shared_from_this<Connection> {
 public:
     Connection(ConnectionList & parent, IHttpConfig & config, StreamSocket socket);
     ~Connection();
 
+    typedef std::shared_ptr<std::vector<uint8_t> const> Buffer;     // serialized frame, possibly shared by several connections
+
     void    handshake(HttpRequest const & request);
     void    sendMessage(Frame const & message);
+    void    sendBuffer(Buffer buffer);
 
-    bool    isConnected() const { return socket_;   }
+    bool    isConnected() const { return connected_;    }
 
 private:
-    ConnectionList &    parent_;
-    IHttpConfig &       config_;
-    StreamSocket        socket_;
-    std::thread         listener_;
+    ConnectionList &        parent_;        // list the connection belongs to
+    IHttpConfig &           config_;        // server configuration
+    StreamSocket            socket_;        // connection with the client
+    std::mutex              socketMutex_;   // thread synchronization for the socket and the output queue
+    std::deque<Buffer>      output_;        // frames waiting to be sent
+    size_t                  outputOffset_;  // number of bytes of the first frame already sent
+    size_t                  outputSize_;    // number of bytes waiting to be sent
+    bool                    watching_;      // whether the event loop waits for the socket to accept more data
+    bool                    registered_;    // whether the socket is registered with the event loop
+    bool                    broken_;        // whether sending failed, or the client was too slow
+    std::vector<uint8_t>    input_;         // data received but not decoded yet (only accessed by the event loop)
+    Frame                   partial_;       // large frame whose payload is read straight from the socket (same)
+    size_t                  partialLength_; // announced payload length of the partial frame, zero if none
+    std::deque<Frame>       queue_;         // messages waiting to be dispatched
+    std::mutex              queueMutex_;    // thread synchronization for the queue
+    bool                    dispatching_;   // whether a worker is dispatching the queued messages
+    std::atomic<bool>       connected_;     // whether the connection is still open
+
+    class Dispatcher : public ThreadPool::Task {    // task passing the queued messages to the configuration
+    public:
+        Dispatcher(std::shared_ptr<Connection> connection) : connection_(std::move(connection))    { }
+        void run(int /* no */) override                                                             { connection_->dispatch(); }
+
+    private:
+        std::shared_ptr<Connection> connection_;
+    };
 
-    void    listen();
+    bool    receive();
+    long    readSocket(void * data, size_t length);
+    bool    transmit();
+    void    post(Frame frame);
+    void    dispatch();
+    void    close();
+    bool    drain();
+    void    abort();
+
+    friend class ConnectionList;
 };
 
 //--------------------------------------------------------------
@@ -103,21 +150,36 @@ private:
 
 class ConnectionList {
 public:
-    ConnectionList() = default;
+    ConnectionList();
+    ~ConnectionList();
 
-    Connection &    add(IHttpConfig & config, StreamSocket socket);
-    void            broadcast(Frame const & frame);
-    void            purge();
+    void    add(IHttpConfig & config, StreamSocket socket, HttpRequest const & request);
+    void    broadcast(Frame const & frame);
+    void    purge();
 
 private:
-    std::list<Connection>   list_;
-    std::mutex              mutex_;
+    std::list<std::shared_ptr<Connection>>  list_;      // open connections
+    std::mutex                              mutex_;     // thread synchronization
+    ThreadPool                              pool_;      // workers dispatching the messages
+    std::thread                             thread_;    // event loop thread
+#ifdef __linux__
+    int                                     epoll_;     // epoll instance the connections are registered with
+    int                                     wakeup_[2]; // pipe used to interrupt epoll_wait() when stopping
+#endif
+    bool                                    stop_;      // shutdown request
+
+    void    run();
+    bool    watch(Connection & connection, bool update);
+    void    release(Connection & connection);
+
+    friend class Connection;
 };
 
 //--------------------------------------------------------------
 // WebSocket helper functions.
 //--------------------------------------------------------------
 
+void        ApplyMask(uint8_t * data, size_t length, uint8_t const * mask);
 std::string MakeNonce(iprng & prng);
 std::string TransformNonce(std::string const & nonce);
 
@@ -131,7 +131,8 @@ bool Variant::parse(std::string const & str) {
 Configuration::Configuration()
     : general_("Server"),
       cgis_(),
-      extensions_() {
+      extensions_(),
+      proxies_() {
 
     // Initialize the server parameter block with default
     // values.
@@ -141,13 +142,26 @@ Configuration::Configuration()
 
     general_.setContent({
         { optListen,                8080,                   [] (Variant & x) { return x.getIntegerValue() >= 1024 && x.getIntegerValue() <= 65535; }    },
+        { optCertificate,           "",                     [] (Variant & x) { return x.getStringValue().empty() || fs::filepath(x.getStringValue()).getFileType() == fs::file; } },
+        { optPrivateKey,            "",                     [] (Variant & x) { return x.getStringValue().empty() || fs::filepath(x.getStringValue()).getFileType() == fs::file; } },
         { optLimitThreads,          32,                     [] (Variant & x) { return x.getIntegerValue() > 0 && x.getIntegerValue() < 128; }           },
+        { optReactorThreads,        1,                      [] (Variant & x) { return x.getIntegerValue() >= 0 && x.getIntegerValue() <= 16; }          },
         { optLimitRequestLine,      2048,                   [] (Variant & x) { return x.getIntegerValue() >= 256 && x.getIntegerValue() <= 655535; }    },
         { optLimitRequestHeaders,   8192,                   [] (Variant & x) { return x.getIntegerValue() >= 256 && x.getIntegerValue() <= 655535; }    },
         { optLimitRequestBody,      32 * 1024 * 1024,       [] (Variant & x) { return x.getIntegerValue() > 0; }                                        },
+        { optBodyBufferSize,        64 * 1024,              [] (Variant & x) { return x.getIntegerValue() >= 0; }                                       },
+        { optTempDirectory,         "",                     [] (Variant & x) { return x.getStringValue().empty() || fs::filepath(x.getStringValue()).getFileType() == fs::directory; } },
         { optCompression,           true,                   nullptr                                                                                     },
         { optDirectoryIndex,        indexes,                nullptr                                                                                     },
         { optDirectoryListing,      true,                   nullptr                                                                                     },
+        { optProxyPass,             "",                     [] (Variant & x) { return parseProxyPass(x.getStringValue(), nullptr); }                    },
+        { optEventStream,           "",                     [] (Variant & x) { return x.getStringValue().empty() || x.getStringValue()[0] == '/'; }     },
+        { optEventBacklog,          256,                    [] (Variant & x) { return x.getIntegerValue() > 0 && x.getIntegerValue() <= 65536; }        },
+        { optEventHeartbeat,        15,                     [] (Variant & x) { return x.getIntegerValue() > 0 && x.getIntegerValue() <= 600; }          },
+        { optWebSocketQueue,        1024 * 1024,            [] (Variant & x) { return x.getIntegerValue() >= 1024; }                                    },
+        { optWebSocketSlowClient,   "close",                [] (Variant & x) { return x.getStringValue() == "close" || x.getStringValue() == "drop"; }  },
+        { optHostnameLookups,       "yes",                  [] (Variant & x) { return x.getStringValue() == "yes" || x.getStringValue() == "no" || x.getStringValue() == "async"; } },
+        { optCacheSize,             16 * 1024 * 1024,       [] (Variant & x) { return x.getIntegerValue() >= 0; }                                       },
         { optTimeout,               30,                     [] (Variant & x) { return x.getIntegerValue() > 0 && x.getIntegerValue() < 600; }           },
         { optExpires,               3600,                   [] (Variant & x) { return x.getIntegerValue() >= 0; }                                       },
         { optServerAdmin,           "admin@" + host,        nullptr                                                                                     },
@@ -191,6 +205,116 @@ void Configuration::buildExtensionMap() {
     }
 }
 
+//--------------------------------------------------------------
+// Build the list of path prefixes forwarded to upstream servers.
+// Prefixes are sorted by decreasing length, so that the first
+// match is the most specific one.
+//--------------------------------------------------------------
+
+void Configuration::buildProxyList() {
+    proxies_.clear();
+    parseProxyPass(general_.at(optProxyPass).getStringValue(), &proxies_);
+    std::stable_sort(proxies_.begin(), proxies_.end(), [] (Proxy const & a, Proxy const & b) { return a.prefix.size() > b.prefix.size(); });
+}
+
+//--------------------------------------------------------------
+// Parse the ProxyPass parameter, a space separated list of
+// prefix=http://host[:port][/path] mappings. Return false if
+// the syntax is invalid. If a list is given, the mappings are
+// appended to it, with their upstream address resolved.
+//--------------------------------------------------------------
+
+bool Configuration::parseProxyPass(std::string const & value, std::vector<Proxy> * result) {
+    bool ok = true;
+    string::split(value, ' ', 0, string::trim_both, [&] (std::string & mapping) {
+        if (mapping.empty()) {
+            return true;
+        }
+
+        size_t sep = mapping.find('=');
+        if (sep == std::string::npos || sep == 0 || mapping[0] != '/' || mapping.compare(sep + 1, 7, "http://") != 0) {
+            ok = false;
+            return false;
+        }
+
+        Proxy proxy;
+        proxy.prefix = mapping.substr(0, sep);
+        if (proxy.prefix.size() > 1 && proxy.prefix.back() == '/') {
+            proxy.prefix.pop_back();
+        }
+
+        std::string url = mapping.substr(sep + 8);
+        size_t slash = url.find('/');
+        proxy.host = url.substr(0, slash);
+        proxy.path = slash != std::string::npos ? url.substr(slash) : "";
+        if (!proxy.path.empty() && proxy.path.back() == '/') {
+            proxy.path.pop_back();
+        }
+
+        if (!parseAddress(proxy.host.find(':') != std::string::npos ? proxy.host : proxy.host + ":80", result ? &proxy.address : nullptr)) {
+            ok = false;
+            return false;
+        }
+
+        if (result) {
+            result->push_back(std::move(proxy));
+        }
+        return true;
+    });
+    return ok;
+}
+
+//--------------------------------------------------------------
+// Parse a host:port address. Return false if the syntax is
+// invalid. If a result is given, the host name is resolved.
+//--------------------------------------------------------------
+
+bool Configuration::parseAddress(std::string const & value, AddrIPv4 * result) {
+    size_t colon = value.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        return false;
+    }
+    long port = string::to_long(value.substr(colon + 1), 10);
+    if (port <= 0 || port > 65535) {
+        return false;
+    }
+    if (result) {
+        *result = AddrIPv4(value.substr(0, colon), static_cast<int>(port));
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Check that a value is a list (space separated) of existing
+// directories.
+//--------------------------------------------------------------
+
+bool Configuration::isDirectoryList(std::string const & value) {
+    bool ok = true;
+    string::split(value, ' ', 0, string::trim_none, [&ok] (std::string & name) {
+        ok = fs::filepath(name).getFileType() == fs::directory;
+        return ok;
+    });
+    return ok;
+}
+
+//--------------------------------------------------------------
+// Return the proxy mapping for a request path, or NULL if the
+// path is not forwarded to an upstream server. A prefix matches
+// whole path segments only: /api matches /api and /api/users,
+// but not /apix.
+//--------------------------------------------------------------
+
+Configuration::Proxy const * Configuration::getProxy(std::string const & path) const {
+    for (Proxy const & proxy: proxies_) {
+        size_t len = proxy.prefix.size();
+        if (path.compare(0, len, proxy.prefix) == 0 && (path.size() == len || path[len] == '/' || proxy.prefix.back() == '/')) {
+            return &proxy;
+        }
+    }
+    return nullptr;
+}
+
 //--------------------------------------------------------------
 // Dump all the configuration parameters to stdout, one line
 // for each key/value pair, according to the following format:
@@ -328,6 +452,7 @@ bool Configuration::load(std::istream & fs, fs::filepath const & filename) {
     }
 
     buildExtensionMap();
+    buildProxyList();
     return ok;
 }
 
@@ -371,13 +496,26 @@ std::vector<std::string> Configuration::getDirectoryIndexes() const {
 //--------------------------------------------------------------
 
 char const * Configuration::optListen               = "Listen";
+char const * Configuration::optCertificate          = "Certificate";
+char const * Configuration::optPrivateKey           = "PrivateKey";
 char const * Configuration::optLimitThreads         = "LimitThreads";
+char const * Configuration::optReactorThreads       = "ReactorThreads";
 char const * Configuration::optLimitRequestLine     = "LimitRequestLine";
 char const * Configuration::optLimitRequestHeaders  = "LimitRequestHeaders";
 char const * Configuration::optLimitRequestBody     = "LimitRequestBody";
+char const * Configuration::optBodyBufferSize       = "BodyBufferSize";
+char const * Configuration::optTempDirectory        = "TempDirectory";
 char const * Configuration::optCompression          = "Compression";
 char const * Configuration::optDirectoryIndex       = "DirectoryIndex";
 char const * Configuration::optDirectoryListing     = "DirectoryListing";
+char const * Configuration::optProxyPass            = "ProxyPass";
+char const * Configuration::optEventStream          = "EventStream";
+char const * Configuration::optEventBacklog         = "EventBacklog";
+char const * Configuration::optEventHeartbeat       = "EventHeartbeat";
+char const * Configuration::optWebSocketQueue       = "WebSocketQueue";
+char const * Configuration::optWebSocketSlowClient  = "WebSocketSlowClient";
+char const * Configuration::optHostnameLookups      = "HostnameLookups";
+char const * Configuration::optCacheSize            = "CacheSize";
 char const * Configuration::optTimeout              = "Timeout";
 char const * Configuration::optExpires              = "Expires";
 char const * Configuration::optServerAdmin          = "ServerAdmin";
@@ -385,6 +523,19 @@ char const * Configuration::optServerName           = "ServerName";
 char const * Configuration::optExtensions           = "Extensions";
 char const * Configuration::optInterpreter          = "Interpreter";
 char const * Configuration::optCmdLine              = "CmdLine";
+char const * Configuration::optStreamBody           = "StreamBody";
+char const * Configuration::optFastCGI              = "FastCGI";
+char const * Configuration::optFastCGIWorkers       = "FastCGIWorkers";
+char const * Configuration::optZygote               = "Zygote";
+char const * Configuration::optMaxProcesses         = "MaxProcesses";
+char const * Configuration::optTimeLimit            = "TimeLimit";
+char const * Configuration::optCPULimit             = "CPULimit";
+char const * Configuration::optMemoryLimit          = "MemoryLimit";
+char const * Configuration::optCache                = "Cache";
+char const * Configuration::optCacheVary            = "CacheVary";
+char const * Configuration::optXSendFilePath        = "XSendFilePath";
+char const * Configuration::optETagLimit            = "ETagLimit";
+char const * Configuration::optFlushDelay           = "FlushDelay";
 
 //========================================================================
 // Configuration::ParameterBlock
@@ -465,7 +616,8 @@ void Configuration::ParameterBlock::print(std::ostream & out, bool file) {
 //--------------------------------------------------------------
 
 Configuration::CGI::CGI(char const * section, char const * extensions, char const * interpreter, char const * cmdline)
-    : ParameterBlock(section) {
+    : ParameterBlock(section),
+      processes_(0) {
 
     // Try to locate the interpreter, if the filename is not
     // already absolute.
@@ -487,10 +639,204 @@ Configuration::CGI::CGI(char const * section, char const * extensions, char cons
     // Initialize the parameter block.
 
     setContent({
-        { optExtensions,  extensions,   nullptr },
-        { optInterpreter, exe,          nullptr },
-        { optCmdLine,     cmdline,      nullptr },
+        { optExtensions,      extensions,   nullptr                                                                                              },
+        { optInterpreter,     exe,          nullptr                                                                                              },
+        { optCmdLine,         cmdline,      nullptr                                                                                              },
+        { optStreamBody,      false,        nullptr                                                                                              },
+        { optFastCGI,         "",           [] (Variant & x) { return x.getStringValue().empty() || parseAddress(x.getStringValue(), nullptr); } },
+        { optFastCGIWorkers,  0,            [] (Variant & x) { return x.getIntegerValue() >= 0 && x.getIntegerValue() <= 256; }                  },
+        { optZygote,          "",           nullptr                                                                                              },
+        { optMaxProcesses,    0,            nullptr                                                                                              },
+        { optTimeLimit,       0,            nullptr                                                                                              },
+        { optCPULimit,        0,            nullptr                                                                                              },
+        { optMemoryLimit,     0,            nullptr                                                                                              },
+        { optCache,           false,        nullptr                                                                                              },
+        { optCacheVary,       "",           nullptr                                                                                              },
+        { optXSendFilePath,   "",           [] (Variant & x) { return isDirectoryList(x.getStringValue()); }                                     },
+        { optETagLimit,       0,            [] (Variant & x) { return x.getIntegerValue() >= 0; }                                                },
+        { optFlushDelay,      20,           [] (Variant & x) { return x.getIntegerValue() >= 0 && x.getIntegerValue() <= 10000; }                },
     });
 }
 
+//--------------------------------------------------------------
+// Return the address of the FastCGI backend, with the host name
+// resolved.
+//--------------------------------------------------------------
+
+AddrIPv4 Configuration::CGI::getFastCGIAddress() const {
+    AddrIPv4 address;
+    parseAddress(getFastCGI(), &address);
+    return address;
+}
+
+//--------------------------------------------------------------
+// Return the application name followed by the extra arguments
+// from the CmdLine parameter. The command line is parsed on first
+// use, i.e. once the configuration is loaded, and then cached.
+//--------------------------------------------------------------
+
+std::vector<std::string> const & Configuration::CGI::getArguments() const {
+    std::call_once(argumentsOnce_, [this] () {
+        std::vector<std::string> & result = arguments_;
+
+        // By convention, the first argument must be the application
+        // name. (Path stripped).
+
+        result.push_back(getInterpreter().getLastComponent().getStdString());
+
+        // Append extra arguments from the configuration. We have to parse
+        // the string as bash would to build the args array.(Except we
+        // don't handle $variables and filename substitution.)
+
+        auto escape = [] (int ch) {
+            switch (ch) {
+            case 'a':   return '\a';
+            case 'b':   return '\b';
+            case 'e':   return '\x1B';
+            case 'f':   return '\f';
+            case 'n':   return '\n';
+            case 'r':   return '\r';
+            case 't':   return '\t';
+            case 'v':   return '\v';
+            default:    return '\0';
+            }
+        };
+
+        std::string const & extra = getCmdLine();
+        std::string buffer;
+        int state = 0;
+
+        size_t count = extra.size();
+        for (size_t i = 0; i < count; i++) {
+            char ch = extra[i], esc;
+            switch (state) {
+            case 0:
+                if (ch == '"') {
+                    state = 3;
+                } else if (ch == '\'') {
+                    state = 5;
+                } else if (!isspace(ch)) {
+                    buffer.push_back(ch);
+                    state = 1;
+                }
+                break;
+            case 1:
+                if (ch == '\\') {
+                    state = 2;
+                } else if (isspace(ch)) {
+                    result.push_back(buffer);
+                    buffer.clear();
+                    state = 0;
+                } else {
+                    buffer.push_back(ch);
+                }
+                break;
+            case 2:
+                if (ch == ' ' || ch == '\'' || ch == '"' || ch == '\\') {
+                    buffer.push_back(ch);
+                } else if ((esc = escape(ch)) != 0) {
+                    buffer.push_back(esc);
+                } else {
+                    buffer.push_back('\\');
+                    buffer.push_back(ch);
+                }
+                state = 1;
+                break;
+            case 3:
+                if (ch == '\\') {
+                    state = 4;
+                } else if (ch == '"') {
+                    result.push_back(buffer);
+                    buffer.clear();
+                    state = 0;
+                } else {
+                    buffer.push_back(ch);
+                }
+                break;
+            case 4:
+                if (ch == '"' || ch == '\\') {
+                    buffer.push_back(ch);
+                } else if ((esc = escape(ch)) != 0) {
+                    buffer.push_back(esc);
+                } else {
+                    buffer.push_back('\\');
+                    buffer.push_back(ch);
+                }
+                state = 3;
+                break;
+            case 5:
+                if (ch == '\'') {
+                    result.push_back(buffer);
+                    buffer.clear();
+                    state = 0;
+                } else {
+                    buffer.push_back(ch);
+                }
+                break;
+            }
+        }
+        if (!buffer.empty()) {
+            result.push_back(buffer);
+        }
+    });
+    return arguments_;
+}
+
+//--------------------------------------------------------------
+// Return the environment variables that are the same for all the
+// scripts of this block. They are built by the given function on
+// first use, and then cached.
+//--------------------------------------------------------------
+
+std::vector<std::string> const & Configuration::CGI::getEnvironment(std::function<std::vector<std::string>()> const & build) const {
+    std::call_once(environmentOnce_, [this, &build] () {
+        environment_ = build();
+    });
+    return environment_;
+}
+
+//--------------------------------------------------------------
+// Return the directories the scripts may designate files in with
+// an X-Sendfile header, as absolute paths without symbolic links.
+//--------------------------------------------------------------
+
+std::vector<fs::filepath> Configuration::CGI::getXSendFilePaths() const {
+    std::vector<fs::filepath> result;
+    string::split(at(optXSendFilePath).getStringValue(), ' ', 0, string::trim_none, [&result] (std::string & name) {
+        fs::filepath dir(name);
+        if (dir.getFileType() == fs::directory) {
+            result.push_back(dir.makeAbsolute());
+        }
+        return true;
+    });
+    return result;
+}
+
+//--------------------------------------------------------------
+// Reserve the right to run an interpreter. If the maximum number
+// of interpreters are already running, wait for one to terminate,
+// at most for the given time. Return false on timeout.
+//--------------------------------------------------------------
+
+bool Configuration::CGI::acquireProcess(std::chrono::milliseconds timeout) const {
+    int limit = getMaxProcesses();
+    std::unique_lock<std::mutex> lock(processMutex_);
+    if (limit > 0 && !processCondition_.wait_for(lock, timeout, [this, limit] { return processes_ < limit; })) {
+        return false;
+    }
+    processes_++;
+    return true;
+}
+
+//--------------------------------------------------------------
+// Release the right obtained by acquireProcess(), once the
+// interpreter is terminated.
+//--------------------------------------------------------------
+
+void Configuration::CGI::releaseProcess() const {
+    std::lock_guard<std::mutex> lock(processMutex_);
+    processes_--;
+    processCondition_.notify_one();
+}
+
 //========================================================================
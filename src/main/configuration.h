@@ -29,8 +29,12 @@
 #include <list>
 #include <vector>
 #include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 
 #include "../misc/filesys.h"
+#include "../http/stream_socket.h"
 
 //--------------------------------------------------------------
 // Container to encapsulate parameter values.
@@ -70,6 +74,7 @@ private:
 class Configuration {
 private:
     void buildExtensionMap();
+    void buildProxyList();
 
     class ParameterBlock {
     public:
@@ -105,22 +110,72 @@ public:
 
         fs::filepath    getInterpreter() const                  { return at(optInterpreter).getStringValue();                               }
         std::string     getCmdLine() const                      { return at(optCmdLine).getStringValue();                                   }
+        bool            isBodyStreamed() const                  { return at(optStreamBody).getBooleanValue();                               }
+        std::string     getFastCGI() const                      { return at(optFastCGI).getStringValue();                                   }
+        AddrIPv4        getFastCGIAddress() const;
+        int             getFastCGIWorkers() const               { return at(optFastCGIWorkers).getIntegerValue();                           }
+        std::string     getZygote() const                       { return at(optZygote).getStringValue();                                    }
+        int             getMaxProcesses() const                 { return at(optMaxProcesses).getIntegerValue();                             }
+        std::chrono::seconds getTimeLimit() const               { return std::chrono::seconds(at(optTimeLimit).getIntegerValue());          }
+        int             getCPULimit() const                     { return at(optCPULimit).getIntegerValue();                                 }
+        int             getMemoryLimit() const                  { return at(optMemoryLimit).getIntegerValue();                              }
+        bool            isCached() const                        { return at(optCache).getBooleanValue();                                    }
+        std::string     getCacheVary() const                    { return at(optCacheVary).getStringValue();                                 }
+        bool            isXSendFileEnabled() const              { return !at(optXSendFilePath).getStringValue().empty();                    }
+        int             getETagLimit() const                    { return at(optETagLimit).getIntegerValue();                                }
+        std::chrono::milliseconds getFlushDelay() const         { return std::chrono::milliseconds(at(optFlushDelay).getIntegerValue());    }
+
+        std::vector<std::string> const &    getArguments() const;
+        std::vector<std::string> const &    getEnvironment(std::function<std::vector<std::string>()> const & build) const;
+        std::vector<fs::filepath>           getXSendFilePaths() const;
+        bool                                acquireProcess(std::chrono::milliseconds timeout) const;
+        void                                releaseProcess() const;
+
+    private:
+        mutable std::once_flag              argumentsOnce_;         // guard for the lazy initialization of arguments_
+        mutable std::vector<std::string>    arguments_;             // interpreter name and extra arguments, parsed from CmdLine
+        mutable std::once_flag              environmentOnce_;       // guard for the lazy initialization of environment_
+        mutable std::vector<std::string>    environment_;           // environment variables that do not depend on the request
+        mutable std::mutex                  processMutex_;          // thread synchronization
+        mutable std::condition_variable     processCondition_;      // thread synchronization
+        mutable int                         processes_;             // number of interpreters currently running
+    };
+
+    struct Proxy {
+        std::string     prefix;                                 // path prefix forwarded to the upstream server
+        std::string     host;                                   // upstream host, as sent in the Host header
+        AddrIPv4        address;                                // upstream address (resolved when the configuration is loaded)
+        std::string     path;                                   // path on the upstream server the prefix is mapped to
     };
 
     void                        log();
     bool                        save(fs::filepath const & filename);
     bool                        load(fs::filepath const & filename);
     CGI const *                 getInterpreter(fs::filepath const & filename) const;
+    std::list<CGI> const &      getInterpreters() const         { return cgis_;                                                             }
+    Proxy const *               getProxy(std::string const & path) const;
 
     void                        setListeningPort(int port)      { general_.at(optListen) = port;                                            }
     int                         getListeningPort() const        { return general_.at(optListen).getIntegerValue();                          }
+    std::string const &         getCertificate() const          { return general_.at(optCertificate).getStringValue();                      }
+    std::string const &         getPrivateKey() const           { return general_.at(optPrivateKey).getStringValue();                       }
     int                         getLimitThreads() const         { return general_.at(optLimitThreads).getIntegerValue();                    }
+    int                         getReactorThreads() const       { return general_.at(optReactorThreads).getIntegerValue();                  }
     int                         getLimitRequestLine() const     { return general_.at(optLimitRequestLine).getIntegerValue();                }
     int                         getLimitRequestHeaders() const  { return general_.at(optLimitRequestHeaders).getIntegerValue();             }
     int                         getLimitRequestBody() const     { return general_.at(optLimitRequestBody).getIntegerValue();                }
+    int                         getBodyBufferSize() const       { return general_.at(optBodyBufferSize).getIntegerValue();                  }
+    std::string const &         getTempDirectory() const        { return general_.at(optTempDirectory).getStringValue();                    }
     bool                        isCompressionEnabled() const    { return general_.at(optCompression).getBooleanValue();                     }
     std::vector<std::string>    getDirectoryIndexes() const;
     bool                        isListingEnabled() const        { return general_.at(optDirectoryListing).getBooleanValue();                }
+    std::string const &         getEventStream() const          { return general_.at(optEventStream).getStringValue();                      }
+    int                         getEventBacklog() const         { return general_.at(optEventBacklog).getIntegerValue();                    }
+    std::chrono::seconds        getEventHeartbeat() const       { return std::chrono::seconds(general_.at(optEventHeartbeat).getIntegerValue()); }
+    int                         getWebSocketQueue() const       { return general_.at(optWebSocketQueue).getIntegerValue();                  }
+    bool                        isSlowClientDropped() const     { return general_.at(optWebSocketSlowClient).getStringValue() == "drop";    }
+    std::string const &         getHostnameLookups() const      { return general_.at(optHostnameLookups).getStringValue();                  }
+    int                         getCacheSize() const            { return general_.at(optCacheSize).getIntegerValue();                       }
     std::chrono::seconds        getTimeout() const              { return std::chrono::seconds(general_.at(optTimeout).getIntegerValue());   }
     std::chrono::seconds        getExpires() const              { return std::chrono::seconds(general_.at(optExpires).getIntegerValue());   }
     std::string const &         getServerAdmin() const          { return general_.at(optServerAdmin).getStringValue();                      }
@@ -130,15 +185,29 @@ private:
     ParameterBlock                          general_;           // General parameter block
     std::list<CGI>                          cgis_;              // Parameter blocks for each supported script language
     std::unordered_map<std::string, CGI &>  extensions_;        // Map to efficiently retrieve a CGI script from a filename extension
+    std::vector<Proxy>                      proxies_;           // Path prefixes forwarded to upstream servers, longest first
 
     static char const * optListen;                              // TCP/IP port the server listens to
+    static char const * optCertificate;                         // TLS certificate chain (PEM)
+    static char const * optPrivateKey;                          // TLS private key (PEM)
     static char const * optLimitThreads;                        // Maximum number of worker threads
+    static char const * optReactorThreads;                      // Number of threads waiting for the running scripts
     static char const * optLimitRequestLine;                    // Maximum number of worker threads
     static char const * optLimitRequestHeaders;                 // Maximum number of worker threads
     static char const * optLimitRequestBody;                    // Maximum number of worker threads
+    static char const * optBodyBufferSize;                      // Maximum size of a request body kept in memory
+    static char const * optTempDirectory;                       // Directory where to store large request bodies
     static char const * optCompression;                         // Enable/disable HTTP compression
     static char const * optDirectoryIndex;                      // Index files to search for when browsing a directory
     static char const * optDirectoryListing;                    // Generate a listing of directory contents
+    static char const * optProxyPass;                           // Path prefixes forwarded to upstream servers
+    static char const * optEventStream;                         // Path of the event stream (Server-Sent Events)
+    static char const * optEventBacklog;                        // Number of events kept for the clients that reconnect
+    static char const * optEventHeartbeat;                      // Interval between two heartbeats on an idle event stream
+    static char const * optWebSocketQueue;                      // Maximum number of bytes waiting to be sent on a WebSocket connection
+    static char const * optWebSocketSlowClient;                 // What to do when a WebSocket client does not keep up (close or drop)
+    static char const * optHostnameLookups;                     // Reverse DNS lookup of clients (yes, no or async)
+    static char const * optCacheSize;                           // Maximum total size of the cached script responses
     static char const * optTimeout;                             // Timeout
     static char const * optExpires;                             // Default value for the Expires header
     static char const * optServerAdmin;                         // Email address of the server admin
@@ -146,6 +215,19 @@ private:
     static char const * optExtensions;                          // List of extensions (comma separated) for a CGI script
     static char const * optInterpreter;                         // Path to the interpreter to execute a CGI script
     static char const * optCmdLine;                             // Extra options to pass to the interpreter
+    static char const * optStreamBody;                          // Start the interpreter before the request body is received
+    static char const * optFastCGI;                             // Address of the FastCGI backend running the scripts
+    static char const * optFastCGIWorkers;                      // Number of FastCGI workers spawned by the server
+    static char const * optZygote;                              // Warm-up script run once by a pre-started interpreter
+    static char const * optMaxProcesses;                        // Maximum number of interpreters running at once
+    static char const * optTimeLimit;                           // Maximum running time of a script (wall clock)
+    static char const * optCPULimit;                            // Maximum CPU time of a script
+    static char const * optMemoryLimit;                         // Maximum memory size of a script
+    static char const * optCache;                               // Cache the script responses that allow it
+    static char const * optCacheVary;                           // Request headers the cached script responses depend on
+    static char const * optXSendFilePath;                       // Directories scripts may send files from with X-Sendfile
+    static char const * optETagLimit;                           // Maximum size of a script output held back to compute an entity tag
+    static char const * optFlushDelay;                          // Maximum time a script output is held back in buffers
 
 #ifdef UNIT_TESTING
 public:
@@ -154,6 +236,9 @@ private:
 #endif
     bool save(std::ostream & fs);
     bool load(std::istream & fs, fs::filepath const & filename);
+    static bool parseProxyPass(std::string const & value, std::vector<Proxy> * result);
+    static bool parseAddress(std::string const & value, AddrIPv4 * result);
+    static bool isDirectoryList(std::string const & value);
 };
 
 //--------------------------------------------------------------
@@ -27,6 +27,7 @@
 
 #include "../misc/portability.h"
 #include "../misc/logger.h"
+#include "../misc/blob.h"
 #include "../http/http_server.h"
 #include "zinc.h"
 
@@ -202,6 +203,26 @@ int main(int argc, char ** argv) {
 
     // Instantiate and start the server.
 
+    blob::setSpillPolicy(static_cast<size_t>(configuration.getBodyBufferSize()), configuration.getTempDirectory());
+    zinc.getResponseCache().setCapacity(static_cast<size_t>(configuration.getCacheSize()));
+    zinc.getEventHub().setCapacity(static_cast<size_t>(configuration.getEventBacklog()));
+
+#ifdef ZINC_TLS
+    std::string const & certificate = configuration.getCertificate();
+    if (!certificate.empty()) {
+        std::string const & key = configuration.getPrivateKey();
+        if (!StreamSocket::setupTLS(certificate, key.empty() ? certificate : key)) {
+            std::cerr << "error: unable to load TLS certificate " << certificate << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+#endif
+
+    if (!zinc.startBackends()) {
+        std::cerr << "error: unable to start FastCGI backends" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     server = std::make_unique<HttpServer>(zinc);
     int status = server->startup();
     server.reset();
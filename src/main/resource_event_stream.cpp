@@ -0,0 +1,195 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+#include "resource_error_page.h"
+#include "resource_event_stream.h"
+
+//========================================================================
+// ResourceEventStream
+//
+// Resource consisting of an event stream (Server-Sent Events). A GET
+// request subscribes to the events: the response never ends, and each
+// event is sent as it is published. The client gets a comment when the
+// stream is idle for a while (heartbeat), and the events it missed when
+// it reconnects with a Last-Event-ID header.
+//
+// With reactors, the subscribers wait in the reactor threads, not in
+// request threads. Otherwise (or with HTTP/2), each subscriber holds a
+// thread.
+//
+// A POST request from the local host publishes its body as an event.
+// The "event" argument sets the event type. The response is the event
+// identifier.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+ResourceEventStream::ResourceEventStream(EventHub & hub, std::chrono::seconds heartbeat)
+    : Resource("event stream"),
+      hub_(hub),
+      heartbeat_(heartbeat),
+      cursor_(0) {
+}
+
+//--------------------------------------------------------------
+// Transmit the resource to the provided HttpResponse object. A
+// subscriber holds the thread until it is gone.
+//--------------------------------------------------------------
+
+void ResourceEventStream::transmit(HttpResponse & response, HttpRequest const & request) {
+    if (publish(response, request) || !start(response, request)) {
+        return;
+    }
+    while (send(response)) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(beat_ - std::chrono::steady_clock::now());
+        hub_.wait(cursor_, remaining + std::chrono::milliseconds(1));
+    }
+    response.flush();
+}
+
+//--------------------------------------------------------------
+// Subscribe to the events in a reactor. Requests other than a
+// subscription are transmitted at once.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+std::unique_ptr<Reactor::Handler> ResourceEventStream::detach(HttpResponse & response, HttpRequest const & request) {
+    if (publish(response, request) || !start(response, request)) {
+        return nullptr;
+    }
+    return std::make_unique<Subscriber>(*this, response);
+}
+#endif
+
+//--------------------------------------------------------------
+// Called when the subscriber is gone.
+//--------------------------------------------------------------
+
+void ResourceEventStream::complete(HttpResponse & response, HttpRequest const & /* request */) {
+    response.flush();
+}
+
+//--------------------------------------------------------------
+// Process the requests that are not a subscription: publish an
+// event, or reject the request. Return false for a subscription.
+//--------------------------------------------------------------
+
+bool ResourceEventStream::publish(HttpResponse & response, HttpRequest const & request) {
+    if (request.getVerb().isOneOf(HttpVerb::Get | HttpVerb::Head)) {
+        return false;
+    } else if (!request.getVerb().isOneOf(HttpVerb::Post)) {
+        ResourceErrorPage(405).transmit(response, request);
+    } else if (!request.getRemoteAddress().isLoopback()) {
+        ResourceErrorPage(403).transmit(response, request);
+    } else {
+        std::vector<uint8_t> data = request.getBody().readAll();
+        auto const & args = request.getURI().getArguments();
+        auto got = args.find("event");
+        uint64_t id = hub_.publish(std::string(data.begin(), data.end()), got != args.end() ? got->second : std::string());
+
+        std::string text = std::to_string(id) + "\r\n";
+        response.emitHeader(HttpHeader::ContentType, "text/plain");
+        response.emitHeader(HttpHeader::ContentLength, std::to_string(text.size()));
+        response.emitEol();
+        response.write(text.data(), text.size());
+        response.flush();
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Start the event stream: send the headers, then the events the
+// client missed if it reconnects, or a comment so that it gets
+// the headers right away. Return false if the stream is over
+// already (HEAD request, or the client is gone).
+//--------------------------------------------------------------
+
+bool ResourceEventStream::start(HttpResponse & response, HttpRequest const & request) {
+    response.emitHeader(HttpHeader::ContentType, "text/event-stream");
+    response.emitHeader(HttpHeader::CacheControl, "no-cache");
+    response.emitEol();
+    if (!request.getVerb().isOneOf(HttpVerb::Get)) {
+        response.flush();
+        return false;
+    }
+
+    std::string text = ":\n";
+    cursor_ = hub_.seek(request.getHeaderValue(HttpHeader::LastEventID));
+    hub_.fetch(cursor_, text);
+    beat_ = std::chrono::steady_clock::now() + heartbeat_;
+    if (!response.write(text.data(), text.size()) || !response.sync()) {
+        response.flush();
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Send the events published since the last call, or a heartbeat
+// if there are none and it is due. Return false when the stream
+// is over (the client is gone, or the server is shutting down).
+//--------------------------------------------------------------
+
+bool ResourceEventStream::send(HttpResponse & response) {
+    std::string text;
+    auto now = std::chrono::steady_clock::now();
+    if (hub_.fetch(cursor_, text) == 0) {
+        if (now < beat_) {
+            return !hub_.isClosed();
+        }
+        text = ":\n";
+    }
+    beat_ = now + heartbeat_;
+    return response.write(text.data(), text.size()) && response.sync() && !hub_.isClosed();
+}
+
+//--------------------------------------------------------------
+// Wait for the next event, or for the next heartbeat.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+
+void ResourceEventStream::Subscriber::prepare(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline) {
+    signal_ = owner_.hub_.watch(owner_.cursor_);
+    fds.push_back({ signal_->getHandle(), POLLIN, 0 });
+    deadline = std::min(deadline, owner_.beat_);
+}
+
+//--------------------------------------------------------------
+// Send the events to the client. Return false when the stream
+// is over.
+//--------------------------------------------------------------
+
+bool ResourceEventStream::Subscriber::process(struct pollfd const * /* fds */) {
+    return owner_.send(response_);
+}
+
+#endif
+
+//========================================================================
@@ -0,0 +1,74 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef __RESOURCE_EVENT_STREAM_H__
+#define __RESOURCE_EVENT_STREAM_H__
+
+#include "../http/resource.h"
+#include "../http/event_hub.h"
+
+//--------------------------------------------------------------
+// Resource consisting of an event stream (Server-Sent Events).
+//--------------------------------------------------------------
+
+class ResourceEventStream : public Resource {
+public:
+    ResourceEventStream(EventHub & hub, std::chrono::seconds heartbeat);
+
+    void            transmit(HttpResponse & response, HttpRequest const & request) override;
+#ifndef _WIN32
+    std::unique_ptr<Reactor::Handler> detach(HttpResponse & response, HttpRequest const & request) override;
+#endif
+    void            complete(HttpResponse & response, HttpRequest const & request) override;
+    bool            acceptsBody() const override                { return true; }
+
+private:
+    EventHub &                              hub_;           // events published
+    std::chrono::seconds                    heartbeat_;     // interval between two heartbeats
+    uint64_t                                cursor_;        // last event sent to the client
+    std::chrono::steady_clock::time_point   beat_;          // when the next heartbeat is due
+
+    bool publish(HttpResponse & response, HttpRequest const & request);
+    bool start(HttpResponse & response, HttpRequest const & request);
+    bool send(HttpResponse & response);
+
+#ifndef _WIN32
+    class Subscriber : public Reactor::Handler {    // handler waiting in a reactor for the events to send
+    public:
+        Subscriber(ResourceEventStream & owner, HttpResponse & response) : owner_(owner), response_(response)  { }
+        void prepare(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline) override;
+        bool process(struct pollfd const * fds) override;
+
+    private:
+        ResourceEventStream &               owner_;
+        HttpResponse &                      response_;
+        std::shared_ptr<EventHub::Signal>   signal_;        // signal polled for the next event
+    };
+#endif
+};
+
+//--------------------------------------------------------------
+
+#endif
+
+//========================================================================
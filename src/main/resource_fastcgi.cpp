@@ -0,0 +1,580 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <csignal>
+#include <sys/wait.h>
+#include <spawn.h>
+#endif
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+#include "../misc/logger.h"
+#include "../misc/string.h"
+#include "zinc.h"
+#include "resource_error_page.h"
+#include "resource_fastcgi.h"
+
+#ifndef _WIN32
+extern char ** environ;
+#endif
+
+//========================================================================
+// FastCGI protocol constants (see the FastCGI specification 1.0).
+//========================================================================
+
+namespace {
+
+    int const       FCGI_VERSION_1          = 1;
+    int const       FCGI_BEGIN_REQUEST      = 1;
+    int const       FCGI_END_REQUEST        = 3;
+    int const       FCGI_PARAMS             = 4;
+    int const       FCGI_STDIN              = 5;
+    int const       FCGI_STDOUT             = 6;
+    int const       FCGI_STDERR             = 7;
+    int const       FCGI_RESPONDER          = 1;
+    int const       FCGI_KEEP_CONN          = 1;
+    int const       FCGI_REQUEST_COMPLETE   = 0;
+
+    int const       requestId               = 1;        // connections carry one request at a time
+    size_t const    maxRecordLength         = 32768;    // maximum content length of the records we send
+
+    // Fill the 8-byte header of a record, and return the
+    // length of the padding that follows the content.
+
+    size_t makeHeader(unsigned char * header, int type, size_t length) {
+        size_t padding = (8 - (length & 7)) & 7;
+        header[0] = FCGI_VERSION_1;
+        header[1] = static_cast<unsigned char>(type);
+        header[2] = static_cast<unsigned char>(requestId >> 8);
+        header[3] = static_cast<unsigned char>(requestId);
+        header[4] = static_cast<unsigned char>(length >> 8);
+        header[5] = static_cast<unsigned char>(length);
+        header[6] = static_cast<unsigned char>(padding);
+        header[7] = 0;
+        return padding;
+    }
+
+    char const      zeros[8] = { 0 };
+}
+
+//========================================================================
+// FastCGIBackend
+//
+// Server running the scripts of a CGI block, reached over TCP. Connections
+// are persistent (FCGI_KEEP_CONN) and pooled. If the CGI block has a
+// number of workers, zinc spawns the interpreter itself in FastCGI mode
+// (as php-cgi -b <address>), restarts it if it dies, and never opens
+// more connections than there are workers, since each worker serves
+// one connection at a time.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+FastCGIBackend::FastCGIBackend(Configuration::CGI const & cgi)
+  : cgi_(cgi),
+    address_(cgi.getFastCGIAddress()),
+    pool_(std::chrono::seconds(60), 64),
+    busy_(0),
+    limit_(cgi.getFastCGIWorkers())
+#ifndef _WIN32
+  , pid_(-1)
+#endif
+    {
+    LOG_TRACE("Init FastCGIBackend");
+}
+
+//--------------------------------------------------------------
+// Destructor. Terminate the managed workers, if any.
+//--------------------------------------------------------------
+
+FastCGIBackend::~FastCGIBackend() {
+    LOG_TRACE("Destroy FastCGIBackend");
+#ifndef _WIN32
+    if (pid_ > 0) {
+        kill(-pid_, SIGTERM);
+        waitpid(pid_, nullptr, 0);
+    }
+#endif
+}
+
+//--------------------------------------------------------------
+// Start the backend, i.e. spawn the workers if they are managed
+// by zinc. Externally managed backends are left alone.
+//--------------------------------------------------------------
+
+bool FastCGIBackend::start() {
+    if (!address_) {
+        LOG_ERROR("Unable to resolve FastCGI address " << cgi_.getFastCGI());
+        return false;
+    }
+#ifndef _WIN32
+    if (limit_ > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return spawn();
+    }
+#endif
+    return true;
+}
+
+//--------------------------------------------------------------
+// Get a connection to the backend, either from the pool or a new
+// one. Wait for a worker to be available if their number is
+// limited. Return an invalid socket on error.
+//--------------------------------------------------------------
+
+StreamSocket FastCGIBackend::acquire(bool pooled, bool & reused) {
+    std::chrono::seconds timeout = Zinc::getInstance().getConfiguration().getTimeout();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!condition_.wait_for(lock, timeout, [this] { return limit_ == 0 || busy_ < limit_; })) {
+            LOG_ERROR("No FastCGI worker available for " << cgi_.getSectionName());
+            reused = false;
+            return StreamSocket();
+        }
+        busy_++;
+    }
+
+    StreamSocket socket = pooled ? pool_.acquire(address_) : StreamSocket();
+    reused = static_cast<bool>(socket);
+    for (int attempt = 0; !socket; attempt++) {
+        if (socket.create() && socket.connect(address_)) {
+            break;
+        }
+        socket.close();
+
+        // If the workers are managed by zinc, they may have died
+        // or may not be listening yet. Restart them if needed and
+        // give them some time.
+
+#ifndef _WIN32
+        if (limit_ > 0 && attempt < 20) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!isAlive()) {
+                spawn();
+            }
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+#endif
+        LOG_ERROR("Unable to connect to FastCGI backend " << address_);
+        release(socket, false);
+        break;
+    }
+    return socket;
+}
+
+//--------------------------------------------------------------
+// Give back a connection obtained by acquire(). It is kept in the
+// pool if it can be reused, and closed otherwise.
+//--------------------------------------------------------------
+
+void FastCGIBackend::release(StreamSocket & socket, bool reusable) {
+    if (reusable && socket) {
+        pool_.release(address_, socket);
+    } else {
+        socket.close();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    busy_--;
+    condition_.notify_one();
+}
+
+#ifndef _WIN32
+
+//--------------------------------------------------------------
+// Spawn the interpreter in FastCGI mode, listening to the backend
+// address. (PHP_FCGI_CHILDREN tells php-cgi how many workers to
+// fork.) The extra arguments are parsed the same way as for
+// CGI scripts. The interpreter gets its own process group, so
+// that it can be terminated along with its workers. Must be
+// called with the mutex locked.
+//--------------------------------------------------------------
+
+bool FastCGIBackend::spawn() {
+    std::vector<std::string> args = cgi_.getArguments();
+    args.push_back("-b");
+    args.push_back(cgi_.getFastCGI());
+
+    std::vector<std::string> env;
+    for (char ** e = environ; *e; e++) {
+        if (strncmp(*e, "PHP_FCGI_CHILDREN=", 18) != 0) {
+            env.push_back(*e);
+        }
+    }
+    env.push_back("PHP_FCGI_CHILDREN=" + std::to_string(limit_));
+
+    std::vector<char const *> buffer;
+    for (std::string const & s: args) {
+        buffer.push_back(s.c_str());
+    }
+    buffer.push_back(nullptr);
+    size_t nenv = buffer.size();
+    for (std::string const & s: env) {
+        buffer.push_back(s.c_str());
+    }
+    buffer.push_back(nullptr);
+
+    if (pid_ > 0) {
+        kill(-pid_, SIGTERM);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+
+    // Spawn the interpreter in its own process group. The server
+    // descriptors are close-on-exec, so they are not leaked to the
+    // workers.
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    pid_t pid;
+    char const ** ptr = buffer.data();
+    int err = posix_spawn(&pid, cgi_.getInterpreter().getCString(), nullptr, &attr, const_cast<char **>(ptr), const_cast<char **>(ptr + nenv));
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+        LOG_ERROR("Unable to execute interpreter " << cgi_.getInterpreter() << ": " << strerror(err));
+        return false;
+    }
+
+    pid_ = pid;
+    LOG_INFO("Started " << limit_ << " FastCGI worker(s) for " << cgi_.getSectionName() << " on " << address_);
+    return true;
+}
+
+//--------------------------------------------------------------
+// Check if the managed workers are still running. Must be called
+// with the mutex locked.
+//--------------------------------------------------------------
+
+bool FastCGIBackend::isAlive() {
+    if (pid_ > 0 && waitpid(pid_, nullptr, WNOHANG) != 0) {
+        LOG_ERROR("FastCGI workers for " << cgi_.getSectionName() << " exited");
+        pid_ = -1;
+    }
+    return pid_ > 0;
+}
+
+#endif
+
+//========================================================================
+// ResourceFastCGI
+//
+// Resource consisting of the result of a script run by a FastCGI backend.
+// The request is passed to the backend as FastCGI records: the CGI
+// variables (the same as for a CGI script) as PARAMS records, then the
+// body as STDIN records. If its length is known in advance, the body is
+// forwarded while it is received from the client. The script output
+// comes back in STDOUT records and is processed exactly as the output
+// of a CGI script.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+ResourceFastCGI::ResourceFastCGI(fs::filepath const & scriptname, std::string const & scripturi, std::string const & pathinfo, FastCGIBackend & backend)
+  : ResourceScript(scriptname, scripturi, pathinfo, backend.getCGI()),
+    backend_(backend),
+    reused_(false),
+    headSent_(false),
+    failed_(false),
+    held_(false),
+    received_(0),
+    forwarder_(*this) {
+    LOG_TRACE("Init ResourceFastCGI");
+}
+
+//--------------------------------------------------------------
+// Destructor. If the connection was not given back to the backend
+// (e.g. because receiving the request body failed), close it.
+//--------------------------------------------------------------
+
+ResourceFastCGI::~ResourceFastCGI() {
+    LOG_TRACE("Destroy ResourceFastCGI");
+    disconnect(false);
+}
+
+//--------------------------------------------------------------
+// If the length of the request body is known, send the request
+// parameters now and return a stream that forwards the body to
+// the backend while it is received. Otherwise, the body is stored
+// and sent by transmit().
+//--------------------------------------------------------------
+
+OutputStream * ResourceFastCGI::getBodySink(HttpRequest const & request, size_t limitRequestBody) {
+    long length = string::to_long(request.getHeaderValue(HttpHeader::ContentLength), 10);
+    if (length <= 0 || length > static_cast<long>(limitRequestBody) || !request.getHeaderValue(HttpHeader::TransferEncoding).empty() || !request.getHeaderValue(HttpHeader::ContentEncoding).empty()) {
+        return nullptr;
+    }
+
+    headSent_ = true;
+    failed_ = !connect(true) || !sendHead(request, static_cast<size_t>(length));
+    return &forwarder_;
+}
+
+//--------------------------------------------------------------
+// Transmit the resource to the provided HttpResponse object.
+//--------------------------------------------------------------
+
+void ResourceFastCGI::transmit(HttpResponse & response, HttpRequest const & request) {
+    bool ok = false, reusable = false;
+
+    // Send the request, unless it was already sent along with its
+    // body. A pooled connection may have been closed by the backend
+    // in the meantime. If it is closed or reset before any byte of
+    // the response, an idempotent request is sent again on a new
+    // connection. (After a timeout, the script may have run.)
+
+    if (headSent_) {
+        ok = !failed_ && receive(response, reusable);
+    } else {
+        blob const & body = request.getBody();
+        std::chrono::seconds timeout = Zinc::getInstance().getConfiguration().getTimeout();
+        bool sent = connect(true) && sendHead(request, body.getSize()) && sendBody(body);
+        if (reused_ && request.getVerb().isIdempotent() && (!sent || socket_.isClosedByPeer(timeout))) {
+            disconnect(false);
+            failed_ = false;
+            sent = connect(false) && sendHead(request, body.getSize()) && sendBody(body);
+        }
+        ok = sent && receive(response, reusable);
+    }
+
+    // If the backend did not answer, reply an error page. Otherwise
+    // give the connection back to the backend: it can be reused if
+    // the request completed normally.
+
+    if (!ok && !received_) {
+        disconnect(false);
+        ResourceErrorPage(502).transmit(response, request);
+    } else {
+        response.flush();
+        disconnect(ok && reusable);
+    }
+
+    logErrors(backend_.getCGI().getSectionName());
+}
+
+//--------------------------------------------------------------
+// The backend output is received by the worker thread, there is
+// no interpreter whose output a reactor could collect.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+std::unique_ptr<Reactor::Handler> ResourceFastCGI::detach(HttpResponse & response, HttpRequest const & request) {
+    transmit(response, request);
+    return nullptr;
+}
+#endif
+
+//--------------------------------------------------------------
+// Get a connection to the backend.
+//--------------------------------------------------------------
+
+bool ResourceFastCGI::connect(bool pooled) {
+    socket_ = backend_.acquire(pooled, reused_);
+    held_ = static_cast<bool>(socket_);
+    return held_;
+}
+
+//--------------------------------------------------------------
+// Give the connection back to the backend.
+//--------------------------------------------------------------
+
+void ResourceFastCGI::disconnect(bool reusable) {
+    if (held_) {
+        socket_.setCorked(false);
+        backend_.release(socket_, reusable);
+        held_ = false;
+    }
+}
+
+//--------------------------------------------------------------
+// Send the BEGIN_REQUEST record and the CGI variables. The socket
+// is corked, so that the first STDIN records leave in the same
+// packets; it is uncorked by finish().
+//--------------------------------------------------------------
+
+bool ResourceFastCGI::sendHead(HttpRequest const & request, size_t length) {
+    unsigned char begin[8] = { 0, FCGI_RESPONDER, FCGI_KEEP_CONN, 0, 0, 0, 0, 0 };
+    std::string head;
+    appendRecord(head, FCGI_BEGIN_REQUEST, begin, sizeof(begin));
+
+    std::string params;
+    for (std::string const & var: buildEnvironment(request, length)) {
+        size_t sep = var.find('=');
+        appendParam(params, var.substr(0, sep), var.substr(sep + 1));
+    }
+    for (size_t pos = 0; pos < params.size(); pos += maxRecordLength) {
+        appendRecord(head, FCGI_PARAMS, params.data() + pos, std::min(params.size() - pos, maxRecordLength));
+    }
+    appendRecord(head, FCGI_PARAMS, nullptr, 0);
+
+    socket_.setCorked(true);
+    return socket_.write(head.data(), head.size());
+}
+
+//--------------------------------------------------------------
+// Send a request body that was stored.
+//--------------------------------------------------------------
+
+bool ResourceFastCGI::sendBody(blob const & body) {
+    if (body.getSize() > 0) {
+        if (body.isInMemory()) {
+            std::vector<uint8_t> data = body.readAll();
+            forward(data.data(), data.size());
+        } else {
+            forwarder_.sendFile(body.getFileDescriptor(), 0, body.getSize());
+        }
+    }
+    finish();
+    return !failed_;
+}
+
+//--------------------------------------------------------------
+// Forward a piece of the request body to the backend as STDIN
+// records. Errors are remembered but not reported, so that the
+// client can finish sending its body and get a proper error page.
+//--------------------------------------------------------------
+
+bool ResourceFastCGI::forward(void const * data, size_t length) {
+    char const * p = static_cast<char const *>(data);
+    while (!failed_ && length) {
+        size_t n = std::min(length, maxRecordLength);
+        unsigned char header[8];
+        size_t padding = makeHeader(header, FCGI_STDIN, n);
+        failed_ = !socket_.write(header, sizeof(header)) || !socket_.write(p, n) || (padding && !socket_.write(zeros, padding));
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Terminate the request body with an empty STDIN record.
+//--------------------------------------------------------------
+
+bool ResourceFastCGI::finish() {
+    if (!failed_) {
+        unsigned char header[8];
+        makeHeader(header, FCGI_STDIN, 0);
+        failed_ = !socket_.write(header, sizeof(header));
+    }
+    socket_.setCorked(false);
+    failed_ = failed_ || !socket_.flush();
+    return true;
+}
+
+//--------------------------------------------------------------
+// Receive records from the backend until the request is complete.
+// The script output is written to the response, and its error
+// output is kept for the log. Return false if the backend fails
+// or the response cannot be transmitted.
+//--------------------------------------------------------------
+
+bool ResourceFastCGI::receive(HttpResponse & response, bool & reusable) {
+    std::chrono::seconds timeout = Zinc::getInstance().getConfiguration().getTimeout();
+    std::vector<char> content;
+    for ( ; ; ) {
+        unsigned char header[8];
+        if (socket_.read(header, sizeof(header), timeout, true) != sizeof(header) || header[0] != FCGI_VERSION_1) {
+            return false;
+        }
+
+        size_t length = (static_cast<size_t>(header[4]) << 8) | header[5];
+        size_t total = length + header[6];
+        content.resize(total);
+        if (total && socket_.read(content.data(), total, timeout, true) != total) {
+            return false;
+        }
+
+        if (((header[2] << 8) | header[3]) == requestId) {
+            switch (header[1]) {
+            case FCGI_STDOUT:
+                if (length) {
+                    if (!received_) {
+                        emitDefaultHeaders(response);
+                    }
+                    received_ += length;
+                    if (!response.write(content.data(), length)) {
+                        return false;
+                    }
+                }
+                break;
+            case FCGI_STDERR:
+                errors_.append(content.data(), length);
+                break;
+            case FCGI_END_REQUEST:
+                reusable = true;
+                return length >= 8 && content[4] == FCGI_REQUEST_COMPLETE;
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------
+// Append a record to a buffer.
+//--------------------------------------------------------------
+
+void ResourceFastCGI::appendRecord(std::string & out, int type, void const * data, size_t length) {
+    unsigned char header[8];
+    size_t padding = makeHeader(header, type, length);
+    out.append(reinterpret_cast<char const *>(header), sizeof(header));
+    if (length) {
+        out.append(static_cast<char const *>(data), length);
+    }
+    out.append(zeros, padding);
+}
+
+//--------------------------------------------------------------
+// Append a name-value pair to a buffer. Lengths are encoded on
+// one byte if they are less than 128, and on four bytes with the
+// high bit set otherwise.
+//--------------------------------------------------------------
+
+void ResourceFastCGI::appendParam(std::string & out, std::string const & name, std::string const & value) {
+    auto appendLength = [&out] (size_t length) {
+        if (length < 128) {
+            out.push_back(static_cast<char>(length));
+        } else {
+            out.push_back(static_cast<char>(((length >> 24) & 0x7F) | 0x80));
+            out.push_back(static_cast<char>(length >> 16));
+            out.push_back(static_cast<char>(length >> 8));
+            out.push_back(static_cast<char>(length));
+        }
+    };
+    appendLength(name.size());
+    appendLength(value.size());
+    out.append(name);
+    out.append(value);
+}
+
+//========================================================================
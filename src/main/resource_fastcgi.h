@@ -0,0 +1,122 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#ifndef __RESOURCE_FASTCGI_H__
+#define __RESOURCE_FASTCGI_H__
+
+#include <mutex>
+#include <condition_variable>
+
+#include "../http/stream_socket.h"
+#include "../http/connection_pool.h"
+#include "resource_script.h"
+
+//--------------------------------------------------------------
+// FastCGI backend, i.e. the server running the scripts of a CGI
+// block. It is either managed externally (e.g. php-fpm) or spawned
+// by zinc itself.
+//--------------------------------------------------------------
+
+class FastCGIBackend {
+public:
+    FastCGIBackend(Configuration::CGI const & cgi);
+    ~FastCGIBackend();
+
+    bool                        start();
+    StreamSocket                acquire(bool pooled, bool & reused);
+    void                        release(StreamSocket & socket, bool reusable);
+    Configuration::CGI const &  getCGI() const                  { return cgi_; }
+
+private:
+    Configuration::CGI const &  cgi_;           // CGI block this backend runs the scripts of
+    AddrIPv4                    address_;       // address the backend listens to
+    ConnectionPool              pool_;          // idle persistent connections to the backend
+    std::mutex                  mutex_;         // thread synchronization
+    std::condition_variable     condition_;     // thread synchronization
+    int                         busy_;          // number of connections currently in use
+    int                         limit_;         // maximum number of connections (0 if unlimited)
+#ifndef _WIN32
+    pid_t                       pid_;           // process ID of the managed workers, or -1
+
+    bool                        spawn();
+    bool                        isAlive();
+#endif
+};
+
+//--------------------------------------------------------------
+// Resource consisting of a script run by a FastCGI backend.
+//--------------------------------------------------------------
+
+class ResourceFastCGI : public ResourceScript {
+public:
+    ResourceFastCGI(fs::filepath const & scriptname, std::string const & scripturi, std::string const & pathinfo, FastCGIBackend & backend);
+    ~ResourceFastCGI() override;
+
+    void            transmit(HttpResponse & response, HttpRequest const & request) override;
+#ifndef _WIN32
+    std::unique_ptr<Reactor::Handler> detach(HttpResponse & response, HttpRequest const & request) override;
+#endif
+    OutputStream *  getBodySink(HttpRequest const & request, size_t limitRequestBody) override;
+
+private:
+    FastCGIBackend &    backend_;           // backend running the script
+    StreamSocket        socket_;            // connection to the backend
+    bool                reused_;            // whether the connection was taken from the pool
+    bool                headSent_;          // whether the request parameters were already sent (when the body is streamed)
+    bool                failed_;            // whether forwarding the request body failed
+    bool                held_;              // whether a connection to the backend is held
+    size_t              received_;          // number of bytes of script output received so far
+
+    class Forwarder : public OutputStream {     // stream that forwards the request body to the backend
+    public:
+        Forwarder(ResourceFastCGI & owner) : owner_(owner)              { }
+        bool write(void const * data, size_t length) override           { return owner_.forward(data, length);  }
+        bool flush() override                                           { return owner_.finish();               }
+
+    private:
+        ResourceFastCGI & owner_;
+    };
+
+    Forwarder           forwarder_;         // stream the request body is written to
+
+    bool                connect(bool pooled);
+    void                disconnect(bool reusable);
+    bool                sendHead(HttpRequest const & request, size_t length);
+    bool                sendBody(blob const & body);
+    bool                receive(HttpResponse & response, bool & reusable);
+    bool                forward(void const * data, size_t length);
+    bool                finish();
+
+#ifdef UNIT_TESTING
+public:
+#endif
+    static void         appendRecord(std::string & out, int type, void const * data, size_t length);
+    static void         appendParam(std::string & out, std::string const & name, std::string const & value);
+};
+
+//--------------------------------------------------------------
+
+#endif
+
+//========================================================================
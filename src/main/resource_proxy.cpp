@@ -0,0 +1,368 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#include <climits>
+#include <cstdio>
+#include <algorithm>
+
+#include "../misc/logger.h"
+#include "../misc/string.h"
+#include "zinc.h"
+#include "resource_error_page.h"
+#include "resource_proxy.h"
+
+//========================================================================
+// ResourceProxy
+//
+// Resource consisting of the response of an upstream HTTP server. The
+// request is forwarded with its hop-by-hop headers removed, and the
+// response is relayed to the client through HttpResponse, which takes
+// care of compression and framing as for any other resource. Neither
+// the request body nor the response body is held in memory: both are
+// passed along while they arrive.
+//
+// Connections to upstream servers are kept alive and pooled, so that
+// consecutive requests do not pay for a new TCP handshake each time.
+//========================================================================
+
+namespace {
+
+    // Idle connections older than this are closed rather than
+    // reused, as the upstream server has probably given up on
+    // them already. (Most servers wait 5 seconds or more.)
+
+    std::chrono::seconds const  idleTimeout(4);
+
+    // Maximum number of idle connections kept for each upstream
+    // server.
+
+    size_t const                maxIdlePerUpstream = 16;
+
+    // Headers that apply to a single connection and that must
+    // not be forwarded, in either direction (see RFC 7230 section
+    // 6.1), plus headers that are rebuilt by the proxy.
+
+    HttpHeader const            hopByHop[] = {
+        HttpHeader::Connection,
+        HttpHeader::TE,
+        HttpHeader::Trailer,
+        HttpHeader::TransferEncoding,
+        HttpHeader::Upgrade,
+        HttpHeader::ProxyAuthenticate,
+        HttpHeader::ProxyAuthorization,
+        HttpHeader::ProxyConnection,
+        HttpHeader::HTTP2Settings,
+        HttpHeader("Keep-Alive"),
+    };
+
+    bool isHopByHop(HttpHeader const & header, std::vector<HttpHeader> const & listed) {
+        return std::find(std::begin(hopByHop), std::end(hopByHop), header) != std::end(hopByHop) ||
+               std::find(listed.begin(), listed.end(), header) != listed.end();
+    }
+
+    // Headers named in the Connection header are hop-by-hop too.
+
+    std::vector<HttpHeader> getConnectionHeaders(HttpHeaderMap const & headers) {
+        std::vector<HttpHeader> listed;
+        auto got = headers.find(HttpHeader::Connection);
+        if (got != headers.end()) {
+            string::split(got->second, ',', 0, string::trim_both, [&] (std::string & name) {
+                if (!name.empty()) {
+                    listed.emplace_back(name);
+                }
+                return true;
+            });
+        }
+        return listed;
+    }
+
+    // Build the request target on the upstream server: the
+    // configured path followed by what remains of the request
+    // path after the prefix.
+
+    std::string buildTarget(Configuration::Proxy const & proxy, URI const & uri) {
+        std::string const & path = uri.getPath();
+        std::string target = string::encodeURI(proxy.path + path.substr(proxy.prefix.size() - (proxy.prefix.back() == '/' ? 1 : 0)));
+        if (target.empty()) {
+            target = "/";
+        }
+        if (!uri.getQuery().empty()) {
+            target.push_back('?');
+            target.append(uri.getQuery());
+        }
+        return target;
+    }
+}
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+ResourceProxy::ResourceProxy(Configuration::Proxy const & proxy, URI const & uri)
+  : Resource("proxy http://" + proxy.host + buildTarget(proxy, uri)),
+    proxy_(proxy),
+    target_(buildTarget(proxy, uri)),
+    reused_(false),
+    headSent_(false),
+    chunked_(false),
+    failed_(false),
+    forwarder_(*this) {
+    LOG_TRACE("Init ResourceProxy");
+}
+
+//--------------------------------------------------------------
+// Destructor.
+//--------------------------------------------------------------
+
+ResourceProxy::~ResourceProxy() {
+    LOG_TRACE("Destroy ResourceProxy");
+}
+
+//--------------------------------------------------------------
+// Return the stream the request body is written to. The request
+// head is sent right away, and the body follows as it is received
+// from the client. If the upstream server cannot be reached, the
+// body is discarded and a 502 (Bad Gateway) is replied later on.
+//--------------------------------------------------------------
+
+OutputStream * ResourceProxy::getBodySink(HttpRequest const & request, size_t limitRequestBody) {
+    HttpHeaderMap const & headers = request.getHeaders();
+    bool transfer = headers.find(HttpHeader::TransferEncoding) != headers.end();
+    long length = transfer ? -1 : string::to_long(request.getHeaderValue(HttpHeader::ContentLength), 10);
+    if (!transfer && length <= 0) {
+        return nullptr;     // no body, the request is sent by transmit()
+    } else if (length > static_cast<long>(limitRequestBody)) {
+        return nullptr;     // rejected by the parser, don't contact the upstream server
+    }
+
+    // The body is decoded by the parser, so its length is unknown
+    // if it was compressed.
+
+    chunked_ = transfer || headers.find(HttpHeader::ContentEncoding) != headers.end();
+    std::string framing = chunked_ ? std::string("Transfer-Encoding: chunked\r\n") : "Content-Length: " + std::to_string(length) + "\r\n";
+
+    headSent_ = true;
+    if (connect(true)) {
+        upstream_.setCorked(true);
+        failed_ = !sendHead(request, framing);
+    } else {
+        failed_ = true;
+    }
+    return &forwarder_;
+}
+
+//--------------------------------------------------------------
+// Forward a piece of the request body to the upstream server.
+// Errors are remembered but not reported, so that the client
+// can finish sending its body and get a proper error page.
+//--------------------------------------------------------------
+
+bool ResourceProxy::forward(void const * data, size_t length) {
+    if (!failed_ && length) {
+        if (chunked_) {
+            char size[32];
+            int len = snprintf(size, sizeof(size), "%zx\r\n", length);
+            failed_ = !upstream_.write(size, static_cast<size_t>(len)) || !upstream_.write(data, length) || !upstream_.write("\r\n", 2);
+        } else {
+            failed_ = !upstream_.write(data, length);
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Terminate the request body.
+//--------------------------------------------------------------
+
+bool ResourceProxy::finish() {
+    if (!failed_ && chunked_) {
+        failed_ = !upstream_.write("0\r\n\r\n", 5);
+    }
+    upstream_.setCorked(false);
+    failed_ = failed_ || !upstream_.flush();
+    return true;
+}
+
+//--------------------------------------------------------------
+// Transmit the response of the upstream server.
+//--------------------------------------------------------------
+
+void ResourceProxy::transmit(HttpResponse & response, HttpRequest const & request) {
+    Configuration const & config = Zinc::getInstance().getConfiguration();
+    std::unique_ptr<HttpRequest> upstream;
+
+    // Send the request, unless it was already sent along with its
+    // body. A pooled connection may have been closed by the upstream
+    // server in the meantime. If it is closed or reset before any
+    // byte of the response, an idempotent request is sent again on
+    // a new connection. (After a timeout or a partial response, the
+    // upstream server may have processed the request.)
+
+    if (headSent_) {
+        if (!failed_) {
+            upstream = receiveHead();
+        }
+    } else {
+        std::string framing = request.getVerb().isOneOf(HttpVerb::Post | HttpVerb::Put) ? "Content-Length: 0\r\n" : "";
+        bool sent = connect(true) && sendHead(request, framing);
+        if (reused_ && request.getVerb().isIdempotent() && (!sent || upstream_.isClosedByPeer(config.getTimeout()))) {
+            sent = connect(false) && sendHead(request, framing);
+        }
+        if (sent) {
+            upstream = receiveHead();
+        }
+    }
+
+    if (!upstream) {
+        LOG_ERROR("No response from upstream server " << proxy_.host);
+        upstream_.close();
+        ResourceErrorPage(502).transmit(response, request);
+        return;
+    }
+
+    // Relay the status and the end-to-end headers. The body is
+    // relayed as encoded by the upstream server, only the chunked
+    // framing is removed, so its length is known unless it was
+    // chunked.
+
+    HttpHeaderMap const & headers = upstream->getHeaders();
+    std::vector<HttpHeader> listed = getConnectionHeaders(headers);
+    bool framed = headers.find(HttpHeader::TransferEncoding) != headers.end() || headers.find(HttpHeader::ContentLength) != headers.end();
+    bool resized = headers.find(HttpHeader::TransferEncoding) != headers.end();
+
+    int status = upstream->getHttpStatus().getStatusCode();
+    bool bodyless = request.getVerb().isOneOf(HttpVerb::Head) || status == 204 || status == 304;
+
+    response.setHttpStatus(upstream->getHttpStatus());
+    for (auto const & p: headers) {
+        if (!isHopByHop(p.first, listed) && !(p.first == HttpHeader::Status) && !(p.first == HttpHeader::ContentLength && resized)) {
+            response.emitHeader(p.first, p.second);
+        }
+    }
+    if (bodyless && headers.find(HttpHeader::ContentLength) == headers.end()) {
+        response.emitHeader(HttpHeader::ContentLength, "0");
+    }
+    response.emitEol();
+
+    // Relay the body, then give the connection back to the pool
+    // if it is in a known state.
+
+    HttpRequest::Result r = HttpRequest::Result::OK();
+    if (!bodyless) {
+        Relay relay(response);
+        r = upstream->parseBody(upstream_, config.getTimeout(), static_cast<size_t>(config.getLimitRequestHeaders()), static_cast<size_t>(LONG_MAX), &relay, false);
+    }
+    response.flush();
+
+    if (r.isOK() && !failed_ && (framed || bodyless) && upstream->shouldKeepAlive()) {
+        getPool().release(proxy_.address, upstream_);
+    } else {
+        upstream_.close();
+    }
+}
+
+//--------------------------------------------------------------
+// Get a connection to the upstream server, either from the pool
+// or a new one.
+//--------------------------------------------------------------
+
+bool ResourceProxy::connect(bool pooled) {
+    upstream_ = pooled ? getPool().acquire(proxy_.address) : StreamSocket();
+    reused_ = static_cast<bool>(upstream_);
+    if (!reused_ && (!upstream_.create() || !upstream_.connect(proxy_.address))) {
+        LOG_ERROR("Unable to connect to upstream server " << proxy_.host);
+        upstream_.close();
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Send the request line and headers to the upstream server. The
+// whole head is gathered first, so that it leaves in one write.
+//--------------------------------------------------------------
+
+bool ResourceProxy::sendHead(HttpRequest const & request, std::string const & framing) {
+    HttpHeaderMap const & headers = request.getHeaders();
+    std::vector<HttpHeader> listed = getConnectionHeaders(headers);
+
+    std::string head = request.getVerb().getVerbName() + " " + target_ + " HTTP/1.1\r\n";
+    head.append("Host: " + proxy_.host + "\r\n");
+
+    for (auto const & p: headers) {
+        if (!isHopByHop(p.first, listed) &&
+            !(p.first == HttpHeader::Host) &&
+            !(p.first == HttpHeader::ContentLength) &&
+            !(p.first == HttpHeader::ContentEncoding) &&
+            !(p.first == HttpHeader::Expect) &&
+            !(p.first == HttpHeader::XForwardedFor) &&
+            !(p.first == HttpHeader::XForwardedHost) &&
+            !(p.first == HttpHeader::XForwardedProto)) {
+            head.append(p.first.getFieldName() + ": " + p.second + "\r\n");
+        }
+    }
+
+    std::string forwarded = request.getHeaderValue(HttpHeader::XForwardedFor);
+    head.append("X-Forwarded-For: " + (forwarded.empty() ? "" : forwarded + ", ") + request.getRemoteAddress().getAddressString() + "\r\n");
+    if (!request.getHeaderValue(HttpHeader::Host).empty()) {
+        head.append("X-Forwarded-Host: " + request.getHeaderValue(HttpHeader::Host) + "\r\n");
+    }
+    head.append(std::string("X-Forwarded-Proto: ") + (request.isSecureHTTP() ? "https" : "http") + "\r\n");
+    head.append(framing);
+    head.append("\r\n");
+
+    LOG_DEBUG_SEND("=> " << request.getVerb() << " " << target_ << " (upstream " << proxy_.host << ")");
+    return upstream_.write(head.data(), head.size()) && upstream_.flush();
+}
+
+//--------------------------------------------------------------
+// Receive the status line and headers from the upstream server,
+// skipping interim (1xx) responses. Return NULL on error.
+//--------------------------------------------------------------
+
+std::unique_ptr<HttpRequest> ResourceProxy::receiveHead() {
+    Configuration const & config = Zinc::getInstance().getConfiguration();
+    for ( ; ; ) {
+        auto upstream = std::make_unique<HttpRequest>();
+        HttpRequest::Result r = upstream->parseHead(upstream_, config.getTimeout(), static_cast<size_t>(config.getLimitRequestLine()), static_cast<size_t>(config.getLimitRequestHeaders()));
+        if (!r.isOK()) {
+            return nullptr;
+        }
+        int status = upstream->getHttpStatus().getStatusCode();
+        if (status < 100 || status >= 200) {
+            return upstream;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+// Return the pool of idle upstream connections.
+//--------------------------------------------------------------
+
+ConnectionPool & ResourceProxy::getPool() {
+    static ConnectionPool pool(idleTimeout, maxIdlePerUpstream);    // Thread-safe as of C++11
+    return pool;
+}
+
+//========================================================================
@@ -0,0 +1,93 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#ifndef __RESOURCE_PROXY_H__
+#define __RESOURCE_PROXY_H__
+
+#include <memory>
+
+#include "../http/resource.h"
+#include "../http/stream_socket.h"
+#include "../http/connection_pool.h"
+#include "configuration.h"
+
+//--------------------------------------------------------------
+// Resource consisting of a request forwarded to an upstream
+// HTTP server.
+//--------------------------------------------------------------
+
+class ResourceProxy : public Resource {
+public:
+    ResourceProxy(Configuration::Proxy const & proxy, URI const & uri);
+    ~ResourceProxy() override;
+
+    void            transmit(HttpResponse & response, HttpRequest const & request) override;
+    OutputStream *  getBodySink(HttpRequest const & request, size_t limitRequestBody) override;
+    bool            acceptsBody() const override                { return true; }
+
+private:
+    Configuration::Proxy const &    proxy_;         // upstream server
+    std::string                     target_;        // request target on the upstream server
+    StreamSocket                    upstream_;      // connection to the upstream server
+    bool                            reused_;        // whether the connection was taken from the pool
+    bool                            headSent_;      // whether the request head was already sent (when the body is streamed)
+    bool                            chunked_;       // whether the request body is sent with chunked encoding
+    bool                            failed_;        // whether forwarding the request body failed
+
+    class Forwarder : public OutputStream {         // stream that forwards the request body to the upstream server
+    public:
+        Forwarder(ResourceProxy & owner) : owner_(owner)                { }
+        bool write(void const * data, size_t length) override           { return owner_.forward(data, length);  }
+        bool flush() override                                           { return owner_.finish();               }
+
+    private:
+        ResourceProxy & owner_;
+    };
+
+    class Relay : public OutputStream {             // stream that relays the response body to the client
+    public:
+        Relay(HttpResponse & response) : response_(response)            { }
+        bool write(void const * data, size_t length) override           { return response_.write(data, length); }
+        bool flush() override                                           { return true;                          }
+
+    private:
+        HttpResponse & response_;
+    };
+
+    Forwarder                       forwarder_;     // stream the request body is written to
+
+    bool                            connect(bool pooled);
+    bool                            sendHead(HttpRequest const & request, std::string const & framing);
+    std::unique_ptr<HttpRequest>    receiveHead();
+    bool                            forward(void const * data, size_t length);
+    bool                            finish();
+
+    static ConnectionPool &         getPool();
+};
+
+//--------------------------------------------------------------
+
+#endif
+
+//========================================================================
@@ -23,16 +23,29 @@
 
 #ifndef _WIN32
 #include <unistd.h>
+#include <fcntl.h>
 #include <poll.h>
+#include <csignal>
+#include <cerrno>
 #include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <spawn.h>
 #endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include <cstring>
+#include <cstdio>
 #include <iostream>
 #include <algorithm>
 
 #include "../misc/portability.h"
 #include "../misc/logger.h"
 #include "../misc/string.h"
+#include "../misc/xxhash.h"
 #include "zinc.h"
+#include "resource_static_file.h"
 #include "resource_script.h"
 
 //========================================================================
@@ -44,19 +57,79 @@
 // URI resolver that must be passed to the script according to CGI/1.1.
 // The object then spawn the interpreter, collect its output and transmit
 // it to the client.
+//
+// On POSIX systems, if the CGI block is configured to do so, the
+// interpreter can be spawned as soon as the request headers are parsed.
+// The request body is then forwarded to its standard input while it is
+// received from the network, so that the processing of the script
+// overlaps with the transfer.
+//
+// If the CGI block has a zygote, the interpreter is not spawned but
+// forked by the zygote, which is already started and warmed up.
+//
+// The CGI block may bound the number of interpreters running at once
+// (extra requests wait for one to terminate, up to the timeout), the
+// running time of the script (the interpreter is then killed along
+// with its process group), and its CPU time and memory size.
+//
+// If the CGI block enables the cache, the output of scripts that allow
+// it (see ResponseCache) is stored and served again to the next GET and
+// HEAD requests for the same URL, without running the script. Identical
+// requests arriving while the script runs wait for its output instead
+// of running it again.
+//
+// If the CGI block allows it, a script can reply with an X-Sendfile
+// header field designating a file instead of sending it itself (e.g.
+// after checking the client is authorized to download it). The file
+// is then sent as a static file, with zero copy and range support.
+//
+// If the CGI block enables it, the output of a GET request is held
+// back, up to a limit, to tag it with a hash of its body. Clients
+// revalidating a response that did not change get a 304 reply
+// without the body (the script still runs).
+//
+// If the server has reactors, the worker thread only spawns the
+// interpreter: its output is then collected by a reactor (see detach),
+// and the worker thread is free to process other requests meanwhile.
 //========================================================================
 
 //--------------------------------------------------------------
 // Constructor.
 //--------------------------------------------------------------
 
-ResourceScript::ResourceScript(fs::filepath const & scriptname, std::string const & scripturi, std::string const & pathinfo, Configuration::CGI const & cgi)
+ResourceScript::ResourceScript(fs::filepath const & scriptname, std::string const & scripturi, std::string const & pathinfo, Configuration::CGI const & cgi, Zygote * zygote)
   : Resource("script " + scriptname.getStdString()),
     scriptname_(scriptname),
     scripturi_(scripturi),
     pathinfo_(pathinfo),
     cgi_(cgi),
-    errors_() {
+    zygote_(zygote),
+    store_(false),
+    ok_(true),
+    sink_(nullptr)
+#ifndef _WIN32
+  , pid_(-1),
+    owned_(true),
+    feeder_(*this),
+    pidfd_(-1),
+    received_(false),
+    syncDue_(std::chrono::steady_clock::time_point::max())
+#endif
+    {
+}
+
+//--------------------------------------------------------------
+// Destructor. If the interpreter was spawned but its output was
+// never collected (for example because receiving the request
+// body failed), kill it.
+//--------------------------------------------------------------
+
+ResourceScript::~ResourceScript() {
+#ifndef _WIN32
+    if (pid_ > 0) {
+        terminate();
+    }
+#endif
 }
 
 //--------------------------------------------------------------
@@ -64,139 +137,570 @@ ResourceScript::ResourceScript(fs::filepath const & scriptname, std::string cons
 //--------------------------------------------------------------
 
 void ResourceScript::transmit(HttpResponse & response, HttpRequest const & request) {
-    std::vector<std::string> args = buildArguments();
-    std::vector<std::string> env = buildEnvironment(request);
+    args_ = buildArguments();
+    if (serveCached(response, request)) {
+        return;
+    }
+    prepare(response, request);
+    ok_ = runScript(*sink_, request.getBody(), args_, buildEnvironment(request, request.getBody().getSize()));
+    complete(response, request);
+}
 
-    response.emitHeader(HttpHeader::ContentType, "text/plain; charset=utf-8");  // default, should be overriden by the script itself
-    response.emitHeader(HttpHeader::LastModified, response.getResponseDate().to_http());
-    response.emitHeader(HttpHeader::Expires, response.getResponseDate().to_http()); // expires immediately
-    response.emitHeader(HttpHeader::CacheControl, "no-cache, no-store, must-revalidate");
-    response.emitHeader(HttpHeader::Pragma, "no-cache");
+//--------------------------------------------------------------
+// Same as transmit, but once the interpreter is spawned, hand its
+// output over to a reactor, which forwards it to the client. The
+// worker thread is then free until the interpreter exits, and
+// complete() finishes the response.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+std::unique_ptr<Reactor::Handler> ResourceScript::detach(HttpResponse & response, HttpRequest const & request) {
+    args_ = buildArguments();
+    if (serveCached(response, request)) {
+        return nullptr;
+    }
+    prepare(response, request);
+    ok_ = pid_ >= 0 || spawn(args_, buildEnvironment(request, request.getBody().getSize()), request.getBody().getFileDescriptor(), Zinc::getInstance().getConfiguration().getTimeout());
+    if (!ok_) {
+        complete(response, request);
+        return nullptr;
+    }
+    startCollect(*sink_);
+    return std::make_unique<Collector>(*this);
+}
+#endif
+
+//--------------------------------------------------------------
+// If the response can be cached and a stored one is still
+// usable, serve it without running the script. If it is
+// stale, we are the one caller elected to refresh it: run the
+// script once the client is served. If there is none, either
+// another request is running the script and we are given its
+// output, or we are elected to run it for everyone. (Scripts
+// may omit the body of HEAD responses, so these are neither
+// stored nor given to other requests.) Return true if the
+// response is served.
+//--------------------------------------------------------------
+
+bool ResourceScript::serveCached(HttpResponse & response, HttpRequest const & request) {
+    ResponseCache & cache = Zinc::getInstance().getResponseCache();
+    bool get = request.getVerb().isOneOf(HttpVerb::Get);
+    key_ = getCacheKey(request);
+    if (key_.empty()) {
+        return false;
+    }
+
+    std::string content;
+    std::chrono::seconds age;
+    ResponseCache::State state = cache.lookup(key_, content, age, get, Zinc::getInstance().getConfiguration().getTimeout());
+    if (state == ResponseCache::State::Lead || state == ResponseCache::State::Revalidate) {
+        lead_ = std::make_unique<ResponseCache::Guard>(cache, key_);
+    }
+    if (state != ResponseCache::State::Hit && state != ResponseCache::State::Revalidate) {
+        return false;
+    }
+
+    LOG_TRACE("Serving " << scriptname_ << " from the response cache");
+    EntityTag etag(&response, request, static_cast<size_t>(cgi_.getETagLimit()));
+    emitDefaultHeaders(response);
+    response.emitHeader(HttpHeader::Age, std::to_string(age.count()));
+    if (get && cgi_.getETagLimit() > 0) {
+        etag.write(content.data(), content.size());
+        etag.finish();
+    } else {
+        response.write(content.data(), content.size());
+    }
+    response.flush();
+    if (state == ResponseCache::State::Revalidate) {
+        Capture capture(nullptr, cache.getEntryLimit());
+        if (runScript(capture, request.getBody(), args_, buildEnvironment(request, 0)) && !capture.isOverflow()) {
+            lead_->store(capture.getContent());
+        }
+        lead_.reset();
+        logErrors(args_[0]);
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Build the chain of streams the script output goes through,
+// depending on the configuration. If the script may designate
+// a file to send instead of its output, the default headers are
+// emitted once we know it did not. If an entity tag is computed,
+// the output is held back until the script is done. If the
+// response can be cached, a copy of the output is kept on the
+// way to the client.
+//--------------------------------------------------------------
+
+void ResourceScript::prepare(HttpResponse & response, HttpRequest const & request) {
+    sink_ = &response;
+    if (cgi_.isXSendFileEnabled()) {
+        xsendfile_ = std::make_unique<XSendFile>(*this, response);
+        sink_ = xsendfile_.get();
+    } else {
+        emitDefaultHeaders(response);
+    }
+
+    bool get = request.getVerb().isOneOf(HttpVerb::Get);
+    if (get && cgi_.getETagLimit() > 0) {
+        etag_ = std::make_unique<EntityTag>(sink_, request, static_cast<size_t>(cgi_.getETagLimit()));
+        sink_ = etag_.get();
+    }
+
+    store_ = !key_.empty() && get;
+    if (store_) {
+        capture_ = std::make_unique<Capture>(sink_, Zinc::getInstance().getResponseCache().getEntryLimit());
+        sink_ = capture_.get();
+    }
+}
 
-    if (!runScript(response, request.getBody(), args, env)) {
+//--------------------------------------------------------------
+// Finish the response once the script is done: release the output
+// held back, send the file the script designated, if any, and
+// store the output in the response cache.
+//--------------------------------------------------------------
+
+void ResourceScript::complete(HttpResponse & response, HttpRequest const & request) {
+    if (etag_) {
+        etag_->finish();
+    }
+    if (xsendfile_) {
+        xsendfile_->finish();
+        if (!xsendfile_->getFilename().empty()) {
+            store_ = false;
+            sendFile(response, request, xsendfile_->getFilename(), xsendfile_->getHeaders());
+        }
+    }
+    if (!ok_) {
         LOG_ERROR("Fork of " << cgi_.getInterpreter() << " failed.");
+        response.emitHeader(HttpHeader::Status, "503 Service Unavailable");
         response.emitEol();
         response.emitPage("Not enough resources to fork interpreter.");
         response.emitEol();
     }
+
+    if (store_ && ok_ && !capture_->isOverflow()) {
+        if (lead_) {
+            lead_->store(capture_->getContent());
+        } else {
+            Zinc::getInstance().getResponseCache().store(key_, capture_->getContent());
+        }
+    }
+    lead_.reset();      // abandons the flight if the output was not stored
     response.flush();
+    logErrors(args_[0]);
+}
+
+//--------------------------------------------------------------
+// Send the file designated by the script with X-Sendfile, as a
+// static file, along with the other header fields the script
+// sent.
+//--------------------------------------------------------------
+
+void ResourceScript::sendFile(HttpResponse & response, HttpRequest const & request, fs::filepath filename, std::string const & headers) {
+    bool allowed = isSendable(filename);
+
+    std::ifstream stream;
+    if (allowed) {
+        stream.open(filename.getStdString(), std::ifstream::in | std::ifstream::binary);
+    }
+    if (!allowed || !stream.good()) {
+        LOG_ERROR("Script " << scriptname_ << " cannot send " << filename);
+        Zinc::getInstance().makeErrorPage(403)->transmit(response, request);
+        return;
+    }
+
+    LOG_TRACE("Script " << scriptname_ << " sends " << filename);
+    ResourceStaticFile(filename, stream, headers).transmit(response, request);
+}
+
+//--------------------------------------------------------------
+// Check that a file designated with X-Sendfile may be sent, and
+// make its path absolute. A relative path is relative to the
+// script directory. The file must be in one of the directories
+// the CGI block allows, once symbolic links and dot segments are
+// resolved.
+//--------------------------------------------------------------
+
+bool ResourceScript::isSendable(fs::filepath & filename) const {
+    if (!filename.isAbsolute()) {
+        filename = scriptname_.getDirectory() + filename;
+    }
+    if (filename.getFileType() != fs::file) {
+        return false;
+    }
+
+    filename = filename.makeAbsolute();
+    std::string const & path = filename.getStdString();
+    for (fs::filepath const & dir: cgi_.getXSendFilePaths()) {
+        std::string const & prefix = dir.getStdString();
+        if (path.size() > prefix.size() && path.compare(0, prefix.size(), prefix) == 0 && (prefix.back() == fs::pathSeparator || path[prefix.size()] == fs::pathSeparator)) {
+            return true;
+        }
+    }
+    return false;
+}
 
+//--------------------------------------------------------------
+// Log the lines the script wrote to its error output, prefixed
+// with the name of their source.
+//--------------------------------------------------------------
+
+void ResourceScript::logErrors(std::string const & source) {
     string::split(errors_, '\n', 0, string::trim_right, [&] (std::string & line) {
-        LOG_ERROR("[" << args[0] << "] " << line);
+        if (!line.empty()) {
+            LOG_ERROR("[" << source << "] " << line);
+        }
         return true;
     });
+    errors_.clear();
 }
 
 //--------------------------------------------------------------
-// Build the argument list to pass to the external interpreter.
+// Construct a stream that keeps a copy of what is written to it,
+// up to the given size, and forwards it to the destination, if
+// any.
 //--------------------------------------------------------------
 
-std::vector<std::string> ResourceScript::buildArguments() const {
-    std::vector<std::string> result;
-
-    // By convention, the first argument must be the application
-    // name. (Path stripped).
-
-    result.push_back(cgi_.getInterpreter().getLastComponent().getStdString());
-
-    // Append extra arguments from the configuration. We have to parse
-    // the string as bash would to build the args array.(Except we
-    // don't handle $variables and filename substitution.)
-
-    auto escape = [] (int ch) {
-        switch (ch) {
-        case 'a':   return '\a';
-        case 'b':   return '\b';
-        case 'e':   return '\x1B';
-        case 'f':   return '\f';
-        case 'n':   return '\n';
-        case 'r':   return '\r';
-        case 't':   return '\t';
-        case 'v':   return '\v';
-        default:    return '\0';
+ResourceScript::Capture::Capture(OutputStream * destination, size_t limit)
+  : limit_(limit),
+    overflow_(false) {
+    setDestination(destination);
+}
+
+//--------------------------------------------------------------
+// Copy and forward data. Past the limit, the copy is dropped.
+//--------------------------------------------------------------
+
+bool ResourceScript::Capture::write(void const * data, size_t length) {
+    if (!overflow_) {
+        if (content_.size() + length > limit_) {
+            overflow_ = true;
+            std::string().swap(content_);
+        } else {
+            content_.append(static_cast<char const *>(data), length);
         }
-    };
+    }
+    return getDestination() ? getDestination()->write(data, length) : true;
+}
 
-    std::string const & extra = cgi_.getCmdLine();
-    std::string buffer;
-    int state = 0;
-
-    size_t count = extra.size();
-    for (size_t i = 0; i < count; i++) {
-        char ch = extra[i], esc;
-        switch (state) {
-        case 0:
-            if (ch == '"') {
-                state = 3;
-            } else if (ch == '\'') {
-                state = 5;
-            } else if (!isspace(ch)) {
-                buffer.push_back(ch);
-                state = 1;
-            }
-            break;
-        case 1:
-            if (ch == '\\') {
-                state = 2;
-            } else if (isspace(ch)) {
-                result.push_back(buffer);
-                buffer.clear();
-                state = 0;
-            } else {
-                buffer.push_back(ch);
-            }
-            break;
-        case 2:
-            if (ch == ' ' || ch == '\'' || ch == '"' || ch == '\\') {
-                buffer.push_back(ch);
-            } else if ((esc = escape(ch)) != 0) {
-                buffer.push_back(esc);
-            } else {
-                buffer.push_back('\\');
-                buffer.push_back(ch);
-            }
-            state = 1;
-            break;
-        case 3:
-            if (ch == '\\') {
-                state = 4;
-            } else if (ch == '"') {
-                result.push_back(buffer);
-                buffer.clear();
-                state = 0;
-            } else {
-                buffer.push_back(ch);
-            }
-            break;
-        case 4:
-            if (ch == '"' || ch == '\\') {
-                buffer.push_back(ch);
-            } else if ((esc = escape(ch)) != 0) {
-                buffer.push_back(esc);
-            } else {
-                buffer.push_back('\\');
-                buffer.push_back(ch);
-            }
-            state = 3;
-            break;
-        case 5:
-            if (ch == '\'') {
-                result.push_back(buffer);
-                buffer.clear();
-                state = 0;
-            } else {
-                buffer.push_back(ch);
-            }
-            break;
+//--------------------------------------------------------------
+// Construct a stream that forwards the interpreter output to the
+// response, unless its header block has an X-Sendfile field.
+//--------------------------------------------------------------
+
+ResourceScript::XSendFile::XSendFile(ResourceScript const & owner, HttpResponse & response)
+  : owner_(owner),
+    response_(response),
+    state_(0) {
+}
+
+//--------------------------------------------------------------
+// Receive the interpreter output. The header block is held back
+// until it is complete. Then if it designates a file, the other
+// fields are kept and the rest of the output is dropped, otherwise
+// the output is forwarded as-is.
+//--------------------------------------------------------------
+
+bool ResourceScript::XSendFile::write(void const * data, size_t length) {
+    if (state_ == 1) {
+        return response_.write(data, length);
+    } else if (state_ == 2) {
+        return true;
+    }
+
+    buffer_.append(static_cast<char const *>(data), length);
+    size_t end = buffer_.find("\n\n");
+    size_t end2 = buffer_.find("\n\r\n");
+    end = std::min(end, end2);
+    if (end == std::string::npos) {
+        if (buffer_.size() > 65536) {
+            forward();      // not a valid header block anyway
         }
+        return true;
+    }
+
+    std::string headers;
+    string::split(buffer_.substr(0, end + 1), '\n', 0, string::trim_right, [&] (std::string & line) {
+        size_t colon = line.find(':');
+        std::string name = line.substr(0, colon);
+        if (string::compare_i(name, "X-Sendfile") && colon != std::string::npos) {
+            filename_ = line.substr(colon + 1);
+            string::trim(filename_, string::trim_both);
+        } else if (!string::compare_i(name, "Status") && !string::compare_i(name, "Content-Length")) {
+            headers.append(line).append("\r\n");
+        }
+        return true;
+    });
+
+    if (filename_.empty()) {
+        forward();
+    } else {
+        headers_ = std::move(headers);
+        buffer_.clear();
+        state_ = 2;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Push the output to the client, once it is forwarded. The header
+// block is held back until it is complete anyway.
+//--------------------------------------------------------------
+
+bool ResourceScript::XSendFile::sync() {
+    return state_ != 1 || response_.sync();
+}
+
+//--------------------------------------------------------------
+// Receive the interpreter output as a pipe. Once the output is
+// forwarded, the response may splice it to the client.
+//--------------------------------------------------------------
+
+long ResourceScript::XSendFile::sendPipe(HANDLE_T pipe, size_t length) {
+    if (state_ == 1) {
+        return response_.sendPipe(pipe, length);
     }
-    if (!buffer.empty()) {
-        result.push_back(buffer);
+    return OutputStream::sendPipe(pipe, length);
+}
+
+//--------------------------------------------------------------
+// Called when the interpreter is done. Forward what is held back
+// if the header block was never completed.
+//--------------------------------------------------------------
+
+void ResourceScript::XSendFile::finish() {
+    if (state_ == 0) {
+        forward();
+    }
+}
+
+//--------------------------------------------------------------
+// Emit the default headers and what was held back, and forward
+// the rest of the output.
+//--------------------------------------------------------------
+
+void ResourceScript::XSendFile::forward() {
+    owner_.emitDefaultHeaders(response_);
+    response_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+    state_ = 1;
+}
+
+//--------------------------------------------------------------
+// Construct a stream that holds the interpreter output back, up to
+// the given size, to compute an entity tag.
+//--------------------------------------------------------------
+
+ResourceScript::EntityTag::EntityTag(OutputStream * destination, HttpRequest const & request, size_t limit)
+  : request_(request),
+    limit_(limit),
+    overflow_(false) {
+    setDestination(destination);
+}
+
+//--------------------------------------------------------------
+// Receive the interpreter output. Past the limit, what is held
+// back is forwarded, then the rest of the output as well.
+//--------------------------------------------------------------
+
+bool ResourceScript::EntityTag::write(void const * data, size_t length) {
+    if (overflow_) {
+        return getDestination()->write(data, length);
+    }
+    buffer_.append(static_cast<char const *>(data), length);
+    if (buffer_.size() > limit_) {
+        overflow_ = true;
+        bool ok = getDestination()->write(buffer_.data(), buffer_.size());
+        std::string().swap(buffer_);
+        return ok;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// Push the output to the client, once it is forwarded. What is
+// held back must stay so until the tag is computed.
+//--------------------------------------------------------------
+
+bool ResourceScript::EntityTag::sync() {
+    return !overflow_ || getDestination()->sync();
+}
+
+//--------------------------------------------------------------
+// Receive the interpreter output as a pipe. Once the output is
+// forwarded, the destination may splice it to the client.
+//--------------------------------------------------------------
+
+long ResourceScript::EntityTag::sendPipe(HANDLE_T pipe, size_t length) {
+    if (overflow_) {
+        return getDestination()->sendPipe(pipe, length);
+    }
+    return OutputStream::sendPipe(pipe, length);
+}
+
+//--------------------------------------------------------------
+// Called when the interpreter is done. If the whole output was
+// held back and is a successful response, tag it with a hash of
+// its body (unless the script did it itself). The tag is weak,
+// since the response may still be compressed on its way to the
+// client, and it must stay valid whatever coding is applied to
+// the body. If the client already has this version, reply 304
+// without the body, otherwise send the output with the tag,
+// asking the client to revalidate it each time. Other outputs
+// are forwarded as-is.
+//--------------------------------------------------------------
+
+void ResourceScript::EntityTag::finish() {
+    if (overflow_) {
+        return;
+    }
+
+    size_t end = std::min(buffer_.find("\n\n"), buffer_.find("\n\r\n"));
+    if (end == std::string::npos) {
+        getDestination()->write(buffer_.data(), buffer_.size());
+        return;
+    }
+    size_t body = buffer_[end + 1] == '\r' ? end + 3 : end + 2;
+
+    bool tagged = true;
+    std::string tag, type, headers;
+    string::split(buffer_.substr(0, end + 1), '\n', 0, string::trim_right, [&] (std::string & line) {
+        size_t colon = line.find(':');
+        std::string name = line.substr(0, colon);
+        std::string value = colon != std::string::npos ? line.substr(colon + 1) : std::string();
+        string::trim(value, string::trim_both);
+        if (string::compare_i(name, "Status")) {
+            tagged = tagged && value.compare(0, 3, "200") == 0;
+        } else if (string::compare_i(name, "X-Sendfile")) {
+            tagged = false;
+        } else if (string::compare_i(name, "ETag")) {
+            tag = value;
+        } else if (string::compare_i(name, "Content-Type")) {
+            type = value;
+        }
+        if (!string::compare_i(name, "Status") && !string::compare_i(name, "Content-Length")) {
+            headers.append(line).append("\r\n");
+        }
+        return true;
+    });
+    if (!tagged) {
+        getDestination()->write(buffer_.data(), buffer_.size());
+        return;
+    }
+
+    std::string prefix = "Cache-Control: no-cache\r\n";
+    if (tag.empty()) {
+        digest::xxh64 hash;
+        hash.update(type.data(), type.size());
+        hash.update("\n", 1);
+        hash.update(buffer_.data() + body, buffer_.size() - body);
+        char text[26];
+        snprintf(text, sizeof(text), "W/\"%016llx\"", static_cast<unsigned long long>(hash.finalize()));
+        tag = text;
+        prefix = "ETag: " + tag + "\r\n" + prefix;
+    }
+
+    bool match = false;
+    string::split(request_.getHeaderValue(HttpHeader::IfNoneMatch), ',', 0, string::trim_both, [&] (std::string & value) {
+        if (value.compare(0, 2, "W/") == 0) {
+            value.erase(0, 2);      // If-None-Match uses the weak comparison
+        }
+        match = value == "*" || value == tag || "W/" + value == tag;
+        return !match;
+    });
+
+    if (match) {
+        prefix = "Status: 304 Not Modified\r\n" + prefix + headers + "\r\n";
+        getDestination()->write(prefix.data(), prefix.size());
+    } else {
+        getDestination()->write(prefix.data(), prefix.size());
+        getDestination()->write(buffer_.data(), buffer_.size());
+    }
+}
+
+//--------------------------------------------------------------
+// Emit the headers every script response starts with. The script
+// output comes next and may override them.
+//--------------------------------------------------------------
+
+void ResourceScript::emitDefaultHeaders(HttpResponse & response) const {
+    response.emitHeader(HttpHeader::ContentType, "text/plain; charset=utf-8");  // default, should be overriden by the script itself
+    response.emitHeader(HttpHeader::LastModified, response.getResponseDate().to_http());
+    response.emitHeader(HttpHeader::Expires, response.getResponseDate().to_http()); // expires immediately
+    response.emitHeader(HttpHeader::CacheControl, "no-cache, no-store, must-revalidate");
+    response.emitHeader(HttpHeader::Pragma, "no-cache");
+}
+
+//--------------------------------------------------------------
+// If the CGI block is configured to stream request bodies, spawn
+// the interpreter now and return a stream that forwards the body
+// to its standard input. This requires the length of the body to
+// be known in advance, since it must be passed to the script in
+// the CONTENT_LENGTH variable, and to fit in the limit, so that
+// no interpreter is forked for a request rejected with 413.
+//--------------------------------------------------------------
+
+OutputStream * ResourceScript::getBodySink(HttpRequest const & request, size_t limitRequestBody) {
+#ifndef _WIN32
+    long length = string::to_long(request.getHeaderValue(HttpHeader::ContentLength), 10);
+    if (cgi_.isBodyStreamed() && length > 0 && length <= static_cast<long>(limitRequestBody) && request.getHeaderValue(HttpHeader::TransferEncoding).empty() && request.getHeaderValue(HttpHeader::ContentEncoding).empty()) {
+        if (!pin_.create() || !spawn(buildArguments(), buildEnvironment(request, static_cast<size_t>(length)), pin_.get(Pipe::Reading), std::chrono::milliseconds(0))) {
+            LOG_ERROR("Fork of " << cgi_.getInterpreter() << " failed.");
+            pin_.close(Pipe::Reading);
+            pin_.close(Pipe::Writing);
+            return nullptr;     // fall back to storing the body
+        }
+        pin_.close(Pipe::Reading);
+        fcntl(pin_.get(Pipe::Writing), F_SETFL, O_NONBLOCK);
+        return &feeder_;
+    }
+#endif
+    return nullptr;
+}
+
+//--------------------------------------------------------------
+// Return the key identifying the response in the response cache,
+// or an empty string if the response must not be cached. Only
+// GET and HEAD requests without body are cached, and only if
+// they do not carry credentials the script could depend on,
+// unless the configuration says the response varies with them.
+//--------------------------------------------------------------
+
+std::string ResourceScript::getCacheKey(HttpRequest const & request) const {
+    if (!cgi_.isCached() || !request.getVerb().isOneOf(HttpVerb::Get | HttpVerb::Head) || request.getBody().getSize() != 0) {
+        return std::string();
+    }
+    if (!request.getHeaderValue(HttpHeader::Authorization).empty()) {
+        return std::string();
+    }
+
+    bool cookie = false;
+    std::string key = request.getHeaderValue(HttpHeader::Host) + request.getURI().getRequestURI(false);
+    string::split(cgi_.getCacheVary(), ' ', 0, string::trim_both, [&] (std::string & name) {
+        HttpHeader hdr(name);
+        cookie = cookie || hdr == HttpHeader::Cookie;
+        key.append("\n").append(request.getHeaderValue(hdr));
+        return true;
+    });
+
+    if (!cookie && !request.getHeaderValue(HttpHeader::Cookie).empty()) {
+        return std::string();
     }
+    return key;
+}
+
+//--------------------------------------------------------------
+// Build the argument list to pass to the external interpreter.
+//--------------------------------------------------------------
+
+std::vector<std::string> ResourceScript::buildArguments() const {
 
-    // The last argument must be the filename containing the script
-    // to run.
+    // The application name and the extra arguments from the
+    // configuration are parsed once for all. The last argument
+    // must be the filename containing the script to run.
 
+    std::vector<std::string> result = cgi_.getArguments();
     result.push_back(scriptname_.getStdString());
     return result;
 }
@@ -206,13 +710,12 @@ std::vector<std::string> ResourceScript::buildArguments() const {
 // external interpreter.
 //--------------------------------------------------------------
 
-std::vector<std::string> ResourceScript::buildEnvironment(HttpRequest const & request) const {
-    std::vector<std::string> result;
+std::vector<std::string> ResourceScript::buildEnvironment(HttpRequest const & request, size_t length) const {
 
-    // Helper function to append a key=value entry to the 
+    // Helper function to append a key=value entry to a
     // list of environment variables.
 
-    auto add = [&result] (char const * varname, bool force, std::string const & value) {
+    auto append = [] (std::vector<std::string> & result, char const * varname, bool force, std::string const & value) {
         if (force || !value.empty()) {
             std::string env;
             env.append(varname);
@@ -222,22 +725,48 @@ std::vector<std::string> ResourceScript::buildEnvironment(HttpRequest const & re
         }
     };
 
+    // Start with the variables that do not depend on the request.
+    // They are built once for each CGI block.
+
+    fs::filepath root = fs::getCurrentDirectory();
+    std::vector<std::string> result = cgi_.getEnvironment([&] () {
+        std::vector<std::string> constant;
+        Configuration const & configuration = Zinc::getInstance().getConfiguration();
+        append(constant, "DOCUMENT_ROOT",       true,   root.getStdString());
+        append(constant, "GATEWAY_INTERFACE",   true,   "CGI/1.1");
+        append(constant, "SERVER_ADMIN",        false,  configuration.getServerAdmin());
+        append(constant, "SERVER_NAME",         false,  configuration.getServerName());
+        append(constant, "SERVER_PROTOCOL",     true,   "HTTP/1.1");
+        append(constant, "SERVER_SOFTWARE",     true,   Zinc::getInstance().getVersionString());
+        if (string::compare_i(cgi_.getSectionName(), "PHP")) {
+            append(constant, "REDIRECT_STATUS", true,   "204");
+        }
+        return constant;
+    });
+
+    auto add = [&append, &result] (char const * varname, bool force, std::string const & value) {
+        append(result, varname, force, value);
+    };
+
+    // Reverse DNS lookups may be disabled, or not waited for. In
+    // both cases the address stands for the name (as CGI/1.1
+    // allows) until the name is known.
+
+    auto remoteHost = [] (AddrIPv4 const & addr) {
+        std::string const & lookups = Zinc::getInstance().getConfiguration().getHostnameLookups();
+        return lookups == "no" ? addr.getAddressString() : addr.getNameInfo(lookups == "yes");
+    };
+
     // If the request contains a body, add variables to indicate
-    // it size and mime type.
+    // its size and mime type.
 
-    size_t size = request.getBody().getSize();
-    if (size > 0) {
-        add("CONTENT_LENGTH",   true,   std::to_string(size));
+    if (length > 0) {
+        add("CONTENT_LENGTH",   true,   std::to_string(length));
         add("CONTENT_TYPE",     false,  request.getHeaderValue(HttpHeader::ContentType));
     }
 
-    // Add all the standard CGI variables.
-
-    Configuration const & configuration = Zinc::getInstance().getConfiguration();
-    fs::filepath root = fs::getCurrentDirectory();
+    // Add the standard CGI variables that depend on the request.
 
-    add("DOCUMENT_ROOT",        true,   root.getStdString());
-    add("GATEWAY_INTERFACE",    true,   "CGI/1.1");
     add("HTTP_ACCEPT",          false,  request.getHeaderValue(HttpHeader::Accept));
     add("HTTP_ACCEPT_CHARSET",  false,  request.getHeaderValue(HttpHeader::AcceptCharset));
     add("HTTP_ACCEPT_ENCODING", false,  request.getHeaderValue(HttpHeader::AcceptEncoding));
@@ -251,18 +780,14 @@ std::vector<std::string> ResourceScript::buildEnvironment(HttpRequest const & re
     add("PATH_INFO",            true,   pathinfo_);
     add("QUERY_STRING",         true,   request.getURI().getQuery());
     add("REMOTE_ADDR",          true,   request.getRemoteAddress().getAddressString());
-    add("REMOTE_HOST",          true,   request.getRemoteAddress().getNameInfo());
+    add("REMOTE_HOST",          true,   remoteHost(request.getRemoteAddress()));
     add("REMOTE_PORT",          true,   request.getRemoteAddress().getPortString());
     add("REQUEST_METHOD",       true,   request.getVerb().getVerbName());
     add("REQUEST_URI",          true,   request.getURI().getRequestURI(false));
     add("SCRIPT_FILENAME",      true,   scriptname_.makeAbsolute().getStdString());
     add("SCRIPT_NAME",          true,   scripturi_);
     add("SERVER_ADDR",          true,   request.getLocalAddress().getAddressString());
-    add("SERVER_ADMIN",         false,  configuration.getServerAdmin());
-    add("SERVER_NAME",          false,  configuration.getServerName());
     add("SERVER_PORT",          false,  request.getLocalAddress().getPortString());
-    add("SERVER_PROTOCOL",      true,   "HTTP/1.1");
-    add("SERVER_SOFTWARE",      true,   Zinc::getInstance().getVersionString());
 
     size_t sep = scripturi_.rfind('/');
     std::string tmp = (sep != std::string::npos) ? scripturi_.substr(0, sep) : scripturi_;
@@ -273,7 +798,6 @@ std::vector<std::string> ResourceScript::buildEnvironment(HttpRequest const & re
 
     if (string::compare_i(cgi_.getSectionName(), "PHP")) {
         add("PHP_SELF",         true,   scripturi_);
-        add("REDIRECT_STATUS",  true,   "204");
     }
 
     return result;
@@ -284,7 +808,7 @@ std::vector<std::string> ResourceScript::buildEnvironment(HttpRequest const & re
 // variables, and redirecting its standard input/output.
 //--------------------------------------------------------------
 
-bool ResourceScript::runScript(HttpResponse & response, blob const & body, std::vector<std::string> const & args, std::vector<std::string> const & env) {
+bool ResourceScript::runScript(OutputStream & output, blob const & body, std::vector<std::string> const & args, std::vector<std::string> const & env) {
 #ifdef _WIN32
 
     // Convert arguments and environnment block to a
@@ -349,7 +873,7 @@ bool ResourceScript::runScript(HttpResponse & response, blob const & body, std::
         char buffer[1024];
         if (PeekNamedPipe(pout.get(Pipe::Reading), nullptr, 0, nullptr, &avail, nullptr)) {
             ReadFile(pout.get(Pipe::Reading), buffer, std::min(static_cast<size_t>(avail), sizeof(buffer)), &read, nullptr);
-            response.write(buffer, read);
+            output.write(buffer, read);
         } else {
             eof |= 0x01;
         }
@@ -364,117 +888,718 @@ bool ResourceScript::runScript(HttpResponse & response, blob const & body, std::
 
 #else
 
+    if (pid_ < 0 && !spawn(args, env, body.getFileDescriptor(), Zinc::getInstance().getConfiguration().getTimeout())) {
+        return false;
+    }
+    collect(output);
+
+#endif
+    return true;
+}
+
+//--------------------------------------------------------------
+// Spawn the external interpreter, passing arguments and environment
+// variables, and redirecting its standard input to the given
+// descriptor, and its standard and error outputs to our pipes.
+// If the maximum number of interpreters are running, wait at most
+// the given time for one to terminate.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+
+bool ResourceScript::spawn(std::vector<std::string> const & args, std::vector<std::string> const & env, HANDLE_T input, std::chrono::milliseconds wait) {
+    if (!cgi_.acquireProcess(wait)) {
+        LOG_ERROR("Too many " << cgi_.getSectionName() << " interpreters running");
+        return false;
+    }
+
     // Convert arguments and environnment block to a
-    // format suitable for execve.
+    // format suitable for posix_spawn.
 
     std::vector<char const *> buffer;
     for (std::string const & s: args) {
-        LOG_TRACE("execve arg: " << s);
+        LOG_TRACE("spawn arg: " << s);
         buffer.push_back(s.c_str());
     }
     buffer.push_back(nullptr);
     size_t nenv = buffer.size();
     for (std::string const & s: env) {
-        LOG_TRACE("execve env: " << s);
+        LOG_TRACE("spawn env: " << s);
         buffer.push_back(s.c_str());
     }
     buffer.push_back(nullptr);
 
     // Create pipes to redirect the interpreter standard and
-    // error outputs, then fork.
+    // error outputs. All our descriptors are close-on-exec, so
+    // the interpreter only inherits the ones duplicated below.
 
-    Pipe pout, perr;
-    if (!pout.create() || !perr.create()) {
+    if (!pout_.create() || !perr_.create()) {
         LOG_ERROR("Error creating communication pipes");
+        cgi_.releaseProcess();
         return false;
     }
 
-    pid_t pid = fork();
-    if (pid == -1) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pout_.get(Pipe::Writing), STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, perr_.get(Pipe::Writing), STDERR_FILENO);
+
+    // If the request has a body, redirect the standard input to
+    // the file containing the body content, or to the pipe the
+    // body is streamed to. (The file offset is shared with the
+    // child, so rewinding here is enough.)
+
+    if (IS_HANDLE_VALID(input)) {
+        lseek(input, 0, SEEK_SET);
+        posix_spawn_file_actions_adddup2(&actions, input, STDIN_FILENO);
+    }
+
+    // Have the zygote fork the interpreter, if there is one. If it
+    // fails, spawn the interpreter as usual. Unlike fork, posix_spawn
+    // does not duplicate the address space of the server (glibc uses
+    // vfork semantics), so its cost does not grow with the memory
+    // footprint of the server. The interpreter gets its own process
+    // group, so that it can be killed along with its children.
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    pid_t pid;
+    int err = 0;
+    if (zygote_ && zygote_->fork(args, env, input, pout_.get(Pipe::Writing), perr_.get(Pipe::Writing), pid)) {
+        owned_ = false;
+    } else {
+        char const ** ptr = buffer.data();
+        err = posix_spawn(&pid, cgi_.getInterpreter().getCString(), &actions, &attr, const_cast<char **>(ptr), const_cast<char **>(ptr + nenv));
+    }
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err != 0) {
+        LOG_ERROR("Unable to execute interpreter " << cgi_.getInterpreter() << ": " << strerror(err));
+        pout_.close(Pipe::Reading);
+        pout_.close(Pipe::Writing);
+        perr_.close(Pipe::Reading);
+        perr_.close(Pipe::Writing);
+        cgi_.releaseProcess();
         return false;
     }
 
-    if (pid == 0) {
+    // Apply the resource limits. (posix_spawn cannot do it in the
+    // child, so the interpreter may run a few instructions before.)
 
-        // We are in the child process. Redirect the standard and error
-        // output to our pipes, and close unused descriptors.
+#ifdef __linux__
+    if (cgi_.getCPULimit() > 0) {
+        struct rlimit rl;
+        rl.rlim_cur = static_cast<rlim_t>(cgi_.getCPULimit());
+        rl.rlim_max = rl.rlim_cur + 1;      // SIGXCPU first, then SIGKILL
+        prlimit(pid, RLIMIT_CPU, &rl, nullptr);
+    }
+    if (cgi_.getMemoryLimit() > 0) {
+        struct rlimit rl;
+        rl.rlim_cur = rl.rlim_max = static_cast<rlim_t>(cgi_.getMemoryLimit()) * 1024 * 1024;
+        prlimit(pid, RLIMIT_AS, &rl, nullptr);
+    }
+#endif
 
-        dup2(pout.get(Pipe::Writing), STDOUT_FILENO);
-        dup2(perr.get(Pipe::Writing), STDERR_FILENO);
-        pout.close(Pipe::Reading);
-        pout.close(Pipe::Writing);
-        perr.close(Pipe::Reading);
-        perr.close(Pipe::Writing);
+    // We are in the parent process. Close the unused end of our
+    // pipes.
 
-        // If the request has a body, redirect the standard input to
-        // the file containing the body content.
+    pid_ = pid;
+    started_ = std::chrono::steady_clock::now();
+    pout_.close(Pipe::Writing);
+    perr_.close(Pipe::Writing);
+    return true;
+}
 
-        if (body.getSize()) {
-            dup2(body.getFileDescriptor(), STDIN_FILENO);
-            lseek(STDIN_FILENO, 0, SEEK_SET);
-        }
+//--------------------------------------------------------------
+// Kill the interpreter along with its process group, and release
+// its slot. A child forked by a zygote is reaped by the zygote as
+// soon as it exits, so its process ID may already belong to an
+// unrelated process: only its process group is signaled. (The
+// group outlives the child as long as the processes it started
+// run.) Our own children cannot be reaped behind our back, so
+// they can be signaled directly.
+//--------------------------------------------------------------
 
-        // Execute the interpreter. If the call is successful, this
-        // call never returns.
+void ResourceScript::terminate() {
+    if (kill(-pid_, SIGKILL) != 0 && owned_) {
+        kill(pid_, SIGKILL);
+    }
+    release();
+}
 
-        char const ** ptr = buffer.data();
-        execve(cgi_.getInterpreter().getCString(), const_cast<char **>(ptr), const_cast<char **>(ptr + nenv));
+//--------------------------------------------------------------
+// Wait for the interpreter to terminate, and release its slot.
+// (Children forked by a zygote are not ours, the zygote reaps
+// them.)
+//--------------------------------------------------------------
 
-        // In case executing the interpreter fails, print an error
-        // message and exit immediately.
+void ResourceScript::release() {
+    if (pidfd_ >= 0) {
+        ::close(pidfd_);
+        pidfd_ = -1;
+    }
+    if (owned_) {
+        waitpid(pid_, nullptr, 0);
+    }
+    cgi_.releaseProcess();
+    pid_ = -1;
+}
 
-        std::cerr << "Unable to execute interpreter " << cgi_.getInterpreter() << std::endl;
-        _exit(EXIT_FAILURE);    // no destructor callings
+//--------------------------------------------------------------
+// Forward a piece of the request body to the interpreter standard
+// input. Since the interpreter may produce output before it has
+// consumed all its input, its standard and error outputs are
+// drained meanwhile, otherwise both processes could block. If the
+// interpreter stops reading its input, remaining data are silently
+// discarded: the request body must be received anyway.
+//--------------------------------------------------------------
 
-    } else {
+bool ResourceScript::feed(void const * data, size_t length) {
+    auto drain = [] (Pipe & pipe, std::string & store) {
+        char buffer[4096];
+        ssize_t count = read(pipe.get(Pipe::Reading), buffer, sizeof(buffer));
+        if (count > 0) {
+            store.append(buffer, static_cast<size_t>(count));
+        } else if (count == 0 || errno != EINTR) {
+            pipe.close(Pipe::Reading);
+        }
+    };
 
-        // We are in the parent process. Close the unused end of our
-        // pipes and loop to forward the standard output of the interpreter
-        // to the client, and the error output to a local buffer.
+    int timeout = static_cast<int>(std::chrono::milliseconds(Zinc::getInstance().getConfiguration().getTimeout()).count());
+    char const * p = static_cast<char const *>(data);
+    while (length && IS_HANDLE_VALID(pin_.get(Pipe::Writing))) {
+        struct pollfd pf[3];
+        pf[0].fd = pin_.get(Pipe::Writing);
+        pf[1].fd = pout_.get(Pipe::Reading);
+        pf[2].fd = perr_.get(Pipe::Reading);
+        pf[0].events = POLLOUT;
+        pf[1].events = pf[2].events = POLLIN;
+
+        int r = poll(pf, 3, timeout);
+        if (r > 0) {
+            if (pf[1].revents & (POLLIN | POLLHUP)) {
+                drain(pout_, output_);
+            }
+            if (pf[2].revents & (POLLIN | POLLHUP)) {
+                drain(perr_, errors_);
+            }
+            if (pf[0].revents & (POLLOUT | POLLERR | POLLHUP)) {
+                ssize_t count = ::write(pin_.get(Pipe::Writing), p, length);
+                if (count > 0) {
+                    p += count;
+                    length -= static_cast<size_t>(count);
+                } else if (count < 0 && errno != EAGAIN && errno != EINTR) {
+                    LOG_TRACE("Interpreter closed its standard input");
+                    pin_.close(Pipe::Writing);
+                }
+            }
+        } else if (r == 0 || errno != EINTR) {
+            LOG_ERROR("Interpreter is not reading the request body");
+            pin_.close(Pipe::Writing);
+        }
+    }
+    return true;
+}
 
-        pout.close(Pipe::Writing);
-        perr.close(Pipe::Writing);
+//--------------------------------------------------------------
+// Signal the end of the input to the interpreter, then forward its
+// standard output to the client, and its error output to a local
+// buffer, until it terminates. This function waits for the
+// interpreter; a reactor does the same without blocking, with
+// startCollect, then prepareCollect and processCollect.
+//--------------------------------------------------------------
 
-        struct pollfd pf[2];
-        pf[0].fd = pout.get(Pipe::Reading);
-        pf[1].fd = perr.get(Pipe::Reading);
-        char buffer[1024];
+void ResourceScript::collect(OutputStream & output) {
+    startCollect(output);
+    std::vector<struct pollfd> fds;
+    for ( ; ; ) {
+        fds.clear();
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        prepareCollect(fds, deadline);
+
+        int timeout = -1;
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            timeout = static_cast<int>(std::max<long long>(0, remaining.count() + 1));
+        }
 
-        for (int eof = 0; eof != 0x03; ) {
-            pf[0].events = pf[1].events = POLLIN;
-            int r = poll(pf, 2, 5000);
-            if (r > 0) {
-                if (pf[0].revents & (POLLIN | POLLHUP)) {
-                    int count = read(pout.get(Pipe::Reading), buffer, sizeof(buffer));
-                    if (count > 0) {
-                        response.write(buffer, count);
-                    } else {
-                        eof |= 0x01;
-                    }
-                }
-                if (pf[1].revents & (POLLIN | POLLHUP)) {
-                    int count = read(perr.get(Pipe::Reading), buffer, sizeof(buffer));
-                    if (count > 0) {
-                        errors_.append(buffer, count);
-                    } else {
-                        eof |= 0x02;
-                    }
-                }
-            } else if (r < 0) {
-                LOG_ERROR("internal error: poll() failed");
-                break;
+        int r = poll(fds.data(), static_cast<nfds_t>(fds.size()), timeout);
+        if (r < 0 && errno != EINTR) {
+            LOG_ERROR("internal error: poll() failed");
+            release();
+            return;
+        }
+        if (r < 0) {
+            for (struct pollfd & pf: fds) {
+                pf.revents = 0;
             }
         }
+        if (!processCollect(output, fds.data())) {
+            return;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+// Start collecting the interpreter output: close its standard
+// input and forward what it sent while the request body was
+// being streamed.
+//--------------------------------------------------------------
+
+void ResourceScript::startCollect(OutputStream & output) {
+    pin_.close(Pipe::Writing);
+    received_ = !output_.empty();
+    syncDue_ = std::chrono::steady_clock::time_point::max();
+    if (!output_.empty()) {
+        output.write(output_.data(), output_.size());
+        output_.clear();
+        syncDue_ = std::chrono::steady_clock::now() + cgi_.getFlushDelay();
+    }
+}
 
-        // Wait for the child process to terminate.
+//--------------------------------------------------------------
+// Append the descriptors to wait for: the standard and error
+// outputs of the interpreter, and its process descriptor once
+// both are closed. The deadline is the moment the output written
+// so far must be pushed to the client, or the script time limit.
+//--------------------------------------------------------------
 
-        waitpid(pid, nullptr, 0);
+void ResourceScript::prepareCollect(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline) {
+    fds.push_back({ pout_.get(Pipe::Reading), POLLIN, 0 });
+    fds.push_back({ perr_.get(Pipe::Reading), POLLIN, 0 });
+    fds.push_back({ pidfd_, POLLIN, 0 });
+    deadline = std::min(deadline, syncDue_);
+    if (cgi_.getTimeLimit().count() > 0) {
+        deadline = std::min(deadline, started_ + std::chrono::steady_clock::duration(cgi_.getTimeLimit()));
     }
+}
 
+//--------------------------------------------------------------
+// Process the descriptors prepareCollect appended, once poll()
+// returned. The standard output is handed to the output stream as
+// a pipe: once the headers are parsed, and if the body needs no
+// encoding, it is spliced to the client socket without being
+// copied. If the output cannot be sent (e.g. the client is gone),
+// the script is killed rather than drained into a dead stream.
+// If the script exceeds its time limit, it is killed too, and if
+// it has not sent anything yet, the client gets a 504 error.
+//
+// What is written may stay in the buffers of the chunked encoder
+// or the compressor. Such output is pushed to the client at the
+// latest FlushDelay after it was received, so that a script that
+// streams its output (progress, events) is not held back until
+// it has produced a full chunk, while a script writing in quick
+// succession still gets full chunks and good compression.
+//
+// Once both outputs are closed, the interpreter is reaped. If it
+// is still running (e.g. a daemon it started keeps running), wait
+// for it to exit on its process descriptor (pidfd) rather than
+// block the thread, if the system has them. Return false when
+// the interpreter is done.
+//--------------------------------------------------------------
+
+bool ResourceScript::processCollect(OutputStream & output, struct pollfd const * fds) {
+    std::chrono::seconds limit = cgi_.getTimeLimit();
+    if (limit.count() > 0 && std::chrono::steady_clock::now() >= started_ + limit) {
+        LOG_ERROR("Script " << scriptname_ << " exceeded its time limit, killing it");
+        if (!received_) {
+            output.emitPage("Status: 504 Gateway Timeout\r\n\r\nThe script took too long to run.\r\n");
+        }
+        terminate();
+        return false;
+    }
+
+    char buffer[16384];
+    if (fds[0].revents & (POLLIN | POLLHUP)) {
+        received_ = true;
+        long count = output.sendPipe(pout_.get(Pipe::Reading), 65536);
+        if (count < 0) {
+            LOG_TRACE("Output of script " << scriptname_ << " cannot be sent, killing it");
+            terminate();
+            return false;
+        }
+        if (count == 0) {
+            pout_.close(Pipe::Reading);
+            syncDue_ = std::chrono::steady_clock::time_point::max();     // the response ends with a flush anyway
+        } else if (syncDue_ == std::chrono::steady_clock::time_point::max()) {
+            syncDue_ = std::chrono::steady_clock::now() + cgi_.getFlushDelay();
+        }
+    }
+    if (fds[1].revents & (POLLIN | POLLHUP)) {
+        ssize_t count = read(perr_.get(Pipe::Reading), buffer, sizeof(buffer));
+        if (count > 0) {
+            errors_.append(buffer, static_cast<size_t>(count));
+        } else {
+            perr_.close(Pipe::Reading);
+        }
+    }
+    if (std::chrono::steady_clock::now() >= syncDue_) {
+        output.sync();
+        syncDue_ = std::chrono::steady_clock::time_point::max();
+    }
+    if (IS_HANDLE_VALID(pout_.get(Pipe::Reading)) || IS_HANDLE_VALID(perr_.get(Pipe::Reading))) {
+        return true;
+    }
+
+    if (owned_ && waitpid(pid_, nullptr, WNOHANG) == pid_) {
+        owned_ = false;         // reaped already
+    }
+#ifdef SYS_pidfd_open
+    if (owned_ && pidfd_ < 0) {
+        pidfd_ = static_cast<int>(syscall(SYS_pidfd_open, pid_, 0));
+    }
+    if (owned_ && pidfd_ >= 0) {
+        return true;
+    }
 #endif
+    release();
+    return false;
+}
+
+//--------------------------------------------------------------
+// Destructor. If the handler is destroyed before the interpreter
+// is done (e.g. the client is gone, or the server is shutting
+// down), kill it. Its output is incomplete, so it is not stored.
+//--------------------------------------------------------------
+
+ResourceScript::Collector::~Collector() {
+    if (owner_.pid_ > 0) {
+        owner_.terminate();
+        owner_.store_ = false;
+    }
+}
+
+//--------------------------------------------------------------
+// Wait for the interpreter output.
+//--------------------------------------------------------------
+
+void ResourceScript::Collector::prepare(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline) {
+    owner_.prepareCollect(fds, deadline);
+}
+
+//--------------------------------------------------------------
+// Forward the interpreter output to the client. Return false
+// when the interpreter is done.
+//--------------------------------------------------------------
+
+bool ResourceScript::Collector::process(struct pollfd const * fds) {
+    return owner_.processCollect(*owner_.sink_, fds);
+}
+
+#endif
+
+//========================================================================
+// Zygote
+//
+// Interpreter started once for a CGI block, which forks a child to run
+// each script. The interpreter startup (loading the runtime, importing
+// modules, etc.) and the warm-up script configured in the CGI block are
+// therefore not paid for each request anymore.
+//
+// The zygote runs a small driver, passed on the command line, connected
+// to the server by a Unix socket. For each script, the server sends the
+// arguments and environment variables in a message, and the standard
+// output, error output and optionally standard input descriptors as
+// ancillary data (SCM_RIGHTS). The zygote forks, the child sets its
+// descriptors and environment and runs the script as a CGI interpreter
+// would, and the zygote replies with the child process ID. From then
+// on, the child is handled as a regular interpreter.
+//
+// Only a driver for Python is available. (PHP cannot fork without
+// optional extensions, use FastCGI instead.)
+//========================================================================
+
+#ifndef _WIN32
+extern char ** environ;
+
+namespace {
+
+    // Driver run by the Python interpreter. The message is the list of
+    // arguments and the list of environment variables, each string
+    // terminated by a null character and both lists separated by an
+    // empty string. The last argument is the script to run. Both the
+    // zygote and the child put the child in its own process group, so
+    // that the group exists by the time its ID is reported.
+
+    char const * pythonDriver = R"(
+import array, os, runpy, signal, socket, sys, traceback
+sock = socket.socket(fileno=int(os.environ.pop('ZINC_ZYGOTE_FD')))
+if len(sys.argv) > 1 and sys.argv[1]:
+    runpy.run_path(sys.argv[1], run_name='__zygote__')
+signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+while True:
+    msg, ancdata, flags, addr = sock.recvmsg(1 << 20, socket.CMSG_SPACE(3 * array.array('i').itemsize))
+    if not msg:
+        break
+    fds = array.array('i')
+    for level, kind, data in ancdata:
+        if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:
+            fds.frombytes(data[:len(data) - len(data) % fds.itemsize])
+    pid = os.fork()
+    if pid == 0:
+        sock.close()
+        os.setpgid(0, 0)
+        signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+        for fd, target in zip(fds, (1, 2, 0)):
+            os.dup2(fd, target)
+        for fd in fds:
+            if fd > 2:
+                os.close(fd)
+        parts = msg.split(b'\0')
+        sep = parts.index(b'')
+        os.environb.clear()
+        for var in parts[sep + 1:-1]:
+            key, _, value = var.partition(b'=')
+            os.environb[key] = value
+        script = os.fsdecode(parts[sep - 1])
+        sys.argv = [script]
+        sys.path[0] = os.path.dirname(os.path.abspath(script))
+        code = 0
+        try:
+            runpy.run_path(script, run_name='__main__')
+        except SystemExit as e:
+            if e.code is None or isinstance(e.code, int):
+                code = e.code or 0
+            else:
+                print(e.code, file=sys.stderr)
+                code = 1
+        except BaseException:
+            traceback.print_exc()
+            code = 1
+        try:
+            sys.stdout.flush()
+            sys.stderr.flush()
+        finally:
+            os._exit(code)
+    try:
+        os.setpgid(pid, pid)
+    except OSError:
+        pass
+    for fd in fds:
+        os.close(fd)
+    sock.send(str(pid).encode())
+)";
+}
+#endif
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+Zygote::Zygote(Configuration::CGI const & cgi)
+  : cgi_(cgi)
+#ifndef _WIN32
+  , socket_(-1),
+    pid_(-1)
+#endif
+    {
+    LOG_TRACE("Init Zygote");
+}
+
+//--------------------------------------------------------------
+// Destructor. Terminate the zygote.
+//--------------------------------------------------------------
+
+Zygote::~Zygote() {
+    LOG_TRACE("Destroy Zygote");
+#ifndef _WIN32
+    terminate();
+#endif
+}
+
+//--------------------------------------------------------------
+// Start the zygote.
+//--------------------------------------------------------------
+
+bool Zygote::start() {
+#ifndef _WIN32
+    if (string::compare_i(cgi_.getSectionName(), "Python")) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return spawn();
+    }
+#endif
+    LOG_ERROR("Zygote is not supported for " << cgi_.getSectionName());
+    return false;
+}
+
+#ifndef _WIN32
+
+//--------------------------------------------------------------
+// Have the zygote fork a child to run a script, with the given
+// arguments and environment, and the given descriptors as its
+// standard input (if valid), output and error output. Return
+// false on error, in which case the zygote is restarted on the
+// next call.
+//--------------------------------------------------------------
+
+bool Zygote::fork(std::vector<std::string> const & args, std::vector<std::string> const & env, HANDLE_T input, HANDLE_T output, HANDLE_T error, pid_t & pid) {
+
+    // Build the message.
+
+    std::string msg;
+    for (std::string const & s: args) {
+        msg.append(s);
+        msg.push_back('\0');
+    }
+    msg.push_back('\0');
+    for (std::string const & s: env) {
+        msg.append(s);
+        msg.push_back('\0');
+    }
+
+    int fds[3] = { output, error, input };
+    size_t nfds = IS_HANDLE_VALID(input) ? 3 : 2;
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov;
+    iov.iov_base = &msg[0];
+    iov.iov_len = msg.size();
+
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+
+    struct cmsghdr * cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+
+    // Send it and wait for the reply. The zygote processes one
+    // message at a time, so requests from concurrent threads are
+    // serialized (forking takes a few milliseconds at most).
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (socket_ < 0 || waitpid(pid_, nullptr, WNOHANG) != 0) {
+        LOG_INFO("Restarting zygote for " << cgi_.getSectionName());
+        if (!spawn()) {
+            return false;
+        }
+    }
+
+    if (sendmsg(socket_, &hdr, MSG_NOSIGNAL) != static_cast<ssize_t>(msg.size())) {
+        LOG_ERROR("Unable to send request to zygote: " << strerror(errno));
+        terminate();
+        return false;
+    }
+
+    struct pollfd pf;
+    pf.fd = socket_;
+    pf.events = POLLIN;
+    char reply[32];
+    ssize_t count = -1;
+    if (poll(&pf, 1, static_cast<int>(std::chrono::milliseconds(Zinc::getInstance().getConfiguration().getTimeout()).count())) > 0) {
+        count = recv(socket_, reply, sizeof(reply) - 1, 0);
+    }
+    long value = count > 0 ? (reply[count] = '\0', strtol(reply, nullptr, 10)) : 0;
+    if (value <= 0) {
+        LOG_ERROR("No reply from zygote for " << cgi_.getSectionName());
+        terminate();
+        return false;
+    }
+
+    pid = static_cast<pid_t>(value);
     return true;
 }
 
+//--------------------------------------------------------------
+// Spawn the interpreter running the zygote driver, in its own
+// process group. (The scripts it forks get their own group, as
+// spawned interpreters do.) Must be called with the mutex locked.
+//--------------------------------------------------------------
+
+bool Zygote::spawn() {
+    terminate();
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        LOG_ERROR("Unable to create zygote socket: " << strerror(errno));
+        return false;
+    }
+
+    // The zygote end of the socket is duplicated as descriptor 3,
+    // which must therefore not be the one we got.
+
+    if (sv[1] == 3) {
+        int fd = fcntl(sv[1], F_DUPFD_CLOEXEC, 4);
+        ::close(sv[1]);
+        sv[1] = fd;
+    }
+
+    std::vector<std::string> args = cgi_.getArguments();
+    args.push_back("-c");
+    args.push_back(pythonDriver);
+    args.push_back(cgi_.getZygote());
+
+    std::vector<std::string> env;
+    for (char ** e = environ; *e; e++) {
+        env.push_back(*e);
+    }
+    env.push_back("ZINC_ZYGOTE_FD=3");
+
+    std::vector<char const *> buffer;
+    for (std::string const & s: args) {
+        buffer.push_back(s.c_str());
+    }
+    buffer.push_back(nullptr);
+    size_t nenv = buffer.size();
+    for (std::string const & s: env) {
+        buffer.push_back(s.c_str());
+    }
+    buffer.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], 3);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    char const ** ptr = buffer.data();
+    int err = posix_spawn(&pid_, cgi_.getInterpreter().getCString(), &actions, &attr, const_cast<char **>(ptr), const_cast<char **>(ptr + nenv));
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(sv[1]);
+
+    if (err != 0) {
+        LOG_ERROR("Unable to start zygote " << cgi_.getInterpreter() << ": " << strerror(err));
+        ::close(sv[0]);
+        pid_ = -1;
+        return false;
+    }
+
+    LOG_INFO("Started zygote for " << cgi_.getSectionName() << ", pid " << pid_);
+    socket_ = sv[0];
+    return true;
+}
+
+//--------------------------------------------------------------
+// Terminate the zygote, if running.
+//--------------------------------------------------------------
+
+void Zygote::terminate() {
+    if (socket_ >= 0) {
+        ::close(socket_);
+        socket_ = -1;
+    }
+    if (pid_ > 0) {
+        kill(-pid_, SIGTERM);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+}
+
+#endif
+
 //========================================================================
 // Pipe
 //
@@ -516,10 +1641,16 @@ bool Pipe::create() {
     }
 
     SetHandleInformation(pipe_[Reading], HANDLE_FLAG_INHERIT, 0);
+#elif defined(__linux__)
+    if (pipe2(pipe_, O_CLOEXEC) < 0) {
+        return false;
+    }
 #else
     if (pipe(pipe_) < 0) {
         return false;
     }
+    fcntl(pipe_[Reading], F_SETFD, FD_CLOEXEC);
+    fcntl(pipe_[Writing], F_SETFD, FD_CLOEXEC);
 #endif
     return true;
 }
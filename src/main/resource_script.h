@@ -24,59 +24,220 @@
 #ifndef __RESOURCE_SCRIPT_H__
 #define __RESOURCE_SCRIPT_H__
 
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+#include <mutex>
+
 #include "../misc/filesys.h"
 #include "../misc/blob.h"
 #include "../http/resource.h"
+#include "../http/response_cache.h"
 #include "configuration.h"
 
+//--------------------------------------------------------------
+// Pipe between processes.
+//--------------------------------------------------------------
+
+class Pipe {
+public:
+    Pipe();
+    ~Pipe();
+
+    enum Side {
+        Reading = 0,
+        Writing = 1,
+    };
+
+    bool        create();
+    void        close(Side side);
+    HANDLE_T    get(Side side) const        { return pipe_[side]; }
+
+private:
+    HANDLE_T pipe_[2];
+};
+
+//--------------------------------------------------------------
+// Pre-started interpreter that forks a child for each request,
+// so that the interpreter startup and warm-up costs are paid once.
+//--------------------------------------------------------------
+
+class Zygote {
+public:
+    Zygote(Configuration::CGI const & cgi);
+    ~Zygote();
+
+    bool                        start();
+    Configuration::CGI const &  getCGI() const                  { return cgi_; }
+#ifndef _WIN32
+    bool                        fork(std::vector<std::string> const & args, std::vector<std::string> const & env, HANDLE_T input, HANDLE_T output, HANDLE_T error, pid_t & pid);
+
+private:
+    Configuration::CGI const &  cgi_;           // CGI block this zygote runs the scripts of
+    std::mutex                  mutex_;         // thread synchronization
+    int                         socket_;        // our end of the socket connected to the zygote, or -1
+    pid_t                       pid_;           // process ID of the zygote, or -1
+
+    bool                        spawn();
+    void                        terminate();
+#else
+private:
+    Configuration::CGI const &  cgi_;           // CGI block this zygote runs the scripts of
+#endif
+};
+
 //--------------------------------------------------------------
 // Resource consisting of a CGI script.
 //--------------------------------------------------------------
 
 class ResourceScript : public Resource {
 public:
-    ResourceScript(fs::filepath const & scriptname, std::string const & scripturi, std::string const & pathinfo, Configuration::CGI const & cgi);
+    ResourceScript(fs::filepath const & scriptname, std::string const & scripturi, std::string const & pathinfo, Configuration::CGI const & cgi, Zygote * zygote = nullptr);
+    ~ResourceScript() override;
 
-    void transmit(HttpResponse & response, HttpRequest const & request) override;
+    void            transmit(HttpResponse & response, HttpRequest const & request) override;
+#ifndef _WIN32
+    std::unique_ptr<Reactor::Handler> detach(HttpResponse & response, HttpRequest const & request) override;
+#endif
+    void            complete(HttpResponse & response, HttpRequest const & request) override;
+    OutputStream *  getBodySink(HttpRequest const & request, size_t limitRequestBody) override;
+    bool            acceptsBody() const override                { return true; }
 
 private:
     fs::filepath                scriptname_;
     std::string                 scripturi_;
     std::string                 pathinfo_;
     Configuration::CGI const &  cgi_;
-    std::string                 errors_;
+    Zygote *                    zygote_;
+
+    bool serveCached(HttpResponse & response, HttpRequest const & request);
+    void prepare(HttpResponse & response, HttpRequest const & request);
+    bool runScript(OutputStream & output, blob const & body, std::vector<std::string> const & args, std::vector<std::string> const & env);
+    void sendFile(HttpResponse & response, HttpRequest const & request, fs::filepath filename, std::string const & headers);
+
+    class Capture : public OutputStream {       // stream that keeps a copy of the interpreter output, for the response cache
+    public:
+        Capture(OutputStream * destination, size_t limit);
+        bool write(void const * data, size_t length) override;
 
-    bool runScript(HttpResponse & response, blob const & body, std::vector<std::string> const & args, std::vector<std::string> const & env);
+        std::string const & getContent() const                          { return content_;                  }
+        bool isOverflow() const                                         { return overflow_;                 }
+
+    private:
+        std::string content_;                   // copy of the output
+        size_t      limit_;                     // maximum size of the copy
+        bool        overflow_;                  // flag to remember if the limit was exceeded
+    };
 
 #ifdef UNIT_TESTING
 public:
-#else
+#endif
+    class EntityTag : public OutputStream {     // stream that holds the interpreter output back to compute an entity tag
+    public:
+        EntityTag(OutputStream * destination, HttpRequest const & request, size_t limit);
+        bool write(void const * data, size_t length) override;
+        bool sync() override;
+        long sendPipe(HANDLE_T pipe, size_t length) override;
+        void finish();
+
+    private:
+        HttpRequest const &     request_;       // request, to compare the tag with its If-None-Match field
+        std::string             buffer_;        // output held back
+        size_t                  limit_;         // maximum size of the output held back
+        bool                    overflow_;      // flag to remember if the limit was exceeded
+    };
+#ifdef UNIT_TESTING
 private:
 #endif
-    std::vector<std::string>    buildArguments() const;
-    std::vector<std::string>    buildEnvironment(HttpRequest const & request) const;
-};
 
-//--------------------------------------------------------------
-// Pipe between processes.
-//--------------------------------------------------------------
+    class XSendFile : public OutputStream {     // stream that looks for an X-Sendfile field in the interpreter output
+    public:
+        XSendFile(ResourceScript const & owner, HttpResponse & response);
+        bool write(void const * data, size_t length) override;
+        bool sync() override;
+        long sendPipe(HANDLE_T pipe, size_t length) override;
+        void finish();
+
+        std::string const & getFilename() const                         { return filename_;                 }
+        std::string const & getHeaders() const                          { return headers_;                  }
+
+    private:
+        ResourceScript const &  owner_;         // resource the output comes from
+        HttpResponse &          response_;      // response the output is forwarded to
+        int                     state_;         // 0: parsing the header block, 1: forwarding the output, 2: discarding it
+        std::string             buffer_;        // header block received so far
+        std::string             filename_;      // file designated by the script, if any
+        std::string             headers_;       // other header fields, to send along with the file
+
+        void                    forward();
+    };
 
-class Pipe {
-public:
-    Pipe();
-    ~Pipe();
+    std::vector<std::string>    args_;          // interpreter arguments
+    std::string                 key_;           // key of the response in the response cache, or empty if it cannot be cached
+    std::unique_ptr<ResponseCache::Guard> lead_;        // flight to land, when elected to run the script for the response cache
+    bool                        store_;         // whether the output is to be stored in the response cache
+    bool                        ok_;            // whether the interpreter could be spawned
+    std::unique_ptr<XSendFile>  xsendfile_;     // stream looking for an X-Sendfile field, if enabled
+    std::unique_ptr<EntityTag>  etag_;          // stream computing an entity tag, if enabled
+    std::unique_ptr<Capture>    capture_;       // stream keeping a copy of the output for the response cache, if enabled
+    OutputStream *              sink_;          // head of the chain of streams the interpreter output is written to
+
+#ifndef _WIN32
+    class Feeder : public OutputStream {        // stream that forwards the request body to the interpreter standard input
+    public:
+        Feeder(ResourceScript & owner) : owner_(owner)                  {                                   }
+        bool write(void const * data, size_t length) override           { return owner_.feed(data, length); }
+
+    private:
+        ResourceScript & owner_;
+    };
 
-    enum Side {
-        Reading = 0,
-        Writing = 1,
+    class Collector : public Reactor::Handler { // handler collecting the interpreter output in a reactor
+    public:
+        Collector(ResourceScript & owner) : owner_(owner)               {                                   }
+        ~Collector() override;
+        void prepare(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline) override;
+        bool process(struct pollfd const * fds) override;
+
+    private:
+        ResourceScript & owner_;
     };
 
-    bool        create();
-    void        close(Side side);
-    HANDLE_T    get(Side side) const        { return pipe_[side]; }
+    pid_t                       pid_;           // process ID of the interpreter, once spawned
+    bool                        owned_;         // whether the interpreter is our child (false if forked by a zygote)
+    std::chrono::steady_clock::time_point started_;     // when the interpreter was spawned
+    Pipe                        pin_;           // pipe to the interpreter standard input (when the body is streamed)
+    Pipe                        pout_;          // pipe from the interpreter standard output
+    Pipe                        perr_;          // pipe from the interpreter error output
+    std::string                 output_;        // interpreter output received while the request body is being streamed
+    Feeder                      feeder_;        // stream the request body is written to (when the body is streamed)
+    int                         pidfd_;         // process descriptor of the interpreter, while waiting for it to exit (Linux), or -1
+    bool                        received_;      // whether the interpreter has sent something
+    std::chrono::steady_clock::time_point syncDue_;     // when the output written but not synced yet must be pushed to the client
+
+    bool spawn(std::vector<std::string> const & args, std::vector<std::string> const & env, HANDLE_T input, std::chrono::milliseconds wait);
+    void terminate();
+    void release();
+    bool feed(void const * data, size_t length);
+    void collect(OutputStream & output);
+    void startCollect(OutputStream & output);
+    void prepareCollect(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & deadline);
+    bool processCollect(OutputStream & output, struct pollfd const * fds);
+#endif
 
-private:
-    HANDLE_T pipe_[2];
+#ifdef UNIT_TESTING
+public:
+#else
+protected:
+#endif
+    std::vector<std::string>    buildArguments() const;
+    std::vector<std::string>    buildEnvironment(HttpRequest const & request, size_t length) const;
+    void                        emitDefaultHeaders(HttpResponse & response) const;
+    std::string                 getCacheKey(HttpRequest const & request) const;
+    bool                        isSendable(fs::filepath & filename) const;
+    void                        logErrors(std::string const & source);
+
+    std::string                 errors_;        // error output of the interpreter
 };
 
 //--------------------------------------------------------------
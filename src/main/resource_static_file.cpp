@@ -21,8 +21,12 @@
 // THE SOFTWARE.
 //========================================================================
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include <algorithm>
 
+#include "../misc/string.h"
 #include "../http/mimetype.h"
 #include "zinc.h"
 #include "resource_static_file.h"
@@ -33,18 +37,21 @@
 // Resource consisting of a local static file. The URI resolver already
 // does much of the job (opening the file, determining its MIME type, etc.)
 // and this class is only responsible for emiting the HTTP headers and
-// data.
+// data. Clients can request a single byte range of the file (e.g. to
+// resume a download).
 //========================================================================
 
 //--------------------------------------------------------------
 // Constructor.
 //--------------------------------------------------------------
 
-ResourceStaticFile::ResourceStaticFile(fs::filepath const & filename, std::ifstream & filestream)
+ResourceStaticFile::ResourceStaticFile(fs::filepath const & filename, std::ifstream & filestream, std::string const & headers)
     : Resource("static file " + filename.getStdString()),
+      filename_(filename),
       fileStream_(std::move(filestream)),
       mimeType_(filename, &fileStream_),
-      lastModified_(filename.getModificationDate()) {
+      lastModified_(filename.getModificationDate()),
+      headers_(headers) {
 }
 
 //--------------------------------------------------------------
@@ -56,28 +63,110 @@ void ResourceStaticFile::transmit(HttpResponse & response, HttpRequest const & r
     if (lastModified_ > ifModifiedSince && request.getVerb().isOneOf(HttpVerb::Get | HttpVerb::Head)) {
         fileStream_.seekg(0, std::istream::end);
         size_t size = static_cast<size_t>(fileStream_.tellg());
+        size_t first = 0, last = size - 1;
+
+        int range = getRange(request, lastModified_, size, first, last);
+        if (range < 0) {
+            response.setHttpStatus(416);
+            response.emitHeader(HttpHeader::ContentRange, "bytes */" + std::to_string(size));
+            response.emitHeader(HttpHeader::ContentLength, "0");
+            response.emitEol();
+            response.flush();
+            return;
+        } else if (range > 0) {
+            response.setHttpStatus(206);
+            response.emitHeader(HttpHeader::ContentRange, "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(size));
+        }
+        size_t length = size ? last - first + 1 : 0;
 
         response.emitHeader(HttpHeader::ContentType, mimeType_.toString());
-        response.emitHeader(HttpHeader::ContentLength, std::to_string(size));
+        response.emitHeader(HttpHeader::ContentLength, std::to_string(length));
+        response.emitHeader(HttpHeader::AcceptRanges, "bytes");
         response.emitHeader(HttpHeader::LastModified, lastModified_.to_http());
         response.emitHeader(HttpHeader::Expires, response.getResponseDate().add(Zinc::getInstance().getConfiguration().getExpires()).to_http());
+        response.write(headers_.data(), headers_.size());
         response.emitEol();
 
-        fileStream_.seekg(0, fileStream_.beg);
-        while (size) {
-            char buffer[1024];
-            size_t count = std::min(size, sizeof(buffer));
-            fileStream_.read(buffer, count);
-            response.write(buffer, count);
-            size -= count;
+        // Hand the file over to the response, which lets the socket
+        // send it with zero copy when possible. If it cannot be reopened,
+        // fall back to the stream we already have.
+
+        HANDLE_T file = filename_.openForReading();
+        if (IS_HANDLE_VALID(file)) {
+            response.sendFile(file, first, length);
+            closefile(file);
+        } else {
+            fileStream_.seekg(static_cast<std::streamoff>(first), fileStream_.beg);
+            while (length) {
+                char buffer[1024];
+                size_t count = std::min(length, sizeof(buffer));
+                fileStream_.read(buffer, count);
+                response.write(buffer, count);
+                length -= count;
+            }
         }
     } else {
         response.setHttpStatus(304);
         response.emitHeader(HttpHeader::ContentLength, "0");    // to indicate the HttpResponse object that the body is empty
+        response.write(headers_.data(), headers_.size());
         response.emitEol();
     }
 
     response.flush();
 }
 
+//--------------------------------------------------------------
+// Parse the Range header of a GET request. Only a single range
+// of bytes is supported. Return 1 and the first and last byte
+// positions if the range is satisfiable, -1 if it is not, and 0
+// if the whole file must be sent (no range, several ranges, or
+// an If-Range condition that does not match the modification
+// date).
+//--------------------------------------------------------------
+
+int ResourceStaticFile::getRange(HttpRequest const & request, date const & lastModified, size_t size, size_t & first, size_t & last) {
+    std::string const & range = request.getHeaderValue(HttpHeader::Range);
+    if (range.compare(0, 6, "bytes=") != 0 || !request.getVerb().isOneOf(HttpVerb::Get)) {
+        return 0;
+    }
+    std::string const & ifRange = request.getHeaderValue(HttpHeader::IfRange);
+    if (!ifRange.empty() && ifRange != lastModified.to_http()) {
+        return 0;
+    }
+
+    std::string spec = range.substr(6);
+    string::trim(spec, string::trim_both);
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos || spec.find(',') != std::string::npos) {
+        return 0;
+    }
+    std::string lo = spec.substr(0, dash), hi = spec.substr(dash + 1);
+    auto isNumber = [] (std::string const & s) {
+        return !s.empty() && s.size() <= 18 && std::all_of(s.begin(), s.end(), [] (char ch) { return ch >= '0' && ch <= '9'; });
+    };
+
+    if (lo.empty()) {
+        if (!isNumber(hi)) {                                // suffix range: the last N bytes
+            return 0;
+        }
+        size_t count = static_cast<size_t>(std::stoull(hi));
+        if (count == 0 || size == 0) {
+            return -1;
+        }
+        first = count < size ? size - count : 0;
+        last = size - 1;
+        return 1;
+    }
+
+    if (!isNumber(lo) || (!hi.empty() && !isNumber(hi))) {
+        return 0;
+    }
+    first = static_cast<size_t>(std::stoull(lo));
+    last = hi.empty() ? size - 1 : std::min(static_cast<size_t>(std::stoull(hi)), size - 1);
+    if (first >= size) {
+        return -1;
+    }
+    return first <= last ? 1 : 0;
+}
+
 //========================================================================
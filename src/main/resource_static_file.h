@@ -35,14 +35,21 @@
 
 class ResourceStaticFile : public Resource {
 public:
-    ResourceStaticFile(fs::filepath const & filename, std::ifstream & filestream);
+    ResourceStaticFile(fs::filepath const & filename, std::ifstream & filestream, std::string const & headers = std::string());
 
     void transmit(HttpResponse & response, HttpRequest const & request) override;
 
 private:
+    fs::filepath    filename_;
     std::ifstream   fileStream_;
     Mime            mimeType_;
     date            lastModified_;
+    std::string     headers_;       // extra header fields (e.g. from the CGI script that designated the file)
+
+#ifdef UNIT_TESTING
+public:
+#endif
+    static int      getRange(HttpRequest const & request, date const & lastModified, size_t size, size_t & first, size_t & last);
 };
 
 //--------------------------------------------------------------
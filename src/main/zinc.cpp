@@ -26,6 +26,9 @@
 #include "resource_builtin.h"
 #include "resource_directory.h"
 #include "resource_error_page.h"
+#include "resource_event_stream.h"
+#include "resource_fastcgi.h"
+#include "resource_proxy.h"
 #include "resource_redirection.h"
 #include "resource_script.h"
 #include "resource_static_file.h"
@@ -38,7 +41,29 @@
 //--------------------------------------------------------------
 
 Zinc::Zinc()
-  : configuration_() {
+  : configuration_(),
+    cache_(0),
+    events_(1) {
+}
+
+//--------------------------------------------------------------
+// Start a FastCGI backend for each CGI block configured to use
+// FastCGI, and a zygote for each CGI block configured to use one.
+// Return false if one of them cannot be started.
+//--------------------------------------------------------------
+
+bool Zinc::startBackends() {
+    bool ok = true;
+    for (Configuration::CGI const & cgi: configuration_.getInterpreters()) {
+        if (!cgi.getFastCGI().empty()) {
+            backends_.emplace_back(cgi);
+            ok = backends_.back().start() && ok;
+        } else if (!cgi.getZygote().empty()) {
+            zygotes_.emplace_back(cgi);
+            ok = zygotes_.back().start() && ok;
+        }
+    }
+    return ok;
 }
 
 //--------------------------------------------------------------
@@ -48,6 +73,19 @@ Zinc::Zinc()
 std::shared_ptr<Resource> Zinc::resolve(URI const & uri) {
     try {
 
+        // The event stream and the paths forwarded to an upstream
+        // server are not looked up on disk.
+
+        std::string const & events = configuration_.getEventStream();
+        if (!events.empty() && uri.getPath() == events) {
+            return std::make_shared<ResourceEventStream>(events_, configuration_.getEventHeartbeat());
+        }
+
+        Configuration::Proxy const * proxy = configuration_.getProxy(uri.getPath());
+        if (proxy) {
+            return std::make_shared<ResourceProxy>(*proxy, uri);
+        }
+
         // Canonicalize the URI by removing references to '.' and
         // '..'. When we hit an existing file, the URI is fully 
         // resolved and the remaining path is considered as part of
@@ -138,6 +176,16 @@ std::shared_ptr<Resource> Zinc::resolve(URI const & uri) {
         fs::filepath filepath = fs::makeFilepathFromURI(uripath);
         Configuration::CGI const * cgi = configuration_.getInterpreter(filepath);
         if (cgi) {
+            for (FastCGIBackend & backend: backends_) {
+                if (&backend.getCGI() == cgi) {
+                    return std::make_shared<ResourceFastCGI>(filepath, uripath, path_info, backend);
+                }
+            }
+            for (Zygote & zygote: zygotes_) {
+                if (&zygote.getCGI() == cgi) {
+                    return std::make_shared<ResourceScript>(filepath, uripath, path_info, *cgi, &zygote);
+                }
+            }
             return std::make_shared<ResourceScript>(filepath, uripath, path_info, *cgi);
         } else {
             std::ifstream fs(filepath.getStdString(), std::ifstream::in | std::ifstream::binary);
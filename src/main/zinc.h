@@ -25,7 +25,10 @@
 #define __ZINC_H__
 
 #include "../http/ihttpconfig.h"
+#include "../http/response_cache.h"
+#include "../http/event_hub.h"
 #include "configuration.h"
+#include "resource_fastcgi.h"
 
 //--------------------------------------------------------------
 // Zinc server configuration
@@ -34,29 +37,39 @@
 class Zinc : public IHttpConfig {
 public:
     Configuration & getConfiguration()                              { return configuration_;                           }
+    ResponseCache & getResponseCache()                              { return cache_;                                   }
+    bool            startBackends();
     static Zinc &   getInstance();
 
     int                     getListeningPort() override             { return configuration_.getListeningPort();        }
     int                     getLimitThreads() override              { return configuration_.getLimitThreads();         }
+    int                     getReactorThreads() override            { return configuration_.getReactorThreads();       }
     int                     getLimitRequestLine() override          { return configuration_.getLimitRequestLine();     }
     int                     getLimitRequestHeaders() override       { return configuration_.getLimitRequestHeaders();  }
     int                     getLimitRequestBody() override          { return configuration_.getLimitRequestBody();     }
     std::chrono::seconds    getTimeout() override                   { return configuration_.getTimeout();              }
     bool                    isCompressionEnabled() override         { return configuration_.isCompressionEnabled();    }
     std::string             getVersionString() override;
+    EventHub &              getEventHub() override                  { return events_;                                  }
 
     std::shared_ptr<Resource>   resolve(URI const & uri) override;
     std::shared_ptr<Resource>   makeErrorPage(HttpStatus status) override;
     bool                        acceptConnection(AddrIPv4 const & remote) override;
 
 #ifdef ZINC_WEBSOCKET
+    int     getWebSocketQueue() override                            { return configuration_.getWebSocketQueue();       }
+    bool    isSlowClientDropped() override                          { return configuration_.isSlowClientDropped();     }
     void    handleMessage(WebSocket::Connection & socket, WebSocket::Frame & frame) override;
 #endif
 
 private:
     Zinc();
 
-    Configuration configuration_; 
+    Configuration               configuration_;     // server configuration
+    std::list<FastCGIBackend>   backends_;          // FastCGI backends, one for each CGI block configured to use FastCGI
+    std::list<Zygote>           zygotes_;           // Zygotes, one for each CGI block configured to use a zygote
+    ResponseCache               cache_;             // Script responses that can be reused
+    EventHub                    events_;            // Events pushed to the subscribers of the event stream
 };
 
 //--------------------------------------------------------------
@@ -23,29 +23,43 @@
 
 #ifndef _WIN32
 #include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
 #endif
+#endif
+
+#include <algorithm>
 
 #include "blob.h"
 
 //========================================================================
 // blob
 //
-// Encapsulate a binary large object. The content is actually stored in a
-// temporary file that is created the first time date are written and
-// deleted when the last descriptor/handle is closed.
+// Encapsulate a binary large object. Small contents are kept in memory.
+// When the content grows past a given threshold, it is moved to a
+// temporary file that is created on the fly and deleted when the last
+// descriptor/handle is closed. On Linux, this temporary file is an
+// anonymous memory file (see memfd_create) unless a temporary directory
+// is explicitly configured.
 //
 // The implementation MUST rely on plateform specific API and not on a
 // higher level library (such as FILE* or std::fstream) because we need
 // the raw file descriptor/handle to communicate with external processes.
 //========================================================================
 
+size_t      blob::spillThreshold_ = 64 * 1024;
+std::string blob::tempDirectory_;
+
 //--------------------------------------------------------------
 // Constructor.
 //--------------------------------------------------------------
 
 blob::blob()
-  : fd_(INVALID_HANDLE_VALUE) {
+  : fd_(INVALID_HANDLE_VALUE),
+    size_(0) {
 }
 
 //--------------------------------------------------------------
@@ -53,13 +67,17 @@ blob::blob()
 //--------------------------------------------------------------
 
 blob::blob(blob const & other)
-  : fd_(INVALID_HANDLE_VALUE) {
+  : memory_(other.memory_),
+    fd_(INVALID_HANDLE_VALUE),
+    size_(other.size_) {
+    if (IS_HANDLE_VALID(other.fd_)) {
 #ifdef _WIN32
-    DuplicateHandle(GetCurrentProcess(), other.fd_, GetCurrentProcess(), &fd_, 0, FALSE, DUPLICATE_SAME_ACCESS);
+        DuplicateHandle(GetCurrentProcess(), other.fd_, GetCurrentProcess(), &fd_, 0, FALSE, DUPLICATE_SAME_ACCESS);
 #else
-    int f = dup(other.fd_);
-    fd_ = f >= 0 ? f : INVALID_HANDLE_VALUE;
+        int f = fcntl(other.fd_, F_DUPFD_CLOEXEC, 0);
+        fd_ = f >= 0 ? f : INVALID_HANDLE_VALUE;
 #endif
+    }
 }
 
 //--------------------------------------------------------------
@@ -77,92 +95,218 @@ blob::~blob() {
 //--------------------------------------------------------------
 
 blob & blob::operator = (blob other) {
+    std::swap(memory_, other.memory_);
     std::swap(fd_, other.fd_);
+    std::swap(size_, other.size_);
     return *this;
 }
 
 //--------------------------------------------------------------
-// Write data to the file, creating and opening it if this is
-// not already done.
+// Append data to the blob. Data are stored in memory as long as
+// the total size does not exceed the threshold, and in a
+// temporary file otherwise.
 //--------------------------------------------------------------
 
 bool blob::write(void const * data, size_t length) {
-#ifdef _WIN32
-    if (!IS_HANDLE_VALID(fd_)) {
-        WCHAR path[MAX_PATH], fname[MAX_PATH];
-        GetTempPathW(MAX_PATH, path);
-        GetTempFileNameW(path, L"tmp_", 0, fname);
-        fd_ = CreateFileW(fname, GENERIC_READ | GENERIC_WRITE,  0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
-        if (fd_ == INVALID_HANDLE_VALUE) {
-            return false;
+    if (!IS_HANDLE_VALID(fd_) && size_ + length <= spillThreshold_) {
+        auto p = static_cast<uint8_t const *>(data);
+        memory_.insert(memory_.end(), p, p + length);
+    } else if (!spill() || !writeFile(data, length)) {
+        return false;
+    }
+    size_ += length;
+    return true;
+}
+
+//--------------------------------------------------------------
+// Append at most the specified number of bytes read from a file
+// descriptor/handle. On Linux, when the content is stored in a
+// file and the source is a pipe, data are transferred by the
+// kernel without being copied in user space. Return the number
+// of bytes actually transferred, which is less than requested
+// if the end of the source is reached or if an error occurs.
+//--------------------------------------------------------------
+
+size_t blob::receive(HANDLE_T source, size_t length) {
+    size_t total = 0;
+#ifdef __linux__
+    if ((IS_HANDLE_VALID(fd_) || size_ + length > spillThreshold_) && spill()) {
+        while (total < length) {
+            ssize_t r = splice(source, nullptr, fd_, nullptr, length - total, SPLICE_F_MOVE);
+            if (r <= 0) {
+                if (r < 0 && errno == EINTR) {
+                    continue;
+                } else if (r < 0 && errno == EINVAL && total == 0) {
+                    break;      // the source is not a pipe: fall back to read/write
+                }
+                return total;
+            }
+            total += static_cast<size_t>(r);
+            size_ += static_cast<size_t>(r);
         }
     }
-    DWORD written;
-    return WriteFile(fd_, data, static_cast<DWORD>(length), &written, nullptr) && static_cast<size_t>(written) == length;
+#endif
+    while (total < length) {
+        char buffer[16384];
+        size_t len = std::min(length - total, sizeof(buffer));
+#ifdef _WIN32
+        DWORD r;
+        if (!ReadFile(source, buffer, static_cast<DWORD>(len), &r, nullptr) || r == 0) {
+            break;
+        }
 #else
+        ssize_t r = ::read(source, buffer, len);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        } else if (r <= 0) {
+            break;
+        }
+#endif
+        if (!write(buffer, static_cast<size_t>(r))) {
+            break;
+        }
+        total += static_cast<size_t>(r);
+    }
+    return total;
+}
+
+//--------------------------------------------------------------
+// Read the whole content in a vector.
+//--------------------------------------------------------------
+
+std::vector<uint8_t> blob::readAll() const {
     if (!IS_HANDLE_VALID(fd_)) {
-        char fname[32] = "tmp_XXXXXX";
-        fd_ = mkstemp(fname);
-        if (fd_ < 0) {
-            return false;
+        return memory_;
+    }
+
+    std::vector<uint8_t> content(size_);
+#ifdef _WIN32
+    SetFilePointer(fd_, 0, nullptr, FILE_BEGIN);
+    DWORD read;
+    ReadFile(fd_, content.data(), static_cast<DWORD>(size_), &read, nullptr);
+    content.resize(static_cast<size_t>(read));
+    SetFilePointer(fd_, 0, nullptr, FILE_END);
+#else
+    size_t offset = 0;
+    while (offset < size_) {
+        ssize_t r = pread(fd_, content.data() + offset, size_ - offset, static_cast<off_t>(offset));
+        if (r < 0 && errno == EINTR) {
+            continue;
+        } else if (r <= 0) {
+            break;
         }
-        unlink(fname);
+        offset += static_cast<size_t>(r);
     }
-    return ::write(fd_, data, length) == static_cast<ssize_t>(length);
+    content.resize(offset);
 #endif
+    return content;
 }
 
 //--------------------------------------------------------------
-// Return the size of the file.
+// Return a file descriptor/handle to the content, for example to
+// redirect the standard input of an external process. If the
+// content is still in memory, it is first moved to a temporary
+// file. Return an invalid descriptor/handle if the blob is empty.
 //--------------------------------------------------------------
 
-size_t blob::getSize() const {
-    size_t result;
-#ifdef _WIN32
+HANDLE_T blob::getFileDescriptor() const {
+    if (size_ && !spill()) {
+        return INVALID_HANDLE_VALUE;
+    }
+    return fd_;
+}
+
+//--------------------------------------------------------------
+// Set the maximum size of blobs kept in memory, and the directory
+// where to create temporary files (an empty string meaning the
+// default location). This function is meant to be called once at
+// startup, before any blob is written.
+//--------------------------------------------------------------
+
+void blob::setSpillPolicy(size_t threshold, std::string const & directory) {
+    spillThreshold_ = threshold;
+    tempDirectory_ = directory;
+}
+
+//--------------------------------------------------------------
+// Create the temporary file, if this is not already done, and
+// move the content held in memory to it.
+//--------------------------------------------------------------
+
+bool blob::spill() const {
     if (IS_HANDLE_VALID(fd_)) {
-        LARGE_INTEGER li;
-        GetFileSizeEx(fd_, &li);
-        result = static_cast<size_t>(li.QuadPart);
+        return true;
+    }
+
+#ifdef _WIN32
+    WCHAR path[MAX_PATH], fname[MAX_PATH];
+    if (tempDirectory_.empty()) {
+        GetTempPathW(MAX_PATH, path);
     } else {
-        result = 0;
+        wcsncpy(path, UTF8ToWideString(tempDirectory_).c_str(), MAX_PATH - 1);
+        path[MAX_PATH - 1] = 0;
+    }
+    GetTempFileNameW(path, L"tmp_", 0, fname);
+    fd_ = CreateFileW(fname, GENERIC_READ | GENERIC_WRITE,  0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if (fd_ == INVALID_HANDLE_VALUE) {
+        return false;
     }
 #else
-    if (IS_HANDLE_VALID(fd_)) {
-        off_t previous = lseek(fd_, 0, SEEK_CUR);
-        result = lseek(fd_, 0, SEEK_END);
-        lseek(fd_, previous, SEEK_SET);
-    } else {
-        result = 0;
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    if (tempDirectory_.empty()) {
+        fd_ = memfd_create("zinc_blob", MFD_CLOEXEC);
+    }
+#endif
+    if (!IS_HANDLE_VALID(fd_)) {
+        char const * tmpdir = getenv("TMPDIR");
+        std::string fname = !tempDirectory_.empty() ? tempDirectory_ : (tmpdir && *tmpdir ? tmpdir : "/tmp");
+        if (fname.back() != '/') {
+            fname.push_back('/');
+        }
+        fname.append("tmp_XXXXXX");
+        int f = mkstemp(&fname[0]);
+        if (f < 0) {
+            return false;
+        }
+        unlink(fname.c_str());
+        fcntl(f, F_SETFD, FD_CLOEXEC);
+        fd_ = f;
     }
 #endif
-    return result;
+
+    if (!memory_.empty()) {
+        if (!writeFile(memory_.data(), memory_.size())) {
+            closefile(fd_);
+            fd_ = INVALID_HANDLE_VALUE;
+            return false;
+        }
+        std::vector<uint8_t>().swap(memory_);
+    }
+    return true;
 }
 
 //--------------------------------------------------------------
-// Read the whole file content in a vector.
+// Append data to the temporary file.
 //--------------------------------------------------------------
 
-std::vector<uint8_t> blob::readAll() const {
-    std::vector<uint8_t> content;
+bool blob::writeFile(void const * data, size_t length) const {
 #ifdef _WIN32
-    if (IS_HANDLE_VALID(fd_)) {
-        LARGE_INTEGER li;
-        GetFileSizeEx(fd_, &li);
-        auto size = static_cast<size_t>(li.QuadPart);
-        content.resize(size);
-        SetFilePointer(fd_, 0, nullptr, FILE_BEGIN);
-        DWORD read;
-        ReadFile(fd_, content.data(), static_cast<DWORD>(size), &read, nullptr);
-    }
+    DWORD written;
+    return WriteFile(fd_, data, static_cast<DWORD>(length), &written, nullptr) && static_cast<size_t>(written) == length;
 #else
-    if (IS_HANDLE_VALID(fd_)) {
-        auto size = static_cast<size_t>(lseek(fd_, 0, SEEK_END));
-        content.resize(size);
-        lseek(fd_, 0, SEEK_SET);
-        read(fd_, content.data(), size);
+    auto p = static_cast<char const *>(data);
+    while (length) {
+        ssize_t r = ::write(fd_, p, length);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        } else if (r <= 0) {
+            return false;
+        }
+        p += r;
+        length -= static_cast<size_t>(r);
     }
+    return true;
 #endif
-    return content;
 }
 
 //========================================================================
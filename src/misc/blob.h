@@ -24,6 +24,7 @@
 #ifndef BLOB_H
 #define BLOB_H
 
+#include <string>
 #include <vector>
 #include <stdint.h>
 
@@ -42,13 +43,25 @@ public:
     blob &  operator = (blob other);
 
     bool                    write(void const * data, size_t length);
-    size_t                  getSize() const;
+    size_t                  receive(HANDLE_T source, size_t length);
+    size_t                  getSize() const                         { return size_; }
     std::vector<uint8_t>    readAll() const;
+    bool                    isInMemory() const                      { return !IS_HANDLE_VALID(fd_); }
 
-    HANDLE_T                getFileDescriptor() const               { return fd_; }
+    HANDLE_T                getFileDescriptor() const;
+
+    static void             setSpillPolicy(size_t threshold, std::string const & directory);
 
 private:
-    HANDLE_T    fd_;
+    mutable std::vector<uint8_t>    memory_;            // content, as long as it is small enough to be kept in memory
+    mutable HANDLE_T                fd_;                // temporary file, once the content has been spilled to disk
+    size_t                          size_;              // size of the content
+
+    bool    spill() const;
+    bool    writeFile(void const * data, size_t length) const;
+
+    static size_t                   spillThreshold_;    // maximum size of a blob kept in memory
+    static std::string              tempDirectory_;     // directory where to create temporary files (empty for default)
 };
 
 //--------------------------------------------------------------
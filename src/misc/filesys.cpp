@@ -26,6 +26,7 @@
 #else
 #include <sys/stat.h> 
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 #include <cstring>
@@ -270,6 +271,21 @@ date fs::filepath::getModificationDate() const {
     return date::now();
 }
 
+//--------------------------------------------------------------
+// Open the file for reading and return a native handle, or
+// INVALID_HANDLE_VALUE on failure. The caller is responsible
+// for closing the handle.
+//--------------------------------------------------------------
+
+HANDLE_T fs::filepath::openForReading() const {
+#ifdef _WIN32
+    std::wstring s = UTF8ToWideString(path_);
+    return CreateFileW(s.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+#else
+    return ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+}
+
 //--------------------------------------------------------------
 // Indicate whether a path is absolute or relative.
 //--------------------------------------------------------------
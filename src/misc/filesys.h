@@ -83,6 +83,7 @@ namespace fs {
         type                    getFileType() const;
         void                    getDirectoryContent(std::function<void(dirent const &)> const & callback) const;
         date                    getModificationDate() const;
+        HANDLE_T                openForReading() const;
 
         bool                    isAbsolute() const;
         filepath                makeAbsolute() const;
@@ -123,6 +123,14 @@ bool logger::isLogEnabled(level level) {
     return level >= minLevel;
 }
 
+//--------------------------------------------------------------
+// Indicate if request and response bodies are dumped.
+//--------------------------------------------------------------
+
+bool logger::isDumpEnabled() {
+    return dumpBodies;
+}
+
 //--------------------------------------------------------------
 // Print a line of log. To avoid mixing messages of different
 // threads, this function is protected by a mutex.
@@ -87,6 +87,7 @@ namespace logger {
     void setLevel(level loglevel, bool logdump);
     void registerWorkerThread(int no);
     bool isLogEnabled(level level);
+    bool isDumpEnabled();
     void print(char level, ansi::color color, std::ostringstream const & oss);
 
     class dump {
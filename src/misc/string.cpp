@@ -22,6 +22,7 @@
 //========================================================================
 
 #include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 #include "string.h"
@@ -155,6 +156,29 @@ std::string string::decodeURI(std::string const & s) {
     return ret;
 }
 
+//--------------------------------------------------------------
+// Encode a URI path. Characters that are neither unreserved nor
+// allowed in a path segment (see RFC 3986 section 3.3) are
+// percent-encoded. Slashes are kept as is.
+//--------------------------------------------------------------
+
+std::string string::encodeURI(std::string const & s) {
+    static char const hex[] = "0123456789ABCDEF";
+    static char const allowed[] = "-._~!$&'()*+,;=:@/";
+
+    std::string ret;
+    for (char ch: s) {
+        if (isalnum(static_cast<unsigned char>(ch)) || (ch != '\0' && strchr(allowed, ch) != nullptr)) {
+            ret.push_back(ch);
+        } else {
+            ret.push_back('%');
+            ret.push_back(hex[static_cast<unsigned char>(ch) >> 4]);
+            ret.push_back(hex[static_cast<unsigned char>(ch) & 0x0F]);
+        }
+    }
+    return ret;
+}
+
 //--------------------------------------------------------------
 // Encode HTML entities. Since all server-generated pages are UTF-8
 // encoded, extended characters are simply represented by their
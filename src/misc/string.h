@@ -47,6 +47,7 @@ void        lowercase(std::string & s);
 bool        compare_i(std::string const & s1, std::string const & s2);
 void        split(std::string const & str, char delimiter, size_t start, mode trim, std::function<bool(std::string &)> callback);
 std::string decodeURI(std::string const & s);
+std::string encodeURI(std::string const & s);
 std::string encodeHtml(std::string const & s);
 long        to_long(std::string const & str, int base);
 
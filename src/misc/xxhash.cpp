@@ -0,0 +1,173 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2020, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#include <cstring>
+
+#include "xxhash.h"
+
+//--------------------------------------------------------------
+// Constants and helpers.
+//--------------------------------------------------------------
+
+namespace {
+
+    uint64_t const PRIME1 = 0x9E3779B185EBCA87ULL;
+    uint64_t const PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    uint64_t const PRIME3 = 0x165667B19E3779F9ULL;
+    uint64_t const PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    uint64_t const PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    inline uint64_t rotl(uint64_t x, int n) {
+        return (x << n) | (x >> (64 - n));
+    }
+
+    inline uint64_t read64(uint8_t const * p) {
+        return static_cast<uint64_t>(p[0])       | static_cast<uint64_t>(p[1]) << 8  | static_cast<uint64_t>(p[2]) << 16 | static_cast<uint64_t>(p[3]) << 24
+             | static_cast<uint64_t>(p[4]) << 32 | static_cast<uint64_t>(p[5]) << 40 | static_cast<uint64_t>(p[6]) << 48 | static_cast<uint64_t>(p[7]) << 56;
+    }
+
+    inline uint32_t read32(uint8_t const * p) {
+        return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+    }
+
+    inline uint64_t round(uint64_t acc, uint64_t input) {
+        return rotl(acc + input * PRIME2, 31) * PRIME1;
+    }
+
+    inline uint64_t merge(uint64_t acc, uint64_t value) {
+        return (acc ^ round(0, value)) * PRIME1 + PRIME4;
+    }
+}
+
+//========================================================================
+// xxh64
+//
+// Implements the XXH64 hashing function. It is much faster than SHA-1,
+// but not cryptographic: use it to detect changes (e.g. entity tags),
+// not to resist an attacker.
+//========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+digest::xxh64::xxh64(uint64_t seed) {
+    init(seed);
+}
+
+//--------------------------------------------------------------
+// Reset the hash function.
+//--------------------------------------------------------------
+
+void digest::xxh64::init(uint64_t seed) {
+    seed_ = seed;
+    count_ = 0;
+    state_[0] = seed + PRIME1 + PRIME2;
+    state_[1] = seed + PRIME2;
+    state_[2] = seed;
+    state_[3] = seed - PRIME1;
+}
+
+//--------------------------------------------------------------
+// Processes a stripe of 32 bytes of data.
+//--------------------------------------------------------------
+
+void digest::xxh64::process(uint8_t const * data) {
+    state_[0] = round(state_[0], read64(data));
+    state_[1] = round(state_[1], read64(data + 8));
+    state_[2] = round(state_[2], read64(data + 16));
+    state_[3] = round(state_[3], read64(data + 24));
+}
+
+//--------------------------------------------------------------
+// Add data to the hash.
+//--------------------------------------------------------------
+
+void digest::xxh64::update(void const * data, size_t length) {
+    uint8_t const * p = static_cast<uint8_t const *>(data);
+    size_t used = static_cast<size_t>(count_ % 32);
+    count_ += length;
+
+    if (used > 0) {
+        size_t count = 32 - used;
+        if (length < count) {
+            memcpy(buffer_ + used, p, length);
+            return;
+        }
+        memcpy(buffer_ + used, p, count);
+        process(buffer_);
+        p += count;
+        length -= count;
+    }
+
+    while (length >= 32) {
+        process(p);
+        p += 32;
+        length -= 32;
+    }
+
+    memcpy(buffer_, p, length);
+}
+
+//--------------------------------------------------------------
+// Return the hash of the data added so far.
+//--------------------------------------------------------------
+
+uint64_t digest::xxh64::finalize() const {
+    uint64_t h;
+    if (count_ >= 32) {
+        h = rotl(state_[0], 1) + rotl(state_[1], 7) + rotl(state_[2], 12) + rotl(state_[3], 18);
+        for (uint64_t v: state_) {
+            h = merge(h, v);
+        }
+    } else {
+        h = seed_ + PRIME5;
+    }
+    h += count_;
+
+    uint8_t const * p = buffer_;
+    size_t length = static_cast<size_t>(count_ % 32);
+    for (; length >= 8; p += 8, length -= 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+    }
+    if (length >= 4) {
+        h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+        length -= 4;
+    }
+    for (; length > 0; p++, length--) {
+        h ^= *p * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+//========================================================================
@@ -0,0 +1,59 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2020, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef XXHASH_H
+#define XXHASH_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace digest {
+
+//--------------------------------------------------------------
+// XXH64 hashing algorithm (non cryptographic).
+//--------------------------------------------------------------
+
+class xxh64 {
+public:
+    xxh64(uint64_t seed = 0);
+
+    void        init(uint64_t seed = 0);
+    void        update(void const * data, size_t length);
+    uint64_t    finalize() const;
+
+private:
+    uint8_t     buffer_[32];
+    uint64_t    state_[4];
+    uint64_t    seed_;
+    uint64_t    count_;
+
+    void        process(uint8_t const * data);
+};
+
+//--------------------------------------------------------------
+
+}
+
+#endif
+
+//========================================================================
@@ -0,0 +1,135 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+#include <thread>
+#include "gtest/gtest.h"
+#include "http/event_hub.h"
+
+using namespace std::literals::chrono_literals;
+
+//--------------------------------------------------------------
+// Test the serialization of an event.
+//--------------------------------------------------------------
+
+TEST(EventHub, Serialize) {
+    EXPECT_EQ(EventHub::serialize(7, "hello", ""), "id: 7\ndata: hello\n\n");
+    EXPECT_EQ(EventHub::serialize(8, "a\r\nb\n", "up\ndate"), "id: 8\nevent: update\ndata: a\ndata: b\ndata: \n\n");
+    EXPECT_EQ(EventHub::serialize(9, "", ""), "id: 9\ndata: \n\n");
+    EXPECT_EQ(EventHub::serialize(10, "a\rb\r\rc\n\rd\r", ""), "id: 10\ndata: a\ndata: b\ndata: \ndata: c\ndata: \ndata: d\ndata: \n\n");
+    EXPECT_EQ(EventHub::serialize(11, "x\revent: evil\rid: 99", "a\r\nb\rc"), "id: 11\nevent: abc\ndata: x\ndata: event: evil\ndata: id: 99\n\n");
+}
+
+//--------------------------------------------------------------
+// Test publishing and fetching events, and resuming from a
+// Last-Event-ID with a bounded backlog.
+//--------------------------------------------------------------
+
+TEST(EventHub, Fetch) {
+    EventHub hub(2);
+    uint64_t cursor = hub.seek("");
+    uint64_t id1 = hub.publish("one");
+    uint64_t id2 = hub.publish("two", "x");
+    EXPECT_EQ(id2, id1 + 1);
+
+    std::string text;
+    EXPECT_EQ(hub.fetch(cursor, text), 2u);
+    EXPECT_EQ(text, EventHub::serialize(id1, "one", "") + EventHub::serialize(id2, "two", "x"));
+    EXPECT_EQ(cursor, id2);
+    text.clear();
+    EXPECT_EQ(hub.fetch(cursor, text), 0u);
+    EXPECT_EQ(text, "");
+
+    uint64_t id3 = hub.publish("three");
+    cursor = hub.seek(std::to_string(id1));
+    EXPECT_EQ(hub.fetch(cursor, text), 2u);
+    EXPECT_EQ(text, EventHub::serialize(id2, "two", "x") + EventHub::serialize(id3, "three", ""));
+
+    text.clear();
+    cursor = hub.seek("1");                 // older than the backlog: what is kept is replayed
+    EXPECT_EQ(hub.fetch(cursor, text), 2u);
+    cursor = hub.seek("99999999999999999"); // newer than the last event: nothing to replay
+    EXPECT_EQ(cursor, id3);
+    cursor = hub.seek("junk");
+    EXPECT_EQ(cursor, id3);
+}
+
+//--------------------------------------------------------------
+// Test waiting for an event in a thread.
+//--------------------------------------------------------------
+
+TEST(EventHub, Wait) {
+    EventHub hub(16);
+    uint64_t cursor = hub.seek("");
+    EXPECT_FALSE(hub.wait(cursor, 10ms));
+
+    std::thread publisher([&hub] {
+        std::this_thread::sleep_for(20ms);
+        hub.publish("event");
+    });
+    EXPECT_TRUE(hub.wait(cursor, 10s));
+    publisher.join();
+
+    std::string text;
+    hub.fetch(cursor, text);
+    hub.close();
+    EXPECT_TRUE(hub.isClosed());
+    EXPECT_FALSE(hub.wait(cursor, 10s));
+}
+
+//--------------------------------------------------------------
+// Test the signals polled by the reactors.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+
+TEST(EventHub, Signal) {
+    EventHub hub(16);
+    uint64_t cursor = hub.seek("");
+    auto signal1 = hub.watch(cursor);
+    auto signal2 = hub.watch(cursor);
+    EXPECT_EQ(signal1, signal2);            // one signal for all the pollers
+
+    struct pollfd pf = { signal1->getHandle(), POLLIN, 0 };
+    EXPECT_EQ(poll(&pf, 1, 0), 0);
+    hub.publish("event");
+    EXPECT_EQ(poll(&pf, 1, 0), 1);
+    EXPECT_EQ(poll(&pf, 1, 0), 1);          // stays ready for all the pollers
+
+    auto signal3 = hub.watch(cursor);       // late: ready right away
+    pf = { signal3->getHandle(), POLLIN, 0 };
+    EXPECT_EQ(poll(&pf, 1, 0), 1);
+
+    std::string text;
+    hub.fetch(cursor, text);
+    auto signal4 = hub.watch(cursor);       // up to date: waits for the next event
+    EXPECT_NE(signal4, signal1);
+    pf = { signal4->getHandle(), POLLIN, 0 };
+    EXPECT_EQ(poll(&pf, 1, 0), 0);
+}
+
+#endif
+
+//========================================================================
@@ -0,0 +1,281 @@
+//========================================================================
+// Zinc - Unit Testing
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#include "gtest/gtest.h"
+#include "http/hpack.h"
+
+#ifdef ZINC_HTTP2
+
+//--------------------------------------------------------------
+// Helper function to convert a string of hex digits into an
+// array of bytes.
+//--------------------------------------------------------------
+
+static std::vector<uint8_t> fromHex(char const * hex) {
+    std::vector<uint8_t> result;
+    for (char const * p = hex; *p; ) {
+        if (isxdigit(p[0]) && isxdigit(p[1])) {
+            result.push_back(static_cast<uint8_t>(std::stoi(std::string(p, 2), nullptr, 16)));
+            p += 2;
+        } else {
+            p++;
+        }
+    }
+    return result;
+}
+
+//--------------------------------------------------------------
+// Test integer representation (RFC 7541, C.1).
+//--------------------------------------------------------------
+
+TEST(Hpack, Integer) {
+    std::vector<uint8_t> out;
+    hpack::encodeInteger(out, 0x00, 5, 10);
+    EXPECT_EQ(out, fromHex("0a"));
+    out.clear();
+    hpack::encodeInteger(out, 0xE0, 5, 1337);
+    EXPECT_EQ(out, fromHex("ff9a0a"));
+    out.clear();
+    hpack::encodeInteger(out, 0x00, 8, 42);
+    EXPECT_EQ(out, fromHex("2a"));
+
+    size_t value;
+    uint8_t const * p = out.data();
+    EXPECT_TRUE(hpack::decodeInteger(p, out.data() + out.size(), 8, value));
+    EXPECT_EQ(value, 42u);
+
+    std::vector<uint8_t> in = fromHex("1f9a0a");
+    p = in.data();
+    EXPECT_TRUE(hpack::decodeInteger(p, in.data() + in.size(), 5, value));
+    EXPECT_EQ(value, 1337u);
+    EXPECT_EQ(p, in.data() + in.size());
+
+    in = fromHex("1f9a");
+    p = in.data();
+    EXPECT_FALSE(hpack::decodeInteger(p, in.data() + in.size(), 5, value));
+    in = fromHex("1fffffffff7f");
+    p = in.data();
+    EXPECT_FALSE(hpack::decodeInteger(p, in.data() + in.size(), 5, value));
+}
+
+//--------------------------------------------------------------
+// Test Huffman coding.
+//--------------------------------------------------------------
+
+TEST(Hpack, Huffman) {
+    std::string str;
+    std::vector<uint8_t> out;
+    hpack::huffmanEncode(out, "www.example.com");
+    EXPECT_EQ(out, fromHex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+    EXPECT_EQ(hpack::huffmanLength("www.example.com"), 12u);
+    EXPECT_TRUE(hpack::huffmanDecode(out.data(), out.size(), str));
+    EXPECT_EQ(str, "www.example.com");
+
+    std::string all;
+    for (int i = 0; i < 256; i++) {
+        all.push_back(static_cast<char>(i));
+    }
+    out.clear();
+    hpack::huffmanEncode(out, all);
+    EXPECT_EQ(out.size(), hpack::huffmanLength(all));
+    EXPECT_TRUE(hpack::huffmanDecode(out.data(), out.size(), str));
+    EXPECT_EQ(str, all);
+
+    uint8_t valid[] = { 0x1F };                     // "a" followed by 3 bits of padding
+    uint8_t zeros[] = { 0x18 };                     // padding not made of ones
+    uint8_t longer[] = { 0x1F, 0xFF };              // padding longer than 7 bits
+    uint8_t eos[] = { 0xFF, 0xFF, 0xFF, 0xFF };     // EOS
+    EXPECT_TRUE(hpack::huffmanDecode(valid, sizeof(valid), str));
+    EXPECT_EQ(str, "a");
+    EXPECT_FALSE(hpack::huffmanDecode(zeros, sizeof(zeros), str));
+    EXPECT_FALSE(hpack::huffmanDecode(longer, sizeof(longer), str));
+    EXPECT_FALSE(hpack::huffmanDecode(eos, sizeof(eos), str));
+}
+
+//--------------------------------------------------------------
+// Test the decoder with requests without Huffman coding
+// (RFC 7541, C.3).
+//--------------------------------------------------------------
+
+TEST(Hpack, DecodeRequests) {
+    hpack::Decoder decoder(4096);
+    hpack::HeaderList headers;
+
+    std::vector<uint8_t> block = fromHex("8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d");
+    EXPECT_TRUE(decoder.decode(block.data(), block.size(), headers));
+    EXPECT_EQ(headers, hpack::HeaderList({ { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" } }));
+
+    headers.clear();
+    block = fromHex("8286 84be 5808 6e6f 2d63 6163 6865");
+    EXPECT_TRUE(decoder.decode(block.data(), block.size(), headers));
+    EXPECT_EQ(headers, hpack::HeaderList({ { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" }, { "cache-control", "no-cache" } }));
+
+    headers.clear();
+    block = fromHex("8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65");
+    EXPECT_TRUE(decoder.decode(block.data(), block.size(), headers));
+    EXPECT_EQ(headers, hpack::HeaderList({ { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" }, { ":authority", "www.example.com" }, { "custom-key", "custom-value" } }));
+}
+
+//--------------------------------------------------------------
+// Test the encoder with requests with Huffman coding (RFC 7541,
+// C.4). The decoder must understand what the encoder produces.
+//--------------------------------------------------------------
+
+TEST(Hpack, EncodeRequests) {
+    hpack::Encoder encoder(4096);
+    hpack::Decoder decoder(4096);
+    hpack::HeaderList decoded;
+    std::vector<uint8_t> block;
+
+    hpack::HeaderList headers1 = { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" } };
+    encoder.encode(headers1, block);
+    EXPECT_EQ(block, fromHex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"));
+    EXPECT_TRUE(decoder.decode(block.data(), block.size(), decoded));
+    EXPECT_EQ(decoded, headers1);
+
+    block.clear();
+    decoded.clear();
+    hpack::HeaderList headers2 = { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" }, { "cache-control", "no-cache" } };
+    encoder.encode(headers2, block);
+    EXPECT_EQ(block, fromHex("8286 84be 5886 a8eb 1064 9cbf"));
+    EXPECT_TRUE(decoder.decode(block.data(), block.size(), decoded));
+    EXPECT_EQ(decoded, headers2);
+
+    block.clear();
+    decoded.clear();
+    hpack::HeaderList headers3 = { { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" }, { ":authority", "www.example.com" }, { "custom-key", "custom-value" } };
+    encoder.encode(headers3, block);
+    EXPECT_EQ(block, fromHex("8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf"));
+    EXPECT_TRUE(decoder.decode(block.data(), block.size(), decoded));
+    EXPECT_EQ(decoded, headers3);
+}
+
+//--------------------------------------------------------------
+// Test eviction and table size updates: after the peer limits
+// the table size, the encoder signals it and the decoder keeps
+// in sync.
+//--------------------------------------------------------------
+
+TEST(Hpack, TableSize) {
+    hpack::Encoder encoder(4096);
+    hpack::Decoder decoder(4096);
+    encoder.setLimit(100);
+
+    for (int i = 0; i < 10; i++) {
+        hpack::HeaderList headers = { { ":status", "200" }, { "x-counter", std::to_string(i) }, { "x-fixed", "constant value" }, { "set-cookie", "id=" + std::to_string(i) } };
+        hpack::HeaderList decoded;
+        std::vector<uint8_t> block;
+        encoder.encode(headers, block);
+        if (i == 0) {
+            EXPECT_EQ(block[0], 0x3F);              // size update to 100
+        }
+        EXPECT_TRUE(decoder.decode(block.data(), block.size(), decoded));
+        EXPECT_EQ(decoded, headers);
+    }
+
+    hpack::Table table(100);
+    table.insert({ "name1", "value1" });
+    table.insert({ "name2", "value2" });
+    table.insert({ "name3", "value3" });
+    EXPECT_EQ(table.getCount(), 2u);
+    EXPECT_EQ(table.getSize(), 86u);
+    hpack::Header header;
+    EXPECT_TRUE(table.get(62, header));
+    EXPECT_EQ(header.first, "name3");
+    EXPECT_FALSE(table.get(64, header));
+    table.setCapacity(50);
+    EXPECT_EQ(table.getCount(), 1u);
+    table.setCapacity(0);
+    EXPECT_EQ(table.getCount(), 0u);
+}
+
+//--------------------------------------------------------------
+// Test decoding errors.
+//--------------------------------------------------------------
+
+TEST(Hpack, Errors) {
+    char const * invalid[] = {
+        "80",                   // index zero
+        "ff00",                 // index out of range
+        "3fe21f",               // table size update above the limit
+        "8220",                 // table size update after a header field
+        "4003 6162",            // truncated string
+        "0081 ff",              // invalid Huffman string
+    };
+
+    for (char const * hex: invalid) {
+        hpack::Decoder decoder(4096);
+        hpack::HeaderList headers;
+        std::vector<uint8_t> block = fromHex(hex);
+        EXPECT_FALSE(decoder.decode(block.data(), block.size(), headers)) << hex;
+    }
+
+    hpack::Decoder decoder(4096);
+    hpack::HeaderList headers;
+    std::vector<uint8_t> block = fromHex("3fe11f 20 82");
+    EXPECT_TRUE(decoder.decode(block.data(), block.size(), headers));
+    EXPECT_EQ(headers, hpack::HeaderList({ { ":method", "GET" } }));
+}
+
+//--------------------------------------------------------------
+// Test the limit on the size of the decoded header list: a
+// large table entry referenced many times by a small block is
+// stopped early.
+//--------------------------------------------------------------
+
+TEST(Hpack, HeaderListLimit) {
+    hpack::Decoder decoder(4096);
+    hpack::HeaderList headers;
+    std::vector<uint8_t> block = { 0x40, 0x01, 'x', 0x7F, 0xA1, 0x1E };     // literal "x" with a 4000-byte value, indexed
+    block.resize(block.size() + 4000, 'a');
+    EXPECT_TRUE(decoder.decode(block.data(), block.size(), headers, 8192));
+    EXPECT_FALSE(decoder.isOverflow());
+    EXPECT_EQ(headers.size(), 1u);
+
+    headers.clear();
+    block.assign(16384, 0xBE);                                              // index 62, the entry above
+    EXPECT_FALSE(decoder.decode(block.data(), block.size(), headers, 8192));
+    EXPECT_TRUE(decoder.isOverflow());
+    EXPECT_EQ(headers.size(), 2u);                                          // 2 x 4033 bytes fit
+
+    hpack::Decoder decoder2(4096);
+    headers.clear();
+    block = fromHex("8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d");
+    EXPECT_TRUE(decoder2.decode(block.data(), block.size(), headers, 4 * 32 + 52));
+    EXPECT_EQ(headers.size(), 4u);                                          // exactly the limit
+    headers.clear();
+    EXPECT_FALSE(decoder2.decode(block.data(), block.size(), headers, 4 * 32 + 51));
+    EXPECT_TRUE(decoder2.isOverflow());
+
+    headers.clear();
+    block = fromHex("80");
+    EXPECT_FALSE(decoder2.decode(block.data(), block.size(), headers));
+    EXPECT_FALSE(decoder2.isOverflow());                                    // other errors
+}
+
+//--------------------------------------------------------------
+
+#endif
+
+//========================================================================
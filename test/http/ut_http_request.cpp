@@ -24,33 +24,10 @@
 #include "gtest/gtest.h"
 #include "misc/logger.h"
 #include "http/http_request.h"
+#include "../streams.h"
 
 using namespace std::literals::chrono_literals;
 
-//--------------------------------------------------------------
-// Helper class to read a string as a stream.
-//--------------------------------------------------------------
-
-class InputString : public InputStream {
-public:
-    InputString(char const * text, size_t length = 0) : text_(text), offset_(0) {
-        length_ = length > 0 ? length : strlen(text);
-    }
-
-    size_t read(void * data, size_t length, std::chrono::milliseconds /*timeout*/, bool /*exact*/) {
-        size_t count = 0;
-        while (count < length && offset_ < length_) {
-            static_cast<char *>(data)[count++] = text_[offset_++];
-        }
-        return count;
-    }
-
-private:
-    char const    * text_;
-    size_t          offset_;
-    size_t          length_;
-};
-
 //--------------------------------------------------------------
 // Test parsing a request (case 1).
 //--------------------------------------------------------------
@@ -237,6 +214,147 @@ TEST(HttpRequest, getBody) {
     EXPECT_STREQ(buffer, "ABCDEF");
 }
 
+//--------------------------------------------------------------
+// Test reading a chunked body, with trailer fields.
+//--------------------------------------------------------------
+
+TEST(HttpRequest, ChunkedBody) {
+    logger::setLevel(logger::error, false);
+    InputString src("POST /store.php HTTP/1.1\nTransfer-Encoding: Chunked\nContent-Type: text/plain\n\n3\r\nABC\r\n4\r\nDEFG\r\n0\r\nX-Checksum: 42\r\nContent-Type: text/html\r\n\r\n");
+
+    HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+    EXPECT_TRUE(req.parse(src, 15s, 1024, 8192, 1024 * 1024).isOK());
+
+    std::vector<uint8_t> content = req.getBody().readAll();
+    EXPECT_EQ(std::string(content.cbegin(), content.cend()), "ABCDEFG");
+    EXPECT_EQ(req.getHeaderValue(HttpHeader("X-Checksum")), "");
+    EXPECT_EQ(req.getHeaderValue(HttpHeader::ContentType), "text/plain");
+    EXPECT_EQ(req.getTrailers().size(), 2u);
+    EXPECT_EQ(req.getTrailers().find(HttpHeader("X-Checksum"))->second, "42");
+}
+
+//--------------------------------------------------------------
+// Test errors when reading a chunked body.
+//--------------------------------------------------------------
+
+TEST(HttpRequest, ChunkedBodyErrors) {
+    logger::setLevel(logger::error, false);
+    auto f = [] (char const * text, size_t limit) {
+        InputString src(text);
+        HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+        HttpRequest::Result r = req.parse(src, 15s, 1024, 8192, limit);
+        return r.isError() ? r.getHttpStatus().getStatusCode() : 0;
+    };
+
+    EXPECT_EQ(f("PUT / HTTP/1.1\nTransfer-Encoding: chunked\n\n5\r\nABCDE\r\n0\r\n\r\n", 5),   0);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nTransfer-Encoding: chunked\n\n5\r\nABCDE\r\n1\r\nF\r\n", 5), 413);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nTransfer-Encoding: chunked\n\n5\r\nABC",                  5),   400);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nTransfer-Encoding: gzip, chunked\n\n",                     5),   501);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nTransfer-Encoding: identity\nContent-Length: 3\n\nABC",    5),   0);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nTransfer-Encoding: chunked\nContent-Length: 2\n\n5\r\nABCDE\r\n0\r\n\r\n", 5), 400);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nContent-Length: 2\nTransfer-Encoding: chunked\n\n5\r\nABCDE\r\n0\r\n\r\n", 5), 400);
+}
+
+//--------------------------------------------------------------
+// Test reading the body to a stream, in a second step.
+//--------------------------------------------------------------
+
+TEST(HttpRequest, BodySink) {
+    logger::setLevel(logger::error, false);
+    InputString src("POST /upload.py HTTP/1.1\nContent-Length: 5\n\nABCDE");
+
+    HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+    EXPECT_TRUE(req.parseHead(src, 15s, 1024, 8192).isOK());
+    EXPECT_EQ(req.getHeaderValue(HttpHeader::ContentLength), "5");
+
+    HexDump sink;
+    EXPECT_TRUE(req.parseBody(src, 15s, 8192, 1024, &sink).isOK());
+    EXPECT_EQ(sink.getRawContent(), "ABCDE");
+    EXPECT_EQ(req.getBody().getSize(), 0);
+}
+
+//--------------------------------------------------------------
+// Test reading an encoded body to a stream without decoding it:
+// only the chunked framing is removed.
+//--------------------------------------------------------------
+
+TEST(HttpRequest, EncodedBodySink) {
+    logger::setLevel(logger::error, false);
+    InputString src("HTTP/1.1 200 OK\nContent-Encoding: compress\nTransfer-Encoding: chunked\nContent-Length: 2\n\n3\r\nABC\r\n2\r\nDE\r\n0\r\n\r\n");
+
+    HttpRequest req;
+    EXPECT_TRUE(req.parseHead(src, 15s, 1024, 8192).isOK());
+
+    HexDump sink;
+    EXPECT_TRUE(req.parseBody(src, 15s, 8192, 1024, &sink, false).isOK());
+    EXPECT_EQ(sink.getRawContent(), "ABCDE");
+    EXPECT_EQ(req.getHeaderValue(HttpHeader::ContentEncoding), "compress");
+    EXPECT_EQ(req.getHeaderValue(HttpHeader::ContentLength), "");     // overridden by the chunked framing
+}
+
+//--------------------------------------------------------------
+// Test the expectsContinue function.
+//--------------------------------------------------------------
+
+TEST(HttpRequest, expectsContinue) {
+    logger::setLevel(logger::error, false);
+    auto f = [] (char const * text) {
+        InputString src(text);
+        HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+        EXPECT_TRUE(req.parseHead(src, 15s, 1024, 8192).isOK());
+        HttpRequest::Result r = req.expectsContinue(1000);
+        return r.isOK() ? 100 : r.isError() ? r.getHttpStatus().getStatusCode() : 0;
+    };
+
+    EXPECT_EQ(f("PUT / HTTP/1.1\nContent-Length: 10\n\n"),                              0);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nExpect: 100-Continue\nContent-Length: 10\n\n"),        100);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nExpect: 100-continue\nContent-Length: 1001\n\n"),      413);
+    EXPECT_EQ(f("PUT / HTTP/1.1\nExpect: 200-ok\nContent-Length: 10\n\n"),              417);
+    EXPECT_EQ(f("PUT / HTTP/1.0\nExpect: 100-continue\nContent-Length: 10\n\n"),        0);
+}
+
+//--------------------------------------------------------------
+// Test reading a compressed body.
+//--------------------------------------------------------------
+
+#if defined(ZINC_COMPRESSION_GZIP)
+
+TEST(HttpRequest, CompressedBody) {
+    logger::setLevel(logger::error, false);
+    static char const text[] = "POST /store.php HTTP/1.1\nContent-Encoding: GZip\nContent-Length: 27\n\n"
+        "\x1F\x8B\x08\x00\x00\x00\x00\x00\x02\x03\x73\x74\x72\x76\x71\x75\x73\x07\x00\xBC\x94\x6F\x0E\x07\x00\x00\x00";
+    InputString src(text, sizeof(text) - 1);
+
+    HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+    EXPECT_TRUE(req.parse(src, 15s, 1024, 8192, 1024 * 1024).isOK());
+
+    std::vector<uint8_t> content = req.getBody().readAll();
+    EXPECT_EQ(std::string(content.cbegin(), content.cend()), "ABCDEFG");
+    EXPECT_EQ(req.getHeaderValue(HttpHeader::ContentEncoding), "");
+
+    InputString src2(text, sizeof(text) - 1);
+    HttpRequest req2(AddrIPv4(), AddrIPv4(), false);
+    HttpRequest::Result r = req2.parse(src2, 15s, 1024, 8192, 6);
+    EXPECT_TRUE(r.isError());
+    EXPECT_EQ(r.getHttpStatus().getStatusCode(), 413);     // the limit applies to the decoded size
+}
+
+#endif
+
+TEST(HttpRequest, CompressedBodyErrors) {
+    logger::setLevel(logger::error, false);
+    InputString src("PUT / HTTP/1.1\nContent-Encoding: compress\nContent-Length: 3\n\nABC");
+
+    HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+    HttpRequest::Result r = req.parse(src, 15s, 1024, 8192, 1024);
+    EXPECT_TRUE(r.isError());
+    EXPECT_EQ(r.getHttpStatus().getStatusCode(), 415);
+
+    InputString src2("PUT / HTTP/1.1\nContent-Encoding: identity\nContent-Length: 3\n\nABC");
+    HttpRequest req2(AddrIPv4(), AddrIPv4(), false);
+    EXPECT_TRUE(req2.parse(src2, 15s, 1024, 8192, 1024).isOK());
+}
+
 //--------------------------------------------------------------
 // Test the addresses and https functions.
 //--------------------------------------------------------------
@@ -106,4 +106,21 @@ TEST(HttpVerb, Set) {
     EXPECT_FALSE(v1.isOneOf(HttpVerb::Head | HttpVerb::Post | HttpVerb::Put));
 }
 
+//--------------------------------------------------------------
+// Test which verbs can be sent again safely.
+//--------------------------------------------------------------
+
+TEST(HttpVerb, Idempotent) {
+    EXPECT_TRUE (HttpVerb("GET").isIdempotent());
+    EXPECT_TRUE (HttpVerb("HEAD").isIdempotent());
+    EXPECT_FALSE(HttpVerb("POST").isIdempotent());
+    EXPECT_TRUE (HttpVerb("PUT").isIdempotent());
+    EXPECT_TRUE (HttpVerb("DELETE").isIdempotent());
+    EXPECT_FALSE(HttpVerb("CONNECT").isIdempotent());
+    EXPECT_TRUE (HttpVerb("OPTIONS").isIdempotent());
+    EXPECT_TRUE (HttpVerb("TRACE").isIdempotent());
+    EXPECT_FALSE(HttpVerb("PATCH").isIdempotent());
+    EXPECT_FALSE(HttpVerb().isIdempotent());
+}
+
 //========================================================================
@@ -0,0 +1,150 @@
+//========================================================================
+// Zinc - Unit Testing
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <atomic>
+#include <thread>
+#include "gtest/gtest.h"
+#include "http/reactor.h"
+
+//--------------------------------------------------------------
+
+class PipeReader : public Reactor::Handler {
+public:
+    PipeReader(int fd, std::string & data, std::atomic<bool> & done)
+      : fd_(fd), data_(data), done_(done) {
+    }
+
+    ~PipeReader() override {
+        ::close(fd_);
+        done_ = true;
+    }
+
+    void prepare(std::vector<struct pollfd> & fds, std::chrono::steady_clock::time_point & /* deadline */) override {
+        fds.push_back({ fd_, POLLIN, 0 });
+    }
+
+    bool process(struct pollfd const * fds) override {
+        char buffer[4];
+        EXPECT_NE(fds[0].revents, 0);
+        ssize_t count = read(fd_, buffer, sizeof(buffer));
+        if (count > 0) {
+            data_.append(buffer, static_cast<size_t>(count));
+        }
+        return count > 0;
+    }
+
+private:
+    int                     fd_;
+    std::string &           data_;
+    std::atomic<bool> &     done_;
+};
+
+class Timer : public Reactor::Handler {
+public:
+    Timer(std::chrono::steady_clock::time_point expires, std::atomic<int> & calls)
+      : expires_(expires), calls_(calls) {
+    }
+
+    void prepare(std::vector<struct pollfd> & /* fds */, std::chrono::steady_clock::time_point & deadline) override {
+        deadline = expires_;
+    }
+
+    bool process(struct pollfd const * /* fds */) override {
+        calls_++;
+        return std::chrono::steady_clock::now() < expires_;
+    }
+
+private:
+    std::chrono::steady_clock::time_point   expires_;
+    std::atomic<int> &                      calls_;
+};
+
+//--------------------------------------------------------------
+// Test a handler waiting for a descriptor.
+//--------------------------------------------------------------
+
+TEST(Reactor, Descriptor) {
+    Reactor reactor;
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    std::string data;
+    std::atomic<bool> done(false);
+    reactor.add(std::make_unique<PipeReader>(fds[0], data, done));
+    EXPECT_EQ(reactor.getHandlerCount(), 1);
+
+    EXPECT_EQ(write(fds[1], "Hello, ", 7), 7);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(write(fds[1], "World!", 6), 6);
+    ::close(fds[1]);
+
+    for (int i = 0; i < 100 && !done; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(done);
+    EXPECT_EQ(data, "Hello, World!");
+    EXPECT_EQ(reactor.getHandlerCount(), 0);
+}
+
+//--------------------------------------------------------------
+// Test a handler waiting for a deadline, and the destruction of
+// the pending handlers when the reactor is stopped.
+//--------------------------------------------------------------
+
+TEST(Reactor, Deadline) {
+    std::atomic<int> calls(0);
+    std::atomic<bool> done(false);
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    auto start = std::chrono::steady_clock::now();
+    Reactor reactor;
+    std::string data;
+    reactor.add(std::make_unique<PipeReader>(fds[0], data, done));
+    reactor.add(std::make_unique<Timer>(start + std::chrono::milliseconds(50), calls));
+    EXPECT_EQ(reactor.getHandlerCount(), 2);
+
+    for (int i = 0; i < 100 && reactor.getHandlerCount() > 1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(reactor.getHandlerCount(), 1);
+    EXPECT_FALSE(done);
+
+    reactor.stop();
+    EXPECT_TRUE(done);
+    EXPECT_EQ(reactor.getHandlerCount(), 0);
+    ::close(fds[1]);
+
+    reactor.add(std::make_unique<Timer>(start, calls));
+    EXPECT_EQ(reactor.getHandlerCount(), 0);
+    EXPECT_EQ(calls, 1);
+}
+
+#endif
+
+//========================================================================
@@ -0,0 +1,184 @@
+//========================================================================
+// Zinc - Unit Testing
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#include <thread>
+#include "gtest/gtest.h"
+#include "http/response_cache.h"
+
+TEST(ResponseCache, Freshness) {
+    std::chrono::seconds maxAge, stale;
+
+    EXPECT_TRUE(ResponseCache::getFreshness("Cache-Control: max-age=60\r\n\r\nbody", maxAge, stale));
+    EXPECT_EQ(maxAge.count(), 60);
+    EXPECT_EQ(stale.count(), 0);
+
+    EXPECT_TRUE(ResponseCache::getFreshness("Content-Type: text/html\ncache-control: public, max-age=60, s-maxage=10, stale-while-revalidate=30\n\n", maxAge, stale));
+    EXPECT_EQ(maxAge.count(), 10);
+    EXPECT_EQ(stale.count(), 30);
+
+    EXPECT_TRUE(ResponseCache::getFreshness("Status: 200 OK\r\nCache-Control: max-age=5\r\n\r\n", maxAge, stale));
+    EXPECT_FALSE(ResponseCache::getFreshness("Status: 404 Not Found\r\nCache-Control: max-age=5\r\n\r\n", maxAge, stale));
+    EXPECT_FALSE(ResponseCache::getFreshness("Set-Cookie: a=b\r\nCache-Control: max-age=5\r\n\r\n", maxAge, stale));
+    EXPECT_FALSE(ResponseCache::getFreshness("Cache-Control: private, max-age=5\r\n\r\n", maxAge, stale));
+    EXPECT_FALSE(ResponseCache::getFreshness("Cache-Control: no-store\r\n\r\n", maxAge, stale));
+    EXPECT_FALSE(ResponseCache::getFreshness("Cache-Control: max-age=0\r\n\r\n", maxAge, stale));
+    EXPECT_FALSE(ResponseCache::getFreshness("Content-Type: text/html\r\n\r\n", maxAge, stale));
+    EXPECT_FALSE(ResponseCache::getFreshness("Cache-Control: max-age=5\r\n", maxAge, stale));
+}
+
+TEST(ResponseCache, LookupStore) {
+    ResponseCache cache(1024);
+    std::string content;
+    std::chrono::seconds age;
+
+    EXPECT_EQ(cache.lookup("GET /a", content, age), ResponseCache::State::Miss);
+    cache.store("GET /a", "Cache-Control: max-age=60\r\n\r\nA");
+    cache.store("GET /b", "Cache-Control: no-cache\r\n\r\nB");
+    EXPECT_EQ(cache.lookup("GET /a", content, age), ResponseCache::State::Hit);
+    EXPECT_EQ(content, "Cache-Control: max-age=60\r\n\r\nA");
+    EXPECT_EQ(age.count(), 0);
+    EXPECT_EQ(cache.lookup("GET /b", content, age), ResponseCache::State::Miss);
+
+    // A response that is not cacheable anymore replaces the stored one.
+
+    cache.store("GET /a", "Status: 500 Internal Server Error\r\n\r\n");
+    EXPECT_EQ(cache.lookup("GET /a", content, age), ResponseCache::State::Miss);
+}
+
+TEST(ResponseCache, Eviction) {
+    std::string header = "Cache-Control: max-age=60\r\n\r\n";
+    std::string body(100 - header.size(), 'x');
+    ResponseCache cache(800);
+    std::string content;
+    std::chrono::seconds age;
+
+    // Responses larger than an eighth of the capacity are not stored.
+
+    cache.store("big", header + body + "x");
+    EXPECT_EQ(cache.lookup("big", content, age), ResponseCache::State::Miss);
+
+    // The least recently used responses are dropped first.
+
+    for (int i = 0; i < 8; i++) {
+        cache.store(std::to_string(i), header + body);
+    }
+    EXPECT_EQ(cache.lookup("0", content, age), ResponseCache::State::Hit);
+    cache.store("8", header + body);
+    EXPECT_EQ(cache.lookup("0", content, age), ResponseCache::State::Hit);
+    EXPECT_EQ(cache.lookup("1", content, age), ResponseCache::State::Miss);
+    EXPECT_EQ(cache.lookup("2", content, age), ResponseCache::State::Hit);
+
+    cache.setCapacity(400);
+    EXPECT_EQ(cache.lookup("3", content, age), ResponseCache::State::Miss);
+    EXPECT_EQ(cache.lookup("2", content, age), ResponseCache::State::Hit);
+}
+
+TEST(ResponseCache, Revalidate) {
+    ResponseCache cache(1024);
+    std::string content;
+    std::chrono::seconds age;
+
+    cache.store("GET /a", "Cache-Control: max-age=1, stale-while-revalidate=60\r\n\r\nA");
+    cache.store("GET /b", "Cache-Control: max-age=1\r\n\r\nB");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    // A single caller refreshes a stale response, the others
+    // are served the stale one in the meantime.
+
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Revalidate);
+    EXPECT_EQ(age.count(), 1);
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Hit);
+    cache.abandon("GET /a");
+    EXPECT_EQ(cache.lookup("GET /a", content, age), ResponseCache::State::Hit);
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Revalidate);
+    cache.store("GET /a", "Cache-Control: max-age=1, stale-while-revalidate=60\r\n\r\nA2");
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Hit);
+    EXPECT_EQ(content, "Cache-Control: max-age=1, stale-while-revalidate=60\r\n\r\nA2");
+
+    // Without stale-while-revalidate, an expired response is gone.
+
+    EXPECT_EQ(cache.lookup("GET /b", content, age), ResponseCache::State::Miss);
+}
+
+TEST(ResponseCache, SingleFlight) {
+    ResponseCache cache(1024);
+    std::string content;
+    std::chrono::seconds age;
+
+    // The first caller leads, the followers get its output, even
+    // if it cannot be stored.
+
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Lead);
+    std::thread leader([&cache] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cache.store("GET /a", "Content-Type: text/plain\r\n\r\nA");
+    });
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true, std::chrono::milliseconds(5000)), ResponseCache::State::Hit);
+    EXPECT_EQ(content, "Content-Type: text/plain\r\n\r\nA");
+    leader.join();
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Lead);
+
+    // Outputs specific to the leader client are not shared, and
+    // followers give up waiting after the timeout.
+
+    cache.store("GET /a", "Set-Cookie: a=b\r\n\r\nA");
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Lead);
+    std::thread leader2([&cache] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cache.store("GET /a", "Set-Cookie: a=b\r\n\r\nA");
+    });
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true, std::chrono::milliseconds(5000)), ResponseCache::State::Miss);
+    leader2.join();
+
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Lead);
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true, std::chrono::milliseconds(50)), ResponseCache::State::Miss);
+    cache.abandon("GET /a");
+    EXPECT_EQ(cache.lookup("GET /a", content, age), ResponseCache::State::Miss);
+}
+
+TEST(ResponseCache, Guard) {
+    ResponseCache cache(1024);
+    std::string content;
+    std::chrono::seconds age;
+
+    // A leader that leaves without storing nor abandoning does
+    // not keep the followers waiting.
+
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Lead);
+    {
+        ResponseCache::Guard guard(cache, "GET /a");
+    }
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Lead);
+
+    // Once stored, the flight is not abandoned again, even if
+    // another caller leads a new one meanwhile.
+
+    {
+        ResponseCache::Guard guard(cache, "GET /a");
+        guard.store("Content-Type: text/plain\r\n\r\nA");
+        EXPECT_EQ(cache.lookup("GET /a", content, age, true), ResponseCache::State::Lead);
+    }
+    EXPECT_EQ(cache.lookup("GET /a", content, age, true, std::chrono::milliseconds(50)), ResponseCache::State::Miss);
+}
+
+//========================================================================
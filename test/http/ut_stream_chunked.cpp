@@ -25,6 +25,8 @@
 #include "http/stream_chunked.h"
 #include "../streams.h"
 
+using namespace std::literals::chrono_literals;
+
 //--------------------------------------------------------------
 // Test the StreamChunked class (case 1).
 //--------------------------------------------------------------
@@ -89,4 +91,87 @@ TEST(StreamChunked, Case5) {
     EXPECT_EQ(os.getRawContent(), "Chunked|10\r\nABCDEFGHIJKLMNOP\r\n10\r\nQRSTUVWXYZabcdef\r\n10\r\nghijklmnopqrstuv\r\n4\r\nwxyz\r\n0\r\n\r\n");
 }
 
+//--------------------------------------------------------------
+// Test the StreamChunked class (sync before the buffer is full).
+//--------------------------------------------------------------
+
+TEST(StreamChunked, Sync) {
+    HexDump os;
+    StreamChunked transformer([&os](long length) { os.emitHeaders(length); }, 10);
+    transformer.setDestination(&os);
+    EXPECT_TRUE(transformer.sync());
+    EXPECT_EQ(os.getRawContent(), "");
+    EXPECT_TRUE(transformer.write("ABC", 3));
+    EXPECT_TRUE(transformer.sync());
+    EXPECT_EQ(os.getRawContent(), "Chunked|3\r\nABC\r\n");
+    EXPECT_TRUE(transformer.write("DE", 2));
+    EXPECT_TRUE(transformer.flush());
+    EXPECT_EQ(os.getRawContent(), "Chunked|3\r\nABC\r\n2\r\nDE\r\n0\r\n\r\n");
+}
+
+//--------------------------------------------------------------
+// Test the StreamDechunked class (case 1).
+//--------------------------------------------------------------
+
+TEST(StreamDechunked, Case1) {
+    InputString src("3\r\nABC\r\n10\r\nDEFGHIJKLMNOPQRS\r\n0\r\n\r\nnext");
+    StreamDechunked decoder(src, 1024);
+
+    char buffer[32];
+    EXPECT_EQ(decoder.read(buffer, sizeof(buffer), 15s, false), 3);
+    EXPECT_EQ(std::string(buffer, 3), "ABC");
+    EXPECT_EQ(decoder.read(buffer, sizeof(buffer), 15s, false), 16);
+    EXPECT_EQ(std::string(buffer, 16), "DEFGHIJKLMNOPQRS");
+    EXPECT_FALSE(decoder.isComplete());
+    EXPECT_EQ(decoder.read(buffer, sizeof(buffer), 15s, false), 0);
+    EXPECT_TRUE(decoder.isComplete());
+    EXPECT_FALSE(decoder.isOverflow());
+
+    EXPECT_EQ(src.read(buffer, sizeof(buffer), 15s, false), 6);
+    EXPECT_EQ(std::string(buffer, 6), "\r\nnext");
+}
+
+//--------------------------------------------------------------
+// Test the StreamDechunked class (case 2: exact reads across
+// chunks, extensions, and LF line endings).
+//--------------------------------------------------------------
+
+TEST(StreamDechunked, Case2) {
+    InputString src("4;name=value\nabcd\na ; x\r\nefghijklmn\r\n0\n");
+    StreamDechunked decoder(src, 1024);
+
+    char buffer[32];
+    EXPECT_EQ(decoder.read(buffer, 6, 15s, true), 6);
+    EXPECT_EQ(std::string(buffer, 6), "abcdef");
+    EXPECT_EQ(decoder.read(buffer, 8, 15s, true), 8);
+    EXPECT_EQ(std::string(buffer, 8), "ghijklmn");
+    EXPECT_EQ(decoder.read(buffer, 8, 15s, true), 0);
+    EXPECT_TRUE(decoder.isComplete());
+}
+
+//--------------------------------------------------------------
+// Test the StreamDechunked class (case 3: errors).
+//--------------------------------------------------------------
+
+TEST(StreamDechunked, Case3) {
+    auto f = [] (char const * text, size_t maxlen, bool overflow) {
+        InputString src(text);
+        StreamDechunked decoder(src, maxlen);
+        char buffer[32];
+        while (decoder.read(buffer, sizeof(buffer), 15s, false)) {
+        }
+        EXPECT_FALSE(decoder.isComplete());
+        EXPECT_EQ(decoder.isOverflow(), overflow);
+    };
+
+    f("",                               1024,   false);
+    f("xyz\r\n",                        1024,   false);
+    f("\r\n",                           1024,   false);
+    f("3\r\nABCD\r\n0\r\n",             1024,   false);
+    f("3\r\nAB",                        1024,   false);
+    f("11111111111111111\r\n",          1024,   false);
+    f("5\r\nABCDE\r\n6\r\nFGHIJK\r\n0\r\n", 10,     true);
+    f("ffffffffffffffff\r\n",           1024,   true);
+}
+
 //========================================================================
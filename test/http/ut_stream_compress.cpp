@@ -74,7 +74,136 @@ TEST(StreamBrotli, Brotli) {
     transformer.setDestination(&os);
     EXPECT_TRUE(transformer.write("AAAAAAAAAA", 10));
     EXPECT_TRUE(transformer.flush());
-    EXPECT_EQ(os.getHexContent(), "8B 04 00 F8 25 82 82 84 00 C0 00");
+    EXPECT_EQ(os.getHexContent(), "1B 09 00 F8 25 82 82 84 00 00");
+}
+
+#endif
+
+//--------------------------------------------------------------
+// Test that what is written before a sync can be decoded at once,
+// and that the stream goes on afterwards.
+//--------------------------------------------------------------
+
+#if defined(ZINC_COMPRESSION_DEFLATE) || defined(ZINC_COMPRESSION_GZIP)
+
+TEST(StreamDeflate, Sync) {
+    HexDump compressed, os;
+    StreamDeflate encoder(false);
+    encoder.setDestination(&compressed);
+    StreamInflate decoder(false);
+    decoder.setDestination(&os);
+
+    EXPECT_TRUE(encoder.write("Hello, ", 7));
+    EXPECT_TRUE(encoder.sync());
+    std::string data = compressed.getRawContent();
+    EXPECT_TRUE(decoder.write(data.data(), data.size()));
+    EXPECT_EQ(os.getRawContent(), "Hello, ");
+
+    EXPECT_TRUE(encoder.write("World!", 6));
+    EXPECT_TRUE(encoder.flush());
+    data = compressed.getRawContent().substr(data.size());
+    EXPECT_TRUE(decoder.write(data.data(), data.size()));
+    EXPECT_TRUE(decoder.flush());
+    EXPECT_EQ(os.getRawContent(), "Hello, World!");
+}
+
+#endif
+
+#if defined(ZINC_COMPRESSION_BROTLI)
+
+TEST(StreamBrotli, Sync) {
+    HexDump compressed, os;
+    StreamBrotli encoder(BROTLI_MODE_TEXT, 0);
+    encoder.setDestination(&compressed);
+    StreamBrotliDecoder decoder;
+    decoder.setDestination(&os);
+
+    EXPECT_TRUE(encoder.write("Hello, ", 7));
+    EXPECT_TRUE(encoder.sync());
+    std::string data = compressed.getRawContent();
+    EXPECT_TRUE(decoder.write(data.data(), data.size()));
+    EXPECT_EQ(os.getRawContent(), "Hello, ");
+
+    EXPECT_TRUE(encoder.write("World!", 6));
+    EXPECT_TRUE(encoder.flush());
+    data = compressed.getRawContent().substr(data.size());
+    EXPECT_TRUE(decoder.write(data.data(), data.size()));
+    EXPECT_TRUE(decoder.flush());
+    EXPECT_EQ(os.getRawContent(), "Hello, World!");
+}
+
+#endif
+
+//--------------------------------------------------------------
+// Test the StreamInflate class (deflate and gzip round trips).
+//--------------------------------------------------------------
+
+#if defined(ZINC_COMPRESSION_DEFLATE) || defined(ZINC_COMPRESSION_GZIP)
+
+TEST(StreamInflate, RoundTrip) {
+    auto f = [] (bool gzip) {
+        HexDump compressed, os;
+        StreamDeflate encoder(gzip);
+        encoder.setDestination(&compressed);
+        EXPECT_TRUE(encoder.write("Hello, World! Hello, World!", 27));
+        EXPECT_TRUE(encoder.flush());
+
+        StreamInflate decoder(gzip);
+        decoder.setDestination(&os);
+        std::string data = compressed.getRawContent();
+        EXPECT_TRUE(decoder.write(data.data(), data.size()));
+        EXPECT_TRUE(decoder.flush());
+        EXPECT_EQ(os.getRawContent(), "Hello, World! Hello, World!");
+    };
+
+    f(false);
+    f(true);
+}
+
+TEST(StreamInflate, Errors) {
+    HexDump os;
+    StreamInflate decoder1(false);
+    decoder1.setDestination(&os);
+    EXPECT_FALSE(decoder1.write("\x78\xDA\xFF\xFF\xFF\xFF", 6));
+
+    StreamInflate decoder2(false);
+    decoder2.setDestination(&os);
+    EXPECT_TRUE(decoder2.write("\x78\xDA\x73\x74", 4));
+    EXPECT_FALSE(decoder2.flush());     // truncated stream
+
+    std::vector<char> zeros(4 * 1024 * 1024);
+    HexDump compressed;
+    StreamDeflate encoder(false);
+    encoder.setDestination(&compressed);
+    EXPECT_TRUE(encoder.write(zeros.data(), zeros.size()));
+    EXPECT_TRUE(encoder.flush());
+
+    StreamInflate decoder3(false, 10);
+    decoder3.setDestination(&os);
+    std::string data = compressed.getRawContent();
+    EXPECT_FALSE(decoder3.write(data.data(), data.size()));
+    EXPECT_TRUE(decoder3.isOverflow());
+}
+
+#endif
+
+//--------------------------------------------------------------
+// Test the StreamBrotliDecoder class.
+//--------------------------------------------------------------
+
+#if defined(ZINC_COMPRESSION_BROTLI)
+
+TEST(StreamBrotliDecoder, RoundTrip) {
+    HexDump os;
+    StreamBrotliDecoder decoder;
+    decoder.setDestination(&os);
+    EXPECT_TRUE(decoder.write("\x8B\x04\x80" "AAAAAAAAAA" "\x03", 14));
+    EXPECT_TRUE(decoder.flush());
+    EXPECT_EQ(os.getRawContent(), "AAAAAAAAAA");
+
+    StreamBrotliDecoder decoder2;
+    decoder2.setDestination(&os);
+    EXPECT_FALSE(decoder2.write("\xFF\xFF\xFF\xFF", 4));
 }
 
 #endif
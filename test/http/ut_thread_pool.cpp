@@ -21,6 +21,7 @@
 // THE SOFTWARE.
 //========================================================================
 
+#include <atomic>
 #include "gtest/gtest.h"
 #include "http/thread_pool.h"
 
@@ -83,4 +84,62 @@ TEST(ThreadPool, Pool) {
     EXPECT_EQ(destructors, 12);
 }
 
+//--------------------------------------------------------------
+// Test the queueing of tasks when the maximum number of threads
+// is reached, and the hand-over of a task once it has run.
+//--------------------------------------------------------------
+
+class HandOverTask : public ThreadPool::Task {
+public:
+    HandOverTask(std::atomic<bool> & release, std::atomic<int> & runs, std::unique_ptr<ThreadPool::Task> & kept)
+      : release_(release), runs_(runs), kept_(kept) {
+    }
+
+    void run(int /* no */) override {
+        while (!release_) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        runs_++;
+    }
+
+    void done(std::unique_ptr<ThreadPool::Task> self) override {
+        if (!kept_) {
+            kept_ = std::move(self);
+        }
+    }
+
+private:
+    std::atomic<bool> &                 release_;
+    std::atomic<int> &                  runs_;
+    std::unique_ptr<ThreadPool::Task> & kept_;
+};
+
+TEST(ThreadPool, Queue) {
+    ThreadPool pool;
+    std::atomic<bool> release(false);
+    std::atomic<int> runs(0);
+    std::unique_ptr<ThreadPool::Task> kept;
+
+    EXPECT_TRUE(pool.addTask(std::make_unique<HandOverTask>(release, runs, kept), 1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(pool.addTask(std::make_unique<HandOverTask>(release, runs, kept), 1));
+    EXPECT_TRUE(pool.addTask(std::make_unique<HandOverTask>(release, runs, kept), 1, true));
+    EXPECT_EQ(pool.getThreadCount(), 1);
+
+    release = true;
+    for (int i = 0; i < 100 && (runs < 2 || pool.getIdleThreadCount() < 1); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(runs, 2);
+    EXPECT_TRUE(kept != nullptr);
+
+    EXPECT_TRUE(pool.addTask(std::move(kept), 1));
+    for (int i = 0; i < 100 && runs < 3; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    pool.stopAll();
+    EXPECT_EQ(runs, 3);
+    EXPECT_TRUE(kept != nullptr);
+}
+
 //========================================================================
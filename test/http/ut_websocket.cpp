@@ -37,6 +37,25 @@ static std::string makeString(size_t n) {
     return ret;
 }
 
+//--------------------------------------------------------------
+// Helper function to serialize a frame. With a masking key, the
+// frame is masked as a client would send it.
+//--------------------------------------------------------------
+
+static std::string serialize(WebSocket::Frame const & frame, uint8_t const * key) {
+    std::vector<uint8_t> data = frame.serialize();
+    std::string raw(data.cbegin(), data.cend());
+    if (key) {
+        size_t offset = (raw[1] & 0x7F) == 126 ? 4 : (raw[1] & 0x7F) == 127 ? 10 : 2;
+        raw[1] = static_cast<char>(raw[1] | 0x80);
+        raw.insert(offset, reinterpret_cast<char const *>(key), 4);
+        WebSocket::ApplyMask(reinterpret_cast<uint8_t *>(&raw[0]) + offset + 4, raw.size() - offset - 4, key);
+    }
+    return raw;
+}
+
+static uint8_t const key[4] = { 0x78, 0x56, 0x34, 0x12 };
+
 //--------------------------------------------------------------
 // Fake random number generator.
 //--------------------------------------------------------------
@@ -78,11 +97,11 @@ TEST(WebSocket, Nonce) {
 
 TEST(WebSocket, TextFrameOut) {
     auto t = [] (std::string const & text, bool masked) -> std::string {
-        HexDump os;
-        FakePRNG prng;
         WebSocket::Frame frame;
         frame.setTextMessage(text.c_str());
-        frame.send(os, prng, masked);
+        std::string raw = serialize(frame, masked ? key : nullptr);
+        HexDump os;
+        os.write(raw.data(), raw.size());
         return os.getHexContent(24);
     };
 
@@ -106,11 +125,11 @@ TEST(WebSocket, TextFrameOut) {
 
 TEST(WebSocket, BinaryFrameOut) {
     auto t = [] (std::string const & text, bool masked) -> std::string {
-        HexDump os;
-        FakePRNG prng;
         WebSocket::Frame frame;
         frame.setBinaryMessage(text.data(), text.size());
-        frame.send(os, prng, masked);
+        std::string raw = serialize(frame, masked ? key : nullptr);
+        HexDump os;
+        os.write(raw.data(), raw.size());
         return os.getHexContent(24);
     };
 
@@ -128,6 +147,124 @@ TEST(WebSocket, BinaryFrameOut) {
     EXPECT_EQ(t(makeString(200000), true),   "82 FF 00 00 00 00 00 03 0D 40 78 56 34 12 39 14 77 56 3D 10 73 5A 31 1C");
 }
 
+//--------------------------------------------------------------
+// Test incremental decoding of incoming frames.
+//--------------------------------------------------------------
+
+TEST(WebSocket, Decode) {
+    auto t = [] (std::string const & text, bool masked) -> bool {
+        WebSocket::Frame frame;
+        frame.setTextMessage(text.c_str());
+        std::string raw = serialize(frame, masked ? key : nullptr);
+        auto data = reinterpret_cast<uint8_t const *>(raw.data());
+
+        // Every truncated buffer is incomplete, the whole buffer
+        // is a frame, and trailing data are not consumed.
+
+        WebSocket::Frame decoded;
+        for (size_t n = 0; n < raw.size(); n += 1 + n / 4) {
+            if (decoded.decode(data, n, 1000000) != 0) {
+                return false;
+            }
+        }
+        raw.append("\x81\x00", 2);
+        data = reinterpret_cast<uint8_t const *>(raw.data());
+        return decoded.decode(data, raw.size(), 1000000) == static_cast<long>(raw.size() - 2)
+            && decoded.getMessageType() == WebSocket::Frame::Text
+            && decoded.getTextMessage() == text;
+    };
+
+    EXPECT_TRUE(t("", false));
+    EXPECT_TRUE(t("Hello", false));
+    EXPECT_TRUE(t("Hello", true));
+    EXPECT_TRUE(t(makeString(125),    true));
+    EXPECT_TRUE(t(makeString(126),    true));
+    EXPECT_TRUE(t(makeString(65535),  false));
+    EXPECT_TRUE(t(makeString(65536),  true));
+    EXPECT_TRUE(t(makeString(200000), true));
+
+    uint8_t big[] = { 0x82, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00 };
+    WebSocket::Frame frame;
+    EXPECT_EQ(frame.decode(big, sizeof(big), 1000000), -1);
+    EXPECT_EQ(frame.decode(big, sizeof(big), 1048576), 0);
+}
+
+//--------------------------------------------------------------
+// Test masking against a byte per byte reference, at various
+// lengths and alignments.
+//--------------------------------------------------------------
+
+TEST(WebSocket, Mask) {
+    uint8_t const mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+    std::vector<uint8_t> source(300);
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+
+    for (size_t start = 0; start < 8; start++) {
+        for (size_t length = 0; length + start <= source.size(); length += 1 + length / 8) {
+            std::vector<uint8_t> data(source);
+            WebSocket::ApplyMask(data.data() + start, length, mask);
+            for (size_t i = 0; i < data.size(); i++) {
+                uint8_t expected = i >= start && i < start + length ? source[i] ^ mask[(i - start) & 3] : source[i];
+                ASSERT_EQ(data[i], expected) << "start " << start << ", length " << length << ", offset " << i;
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------
+// Test decoding binary frames sent by a client.
+//--------------------------------------------------------------
+
+TEST(WebSocket, FrameIn) {
+    auto t = [] (std::string const & text) -> bool {
+        WebSocket::Frame frame;
+        frame.setBinaryMessage(text.data(), text.size());
+        std::string raw = serialize(frame, key);
+
+        WebSocket::Frame received;
+        return received.decode(reinterpret_cast<uint8_t const *>(raw.data()), raw.size(), 1000000) == static_cast<long>(raw.size())
+            && received.getMessageType() == WebSocket::Frame::Binary
+            && received.getTextMessage() == text;
+    };
+
+    EXPECT_TRUE(t("Hello"));
+    EXPECT_TRUE(t(makeString(126)));
+    EXPECT_TRUE(t(makeString(65536)));
+    EXPECT_TRUE(t(makeString(200001)));
+}
+
+//--------------------------------------------------------------
+// Test decoding only the header of a frame, as done for large
+// frames whose payload is then received in place.
+//--------------------------------------------------------------
+
+TEST(WebSocket, HeaderIn) {
+    std::string text = makeString(70000);
+    WebSocket::Frame frame;
+    frame.setTextMessage(text.c_str());
+    std::string raw = serialize(frame, key);
+    auto data = reinterpret_cast<uint8_t const *>(raw.data());
+
+    WebSocket::Frame received;
+    size_t size = 0;
+    EXPECT_EQ(received.decodeHeader(data, 1, 1000000, size), 0);
+    EXPECT_EQ(received.decodeHeader(data, 13, 1000000, size), 0);       // masking key incomplete
+    EXPECT_EQ(received.decodeHeader(data, 14, 1000000, size), 14);
+    EXPECT_EQ(size, text.size());
+    EXPECT_EQ(received.decodeHeader(data, 14, 69999, size), -1);
+    EXPECT_EQ(received.decode(data, raw.size() - 1, 1000000), 0);
+
+    received.setBinaryMessage(data + 14, size);                         // payload as received, still masked
+    EXPECT_EQ(received.decodeHeader(data, raw.size(), 1000000, size), 14);
+    received.unmask();
+    EXPECT_EQ(received.getMessageType(), WebSocket::Frame::Text);
+    EXPECT_EQ(received.getTextMessage(), text);
+    received.unmask();                                                  // only once
+    EXPECT_EQ(received.getTextMessage(), text);
+}
+
 //--------------------------------------------------------------
 
 #endif
@@ -44,12 +44,18 @@ TEST(Config, DefaultValues) {
 
     EXPECT_EQ(cfg.getListeningPort(),       8080                );
     EXPECT_EQ(cfg.getLimitThreads(),        32                  );
+    EXPECT_EQ(cfg.getReactorThreads(),      1                   );
     EXPECT_EQ(cfg.getLimitRequestLine(),    2048                );
     EXPECT_EQ(cfg.getLimitRequestHeaders(), 8192                );
     EXPECT_EQ(cfg.getLimitRequestBody(),    32 * 1024 * 1024    );
     EXPECT_EQ(cfg.isCompressionEnabled(),   true                );
     EXPECT_EQ(cfg.getDirectoryIndexes(),    indexes             );
     EXPECT_EQ(cfg.isListingEnabled(),       true                );
+    EXPECT_EQ(cfg.getEventStream(),         ""                  );
+    EXPECT_EQ(cfg.getEventBacklog(),        256                 );
+    EXPECT_EQ(cfg.getEventHeartbeat(),      15s                 );
+    EXPECT_EQ(cfg.getWebSocketQueue(),      1024 * 1024         );
+    EXPECT_EQ(cfg.isSlowClientDropped(),    false               );
     EXPECT_EQ(cfg.getTimeout(),             30s                 );
     EXPECT_EQ(cfg.getExpires(),             3600s               );
 
@@ -98,21 +104,60 @@ TEST(Config, Save) {
         "###############################",
         "[Server]",
         "Listen = 8080",
+        "Certificate =",
+        "PrivateKey =",
         "LimitThreads = 32",
+        "ReactorThreads = 1",
         "LimitRequestLine = 2048",
         "LimitRequestHeaders = 8192",
         "LimitRequestBody = 33554432",
+        "BodyBufferSize = 65536",
+        "TempDirectory =",
         "Compression = yes",
         "DirectoryIndex = index.html index.xhtml index.htm index.php index.py",
         "DirectoryListing = yes",
+        "ProxyPass =",
+        "EventStream =",
+        "EventBacklog = 256",
+        "EventHeartbeat = 15",
+        "WebSocketQueue = 1048576",
+        "WebSocketSlowClient = close",
+        "HostnameLookups = yes",
+        "CacheSize = 16777216",
         "Timeout = 30",
         "Expires = 3600",
         "[PHP]",
         "Extensions = php php7",
         "CmdLine =",
+        "StreamBody = no",
+        "FastCGI =",
+        "FastCGIWorkers = 0",
+        "Zygote =",
+        "MaxProcesses = 0",
+        "TimeLimit = 0",
+        "CPULimit = 0",
+        "MemoryLimit = 0",
+        "Cache = no",
+        "CacheVary =",
+        "XSendFilePath =",
+        "ETagLimit = 0",
+        "FlushDelay = 20",
         "[Python]",
         "Extensions = py",
         "CmdLine =",
+        "StreamBody = no",
+        "FastCGI =",
+        "FastCGIWorkers = 0",
+        "Zygote =",
+        "MaxProcesses = 0",
+        "TimeLimit = 0",
+        "CPULimit = 0",
+        "MemoryLimit = 0",
+        "Cache = no",
+        "CacheVary =",
+        "XSendFilePath =",
+        "ETagLimit = 0",
+        "FlushDelay = 20",
     };
 
     EXPECT_EQ(lines, ref);
@@ -142,6 +187,7 @@ TEST(Config, Load) {
         "Extensions = foo\n"
         "Interpreter = /usr/bin/foo\n"
         "CmdLine = -x\n"
+        "StreamBody = yes\n"
         "\n";
 
     Configuration cfg;
@@ -165,6 +211,46 @@ TEST(Config, Load) {
     EXPECT_EQ(cgi->getSectionName(),    "Foo");
     EXPECT_EQ(cgi->getInterpreter(),    "/usr/bin/foo");
     EXPECT_EQ(cgi->getCmdLine(),        "-x");
+    EXPECT_EQ(cgi->isBodyStreamed(),    true);
+}
+
+//--------------------------------------------------------------
+// Test the ProxyPass parameter.
+//--------------------------------------------------------------
+
+TEST(Config, ProxyPass) {
+    EXPECT_TRUE(Configuration::parseProxyPass("", nullptr));
+    EXPECT_TRUE(Configuration::parseProxyPass("/api=http://127.0.0.1:3000  /=http://localhost/site/", nullptr));
+    EXPECT_FALSE(Configuration::parseProxyPass("api=http://127.0.0.1", nullptr));
+    EXPECT_FALSE(Configuration::parseProxyPass("/api=https://127.0.0.1", nullptr));
+    EXPECT_FALSE(Configuration::parseProxyPass("/api=http://127.0.0.1:0", nullptr));
+    EXPECT_FALSE(Configuration::parseProxyPass("/api=http://:80", nullptr));
+    EXPECT_FALSE(Configuration::parseProxyPass("/api", nullptr));
+
+    std::string ref =
+        "[Server]\n"
+        "ProxyPass = /=http://127.0.0.1:3000/site/ /api/=http://127.0.0.1:4000 /api/v2=http://127.0.0.1:5000/v2\n"
+        "\n";
+
+    Configuration cfg;
+    std::istringstream ss(ref);
+    cfg.load(ss, "zinc.ini");
+
+    Configuration::Proxy const * proxy = cfg.getProxy("/api/v2/users");
+    ASSERT_NE(proxy, nullptr);
+    EXPECT_EQ(proxy->prefix,    "/api/v2"                       );
+    EXPECT_EQ(proxy->host,      "127.0.0.1:5000"                );
+    EXPECT_EQ(proxy->path,      "/v2"                           );
+    EXPECT_EQ(proxy->address,   AddrIPv4(0x7F000001, 5000)      );
+
+    EXPECT_EQ(cfg.getProxy("/api")->prefix,     "/api"          );
+    EXPECT_EQ(cfg.getProxy("/api/v2")->prefix,  "/api/v2"       );
+    EXPECT_EQ(cfg.getProxy("/api/v23")->prefix, "/api"          );
+    EXPECT_EQ(cfg.getProxy("/apix")->prefix,    "/"             );
+    EXPECT_EQ(cfg.getProxy("/apix")->path,      "/site"         );
+
+    Configuration empty;
+    EXPECT_EQ(empty.getProxy("/api"), nullptr);
 }
 
 //========================================================================
@@ -0,0 +1,71 @@
+//========================================================================
+// Zinc - Web Server
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+
+#include "gtest/gtest.h"
+#include "main/resource_fastcgi.h"
+
+//--------------------------------------------------------------
+// Test the appendRecord function.
+//--------------------------------------------------------------
+
+TEST(ResourceFastCGI, appendRecord) {
+    std::string out;
+
+    ResourceFastCGI::appendRecord(out, 5, nullptr, 0);
+    EXPECT_EQ(out, std::string("\x01\x05\x00\x01\x00\x00\x00\x00", 8));
+
+    out.clear();
+    ResourceFastCGI::appendRecord(out, 6, "hello", 5);
+    EXPECT_EQ(out, std::string("\x01\x06\x00\x01\x00\x05\x03\x00hello\x00\x00\x00", 16));
+
+    out.clear();
+    std::string content(300, 'x');
+    ResourceFastCGI::appendRecord(out, 4, content.data(), content.size());
+    EXPECT_EQ(out.size(), 8u + 304u);
+    EXPECT_EQ(out.substr(0, 8), std::string("\x01\x04\x00\x01\x01\x2C\x04\x00", 8));
+}
+
+//--------------------------------------------------------------
+// Test the appendParam function.
+//--------------------------------------------------------------
+
+TEST(ResourceFastCGI, appendParam) {
+    std::string out;
+
+    ResourceFastCGI::appendParam(out, "A", "");
+    EXPECT_EQ(out, std::string("\x01\x00" "A", 3));
+
+    out.clear();
+    ResourceFastCGI::appendParam(out, "QUERY_STRING", "x=1");
+    EXPECT_EQ(out, std::string("\x0C\x03" "QUERY_STRINGx=1", 17));
+
+    out.clear();
+    std::string value(200, 'v');
+    ResourceFastCGI::appendParam(out, "HTTP_COOKIE", value);
+    EXPECT_EQ(out.size(), 1u + 4u + 11u + 200u);
+    EXPECT_EQ(out.substr(0, 5), std::string("\x0B\x80\x00\x00\xC8", 5));
+    EXPECT_EQ(out.substr(5, 11), "HTTP_COOKIE");
+}
+
+//========================================================================
@@ -22,7 +22,15 @@
 //========================================================================
 
 #include "gtest/gtest.h"
+#include "misc/logger.h"
 #include "main/resource_script.h"
+#include "../streams.h"
+
+#ifndef _WIN32
+#include <fstream>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 
 //--------------------------------------------------------------
 // Test the buildArguments function.
@@ -57,4 +65,138 @@ TEST(ResourceScript, buildArguments) {
     EXPECT_EQ(f(php, "-x 'a\\b c' d", "test.php"),   std::vector<std::string>({ exe, "-x", "a\\b c", "d", "test.php"   }));
 }
 
+//--------------------------------------------------------------
+// Test that no interpreter is spawned to stream a request body
+// that is known to exceed the limit.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+TEST(ResourceScript, getBodySink) {
+    auto f = [] (char const * text, size_t limit) {
+        Configuration::CGI cgi("test", "xxx", "/bin/cat", "");
+        std::string err;
+        EXPECT_TRUE(cgi.loadParameter("StreamBody", "yes", err));
+        ResourceScript res("test.sh", "test.sh", "", cgi);
+        InputString src(text);
+        HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+        EXPECT_TRUE(req.parseHead(src, std::chrono::seconds(15), 1024, 8192).isOK());
+        return res.getBodySink(req, limit) != nullptr;
+    };
+
+    EXPECT_FALSE(f("POST /test.sh HTTP/1.1\nContent-Length: 1025\n\n",                          1024));
+    EXPECT_FALSE(f("POST /test.sh HTTP/1.1\nContent-Length: 0\n\n",                             1024));
+    EXPECT_FALSE(f("POST /test.sh HTTP/1.1\nTransfer-Encoding: chunked\n\n",                     1024));
+}
+#endif
+
+//--------------------------------------------------------------
+// Test the entity tags computed on the interpreter output.
+//--------------------------------------------------------------
+
+TEST(ResourceScript, EntityTag) {
+    logger::setLevel(logger::error, false);
+    auto f = [] (std::string const & output, char const * ifNoneMatch, size_t limit) {
+        std::string text = std::string("GET /test.sh HTTP/1.1\n") + (*ifNoneMatch ? "If-None-Match: " + std::string(ifNoneMatch) + "\n" : "") + "\n";
+        InputString src(text.c_str());
+        HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+        EXPECT_TRUE(req.parseHead(src, std::chrono::seconds(15), 1024, 8192).isOK());
+        HexDump dst;
+        ResourceScript::EntityTag etag(&dst, req, limit);
+        etag.write(output.data(), output.size());
+        etag.finish();
+        return dst.getRawContent();
+    };
+
+    // Tag computed from the body, always weak.
+
+    std::string output = "Content-Type: text/plain\nContent-Length: 5\n\nhello";
+    std::string result = f(output, "", 1024);
+    ASSERT_EQ(result.compare(0, 9, "ETag: W/\""), 0);
+    size_t eol = result.find("\r\n");
+    ASSERT_NE(eol, std::string::npos);
+    std::string tag = result.substr(6, eol - 6);
+    EXPECT_EQ(tag.size(), 20);
+    EXPECT_EQ(result, "ETag: " + tag + "\r\nCache-Control: no-cache\r\n" + output);
+    EXPECT_EQ(f("Content-Type: text/plain\n\nhello", "", 1024), result.substr(0, result.size() - output.size()) + "Content-Type: text/plain\n\nhello");
+    EXPECT_NE(f("Content-Type: text/html\n\nhello", "", 1024).substr(0, eol), result.substr(0, eol));
+
+    // If-None-Match, with the weak comparison.
+
+    std::string notModified = "Status: 304 Not Modified\r\nETag: " + tag + "\r\nCache-Control: no-cache\r\nContent-Type: text/plain\r\n\r\n";
+    EXPECT_EQ(f(output, tag.c_str(), 1024), notModified);
+    EXPECT_EQ(f(output, tag.c_str() + 2, 1024), notModified);
+    EXPECT_EQ(f(output, ("\"abc\", " + tag + " , \"def\"").c_str(), 1024), notModified);
+    EXPECT_EQ(f(output, "*", 1024), notModified);
+    EXPECT_EQ(f(output, "\"abc\", W/\"def\"", 1024), result);
+    EXPECT_EQ(f(output, "W/", 1024), result);
+
+    // Tag set by the script itself.
+
+    std::string tagged = "ETag: \"v1\"\nContent-Type: text/plain\n\nhello";
+    EXPECT_EQ(f(tagged, "", 1024), "Cache-Control: no-cache\r\n" + tagged);
+    EXPECT_EQ(f(tagged, "W/\"v1\"", 1024), "Status: 304 Not Modified\r\nCache-Control: no-cache\r\nETag: \"v1\"\r\nContent-Type: text/plain\r\n\r\n");
+
+    // Outputs forwarded as-is: not successful, designating a
+    // file, without header block or exceeding the limit.
+
+    for (std::string text: { "Status: 404 Not Found\n\nmissing", "X-Sendfile: /tmp/foo\n\n", "hello", "Content-Type: text/plain\n\nhello world" }) {
+        EXPECT_EQ(f(text, "*", 32), text);
+    }
+    std::string big = "Content-Type: text/plain\n\n" + std::string(100, 'x');
+    EXPECT_EQ(f(big, "*", 64), big);
+}
+
+//--------------------------------------------------------------
+// Test the checks on files designated with X-Sendfile.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+TEST(ResourceScript, isSendable) {
+    char root[] = "/tmp/zinc-xsendfile-XXXXXX";
+    ASSERT_NE(mkdtemp(root), nullptr);
+    std::string base(root);
+
+    ASSERT_EQ(mkdir((base + "/public").c_str(), 0700), 0);
+    ASSERT_EQ(mkdir((base + "/public2").c_str(), 0700), 0);
+    ASSERT_EQ(mkdir((base + "/private").c_str(), 0700), 0);
+    ASSERT_EQ(mkdir((base + "/scripts").c_str(), 0700), 0);
+    std::ofstream(base + "/public/a.txt") << "a";
+    std::ofstream(base + "/public2/b.txt") << "b";
+    std::ofstream(base + "/private/c.txt") << "c";
+    ASSERT_EQ(symlink((base + "/private/c.txt").c_str(), (base + "/public/link.txt").c_str()), 0);
+
+    Configuration::CGI cgi("test", "xxx", "/bin/sh", "");
+    std::string err;
+    EXPECT_TRUE(cgi.loadParameter("XSendFilePath", base + "/public", err));
+    ResourceScript res(base + "/scripts/test.sh", "/test.sh", "", cgi);
+
+    auto f = [&res] (std::string const & name) {
+        fs::filepath filename(name);
+        return res.isSendable(filename);
+    };
+
+    EXPECT_TRUE(f(base + "/public/a.txt"));
+    EXPECT_TRUE(f(base + "/scripts/../public/a.txt"));
+    EXPECT_TRUE(f("../public/a.txt"));
+    EXPECT_FALSE(f(base + "/public/missing.txt"));
+    EXPECT_FALSE(f(base + "/public"));
+    EXPECT_FALSE(f(base + "/public2/b.txt"));
+    EXPECT_FALSE(f(base + "/private/c.txt"));
+    EXPECT_FALSE(f(base + "/public/../private/c.txt"));
+    EXPECT_FALSE(f("../private/c.txt"));
+    EXPECT_FALSE(f(base + "/public/link.txt"));
+
+    fs::filepath filename("../public/a.txt");
+    EXPECT_TRUE(res.isSendable(filename));
+    EXPECT_EQ(filename.getStdString(), fs::filepath(base + "/public/a.txt").makeAbsolute().getStdString());
+
+    for (char const * name: { "/public/link.txt", "/public/a.txt", "/public2/b.txt", "/private/c.txt" }) {
+        unlink((base + name).c_str());
+    }
+    for (char const * name: { "/public", "/public2", "/private", "/scripts", "" }) {
+        rmdir((base + name).c_str());
+    }
+}
+#endif
+
 //========================================================================
@@ -0,0 +1,98 @@
+//========================================================================
+// Zinc - Unit Testing
+// Copyright (c) 2019, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#include "gtest/gtest.h"
+#include "misc/logger.h"
+#include "main/resource_static_file.h"
+#include "../streams.h"
+
+//--------------------------------------------------------------
+// Test the getRange function.
+//--------------------------------------------------------------
+
+TEST(ResourceStaticFile, getRange) {
+    logger::setLevel(logger::error, false);
+    date modified = date::from_http("Wed, 21 Oct 2015 07:28:00 GMT");
+    size_t first, last;
+
+    auto f = [&] (char const * fields, size_t size) {
+        std::string text = std::string("GET /test.bin HTTP/1.1\n") + fields + "\n";
+        InputString src(text.c_str());
+        HttpRequest req(AddrIPv4(), AddrIPv4(), false);
+        EXPECT_TRUE(req.parseHead(src, std::chrono::seconds(15), 1024, 8192).isOK());
+        first = 0;
+        last = size - 1;
+        return ResourceStaticFile::getRange(req, modified, size, first, last);
+    };
+
+    EXPECT_EQ(f("", 1000), 0);
+    EXPECT_EQ(f("Range: items=0-10\n", 1000), 0);
+    EXPECT_EQ(f("Range: bytes=0-99\n", 1000), 1);
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(last, 99);
+    EXPECT_EQ(f("Range: bytes=500-\n", 1000), 1);
+    EXPECT_EQ(first, 500);
+    EXPECT_EQ(last, 999);
+    EXPECT_EQ(f("Range: bytes=900-5000\n", 1000), 1);
+    EXPECT_EQ(first, 900);
+    EXPECT_EQ(last, 999);
+    EXPECT_EQ(f("Range: bytes=0-0,10-20\n", 1000), 0);
+    EXPECT_EQ(f("Range: bytes=20-10\n", 1000), 0);
+    EXPECT_EQ(f("Range: bytes=a-10\n", 1000), 0);
+    EXPECT_EQ(f("Range: bytes=-\n", 1000), 0);
+
+    // Suffix ranges.
+
+    EXPECT_EQ(f("Range: bytes=-100\n", 1000), 1);
+    EXPECT_EQ(first, 900);
+    EXPECT_EQ(last, 999);
+    EXPECT_EQ(f("Range: bytes=-5000\n", 1000), 1);
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(last, 999);
+    EXPECT_EQ(f("Range: bytes=-0\n", 1000), -1);
+    EXPECT_EQ(f("Range: bytes=-10\n", 0), -1);
+
+    // Unsatisfiable ranges.
+
+    EXPECT_EQ(f("Range: bytes=1000-\n", 1000), -1);
+    EXPECT_EQ(f("Range: bytes=1000-2000\n", 1000), -1);
+    EXPECT_EQ(f("Range: bytes=0-\n", 0), -1);
+
+    // Numbers too large to be converted are ignored rather than
+    // wrapped around.
+
+    EXPECT_EQ(f("Range: bytes=0-99999999999999999999999\n", 1000), 0);
+    EXPECT_EQ(f("Range: bytes=99999999999999999999999-\n", 1000), 0);
+    EXPECT_EQ(f("Range: bytes=-99999999999999999999999\n", 1000), 0);
+    EXPECT_EQ(f("Range: bytes=999999999999999999-\n", 1000), -1);
+
+    // Conditional ranges.
+
+    EXPECT_EQ(f("Range: bytes=0-99\nIf-Range: Wed, 21 Oct 2015 07:28:00 GMT\n", 1000), 1);
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(last, 99);
+    EXPECT_EQ(f("Range: bytes=0-99\nIf-Range: Thu, 22 Oct 2015 07:28:00 GMT\n", 1000), 0);
+    EXPECT_EQ(f("Range: bytes=0-99\nIf-Range: \"abc\"\n", 1000), 0);
+}
+
+//========================================================================
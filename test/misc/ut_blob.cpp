@@ -24,6 +24,10 @@
 #include "gtest/gtest.h"
 #include "misc/blob.h"
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 //--------------------------------------------------------------
 // Test the blob class.
 //--------------------------------------------------------------
@@ -42,4 +46,65 @@ TEST(Blob, Creation) {
     EXPECT_STREQ(reinterpret_cast<char const *>(content.data()), "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789abcdefghijklmnopqrstuvwxyz");
 }
 
+//--------------------------------------------------------------
+// Test moving the content of a blob to a temporary file.
+//--------------------------------------------------------------
+
+TEST(Blob, Spill) {
+    blob::setSpillPolicy(16, "");
+
+    blob f;
+    EXPECT_TRUE(f.write("ABCDEFGHIJ", 10));
+    EXPECT_TRUE(f.isInMemory());
+    EXPECT_TRUE(f.write("KLMNOPQRST", 10));
+    EXPECT_FALSE(f.isInMemory());
+    EXPECT_EQ(f.getSize(), 20);
+
+    blob g;
+    EXPECT_FALSE(IS_HANDLE_VALID(g.getFileDescriptor()));
+    EXPECT_TRUE(g.write("0123456789", 10));
+    EXPECT_TRUE(IS_HANDLE_VALID(g.getFileDescriptor()));
+    EXPECT_FALSE(g.isInMemory());
+    EXPECT_TRUE(g.write("ABC", 3));
+
+    std::vector<uint8_t> content = g.readAll();
+    EXPECT_EQ(std::string(content.cbegin(), content.cend()), "0123456789ABC");
+    content = f.readAll();
+    EXPECT_EQ(std::string(content.cbegin(), content.cend()), "ABCDEFGHIJKLMNOPQRST");
+
+    blob::setSpillPolicy(64 * 1024, "");
+}
+
+//--------------------------------------------------------------
+// Test filling a blob from a file descriptor.
+//--------------------------------------------------------------
+
+#ifndef _WIN32
+
+TEST(Blob, Receive) {
+    auto f = [] (size_t threshold) {
+        blob::setSpillPolicy(threshold, "");
+        int p[2];
+        EXPECT_EQ(pipe(p), 0);
+        EXPECT_EQ(::write(p[1], "ABCDEFGHIJKLMNOPQRSTUVWXYZ", 26), 26);
+        close(p[1]);
+
+        blob b;
+        EXPECT_TRUE(b.write("0123", 4));
+        EXPECT_EQ(b.receive(p[0], 20), 20);
+        EXPECT_EQ(b.receive(p[0], 20), 6);
+        close(p[0]);
+
+        std::vector<uint8_t> content = b.readAll();
+        EXPECT_EQ(std::string(content.cbegin(), content.cend()), "0123ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+        EXPECT_EQ(b.getSize(), 30);
+    };
+
+    f(0);
+    f(1024);
+    blob::setSpillPolicy(64 * 1024, "");
+}
+
+#endif
+
 //========================================================================
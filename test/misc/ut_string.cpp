@@ -152,6 +152,18 @@ TEST(String, decodeURI) {
     EXPECT_THROW(string::decodeURI("a%"),  std::runtime_error);
 }
 
+//--------------------------------------------------------------
+// Test the string::encodeURI() function.
+//--------------------------------------------------------------
+
+TEST(String, encodeURI) {
+    EXPECT_EQ(string::encodeURI(""),                "");
+    EXPECT_EQ(string::encodeURI("/a/b.html"),       "/a/b.html");
+    EXPECT_EQ(string::encodeURI("/a b/c#d?e"),      "/a%20b/c%23d%3Fe");
+    EXPECT_EQ(string::encodeURI("/x=1;y@z~"),       "/x=1;y@z~");
+    EXPECT_EQ(string::encodeURI("/\xC3\xA9%"),      "/%C3%A9%25");
+}
+
 //--------------------------------------------------------------
 // Test the string::encodeHtml() function.
 //--------------------------------------------------------------
@@ -0,0 +1,74 @@
+//========================================================================
+// Zinc - Unit Testing
+// Copyright (c) 2020, Pascal Levy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//========================================================================
+
+#include <string>
+#include "gtest/gtest.h"
+#include "misc/xxhash.h"
+
+//--------------------------------------------------------------
+// Test the XXH64 function.
+//--------------------------------------------------------------
+
+TEST(XXH64, Global) {
+    auto test = [] (std::string const & text, uint64_t seed) {
+        digest::xxh64 hash(seed);
+        hash.update(text.data(), text.size());
+        return hash.finalize();
+    };
+
+    std::string sample;
+    for (int i = 0; i < 1024; i++) {
+        sample.push_back(static_cast<char>(i & 0xFF));
+    }
+
+    EXPECT_EQ(0xEF46DB3751D8E999ULL, test("", 0));
+    EXPECT_EQ(0xD24EC4F1A98C6E5BULL, test("a", 0));
+    EXPECT_EQ(0x44BC2CF5AD770999ULL, test("abc", 0));
+    EXPECT_EQ(0xCFE1F278FA89835CULL, test("abcdefghijklmnopqrstuvwxyz", 0));
+    EXPECT_EQ(0xC7E329301F4E44A4ULL, test("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz0123456789", 0));
+    EXPECT_EQ(0x6F3914F18FE4DF57ULL, test(sample, 0));
+    EXPECT_EQ(0x98B1582B0977E704ULL, test("", 42));
+    EXPECT_EQ(0x13C1D910702770E6ULL, test("abc", 42));
+    EXPECT_EQ(0x4CB9B11211D5B1A0ULL, test(sample, 42));
+}
+
+//--------------------------------------------------------------
+// Test the XXH64 function when data are added in pieces.
+//--------------------------------------------------------------
+
+TEST(XXH64, Streaming) {
+    std::string sample;
+    for (int i = 0; i < 1024; i++) {
+        sample.push_back(static_cast<char>(i & 0xFF));
+    }
+
+    for (size_t step: { 1, 3, 7, 31, 32, 33, 100 }) {
+        digest::xxh64 hash;
+        for (size_t pos = 0; pos < sample.size(); pos += step) {
+            hash.update(sample.data() + pos, std::min(step, sample.size() - pos));
+        }
+        EXPECT_EQ(0x6F3914F18FE4DF57ULL, hash.finalize());
+    }
+}
+
+//========================================================================
@@ -23,6 +23,7 @@
 
 #include <sstream>
 #include <iomanip>
+#include <cstring>
 
 #include "streams.h"
 
@@ -95,3 +96,27 @@ std::string HexDump::getHexContent(size_t n) const {
 }
 
 //========================================================================
+
+//--------------------------------------------------------------
+// Constructor.
+//--------------------------------------------------------------
+
+InputString::InputString(char const * text, size_t length)
+  : text_(text),
+    offset_(0) {
+    length_ = length > 0 ? length : strlen(text);
+}
+
+//--------------------------------------------------------------
+// Read data from the stream.
+//--------------------------------------------------------------
+
+size_t InputString::read(void * data, size_t length, std::chrono::milliseconds /*timeout*/, bool /*exact*/) {
+    size_t count = 0;
+    while (count < length && offset_ < length_) {
+        static_cast<char *>(data)[count++] = text_[offset_++];
+    }
+    return count;
+}
+
+//========================================================================
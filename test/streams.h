@@ -47,6 +47,22 @@ private:
     std::vector<uint8_t> data_;
 };
 
+//--------------------------------------------------------------
+// Helper class to read a string as a stream.
+//--------------------------------------------------------------
+
+class InputString : public InputStream {
+public:
+    InputString(char const * text, size_t length = 0);
+
+    size_t      read(void * data, size_t length, std::chrono::milliseconds timeout, bool exact);
+
+private:
+    char const    * text_;
+    size_t          offset_;
+    size_t          length_;
+};
+
 //--------------------------------------------------------------
 
 #endif